@@ -0,0 +1,75 @@
+#ifndef __BAND_SCHEDULER_H__
+#define __BAND_SCHEDULER_H__
+
+/**
+ * @file band_scheduler.h
+ * @brief Work-stealing distribution of image row bands between workers
+ */
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Range of frames covering one or more whole frame strips
+ */
+struct RowBand {
+    size_t firstFrame;  /**< number of the first frame in the band */
+    size_t framesCount; /**< number of frames in the band */
+};
+
+/**
+ * @brief Split frame grid into row bands that are small enough to balance
+ * the load between workers
+ * @details Band boundaries are calculated from frame indices only, bands
+ * are returned in the top to bottom order; an image with fewer strips than
+ * workers gets a band per strip
+ *
+ * @param framesInStrip number of frames in one frame strip
+ * @param stripsTotal number of frame strips in the image
+ * @param workersNum number of workers that will process the bands
+ */
+std::vector<RowBand> splitIntoRowBands( size_t framesInStrip, size_t stripsTotal,
+                                        size_t workersNum);
+
+/**
+ * @brief Hands out band numbers to workers
+ * @details Every worker starts with its own contiguous range of bands and
+ * takes them from the front; worker that ran out of bands steals the back
+ * half of the largest range left, so slow workers do not hold up the rest
+ */
+class BandScheduler {
+public:
+    /**
+     * @brief Distribute bands evenly between workers
+     *
+     * @param bandsTotal number of bands to distribute
+     * @param workersNum number of workers that will claim the bands
+     */
+    BandScheduler(size_t bandsTotal, size_t workersNum);
+
+    /**
+     * @brief Claim the next band for the worker
+     *
+     * @param worker number of the claiming worker, less than workersNum
+     * @param band set to the claimed band number on success
+     * @return false if there are no bands left to process
+     */
+    bool nextBand(size_t worker, size_t& band);
+
+private:
+    struct BandRange {
+        std::mutex  lock;
+        size_t      next;   /**< first band that is not claimed yet */
+        size_t      end;    /**< band after the last one in range */
+    };
+
+    bool stealBands(size_t thief);
+
+    std::vector< std::unique_ptr<BandRange> > ranges;
+    std::atomic<size_t> steals; /**< number of steals done, a thief that found
+                                    nothing to steal looks again if it grew */
+};
+
+#endif // __BAND_SCHEDULER_H__
@@ -0,0 +1,70 @@
+#ifndef __BATCH_CONVERTER_H__
+#define __BATCH_CONVERTER_H__
+
+/**
+ * @file batch_converter.h
+ * @brief Conversion of many images in one process
+ */
+
+#include <string>
+#include <vector>
+
+#include "settings.h"
+
+/**
+ * @brief Check whether the path has the extension of an image format SDL_image
+ * can decode, regardless of the letter case
+ */
+bool hasImageExtension(const std::string& path);
+
+/**
+ * @brief Get list of images to convert from the batch source
+ * @details Source can be a directory (all files with known image extensions
+ * inside it are taken, subdirectories are not entered), a glob pattern or
+ * a manifest file with one image path per line; empty manifest lines and
+ * lines starting with '#' are skipped
+ *
+ * @param source Directory path, glob pattern or manifest file path
+ * @return Image paths in lexicographical order for directories and globs,
+ * in manifest order for manifests
+ */
+std::vector<std::string> collectBatchImages(const std::string& source);
+
+/**
+ * @brief Get output file path for the image converted in batch mode
+ * @details Image extension is replaced with '.txt'; if output directory
+ * is not empty, the resulting file name is placed there
+ *
+ * @param imagePath Path to the converted image
+ * @param outdir Output directory, can be empty
+ */
+std::string batchOutfilePath(const std::string& imagePath, const std::string& outdir);
+
+/**
+ * @brief Get output file paths for all the images of the batch
+ * @details Images are converted in parallel, so no two of them may share an
+ * output file: images with the same name in different directories written
+ * to one output directory, or images that differ by the extension only,
+ * are refused before anything is converted
+ *
+ * @param images Paths to the converted images
+ * @param outdir Output directory, can be empty
+ * @return Output file paths in the order of the images
+ */
+std::vector<std::string> batchOutfilePaths( const std::vector<std::string>& images,
+                                            const std::string& outdir);
+
+/**
+ * @brief Convert every image from the batch source
+ * @details Font is loaded and the vocabulary is built once for all images;
+ * every image is decoded, matched and written by a single pool task, so
+ * these stages of different images overlap on the worker threads. Failed
+ * images are reported and skipped, aggregate throughput is printed at the end;
+ * nothing is converted if two images would be written to one file
+ *
+ * @param settings Settings with the batch source specified
+ * @return Number of images that failed to convert
+ */
+size_t batchToText(const Settings& settings);
+
+#endif // __BATCH_CONVERTER_H__
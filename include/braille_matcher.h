@@ -0,0 +1,46 @@
+#ifndef __BRAILLE_MATCHER_H__
+#define __BRAILLE_MATCHER_H__
+
+/**
+ * @file braille_matcher.h
+ * @brief Frame matching with Braille patterns built from thresholded dots
+ */
+
+#include "frame_matcher.h"
+#include "freetype_interface.h"
+
+/**
+ * Code point of the Braille pattern without dots, patterns with dots follow
+ * it in the order of their dot bits
+ */
+const code_point BRAILLE_PATTERNS_START = 0x2800;
+
+/**
+ * @brief Matches frames to Braille patterns dot by dot
+ * @details Every frame is split into 2 columns and 4 rows of sub-cells, one
+ * per Braille dot; the dot is raised if the average brightness of its
+ * sub-cell is on the ink side of the middle gray level, which is the dark
+ * side, or the bright one for inverted vocabularies. Raised dots are packed
+ * into the bits of the pattern code point, so no glyphs are compared at all
+ * and the text gets eight times as many brightness samples as symbols
+ */
+class BrailleMatcher : public FrameMatcher {
+public:
+    /**
+     * @brief Take the symbol cell size and the brightness inversion
+     *
+     * @param vocab Vocabulary the frame size is taken from, symbol cells
+     * must be at least 2 pixels wide and 4 pixels high
+     */
+    explicit BrailleMatcher(const GlyphVocabulary& vocab);
+
+    void matchStrip(const FramedBitmap& map, size_t strip,
+                    size_t firstFrame, size_t framesCount,
+                    code_point* matches) const override;
+
+private:
+    uint8_t invertMask; /**< xor-ed with the bits of the sub-cells darker
+                            than the threshold, all ones for bright ink */
+};
+
+#endif // __BRAILLE_MATCHER_H__
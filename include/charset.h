@@ -0,0 +1,75 @@
+#ifndef __CHARSET_H__
+#define __CHARSET_H__
+
+/**
+ * @file charset.h
+ * @brief Symbol sets the vocabularies are built from and their UTF-8 output
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Unicode code point of a symbol
+ */
+typedef uint32_t code_point;
+
+const code_point FIRST_PRINTABLE_ASCII_SYMBOL = ' ';
+const code_point LAST_PRINTABLE_ASCII_SYMBOL  = '~';
+
+/**
+ * @brief Longest UTF-8 sequence of a single code point
+ */
+const size_t MAX_UTF8_SYMBOL_BYTES = 4;
+
+/**
+ * @brief Get the printable ASCII symbols, the default symbol set
+ */
+std::vector<code_point> printableAsciiCharset();
+
+/**
+ * @brief Parse a symbol set description
+ * @details Description is a comma-separated list of set names ('ascii',
+ * 'blocks' for the block elements, 'box' for the box drawing symbols,
+ * 'braille' for the Braille patterns), single code points ('U+2588') and
+ * code point ranges ('U+2580-U+259F'). Repeated code points are kept at the
+ * place of their first appearance
+ *
+ * @param description Symbol set description
+ * @return Code points in the description order
+ */
+std::vector<code_point> parseCharset(const std::string& description);
+
+/**
+ * @brief Read a symbol set from a UTF-8 text file
+ * @details Every symbol of the file but the control ones and the repeated
+ * ones is taken, in the file order
+ *
+ * @param path Path to the file
+ * @return Code points in the file order
+ */
+std::vector<code_point> readCharsetFile(const std::string& path);
+
+/**
+ * @brief Append the symbols that are not in the set yet
+ */
+void mergeCharsets(std::vector<code_point>& charset,
+                    const std::vector<code_point>& symbols);
+
+/**
+ * @brief Encode symbols in UTF-8
+ *
+ * @param symbols Symbols to encode
+ * @param count Number of symbols
+ * @param out Storage for at least count * MAX_UTF8_SYMBOL_BYTES bytes
+ * @return Number of bytes written
+ */
+size_t encodeUtf8(const code_point* symbols, size_t count, char* out);
+
+/**
+ * @brief Append symbols encoded in UTF-8 to the text
+ */
+void appendUtf8(const code_point* symbols, size_t count, std::string& text);
+
+#endif // __CHARSET_H__
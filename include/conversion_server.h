@@ -0,0 +1,259 @@
+#ifndef __CONVERSION_SERVER_H__
+#define __CONVERSION_SERVER_H__
+
+/**
+ * @file conversion_server.h
+ * @brief Conversion daemon serving requests over a Unix domain socket
+ */
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "converter.h"
+#include "settings.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Parsed header line of a conversion request
+ * @details The header is one line of space-separated 'key=value' fields:
+ * 'pixels=<width>x<height> format=<gray8|rgb24|rgb888>' is followed by the
+ * raw rows without padding, 'encoded=<bytes>' is followed by the contents of
+ * an image file, 'image=<path>' names a file readable by the server and must
+ * be the last field, its value runs to the end of the line. 'font=<path>',
+ * 'fontsize=<size>' and 'match=<mean|shape|sad|ssd|braille>' override the server
+ * defaults, sizes go up to 256. Payloads are limited to 128 MiB.
+ * 'keep-alive=1' keeps the connection open for the next request after the
+ * answer. A line with the single word 'stats' asks for the latency metrics
+ */
+struct ConversionRequest {
+    ConversionRequest();
+
+    bool            stats;          /**< metrics are requested, not a conversion */
+    std::string     imagePath;      /**< image file to convert, if not empty */
+    size_t          encodedBytes;   /**< size of the image file that follows */
+    size_t          width;          /**< pixel columns of the raw pixels */
+    size_t          height;         /**< pixel rows of the raw pixels */
+    PixelFormat     format;         /**< layout of the raw pixels */
+    std::string     fontPath;       /**< font override, default if empty */
+    uint_fast16_t   fontSize;       /**< font size override, default if 0 */
+    bool            overrideMatching;   /**< matching is overridden if true */
+    MatchingMode    matching;       /**< matching strategy override */
+    bool            keepAlive;      /**< connection stays open for the next
+                                        request after the answer */
+
+    /**
+     * @brief Get number of payload bytes following the header
+     */
+    size_t payloadBytes() const;
+};
+
+/**
+ * @brief Parse the request header line
+ * @details Errors are reported with std::runtime_error exceptions carrying
+ * the message for the client
+ *
+ * @param line Header line without the trailing '\n'
+ */
+ConversionRequest parseConversionRequest(const std::string& line);
+
+/**
+ * @brief Request latency percentiles and counters of the server
+ */
+struct ServerStats {
+    uint64_t served;        /**< requests answered with text */
+    uint64_t failed;        /**< requests answered with an error */
+    uint64_t rejected;      /**< connections turned away by admission control */
+    uint64_t p50Micros;     /**< latencies from accepting the connection to
+                                sending the answer, over the recent requests */
+    uint64_t p90Micros;
+    uint64_t p99Micros;
+    uint64_t maxMicros;
+};
+
+/**
+ * @brief Print the server counters and latencies, one 'name value' per line
+ */
+void printServerStats(const ServerStats& stats, std::ostream& out);
+
+/**
+ * @brief Latencies of the recent requests
+ * @details Keeps a fixed window of the latest samples, so percentiles follow
+ * the current load; safe to use from several threads
+ */
+class LatencyWindow {
+public:
+    /**
+     * @param capacity Number of latest samples kept
+     */
+    explicit LatencyWindow(size_t capacity);
+
+    void record(uint64_t micros);
+
+    /**
+     * @brief Get the latency percentile of the kept samples, 0 if none
+     *
+     * @param percent Percentile from 0 to 100
+     */
+    uint64_t percentile(double percent) const;
+
+private:
+    mutable std::mutex      lock;
+    std::vector<uint64_t>   samples;
+    size_t                  next;       /**< slot of the next sample */
+    size_t                  count;      /**< samples kept, up to capacity */
+};
+
+/**
+ * @brief Server settings
+ */
+struct ServerOptions {
+    ServerOptions();
+
+    std::string         socketPath;     /**< path of the listening socket */
+    size_t              workers;        /**< requests converted at once */
+    size_t              maxPending;     /**< requests admitted but not yet
+                                            answered; connections above it are
+                                            answered 'BUSY' right away */
+    size_t              maxConverters;  /**< converters kept for the fonts,
+                                            sizes and matching strategies of
+                                            the requests; the least recently
+                                            used one is dropped above it */
+    ConverterOptions    defaults;       /**< converter settings of requests
+                                            without overrides */
+    uint64_t            requestTimeoutMillis;   /**< time to receive a whole
+                                                    request in, counted from
+                                                    its admission */
+};
+
+class RequestReader;
+
+/**
+ * @brief Conversion daemon keeping fonts and vocabularies loaded
+ * @details Admitted requests are queued to the worker pool in arrival order,
+ * and every worker converts one request at a time in its own thread, so that
+ * a burst of requests does not make all of them wait for each other. Kept
+ * alive connections go back to the accept loop between requests, so that
+ * idle clients do not hold workers; requests sent without waiting for the
+ * answers are served one after another by the same worker. A converter is created for every
+ * distinct font, size and matching strategy on its first request, outside
+ * of any lock shared with the other requests, and is kept until it is the
+ * least recently used one of too many. Answers are 'OK <bytes>\n' followed by
+ * the text, 'ERROR <message>\n' or 'BUSY\n'
+ */
+class ConversionServer {
+public:
+    /**
+     * @brief Start listening on the socket
+     * @details Stale socket file left by a previous server is replaced
+     */
+    explicit ConversionServer(const ServerOptions& options);
+
+    /**
+     * @brief Stop listening, finish admitted requests and remove the socket
+     */
+    ~ConversionServer();
+
+    ConversionServer(const ConversionServer&) = delete;
+    ConversionServer& operator=(const ConversionServer&) = delete;
+
+    /**
+     * @brief Make the converter used for requests with the given settings
+     * @details Lets fonts be loaded before the first request, or converters
+     * be built from ready vocabularies; added converters are never dropped
+     */
+    void addConverter(const ConverterOptions& options,
+                        std::unique_ptr<Converter> converter);
+
+    /**
+     * @brief Accept connections until stop() is called
+     */
+    void run();
+
+    /**
+     * @brief Make run() return soon; safe to call from signal handlers
+     */
+    void stop();
+
+    ServerStats stats() const;
+
+private:
+    void acceptConnection();
+
+    void admitConnection(int connection, uint64_t acceptedMicros);
+
+    void serveConnection(int connection, uint64_t acceptedMicros);
+
+    bool serveRequest(int connection, RequestReader& reader, uint64_t startMicros);
+
+    void parkConnection(int connection);
+
+    std::string convertRequest( const ConversionRequest& request,
+                                RequestReader& reader);
+
+    std::shared_ptr<const Converter> converterFor(const ConverterOptions& options);
+
+    void dropLeastRecentConverter();
+
+    ConverterOptions requestOptions(const ConversionRequest& request) const;
+
+    ServerOptions                   options;
+    int                             listener;
+    int                             spareDescriptor;    /**< given up to
+                                                        turn connections away
+                                                        when out of them */
+    int                             wakeRead;   /**< pipe waking the accept
+                                                    loop up when a connection
+                                                    is parked */
+    int                             wakeWrite;
+    std::atomic<bool>               stopping;
+    std::atomic<size_t>             pending;
+    std::atomic<uint64_t>           served;
+    std::atomic<uint64_t>           failed;
+    std::atomic<uint64_t>           rejected;
+    LatencyWindow                   latencies;
+
+    std::mutex                      parkedLock;
+    std::vector<int>                parkedConnections;  /**< kept alive
+                                                        connections not yet
+                                                        taken by the accept
+                                                        loop */
+
+    /**
+     * @brief Converter kept for requests with the same settings
+     * @details Requests coming while the converter is built wait for the
+     * same future; requests in progress keep their converter alive even if
+     * it is dropped meanwhile
+     */
+    struct CachedConverter {
+        std::shared_future< std::shared_ptr<const Converter> > ready;
+        uint64_t    created;    /**< use count when the entry was made */
+        uint64_t    lastUse;    /**< use count of the latest request */
+        bool        pinned;     /**< added with addConverter, never dropped */
+    };
+
+    std::mutex                      convertersLock;
+    std::map<std::string, CachedConverter> converters;
+    uint64_t                        converterUses;
+
+    std::unique_ptr<ThreadPool>     pool;   /**< declared last, so that workers
+                                                are joined before the data
+                                                they use is destroyed */
+};
+
+/**
+ * @brief Run the conversion daemon until SIGINT or SIGTERM
+ * @details Server defaults are taken from the settings; latency metrics are
+ * printed on exit
+ *
+ * @param settings Settings with the socket path specified
+ * @return 0 on clean shutdown
+ */
+int serveConversions(const Settings& settings);
+
+#endif // __CONVERSION_SERVER_H__
@@ -0,0 +1,159 @@
+#ifndef __CONVERSION_STATS_H__
+#define __CONVERSION_STATS_H__
+
+/**
+ * @file conversion_stats.h
+ * @brief Timings of the conversion stages and per-worker counters
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Stages of an image conversion that are timed separately
+ */
+enum ConversionStage {
+    FONT_SETUP_STAGE,       /**< glyph vocabulary load or build */
+    DECODE_STAGE,           /**< reading and decoding of the image file,
+                                binary PGM and PPM images are mapped and
+                                turned to gray levels here */
+    GRAYSCALE_STAGE,        /**< turning decoded pixels to gray levels */
+    INTEGRAL_IMAGE_STAGE,   /**< summed-area table build */
+    PARTITIONING_STAGE,     /**< splitting the frames into row bands */
+    MATCHING_STAGE,         /**< from handing out the bands until the last
+                                one is matched, output of the finished bands
+                                goes on at the same time */
+    OUTPUT_STAGE,           /**< assembling and writing the text */
+    CONVERSION_STAGES_COUNT
+};
+
+/**
+ * @brief Total time of one stage
+ */
+struct StageTiming {
+    uint64_t calls;         /**< times the stage was entered */
+    uint64_t nanoseconds;   /**< wall time spent in the stage */
+};
+
+/**
+ * @brief Work done by one matching worker
+ */
+struct WorkerCounters {
+    uint64_t bands;             /**< row bands matched */
+    uint64_t frames;            /**< frames matched */
+    uint64_t busyNanoseconds;   /**< time spent matching the bands */
+};
+
+/**
+ * @brief Conversion counters collected so far
+ */
+struct ConversionStats {
+    StageTiming                 stages[CONVERSION_STAGES_COUNT];
+    std::vector<WorkerCounters> workers;        /**< by worker number */
+    uint64_t                    bytesWritten;   /**< size of the text */
+};
+
+/**
+ * @brief Get the name of the stage as it is printed in the JSON output
+ */
+const char* conversionStageName(ConversionStage stage);
+
+/**
+ * @brief Print the counters as a JSON object
+ */
+void printConversionStats(const ConversionStats& stats, std::ostream& out);
+
+/**
+ * @brief Print the counters as a JSON object to a file
+ *
+ * @param stats Counters to print
+ * @param path File to write, the standard output is used if empty
+ */
+void saveConversionStats(const ConversionStats& stats, const std::string& path);
+
+/**
+ * @brief Accumulates conversion counters from any number of threads
+ * @details Counters are updated once per stage or per row band, never per
+ * frame; code that is given a null collector skips even the clock reads,
+ * so conversions without statistics pay nothing but a pointer check
+ */
+class StatsCollector {
+public:
+    /**
+     * @param workersNum number of workers counted separately, workers with
+     * greater numbers share the counters modulo this number
+     */
+    explicit StatsCollector(size_t workersNum);
+
+    StatsCollector(const StatsCollector&) = delete;
+    StatsCollector& operator=(const StatsCollector&) = delete;
+
+    /**
+     * @brief Count one more pass through the stage
+     */
+    void addStageTime(ConversionStage stage, uint64_t nanoseconds);
+
+    /**
+     * @brief Count a row band matched by the worker
+     */
+    void addWorkerBand(size_t worker, size_t frames, uint64_t nanoseconds);
+
+    /**
+     * @brief Count bytes of the text produced
+     */
+    void addBytesWritten(uint64_t bytes);
+
+    /**
+     * @brief Get the counters accumulated since the collector was made
+     */
+    ConversionStats stats() const;
+
+    /**
+     * @brief Get monotonic clock reading in nanoseconds
+     */
+    static uint64_t now();
+
+private:
+    struct StageCounters {
+        std::atomic<uint64_t>   calls;
+        std::atomic<uint64_t>   nanoseconds;
+    };
+
+    // every worker writes to its own cache line
+    struct WorkerSlot {
+        std::atomic<uint64_t>   bands;
+        std::atomic<uint64_t>   frames;
+        std::atomic<uint64_t>   busyNanoseconds;
+        char                    padding[64 - 3 * sizeof(uint64_t)];
+    };
+
+    StageCounters                   stages[CONVERSION_STAGES_COUNT];
+    size_t                          workersNum;
+    std::unique_ptr<WorkerSlot[]>   workers;
+    std::atomic<uint64_t>           bytesWritten;
+};
+
+/**
+ * @brief Adds the time from construction to destruction to a stage
+ * @details Does nothing if the collector is null
+ */
+class ScopedStageTimer {
+public:
+    ScopedStageTimer(StatsCollector* collector, ConversionStage stage);
+
+    ~ScopedStageTimer();
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    StatsCollector*     collector;
+    ConversionStage     stage;
+    uint64_t            start;
+};
+
+#endif // __CONVERSION_STATS_H__
@@ -0,0 +1,154 @@
+#ifndef __CONVERTER_H__
+#define __CONVERTER_H__
+
+/**
+ * @file converter.h
+ * @brief Library interface: long-lived image to text converter
+ */
+
+#include <memory>
+#include <string>
+
+#include "settings.h"
+#include "freetype_interface.h"
+#include "frame_matcher.h"
+#include "frame_cache.h"
+#include "error_diffusion.h"
+#include "thread_pool.h"
+#include "conversion_stats.h"
+
+/**
+ * @brief Layouts of in-memory pixel buffers accepted by the converter
+ */
+enum PixelFormat {
+    GRAY8_PIXELS,   /**< one gray level byte per pixel, used without copying */
+    RGB24_PIXELS,   /**< red, green and blue bytes per pixel, as in PPM */
+    RGB888_PIXELS   /**< 0x00RRGGBB 32-bit pixels in native byte order, as
+                        SDL_PIXELFORMAT_RGB888 */
+};
+
+/**
+ * @brief Converter settings, the same as the command-line options
+ * @see Settings
+ */
+struct ConverterOptions {
+    ConverterOptions();
+
+    std::string fontPath;       /**< monospaced scalable font file */
+    uint_fast16_t fontSize;     /**< the smaller it is, the more detailed the
+                                    result is */
+    bool invert;                /**< paint in white over black background */
+    BrightnessEngine engine;    /**< frame brightness calculation method */
+    MatchingMode matching;      /**< strategy of choosing symbols for frames */
+    DitheringMode dithering;    /**< error diffusion of the mean brightness
+                                    matching, the other ones refuse it */
+    size_t shapeGrid;           /**< sub-block rows and columns used by the
+                                    shape matching */
+    size_t frameCacheEntries;   /**< frames the frame-to-symbol cache
+                                    remembers, shared by all conversions;
+                                    cache is off if 0 */
+    size_t threads;             /**< worker threads owned by the converter,
+                                    0 means as much as the hardware supports;
+                                    with 1 every conversion runs in the
+                                    calling thread */
+    std::string vocabularyCacheDir; /**< on-disk glyph vocabulary cache
+                                        directory, cache is off if empty */
+    std::vector<code_point> charset;    /**< symbols to choose from, printable
+                                            ASCII if empty */
+    bool collectStats;          /**< time the conversion stages and count
+                                    the work of every worker */
+};
+
+/**
+ * @brief Image to text converter owning its font data
+ * @details The glyph vocabulary and the matcher are prepared once on
+ * construction and reused by every conversion; no global state is involved,
+ * so converters with different fonts and sizes can live in one process.
+ * convert() and convertFile() can be called from several threads at once
+ */
+class Converter {
+public:
+    /**
+     * @brief Load the font and prepare the matcher
+     *
+     * @param options Converter settings
+     */
+    explicit Converter(const ConverterOptions& options);
+
+    /**
+     * @brief Prepare the matcher for an already built vocabulary
+     *
+     * @param vocab Font data to choose symbols from
+     * @param options Converter settings, font settings are not used
+     */
+    Converter(const GlyphVocabulary& vocab, const ConverterOptions& options);
+
+    Converter(const Converter&) = delete;
+    Converter& operator=(const Converter&) = delete;
+
+    /**
+     * @brief Convert an image in memory
+     * @details Pixels outside the last full row and column of frames are
+     * ignored, as in the command-line tool
+     *
+     * @param pixels first pixel of the image
+     * @param width number of pixel columns
+     * @param height number of pixel rows
+     * @param stride distance between the starts of adjacent rows, in bytes
+     * @param format layout of the pixels
+     * @return UTF-8 text with one line per frame row, every line ends with '\n'
+     */
+    std::string convert(const uint8_t* pixels, size_t width, size_t height,
+                        size_t stride, PixelFormat format) const;
+
+    /**
+     * @brief Convert an image file
+     * @see loadGrayscaleImage()
+     */
+    std::string convertFile(const std::string& path) const;
+
+    /**
+     * @brief Convert an image file that is already in memory
+     * @see decodeGrayscaleImage()
+     */
+    std::string convertEncoded(const uint8_t* bytes, size_t size) const;
+
+    /**
+     * @brief Get the font data the converter chooses symbols from
+     */
+    const GlyphVocabulary& vocabulary() const;
+
+    /**
+     * @brief Get the frame cache usage counters, zeros if it is off
+     */
+    FrameCacheStats frameCacheStats() const;
+
+    /**
+     * @brief Get the stage timings and worker counters summed over all
+     * conversions, zeros if they are not collected
+     */
+    ConversionStats conversionStats() const;
+
+private:
+    void prepareStats(const ConverterOptions& options);
+
+    void prepareMatcher(const ConverterOptions& options);
+
+    std::string convertBitmap(FramedBitmap& map) const;
+
+    GlyphVocabulary                 vocab;
+    BrightnessEngine                engine;
+    size_t                          workersNum;
+    std::unique_ptr<FrameMatcher>   matcher;
+    std::unique_ptr<CachingMatcher> cachingMatcher;
+    const FrameMatcher*             frameMatcher;   /**< cache or matcher */
+    std::unique_ptr<ErrorDiffusion> diffusion;      /**< null if the frames
+                                                        are not dithered */
+    std::unique_ptr<StatsCollector> stats;          /**< null if statistics
+                                                        are not collected */
+    std::unique_ptr<ThreadPool>     pool;           /**< null if conversions
+                                                        run in the calling
+                                                        thread */
+};
+
+#endif // __CONVERTER_H__
@@ -0,0 +1,116 @@
+#ifndef __ERROR_DIFFUSION_H__
+#define __ERROR_DIFFUSION_H__
+
+/**
+ * @file error_diffusion.h
+ * @brief Error diffusion dithering of the mean brightness matching
+ */
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "grayscale_bitmap.h"
+#include "freetype_interface.h"
+#include "conversion_stats.h"
+
+/**
+ * @brief Ways to spread the brightness error of a frame to its neighbours
+ */
+enum DitheringMode {
+    NO_DITHERING,               /**< every frame is matched on its own */
+    FLOYD_STEINBERG_DITHERING,  /**< whole error goes to 4 neighbours */
+    ATKINSON_DITHERING          /**< 3/4 of the error goes to 6 neighbours,
+                                    which keeps flat areas cleaner */
+};
+
+/**
+ * @brief Frame strips of one image shared by the diffusion workers
+ * @details Strips are claimed one by one in the top to bottom order; a strip
+ * is matched in chunks of frames, every chunk waits until the strip above is
+ * far enough ahead that no more error will be added to the frames of the
+ * chunk. Strips are thus matched by a skewed wavefront, as many at once as
+ * there are workers. A worker claims the next strip only after it finished
+ * its previous one, so the lowest unfinished strip never waits and workers
+ * of a shared pool cannot block each other
+ */
+class DiffusionWavefront {
+public:
+    /**
+     * @brief Prepare the error storage and the progress counters
+     *
+     * @param map bitmap with the frame size already set
+     */
+    explicit DiffusionWavefront(const FramedBitmap& map);
+
+    DiffusionWavefront(const DiffusionWavefront&) = delete;
+    DiffusionWavefront& operator=(const DiffusionWavefront&) = delete;
+
+    std::vector<code_point> frameMatches;   /**< symbols matched to frames,
+                                                complete once every worker
+                                                has returned */
+
+private:
+    friend class ErrorDiffusion;
+
+    size_t                                  framesInStrip;
+    size_t                                  stripsTotal;
+    std::atomic<size_t>                     nextStrip;
+    std::unique_ptr<std::atomic<size_t>[]>  stripProgress;  /**< frames
+                                                    matched in every strip */
+    std::vector<int32_t>                    errors; /**< error diffused to every
+                                                    frame so far, in 1/16 of
+                                                    a gray level */
+};
+
+/**
+ * @brief Matches frames to symbols by average brightness, passing on the
+ * difference between the brightness of the frame and the one of its symbol
+ * @details Plain mean brightness matching turns smooth gradients into bands
+ * of the same symbol; with the error diffused to the frames that are not
+ * matched yet, neighbouring symbols alternate so that the average brightness
+ * of an area follows the image
+ */
+class ErrorDiffusion {
+public:
+    /**
+     * @brief Take the brightness lookup table and the symbol brightness
+     *
+     * @param vocab Vocabulary with the lookup table built
+     * @param mode Error distribution, must not be NO_DITHERING
+     */
+    ErrorDiffusion(const GlyphVocabulary& vocab, DitheringMode mode);
+
+    /**
+     * @brief Match strips claimed from the wavefront until none are left
+     * @details Entry point for tasks submitted to the worker threads, any
+     * number of workers give the same symbols
+     *
+     * @param map bitmap with the frame size already set
+     * @param wavefront state of the image shared by the workers
+     * @param worker number of the worker, used for the counters only
+     * @param stats collector of the worker counters, nothing is counted if null
+     */
+    void matchStrips(   const FramedBitmap& map, DiffusionWavefront& wavefront,
+                        size_t worker, StatsCollector* stats = NULL) const;
+
+private:
+    struct Tap {
+        int32_t rows;       /**< strips below the frame */
+        int32_t columns;    /**< frames to the right, negative to the left */
+        int32_t weight;     /**< share of the error in 1/16 */
+    };
+
+    void matchStrip(const FramedBitmap& map, DiffusionWavefront& wavefront,
+                    size_t strip) const;
+
+    std::array<code_point, MAX_GRAY_LEVELS + 1> brightnessLookup;
+    std::array<int32_t, MAX_GRAY_LEVELS + 1>    symbolBrightness; /**< of the
+                                                    symbol chosen for every
+                                                    brightness */
+    std::vector<Tap>    taps;
+    size_t              reach;  /**< farthest tap to the right */
+};
+
+#endif // __ERROR_DIFFUSION_H__
@@ -0,0 +1,118 @@
+#ifndef __FRAME_CACHE_H__
+#define __FRAME_CACHE_H__
+
+/**
+ * @file frame_cache.h
+ * @brief Memoization of frame-to-symbol matches for repeated frames
+ */
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "frame_matcher.h"
+
+/**
+ * @brief Frame cache usage counters
+ */
+struct FrameCacheStats {
+    uint64_t hits;      /**< frames whose symbol was taken from the cache */
+    uint64_t misses;    /**< frames passed on to the wrapped matcher */
+};
+
+/**
+ * Most bytes of frame pixels one cache may keep, whatever number of entries
+ * it was asked for; large fonts get fewer entries
+ */
+const size_t MAX_FRAME_CACHE_BYTES = 64 << 20;
+
+/**
+ * @brief Print the frame cache counters and the hit rate in one line
+ */
+void printFrameCacheStats(const FrameCacheStats& stats, std::ostream& out);
+
+/**
+ * @brief Matcher that remembers symbols chosen for frame contents
+ * @details Frames are looked up by the hash of their pixels in a fixed-size
+ * table split into independently locked shards, so that workers rarely wait
+ * for each other; every entry keeps a copy of the frame pixels, so a hash
+ * collision never gives a wrong symbol. Runs of adjacent frames that are not
+ * in the cache are matched by the wrapped matcher in one call, and the table
+ * entry of the same slot is replaced with the newest frame. Pixels of a slot
+ * are allocated when a frame is first stored there, so the memory used grows
+ * with the distinct frames seen, up to MAX_FRAME_CACHE_BYTES
+ */
+class CachingMatcher : public FrameMatcher {
+public:
+    /**
+     * @brief Make an empty cache in front of the matcher
+     *
+     * @param matcher Matcher of the frames that are not in the cache, must
+     * outlive the cache
+     * @param frameWidth Width of the frames that will be matched
+     * @param frameHeight Height of the frames that will be matched
+     * @param entries Number of frames the cache can remember, at least one;
+     * fewer are kept if their pixels would not fit MAX_FRAME_CACHE_BYTES
+     */
+    CachingMatcher( const FrameMatcher& matcher,
+                    size_t frameWidth, size_t frameHeight, size_t entries);
+
+    CachingMatcher(const CachingMatcher&) = delete;
+    CachingMatcher& operator=(const CachingMatcher&) = delete;
+
+    void matchStrip(const FramedBitmap& map, size_t strip,
+                    size_t firstFrame, size_t framesCount,
+                    code_point* matches) const override;
+
+    /**
+     * @brief Get the usage counters accumulated since the cache was made
+     */
+    FrameCacheStats stats() const;
+
+    /**
+     * @brief Get the number of frames the cache can remember
+     */
+    size_t entries() const;
+
+    /**
+     * @brief Get the number of bytes taken by the table and the stored frames
+     */
+    size_t memoryBytes() const;
+
+private:
+    struct Shard {
+        std::mutex      lock;
+        std::vector<uint64_t>   hashes;     /**< hashes of the stored frames */
+        std::vector<code_point> symbols;    /**< symbols, 0 in empty slots */
+        std::vector<pixels_vector> frames;  /**< stored frame pixels, empty
+                                                until the slot is used */
+        size_t          storedFrames;       /**< slots with pixels allocated */
+        uint64_t        hits;
+        uint64_t        misses;
+    };
+
+    bool lookup(const obj_brightness* frame, uint64_t hash, code_point& symbol) const;
+
+    void store(const obj_brightness* frame, uint64_t hash, code_point symbol) const;
+
+    const FrameMatcher&     matcher;
+    size_t                  frameWidth;
+    size_t                  frameHeight;
+    size_t                  framePixels;
+    size_t                  slotsPerShard;
+    std::vector< std::unique_ptr<Shard> > shards;
+};
+
+/**
+ * @brief Make a cache in front of the matcher for frames of the font size
+ * chosen during the font setup
+ *
+ * @param matcher Matcher of the frames that are not in the cache
+ * @param entries Number of frames the cache can remember
+ * @return null if entries is 0, so that the matcher is used directly
+ */
+std::unique_ptr<CachingMatcher> createFrameCache(const FrameMatcher& matcher,
+                                                 size_t entries);
+
+#endif // __FRAME_CACHE_H__
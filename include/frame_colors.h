@@ -0,0 +1,89 @@
+#ifndef __FRAME_COLORS_H__
+#define __FRAME_COLORS_H__
+
+/**
+ * @file frame_colors.h
+ * @brief Average colors of image frames for the colored output
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Color with 8 bits per channel
+ */
+struct RgbColor {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+/**
+ * @brief Sums up the colors of image frames while the pixels are turned to
+ * gray levels
+ * @details Image decoders pass every pixel row here right before it is
+ * turned to gray levels in place, so chroma is taken in the same pass over
+ * the decoded pixels and no colored copy of the image is kept. Channel sums
+ * of one frame strip are kept at a time; rows and columns outside the last
+ * full strip and frame are skipped, as they are by the matching
+ */
+class FrameColors {
+public:
+    /**
+     * @brief Set the frame size the colors are averaged over
+     *
+     * @param frameWidth frame width in pixels
+     * @param frameHeight frame height in pixels
+     */
+    FrameColors(size_t frameWidth, size_t frameHeight);
+
+    /**
+     * @brief Drop the colors of the previous image and prepare for a new one
+     *
+     * @param columns number of pixel columns of the image
+     * @param rows number of pixel rows of the image
+     */
+    void startImage(size_t columns, size_t rows);
+
+    /**
+     * @brief Add the next pixel row with red, green and blue bytes per pixel
+     */
+    void addRgbRow(const uint8_t* pixels);
+
+    /**
+     * @brief Add the next pixel row of 0x00RRGGBB pixels
+     */
+    void addRgb888Row(const uint32_t* pixels);
+
+    /**
+     * @brief Add the next pixel row of gray levels
+     */
+    void addGrayRow(const uint8_t* grays);
+
+    /**
+     * @brief Get the average colors of the frames added so far, line by line
+     */
+    const std::vector<RgbColor>& colors() const;
+
+    /**
+     * @brief Get how much frames fit in one strip of the image
+     */
+    size_t framesInStrip() const;
+
+private:
+    bool rowNeeded() const;
+
+    void finishRow();
+
+    size_t                  frameWidth;
+    size_t                  frameHeight;
+    size_t                  stripFrames;    /**< frames in one strip */
+    size_t                  stripsTotal;
+    size_t                  nextRow;
+    std::vector<uint32_t>   sums;       /**< red, green and blue sums of every
+                                            frame of the current strip */
+    std::vector<RgbColor>   frameColors;
+};
+
+#endif // __FRAME_COLORS_H__
@@ -0,0 +1,220 @@
+#ifndef __FRAME_KERNELS_H__
+#define __FRAME_KERNELS_H__
+
+/**
+ * @file frame_kernels.h
+ * @brief Vectorized pixel processing routines
+ * @details Implementation (AVX2, SSE2, NEON or plain scalar code) is chosen
+ * once at runtime, according to the instruction sets the CPU supports;
+ * tests can switch between the supported ones
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "grayscale_bitmap.h"
+
+/**
+ * @brief Sum brightness values of a rectangular pixel area
+ *
+ * @param topLeft pointer to the top left pixel of the area
+ * @param stride distance in pixels between the starts of adjacent rows
+ * @param width area width in pixels
+ * @param height area height in pixels
+ */
+uint64_t sumAreaPixels( const obj_brightness* topLeft, size_t stride,
+                        size_t width, size_t height);
+
+/**
+ * @brief Sum brightness values of every frame in a row of adjacent frames
+ * @details Rows of the whole strip are accumulated column-wise with wide
+ * vector additions, then column sums are folded into per-frame sums, so
+ * narrow frames do not waste vector lanes
+ *
+ * @param topLeft pointer to the top left pixel of the first frame
+ * @param stride distance in pixels between the starts of adjacent rows
+ * @param frameWidth frame width in pixels
+ * @param frameHeight frame height in pixels
+ * @param framesCount number of adjacent frames to process
+ * @param sums storage for framesCount resulting sums
+ */
+void sumStripFrames(const obj_brightness* topLeft, size_t stride,
+                    size_t frameWidth, size_t frameHeight,
+                    size_t framesCount, uint32_t* sums);
+
+/**
+ * @brief Sum brightness values of the left and the right part of every frame
+ * in a row of adjacent frames
+ * @details Same as sumStripFrames(), but every frame sum is split in two at
+ * the given column
+ *
+ * @param topLeft pointer to the top left pixel of the first frame
+ * @param stride distance in pixels between the starts of adjacent rows
+ * @param frameWidth frame width in pixels
+ * @param leftWidth width of the left part of a frame in pixels
+ * @param height height of the parts in pixels
+ * @param framesCount number of adjacent frames to process
+ * @param leftSums storage for framesCount sums of the left parts
+ * @param rightSums storage for framesCount sums of the right parts
+ */
+void sumStripFrameHalves(   const obj_brightness* topLeft, size_t stride,
+                            size_t frameWidth, size_t leftWidth, size_t height,
+                            size_t framesCount, uint32_t* leftSums,
+                            uint32_t* rightSums);
+
+/**
+ * @brief Sum brightness values of every column of a pixel area
+ *
+ * @param topLeft pointer to the top left pixel of the area
+ * @param stride distance in pixels between the starts of adjacent rows
+ * @param width area width in pixels
+ * @param height area height in pixels
+ * @param columnSums storage for width resulting sums
+ */
+void sumStripColumns(const obj_brightness* topLeft, size_t stride,
+                    size_t width, size_t height, uint32_t* columnSums);
+
+/**
+ * Number of glyphs the glyph count passed to descriptorDistances() must be
+ * a multiple of
+ */
+const size_t DESCRIPTOR_GLYPHS_ALIGNMENT = 8;
+
+/**
+ * @brief Get squared euclidean distances from the frame descriptor to every
+ * glyph descriptor
+ * @details Glyph descriptors are stored as a structure of arrays of component
+ * pairs: for every pair of descriptor components there is an array of
+ * glyphsCount (first, second) component values, so distances to several
+ * glyphs are calculated with every vector instruction
+ *
+ * @param glyphPairs pairsCount arrays of glyphsCount component pairs
+ * @param pairsCount number of component pairs in a descriptor, descriptors
+ * with odd number of components are padded with a zero component
+ * @param glyphsCount number of glyphs, multiple of DESCRIPTOR_GLYPHS_ALIGNMENT
+ * @param frameDescriptor 2*pairsCount frame descriptor components
+ * @param distances storage for glyphsCount resulting distances
+ */
+void descriptorDistances(   const int16_t* glyphPairs, size_t pairsCount,
+                            size_t glyphsCount, const int16_t* frameDescriptor,
+                            uint32_t* distances);
+
+/**
+ * Number of bytes the cell sizes passed to the cell distance kernels must be
+ * a multiple of; cells aligned to it are loaded without crossing cache lines
+ */
+const size_t CELL_ALIGNMENT = 32;
+
+/**
+ * @brief Get the sum of absolute differences of two pixel cells
+ * @details Calculation stops as soon as the partial sum gets greater than
+ * the bound, so hopeless candidates are rejected early
+ *
+ * @param first pixels of the first cell
+ * @param second pixels of the second cell
+ * @param cellBytes cell size, multiple of CELL_ALIGNMENT; padding pixels must
+ * be equal in both cells
+ * @param bound largest distance the caller is interested in
+ *
+ * @return exact distance if it is not greater than the bound, some value
+ * greater than the bound otherwise
+ */
+uint32_t cellAbsoluteDifference(const obj_brightness* first,
+                                const obj_brightness* second,
+                                size_t cellBytes, uint32_t bound);
+
+/**
+ * @brief Get the sum of squared differences of two pixel cells
+ * @details Same as cellAbsoluteDifference(), but differences are squared;
+ * cells must be 66051 pixels at most for the sum to fit 32 bits
+ *
+ * @see cellAbsoluteDifference()
+ */
+uint32_t cellSquaredDifference( const obj_brightness* first,
+                                const obj_brightness* second,
+                                size_t cellBytes, uint32_t bound);
+
+/**
+ * @brief Set a bit in the flags of every sum below the bound
+ * @details Comparisons of 16 sums are packed into a vector of byte flags at
+ * once, so thresholding costs a few instructions per 16 frames
+ *
+ * @param sums values to compare, each below 2^31
+ * @param count number of sums
+ * @param bound values below this one get the bit set, not above 2^31
+ * @param bit flag bit to set
+ * @param flags count flags the bit is added to
+ */
+void markSumsBelow( const uint32_t* sums, size_t count, uint32_t bound,
+                    uint8_t bit, uint8_t* flags);
+
+/**
+ * Luminance coefficients in the 1.15 fixed point format, they sum up to 1.0
+ * exactly, so the white color stays at the maximum gray level
+ */
+const uint32_t GRAY_FIXED_POINT_SHIFT = 15;
+const uint32_t RED_LUMINANCE    = 6969;     /**< 0.212671 */
+const uint32_t GREEN_LUMINANCE  = 23434;    /**< 0.715160 */
+const uint32_t BLUE_LUMINANCE   = 2365;     /**< 0.072169 */
+
+/**
+ * @brief Convert color components to the gray level
+ * @details Scalar reference for the rgb888RowToGrayscale() results
+ */
+inline obj_brightness rgbToGrayscale(uint32_t r, uint32_t g, uint32_t b) {
+    return (    RED_LUMINANCE   * r
+            +   GREEN_LUMINANCE * g
+            +   BLUE_LUMINANCE  * b) >> GRAY_FIXED_POINT_SHIFT;
+}
+
+/**
+ * @brief Convert one row of SDL_PIXELFORMAT_RGB888 pixels to gray levels
+ *
+ * @param row pointer to the first pixel of the row, 0x00RRGGBB pixels
+ * in native byte order
+ * @param width number of pixels in the row
+ * @param grays storage for width resulting gray levels, may be the row
+ * itself, so that the row is converted in place
+ */
+void rgb888RowToGrayscale(const uint32_t* row, size_t width, obj_brightness* grays);
+
+/**
+ * @brief Convert one row of packed 24-bit RGB pixels to gray levels
+ * @details Results are the same as those of rgb888RowToGrayscale() for the
+ * same colors
+ *
+ * @param row pointer to the first pixel of the row, three bytes per pixel in
+ * the red, green, blue order, as in PPM images
+ * @param width number of pixels in the row
+ * @param grays storage for width resulting gray levels, must not overlap
+ * the row
+ */
+void rgb24RowToGrayscale(const uint8_t* row, size_t width, obj_brightness* grays);
+
+/**
+ * @brief Get the name of the instruction set chosen for the kernels
+ */
+const char* frameKernelsIsa();
+
+/**
+ * @brief Get names of the instruction sets the CPU can run the kernels with
+ * @return Names in the order of preference, "scalar" is always the last one
+ */
+std::vector<std::string> supportedFrameKernelsIsas();
+
+/**
+ * @brief Use the kernels of the given instruction set instead of the one
+ * chosen at startup
+ * @details Meant for tests and benchmarks that compare the implementations;
+ * must not be called while any kernel is running
+ *
+ * @param isa name of the instruction set, as supportedFrameKernelsIsas()
+ * returns it
+ * @return false if the CPU does not support the instruction set, the kernels
+ * are not changed then
+ */
+bool selectFrameKernelsIsa(const std::string& isa);
+
+#endif // __FRAME_KERNELS_H__
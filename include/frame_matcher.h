@@ -0,0 +1,119 @@
+#ifndef __FRAME_MATCHER_H__
+#define __FRAME_MATCHER_H__
+
+/**
+ * @file frame_matcher.h
+ * @brief Strategies of choosing symbols for image frames
+ */
+
+#include <array>
+#include <memory>
+
+#include "grayscale_bitmap.h"
+#include "charset.h"
+
+/**
+ * @brief Ways to choose the best matching symbol for an image frame
+ */
+enum MatchingMode {
+    MEAN_BRIGHTNESS_MATCHING,   /**< compare average brightness only */
+    SHAPE_MATCHING,             /**< compare grids of sub-block brightness */
+    ABSOLUTE_PIXEL_MATCHING,    /**< compare every pixel, sum of absolute
+                                    differences */
+    SQUARED_PIXEL_MATCHING,     /**< compare every pixel, sum of squared
+                                    differences */
+    BRAILLE_MATCHING            /**< threshold 2x4 sub-cells into the dots
+                                    of Braille patterns, no glyphs compared */
+};
+
+struct GlyphVocabulary;
+
+/**
+ * @brief Mapping of rendered glyph brightness to the image brightness range
+ * @details The same mapping the mean brightness vocabulary is built with:
+ * brightness is inverted if the vocabulary is, then the average brightness
+ * of the darkest glyph becomes black and the one of the brightest glyph
+ * becomes white
+ */
+class GlyphBrightnessScale {
+public:
+    explicit GlyphBrightnessScale(const GlyphVocabulary& vocab);
+
+    /**
+     * @brief Map brightness of a glyph cell pixel or a cell part
+     * @return brightness clamped to the range from 0 to MAX_GRAY_LEVELS
+     */
+    obj_brightness operator()(uint32_t cellBrightness) const;
+
+private:
+    bool    invert;
+    int32_t darkest;
+    int32_t range;
+};
+
+/**
+ * @brief Interface of the frame-to-symbol matching strategies
+ * @details Frames are matched strip by strip, so that implementations can
+ * reduce the pixel data of adjacent frames in a single pass; implementations
+ * must allow concurrent calls from several threads
+ */
+class FrameMatcher {
+public:
+    virtual ~FrameMatcher();
+
+    /**
+     * @brief Find symbol matches for adjacent frames of one frame strip
+     *
+     * @param map bitmap with the frame size already set
+     * @param strip number of the strip, counting from the top of the bitmap
+     * @param firstFrame number of the first frame inside the strip
+     * @param framesCount number of frames to match
+     * @param matches storage for framesCount matched symbols
+     */
+    virtual void matchStrip(const FramedBitmap& map, size_t strip,
+                            size_t firstFrame, size_t framesCount,
+                            code_point* matches) const = 0;
+};
+
+/**
+ * @brief Matches frames to symbols with the closest average brightness
+ * @details Uses the brightness lookup table of the vocabulary
+ */
+class MeanBrightnessMatcher : public FrameMatcher {
+public:
+    /**
+     * @brief Take the brightness lookup table
+     *
+     * @param vocab Vocabulary with the lookup table built
+     */
+    explicit MeanBrightnessMatcher(const GlyphVocabulary& vocab);
+
+    void matchStrip(const FramedBitmap& map, size_t strip,
+                    size_t firstFrame, size_t framesCount,
+                    code_point* matches) const override;
+
+private:
+    std::array<code_point, MAX_GRAY_LEVELS + 1> brightnessLookup; /**< best
+                                        matching symbol for every possible
+                                        brightness */
+};
+
+/**
+ * @brief Create the matcher for the vocabulary
+ * @details Matchers keep their own copies of the vocabulary data they need
+ *
+ * @param vocab Vocabulary to choose symbols from
+ * @param mode Matching strategy
+ * @param shapeGrid Number of sub-block rows and columns for shape matching
+ */
+std::unique_ptr<FrameMatcher> createFrameMatcher(   const GlyphVocabulary& vocab,
+                                                    MatchingMode mode,
+                                                    size_t shapeGrid);
+
+/**
+ * @brief Create the matcher for the vocabulary built during the font setup
+ * @see createFrameMatcher(const GlyphVocabulary&, MatchingMode, size_t)
+ */
+std::unique_ptr<FrameMatcher> createFrameMatcher(MatchingMode mode, size_t shapeGrid);
+
+#endif // __FRAME_MATCHER_H__
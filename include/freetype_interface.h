@@ -6,23 +6,89 @@
  * @brief Font library driver
  */
 
+#include <array>
 #include <map>
+#include <string>
+#include <vector>
 #include "grayscale_bitmap.h"
+#include "charset.h"
 
-typedef std::pair<const char, obj_brightness> symbol_brightness_pair;
-typedef std::map< const char, obj_brightness> brihgtness_map;
+typedef std::pair<const code_point, obj_brightness> symbol_brightness_pair;
+typedef std::map< const code_point, obj_brightness> brihgtness_map;
 
 /**
- * @brief Prepare the font data needed to calculate image-to-symbol matches
+ * @brief Font data needed to match image frames to symbols
+ * @details Either built from the font file with FreeType or restored from
+ * the on-disk vocabulary cache
+ */
+struct GlyphVocabulary {
+    uint_fast16_t   fontWidth;          /**< symbol cell width in pixels */
+    uint_fast16_t   fontHeight;         /**< symbol cell height in pixels */
+    bool            invert;             /**< brightness values are inverted */
+    brihgtness_map  brightness;         /**< average brightness of symbols */
+    std::array<code_point, MAX_GRAY_LEVELS + 1> brightnessLookup; /**< best
+                                        matching symbol for every possible
+                                        brightness */
+    std::vector<code_point> glyphSymbols; /**< symbols in the glyph cells
+                                            order */
+    pixels_vector   glyphCells;         /**< rendered symbol cells, each one is
+                                            fontWidth*fontHeight pixels, placed
+                                            one after another */
+};
+
+/**
+ * @brief Build the font data needed to calculate image-to-symbol matches
  * @details Loads the given font file with the given font size and builds
- * the 'vocabulary' of average symbol pixelmap's brightness
+ * the 'vocabulary' of average symbol pixelmap's brightness; no state is
+ * shared between calls, so vocabularies of different fonts and sizes can be
+ * built and used in one process, from several threads at once
  *
  * @param fontpath Path to font file that will be loaded, only monospaced,
  * scalable fonts will be accepted
  * @param fontSize Font size that will be used on symbol pixelmaps retrieval
  * @param invert Invert brightness values in vocabulary if true
+ * @param cacheDir Directory of the vocabulary cache; if the vocabulary for
+ * the same font file contents, size, inversion and symbol set is cached
+ * there, FreeType is not used at all, otherwise the built vocabulary is
+ * stored there. Empty string disables the cache
+ * @param charset Symbols to choose from, printable ASCII if empty; symbols
+ * the font has no glyphs for are left out. Big sets are rendered by several
+ * threads, each with its own FreeType instance
+ */
+GlyphVocabulary loadGlyphVocabulary(const std::string& fontpath,
+                                    uint_fast16_t fontSize, bool invert,
+                                    const std::string& cacheDir = std::string(),
+                                    const std::vector<code_point>& charset
+                                                = std::vector<code_point>());
+
+/**
+ * @brief Build the vocabulary from already rendered glyph cells
+ * @details Average brightness of every cell is spread over the whole range
+ * of gray levels and the brightness lookup table is filled, the same way as
+ * for the cells rendered from a font file
+ *
+ * @param fontWidth symbol cell width in pixels
+ * @param fontHeight symbol cell height in pixels
+ * @param invert Invert brightness values in vocabulary if true
+ * @param symbols symbols of the cells
+ * @param glyphCells cells of the symbols, each one is fontWidth*fontHeight
+ * pixels, in the order of the symbols
  */
-void setupFont(const std::string& fontpath, uint_fast16_t fontSize, bool invert);
+GlyphVocabulary buildGlyphVocabulary(   uint_fast16_t fontWidth,
+                                        uint_fast16_t fontHeight, bool invert,
+                                        const std::vector<code_point>& symbols,
+                                        const pixels_vector& glyphCells);
+
+/**
+ * @brief Prepare the process-wide font data used by the functions below
+ * @details Stores the vocabulary built by loadGlyphVocabulary() for the
+ * command-line tool; not safe to call while other threads use the data,
+ * library users should keep their own vocabularies instead
+ * @see loadGlyphVocabulary(), Converter
+ */
+void setupFont(const std::string& fontpath, uint_fast16_t fontSize, bool invert,
+                const std::string& cacheDir = std::string(),
+                const std::vector<code_point>& charset = std::vector<code_point>());
 
 /**
  * @brief Get font height in pixels
@@ -42,22 +108,27 @@ uint_fast16_t getFontWidth();
  * @details Return the value calculated for the symbol's pixelmap during the
  * brightness vocabulary init
  *
- * @param symbol Printable ASCII symbol for which the brightness value will be
- * retrieved
+ * @param symbol Symbol of the vocabulary for which the brightness value
+ * will be retrieved
  */
-obj_brightness getSymbolBrightness(char symbol);
+obj_brightness getSymbolBrightness(code_point symbol);
 const brihgtness_map& getBrightnessVocabulary();
 
+/**
+ * @brief Get the whole vocabulary built during the font setup
+ */
+const GlyphVocabulary& getGlyphVocabulary();
+
 /**
  * @brief Find the symbol from the brightness vocabulary with the brightness
  * value closest to the requested brightness
+ * @details Answer is taken from the lookup table that is built for every
+ * possible brightness value during the vocabulary init, so the call costs a
+ * single indexed load regardless of the vocabulary size
  *
  * @param targetBrightness Target brightness value
- * @return Best matching printable ASCII symbol
+ * @return Best matching symbol
  */
-char symbolWithBrightnessClosestTo(obj_brightness targetBrightness);
-
-const char FIRST_PRINTABLE_ASCII_SYMBOL = ' ';
-const char LAST_PRINTABLE_ASCII_SYMBOL  = '~';
+code_point symbolWithBrightnessClosestTo(obj_brightness targetBrightness);
 
 #endif // __FREETYPE_INTERFACE_H__
@@ -0,0 +1,92 @@
+#ifndef __GIF_DECODER_H__
+#define __GIF_DECODER_H__
+
+/**
+ * @file gif_decoder.h
+ * @brief Frame-by-frame decoder of animated GIF images
+ */
+
+#include <string>
+#include <vector>
+
+#include "grayscale_bitmap.h"
+
+/**
+ * @brief Check whether the file starts with the GIF87a or GIF89a signature
+ */
+bool isGifFile(const std::string& path);
+
+/**
+ * @brief Decodes GIF frames one at a time onto a gray canvas
+ * @details SDL_image only decodes the first frame of animations, so frames
+ * are decoded here: every frame is drawn over the canvas left by the previous
+ * ones, honoring their disposal methods and transparent colors, so that the
+ * canvas always holds the whole picture as it is shown. Palette colors are
+ * turned to gray levels with the same kernels as the other images
+ */
+class GifDecoder {
+public:
+    /**
+     * @brief Read the file and its header
+     *
+     * @param path Path to a GIF image
+     */
+    explicit GifDecoder(const std::string& path);
+
+    /**
+     * @brief Draw the next frame over the canvas
+     *
+     * @return false if there are no more frames, the canvas is left as is
+     */
+    bool nextFrame();
+
+    /**
+     * @brief Get the composed picture, rows are width() pixels apart
+     * @details Stays valid until the decoder is destroyed; changes with
+     * every nextFrame() call
+     */
+    const obj_brightness* canvas() const;
+
+    size_t width() const;
+    size_t height() const;
+
+private:
+    GifDecoder(const GifDecoder&);
+    GifDecoder& operator=(const GifDecoder&);
+
+    uint8_t nextByte();
+
+    uint16_t nextWord();
+
+    void readPalette(size_t colors, obj_brightness* grays);
+
+    void skipSubBlocks();
+
+    void readGraphicControl();
+
+    void drawImage();
+
+    size_t decodeIndices(size_t minCodeSize, std::vector<uint8_t>& indices);
+
+    void disposePreviousFrame();
+
+    std::string             path;
+    std::vector<uint8_t>    file;           /**< the whole image file */
+    size_t                  pos;            /**< next unread byte of the file */
+    size_t                  canvasWidth;
+    size_t                  canvasHeight;
+    pixels_vector           pixels;         /**< composed picture */
+    pixels_vector           savedPixels;    /**< picture to restore after
+                                                the current frame */
+    obj_brightness          globalGrays[256];
+    obj_brightness          background;     /**< gray level of disposed areas */
+    int                     transparentIndex;   /**< -1 if none */
+    uint8_t                 disposal;       /**< disposal of the next frame */
+    uint8_t                 lastDisposal;   /**< disposal of the drawn frame */
+    size_t                  lastLeft;       /**< area of the drawn frame */
+    size_t                  lastTop;
+    size_t                  lastWidth;
+    size_t                  lastHeight;
+};
+
+#endif // __GIF_DECODER_H__
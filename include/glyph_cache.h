@@ -0,0 +1,77 @@
+#ifndef __GLYPH_CACHE_H__
+#define __GLYPH_CACHE_H__
+
+/**
+ * @file glyph_cache.h
+ * @brief Persistent on-disk storage of built glyph vocabularies
+ */
+
+#include <string>
+#include <vector>
+
+#include "freetype_interface.h"
+
+/**
+ * @brief Everything the vocabulary contents depend on
+ */
+struct VocabularyCacheKey {
+    uint64_t fontHash;      /**< hash of the font file contents */
+    uint64_t fontFileSize;  /**< font file size in bytes */
+    uint32_t fontSize;      /**< font size in points */
+    uint32_t resolution;    /**< font resolution in dots per inch */
+    uint32_t invert;        /**< 1 if brightness values are inverted */
+    uint64_t charsetHash;   /**< hash of the symbol set code points */
+};
+
+/**
+ * @brief Build cache key for the font file and font settings
+ *
+ * @param fontpath Path to the font file, its contents are hashed
+ * @param fontSize Font size in points
+ * @param resolution Font resolution in dots per inch
+ * @param invert True if brightness values in vocabulary are inverted
+ * @param charset Symbols the vocabulary is built from, printable ASCII if
+ * empty
+ */
+VocabularyCacheKey makeVocabularyCacheKey(  const std::string& fontpath,
+                                            uint32_t fontSize,
+                                            uint32_t resolution, bool invert,
+                                            const std::vector<code_point>& charset
+                                                = std::vector<code_point>());
+
+/**
+ * @brief Get the directory used for the cache when none is specified
+ * @details $XDG_CACHE_HOME/img_glypher or $HOME/.cache/img_glypher; empty
+ * string if neither variable is set
+ */
+std::string defaultVocabularyCacheDir();
+
+/**
+ * @brief Restore the vocabulary from the cache file
+ * @details Cache file is memory-mapped and validated; missing, corrupted
+ * or outdated files are treated as cache misses
+ *
+ * @param cacheDir Cache directory
+ * @param key Key of the requested vocabulary
+ * @param vocab Storage for the restored vocabulary, left intact on miss
+ * @return True if the vocabulary was restored
+ */
+bool loadVocabularyCache(   const std::string& cacheDir,
+                            const VocabularyCacheKey& key,
+                            GlyphVocabulary& vocab);
+
+/**
+ * @brief Store the vocabulary to the cache file
+ * @details File is written under a temporary name and then renamed, so
+ * concurrent runs never see partially written files; failures are ignored,
+ * the cache is an optimization only
+ *
+ * @param cacheDir Cache directory, created if missing
+ * @param key Key of the stored vocabulary
+ * @param vocab Vocabulary to store
+ */
+void storeVocabularyCache(  const std::string& cacheDir,
+                            const VocabularyCacheKey& key,
+                            const GlyphVocabulary& vocab);
+
+#endif // __GLYPH_CACHE_H__
@@ -19,6 +19,14 @@ extern "C" {
 typedef uint_fast8_t obj_brightness;
 typedef std::vector<obj_brightness> pixels_vector;
 typedef std::unique_ptr<pixels_vector> unique_pixels_ptr;
+typedef std::vector<uint32_t> integral_vector;
+typedef std::shared_ptr<SDL_Surface> shared_surface_ptr;
+typedef std::shared_ptr<const void> shared_owner_ptr;
+
+class FrameColors;
+
+static_assert(sizeof(obj_brightness) == 1,
+                "gray levels are written over the bytes of image pixels");
 
 /**
  * Brightness level that corresponds to a white-colored pixel
@@ -46,20 +54,82 @@ public:
 
     /**
      * @brief Place SDL_Surface image data into an interface object
+     * @details SDL_PIXELFORMAT_RGB888 surfaces are converted row by row with
+     * vectorized kernels, other formats go through the generic per-pixel path
      *
      * @param  Pointer to a valid SDL_Surface object, not const due to the ways
      * SDL handles conversion of colored images to grayscale
      */
     explicit GrayscaleBitmap(SDL_Surface*);
 
+    /**
+     * @brief Turn SDL_Surface pixels into gray levels in place and view them
+     * @details Gray level of every pixel is written over the first byte of
+     * its row's memory, so rows keep the surface pitch and no other pixel
+     * buffer is allocated; 8-bit surfaces with a gray palette are used as is.
+     * The bitmap shares the surface ownership and keeps it alive
+     *
+     * @param  Surface with the pixels accessible, up to 4 bytes per pixel
+     * @param colors average frame colors are summed up here in the same
+     * pass if not null
+     */
+    explicit GrayscaleBitmap(shared_surface_ptr, FrameColors* colors = NULL);
+
+    /**
+     * @brief Make a black bitmap owning its pixels, to be filled through them
+     *
+     * @param rows Number of pixel rows
+     * @param columns Number of pixel columns
+     */
+    GrayscaleBitmap(size_t rows, size_t columns);
+
+    /**
+     * @brief View gray levels owned elsewhere without copying them
+     *
+     * @param data first pixel of the bitmap
+     * @param rows Number of pixel rows
+     * @param columns Number of pixel columns
+     * @param stride Distance between the starts of adjacent rows, in pixels
+     * @param owner Owner of the pixel memory, kept alive by the bitmap
+     */
+    GrayscaleBitmap(const obj_brightness* data, size_t rows, size_t columns,
+                    size_t stride, shared_owner_ptr owner);
+
+    /**
+     * @brief Copy pixel data into a compact bitmap owning its pixels
+     */
     GrayscaleBitmap(const GrayscaleBitmap&);
 
+    /**
+     * @brief Take over pixel data without copying it
+     */
+    GrayscaleBitmap(GrayscaleBitmap&&);
+
     virtual ~GrayscaleBitmap();
 
+    /**
+     * @brief Get pointer to the first pixel of the bitmap row
+     * @details Pixels of one row are adjacent, the row below starts stride
+     * pixels after the row start
+     */
+    const obj_brightness* rowPixels(size_t row) const {
+        return data + row * stride;
+    }
+
     const size_t rows;              /**< Number of pixel rows in bitmap */
     const size_t columns;           /**< Number of pixel columns in bitmap */
-    const unique_pixels_ptr pixels; /**< Pointer to vector containig pixel data */
+    const size_t stride;            /**< Distance between the starts of adjacent
+                                        pixel rows, in pixels */
+    unique_pixels_ptr pixels;       /**< Pointer to vector containig pixel data
+                                        owned by the bitmap; null for bitmaps
+                                        viewing pixels owned elsewhere */
     const uint_fast8_t num_grays;   /**< Stored gray pixel format */
+
+private:
+    const obj_brightness* data;     /**< first pixel of the bitmap */
+
+protected:
+    shared_owner_ptr owner;         /**< owner of the viewed pixels, if any */
 };
 
 class FrameSlider;
@@ -76,7 +146,35 @@ public:
      * @see GrayscaleBitmap(SDL_Surface*)
      */
     explicit FramedBitmap(SDL_Surface*);
+    /**
+     * @brief View SDL_Surface pixels turned into gray levels in place
+     * @see GrayscaleBitmap(shared_surface_ptr, FrameColors*)
+     */
+    explicit FramedBitmap(shared_surface_ptr, FrameColors* colors = NULL);
+
+    /**
+     * @brief Make a black bitmap owning its pixels
+     * @see GrayscaleBitmap(size_t, size_t)
+     */
+    FramedBitmap(size_t rows, size_t columns);
+
+    /**
+     * @brief View gray levels owned elsewhere
+     * @see GrayscaleBitmap(const obj_brightness*, size_t, size_t, size_t,
+     * shared_owner_ptr)
+     */
+    FramedBitmap(const obj_brightness* data, size_t rows, size_t columns,
+                size_t stride, shared_owner_ptr owner);
     FramedBitmap(const FramedBitmap&);
+    FramedBitmap(FramedBitmap&&);
+
+    /**
+     * @brief Make a bitmap viewing the same pixels, with a frame size of its
+     * own
+     * @details The summed-area table is shared with the view instead of
+     * being copied; pixels owned by this bitmap itself must outlive the view
+     */
+    FramedBitmap view() const;
 
     /**
      * @brief Get frame slider with access to the first bitmap frame
@@ -100,8 +198,61 @@ public:
      */
     size_t countFrames() const;
 
+    /**
+     * @brief Build the summed-area table (integral image) of the bitmap
+     * @details After the table is built, brightness sum of any bitmap area
+     * costs four lookups regardless of the area size; the table does not
+     * depend on the frame size, so it stays valid after setFrameSize()
+     */
+    void buildIntegralImage();
+
+    /**
+     * @brief Check whether the summed-area table was built for the bitmap
+     */
+    bool hasIntegralImage() const;
+
+    /**
+     * @brief Get sum of pixel brightness values inside the bitmap area
+     * @details Requires the summed-area table to be built
+     * @see buildIntegralImage()
+     *
+     * @param leftCol absolute horizontal area position inside the bitmap
+     * @param topRow absolute vertical area position inside the bitmap
+     * @param width area width in pixels
+     * @param height area height in pixels
+     */
+    uint32_t areaBrightnessSum( size_t leftCol, size_t topRow,
+                                size_t width,   size_t height) const;
+
+    /**
+     * @brief Get brightness sums of adjacent frames inside one frame strip
+     * @details Strip is a row of frames spanning the whole bitmap width; sums
+     * are taken from the summed-area table if it was built, otherwise the
+     * strip is reduced with vectorized kernels
+     *
+     * @param strip number of the strip, counting from the top of the bitmap
+     * @param firstFrame number of the first frame inside the strip
+     * @param framesCount number of frames to process
+     * @param sums storage for framesCount resulting sums
+     */
+    void stripBrightnessSums(size_t strip, size_t firstFrame,
+                            size_t framesCount, uint32_t* sums) const;
+
+    /**
+     * @brief Get how much frames with the current size fit in one strip
+     */
+    size_t framesInStrip() const;
+
     size_t frameWidth;  /**< frame width in pixels */
     size_t frameHeight; /**< frame height in pixels */
+
+private:
+    std::shared_ptr<const integral_vector> integral; /**< summed-area table
+                                    with one extra leading row and column of
+                                    zeroes, shared by the copies and views of
+                                    the bitmap; values are allowed to wrap
+                                    around, area sums stay correct as long as
+                                    they fit in 32 bits */
 };
 
 /**
@@ -142,6 +293,13 @@ public:
      */
     size_t size() const;
 
+    /**
+     * @brief Get sum of brightness values of all frame pixels
+     * @details Uses the bitmap's summed-area table if it was built, goes
+     * through frame pixels otherwise
+     */
+    uint64_t brightnessSum() const;
+
     bool operator==(const FrameSlider&) const;
     bool operator!=(const FrameSlider&) const;
 
@@ -6,17 +6,21 @@
  * @brief Multithreaded image processing module
  */
 
+#include <future>
 #include <memory>
 #include <vector>
-#include <atomic>
 
 #include "grayscale_bitmap.h"
+#include "band_scheduler.h"
+#include "frame_matcher.h"
+#include "error_diffusion.h"
+#include "thread_pool.h"
+#include "conversion_stats.h"
 
 /**
  * @brief Image to symbols conversion result storage
  * @details Multiple threads can be assigned with objects of this type
- * to store partial image processing results in them and to organize feedback
- * to the main thread
+ * to store partial image processing results in them
  */
 class ImageToTextResult {
 public:
@@ -26,25 +30,130 @@ public:
      * @param framesQuantity space will be allocated for this number of symbols
      */
     ImageToTextResult(size_t framesQuantity);
-    ImageToTextResult(const ImageToTextResult&);
 
-    std::vector<char>   frameMatches;   /**< symbols that were matched to image
-                                            frames */
-    std::atomic_bool    done;           /**< indicates to the main thread that
-                                            processing of the image part was
-                                            completed */
+    std::vector<code_point> frameMatches;   /**< symbols that were matched
+                                                to image frames */
+    std::promise<void>  done;           /**< fulfilled when all the frames are
+                                            matched, holds the error if
+                                            matching has failed */
 };
 
 /**
  * @brief Find symbol matches for frames in the given frame range
- * @details Entry point for threads spawned by the main thread, frame range is
- * inclusive
+ * @details Errors are not handled here, they are passed on to the caller
  *
- * @param start first frame to find symbol match for
- * @param end last frame to find symbol match for
+ * @param map bitmap with the frame size already set
+ * @param firstFrame number of the first frame to find symbol match for
+ * @param framesCount number of frames to find symbol matches for
+ * @param matcher frame-to-symbol matching strategy
  * @param result storage for symbol matches
  */
-void processImagePart(  FrameSlider &start, const FrameSlider& end,
+void processImagePart(  const FramedBitmap& map,
+                        size_t firstFrame, size_t framesCount,
+                        const FrameMatcher& matcher,
                         ImageToTextResult& result);
 
+/**
+ * @brief Process row bands claimed from the scheduler until none are left
+ * @details Entry point for tasks submitted to the worker threads; completion
+ * or failure of every band is reported through its result's promise
+ *
+ * @param map bitmap with the frame size already set
+ * @param bands all row bands of the bitmap
+ * @param scheduler source of band numbers to process
+ * @param worker number of the worker in the scheduler
+ * @param matcher frame-to-symbol matching strategy
+ * @param results storage for symbol matches, one per band
+ * @param stats collector of the worker counters, nothing is counted if null
+ */
+void processImageBands( const FramedBitmap& map,
+                        const std::vector<RowBand>& bands,
+                        BandScheduler& scheduler, size_t worker,
+                        const FrameMatcher& matcher,
+                        std::vector<ImageToTextResult>& results,
+                        StatsCollector* stats = NULL);
+
+/**
+ * @brief Frames of one bitmap matched to symbols by the workers of a pool
+ * @details Frames are split into row bands handed out by a BandScheduler,
+ * or into the strips of the error diffusion wavefront if they are dithered.
+ * Symbols come out in parts from top to bottom, and every part can be taken
+ * as soon as it is matched, while the parts below it are still matched.
+ * The workers are waited for on destruction, so the bitmap, the matcher and
+ * the pool must outlive the object
+ */
+class FrameMatching {
+public:
+    /**
+     * @brief Split the frames between the workers
+     *
+     * @param map bitmap with the frame size already set
+     * @param matcher frame-to-symbol matching strategy
+     * @param diffusion error diffusion of the frames, the matcher is used if
+     * null
+     * @param workersNum number of workers that will match the frames
+     * @param stats collector of the partitioning time and the worker
+     * counters, nothing is counted if null
+     */
+    FrameMatching(  const FramedBitmap& map, const FrameMatcher& matcher,
+                    const ErrorDiffusion* diffusion, size_t workersNum,
+                    StatsCollector* stats = NULL);
+
+    ~FrameMatching();
+
+    FrameMatching(const FrameMatching&) = delete;
+    FrameMatching& operator=(const FrameMatching&) = delete;
+
+    /**
+     * @brief Hand the frames to the workers
+     *
+     * @param pool pool with as many workers as the matching is split for;
+     * if null, all the frames are matched in the calling thread before
+     * return
+     */
+    void start(ThreadPool* pool);
+
+    /**
+     * @brief Wait until every worker is done, errors are not rethrown here
+     */
+    void wait();
+
+    /**
+     * @brief Get number of parts the symbols come out in
+     */
+    size_t partsCount() const;
+
+    /**
+     * @brief Wait for the part to be matched and take its symbols
+     * @details Rethrows the error if matching of the part has failed; every
+     * part can be taken once
+     *
+     * @param part number of the part, parts go from top to bottom
+     * @return symbols of the part, line by line
+     */
+    std::vector<code_point> takePart(size_t part);
+
+    /**
+     * @brief Wait for all the parts and take their symbols
+     * @return symbols of all the frames, line by line
+     */
+    std::vector<code_point> takeAll();
+
+private:
+    void matchAsWorker(size_t worker);
+
+    const FramedBitmap&                 map;
+    const FrameMatcher&                 matcher;
+    const ErrorDiffusion*               diffusion;
+    size_t                              workersNum;
+    StatsCollector*                     stats;
+    std::vector<RowBand>                bands;
+    std::unique_ptr<BandScheduler>      scheduler;
+    std::vector<ImageToTextResult>      bandResults;
+    std::vector< std::future<void> >    bandDone;
+    std::unique_ptr<DiffusionWavefront> wavefront;  /**< null if the frames
+                                                        are not dithered */
+    std::vector< std::future<void> >    workersDone;
+};
+
 #endif // __IMAGE_PROCESSOR_H__
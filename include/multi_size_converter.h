@@ -0,0 +1,71 @@
+#ifndef __MULTI_SIZE_CONVERTER_H__
+#define __MULTI_SIZE_CONVERTER_H__
+
+/**
+ * @file multi_size_converter.h
+ * @brief Conversion of one image with several font sizes at once
+ */
+
+#include <string>
+#include <vector>
+
+#include "grayscale_bitmap.h"
+#include "freetype_interface.h"
+#include "frame_cache.h"
+#include "settings.h"
+#include "thread_pool.h"
+#include "conversion_stats.h"
+
+/**
+ * @brief Symbols matched to the frames of one font size
+ */
+struct SizeMatches {
+    size_t                  framesInStrip;  /**< symbols in every line */
+    std::vector<code_point> frameMatches;   /**< symbols line by line */
+    FrameCacheStats         frameCache;     /**< usage of the frame cache of
+                                                the size, zeros if it is off */
+};
+
+/**
+ * @brief Match the image with the vocabularies of several font sizes
+ * @details Every size matches a view of the image with its own frame size,
+ * so the pixels and the summed-area table, if it was built, are shared by
+ * all of them. Row bands of all sizes are handed to the same workers, one
+ * size after another, so that the workers done with the bands of one size
+ * go on with the next one instead of waiting
+ *
+ * @param map image, with the summed-area table built if it is to be used
+ * @param vocabs vocabulary of every size
+ * @param settings matching strategy, shape grid, frame cache and dithering
+ * @param pool workers to match the frames on
+ * @param stats collector of the worker counters, nothing is counted if null
+ * @return symbols of every size, in the order of the vocabularies
+ */
+std::vector<SizeMatches> matchImageSizes(   const FramedBitmap& map,
+                                            const std::vector<GlyphVocabulary>& vocabs,
+                                            const Settings& settings,
+                                            ThreadPool& pool,
+                                            StatsCollector* stats = NULL);
+
+/**
+ * @brief Get the output file path of one of several font sizes
+ * @details Size goes before the extension: 'art/cat.txt' of size 8 is
+ * 'art/cat.8.txt'
+ *
+ * @param outfile Output file path given for all the sizes
+ * @param fontSize Font size of the output
+ */
+std::string sizedOutfilePath(const std::string& outfile, uint_fast16_t fontSize);
+
+/**
+ * @brief Convert the image from the settings with every one of its font sizes
+ * @details The image is decoded and turned to gray levels once, while the
+ * vocabularies of all sizes are built by the workers; outputs of all sizes
+ * are written at once
+ *
+ * @param settings Valid settings of the single image conversion with
+ * several font sizes
+ */
+void multiSizeImageToText(const Settings& settings);
+
+#endif // __MULTI_SIZE_CONVERTER_H__
@@ -0,0 +1,80 @@
+#ifndef __NETPBM_READER_H__
+#define __NETPBM_READER_H__
+
+/**
+ * @file netpbm_reader.h
+ * @brief Row-streaming decoder of binary PGM and PPM images
+ */
+
+#include <string>
+#include <vector>
+
+#include "row_source.h"
+#include "frame_colors.h"
+
+/**
+ * @brief Check whether the file starts with the binary PGM (P5) or PPM (P6)
+ * signature
+ */
+bool isRawNetpbmFile(const std::string& path);
+
+/**
+ * @brief Map a binary PGM or PPM file into memory and get its gray levels
+ * @details Raster of 8-bit PGM images is viewed in the mapping as is, without
+ * decoding or copying; 8-bit PPM images are converted to gray levels in one
+ * vectorized pass over the mapping, other sample depths are scaled row by row
+ *
+ * @param path Path to a binary PGM or PPM file
+ * @param colors average frame colors are summed up here in the same pass if
+ * not null
+ */
+FramedBitmap mapNetpbmImage(const std::string& path, FrameColors* colors = NULL);
+
+/**
+ * @brief Reads binary PGM and PPM images row by row
+ * @details Only the rows being read are kept in memory; samples wider than
+ * 8 bits and maximum values other than 255 are scaled to the gray levels,
+ * PPM colors are turned to gray with the vectorized kernels
+ */
+class NetpbmReader : public ImageRowSource {
+public:
+    /**
+     * @brief Open the image and read its header
+     *
+     * @param path Path to a binary PGM or PPM file
+     * @param colors average frame colors of the rows read are summed up here
+     * if not null
+     */
+    explicit NetpbmReader(const std::string& path, FrameColors* colors = NULL);
+
+    ~NetpbmReader();
+
+    void readRows(size_t count, obj_brightness* grays, size_t stride) override;
+
+private:
+    NetpbmReader(const NetpbmReader&);
+    NetpbmReader& operator=(const NetpbmReader&);
+
+    void readHeader();
+
+    int nextHeaderByte();
+
+    void readBytes(uint8_t* bytes, size_t count);
+
+    void rowToGrayscale(const uint8_t* row, obj_brightness* grays);
+
+    std::string             path;
+    int                     fd;
+    std::vector<uint8_t>    buffer;         /**< read-ahead file data */
+    size_t                  bufferPos;
+    size_t                  bufferEnd;
+    size_t                  channels;       /**< 1 for PGM, 3 for PPM */
+    uint32_t                maxValue;       /**< largest sample value */
+    size_t                  sampleBytes;    /**< 1 or 2 bytes per sample */
+    std::vector<uint8_t>    rowBytes;       /**< raw samples of one row */
+    obj_brightness          levels[256];    /**< gray levels of 8-bit samples */
+    FrameColors*            colors;         /**< colors of the rows read are
+                                                summed up here if not null */
+};
+
+#endif // __NETPBM_READER_H__
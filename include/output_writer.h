@@ -0,0 +1,148 @@
+#ifndef __OUTPUT_WRITER_H__
+#define __OUTPUT_WRITER_H__
+
+/**
+ * @file output_writer.h
+ * @brief Buffered output of the matched symbols
+ */
+
+#include <string>
+#include <vector>
+
+#include "charset.h"
+#include "frame_colors.h"
+
+/**
+ * @brief Ways to color the output symbols
+ */
+enum ColorMode {
+    NO_COLOR,           /**< plain text */
+    ANSI_TRUECOLOR,     /**< 24-bit color escape sequences of terminals */
+    ANSI_256_COLOR,     /**< escape sequences of the 256-color terminal
+                            palette, for terminals without 24-bit colors */
+    HTML_COLOR          /**< HTML page with a span for every run of symbols
+                            of the same color */
+};
+
+/**
+ * @brief Writes symbol matches to a file line by line in large blocks
+ * @details Lines are encoded in UTF-8 into a preallocated buffer that is
+ * written with a single system call when full; lines that may not fit into
+ * the whole buffer are encoded and written on their own
+ */
+class TextWriter {
+public:
+    /**
+     * @brief Create or truncate the output file
+     *
+     * @param path Path to the output file
+     * @param bufferSize Size of the line assembly buffer in bytes
+     */
+    explicit TextWriter(const std::string& path, size_t bufferSize = 1 << 20);
+
+    /**
+     * @brief Write out the buffered lines and close the file
+     * @details Errors are not reported here, call flush() to catch them
+     */
+    ~TextWriter();
+
+    /**
+     * @brief Append symbols to the output, ending every line with a newline
+     *
+     * @param symbols Symbols to write
+     * @param symbolsCount Number of symbols to write, a multiple of
+     * symbolsInLine
+     * @param symbolsInLine Number of symbols in one output line
+     */
+    void writeLines(const code_point* symbols, size_t symbolsCount,
+                    size_t symbolsInLine);
+
+    /**
+     * @brief Append bytes to the output as they are
+     *
+     * @param bytes Bytes to write
+     * @param size Number of bytes to write
+     */
+    void write(const char* bytes, size_t size);
+
+    /**
+     * @brief Write out the buffered lines
+     */
+    void flush();
+
+    /**
+     * @brief Get number of bytes passed to the writer so far
+     */
+    size_t bytesWritten() const;
+
+private:
+    TextWriter(const TextWriter&);
+    TextWriter& operator=(const TextWriter&);
+
+    void writeLineDirectly(const code_point* symbols, size_t symbolsInLine);
+
+    std::string         path;
+    int                 fd;
+    std::vector<char>   buffer;
+    size_t              bufferUsed;
+    size_t              bytesTotal;
+};
+
+/**
+ * @brief Writes symbol matches with the colors of their frames
+ * @details Color is set only where it changes along a line, so a run of
+ * symbols of the same color takes a single escape sequence or span; spaces
+ * have no ink to color, so they continue the current run. Every line ends
+ * with the color reset, lines can be shown on their own
+ */
+class ColorTextWriter {
+public:
+    /**
+     * @brief Write the page header if the output is HTML
+     *
+     * @param out Writer of the output file
+     * @param mode Output coloring, not NO_COLOR
+     * @param darkBackground Page background is black instead of white, for
+     * symbols painted in white
+     */
+    ColorTextWriter(TextWriter& out, ColorMode mode, bool darkBackground);
+
+    /**
+     * @brief Append colored symbols to the output, ending every line with
+     * a newline
+     *
+     * @param symbols Symbols to write
+     * @param colors Color of every symbol
+     * @param symbolsCount Number of symbols to write, a multiple of
+     * symbolsInLine
+     * @param symbolsInLine Number of symbols in one output line
+     */
+    void writeLines(const code_point* symbols, const RgbColor* colors,
+                    size_t symbolsCount, size_t symbolsInLine);
+
+    /**
+     * @brief Write the page footer if the output is HTML
+     */
+    void finish();
+
+    /**
+     * @brief Get the index of the 256-color palette entry closest to the color
+     * @details Entries of the 6x6x6 color cube and of the gray ramp are
+     * considered, the 16 system colors differ between terminals
+     */
+    static uint8_t paletteIndex(const RgbColor& color);
+
+private:
+    ColorTextWriter(const ColorTextWriter&);
+    ColorTextWriter& operator=(const ColorTextWriter&);
+
+    void appendColor(const RgbColor& color);
+
+    void appendSymbol(code_point symbol);
+
+    TextWriter&     out;
+    ColorMode       mode;
+    std::string     line;   /**< assembly buffer of one line */
+};
+
+#endif // __OUTPUT_WRITER_H__
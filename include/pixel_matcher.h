@@ -0,0 +1,67 @@
+#ifndef __PIXEL_MATCHER_H__
+#define __PIXEL_MATCHER_H__
+
+/**
+ * @file pixel_matcher.h
+ * @brief Frame matching by comparing every pixel with the glyph cells
+ */
+
+#include <vector>
+
+#include "frame_matcher.h"
+#include "freetype_interface.h"
+
+/**
+ * @brief Ways to measure the difference between a frame and a glyph cell
+ */
+enum PixelMetric {
+    SUM_OF_ABSOLUTE_DIFFERENCES,    /**< SAD, every pixel weighs the same */
+    SUM_OF_SQUARED_DIFFERENCES      /**< SSD, big differences weigh more */
+};
+
+/**
+ * @brief Matches frames to glyphs with the closest pixels
+ * @details Glyph cells are kept brightness-mapped in one contiguous aligned
+ * array. Candidates are tried from the glyph with the closest average
+ * brightness outwards; the difference of brightness sums is a lower bound of
+ * the distance, so the search stops as soon as it exceeds the best distance
+ * found, and distance calculation of a candidate stops as soon as it gets
+ * worse than the best one
+ */
+class PixelMatcher : public FrameMatcher {
+public:
+    /**
+     * @brief Prepare glyph cells
+     *
+     * @param vocab Vocabulary with the glyph cells
+     * @param metric Distance between a frame and a glyph cell
+     */
+    PixelMatcher(const GlyphVocabulary& vocab, PixelMetric metric);
+
+    PixelMatcher(const PixelMatcher&) = delete;
+    PixelMatcher& operator=(const PixelMatcher&) = delete;
+
+    void matchStrip(const FramedBitmap& map, size_t strip,
+                    size_t firstFrame, size_t framesCount,
+                    code_point* matches) const override;
+
+private:
+    void buildGlyphCells(const GlyphVocabulary& vocab);
+
+    code_point closestGlyph(const obj_brightness* frameCell, uint32_t frameSum) const;
+
+    uint32_t sumGapBound(uint32_t firstSum, uint32_t secondSum) const;
+
+    PixelMetric             metric;
+    size_t                  cellPixels;     /**< pixels in a symbol cell */
+    size_t                  cellBytes;      /**< cell size with the padding */
+    std::vector<code_point> glyphSymbols;   /**< symbols in the cells order */
+    std::vector<uint32_t>   glyphOrder;     /**< vocabulary positions of the
+                                                cells, equally close glyphs
+                                                are chosen by it */
+    std::vector<uint32_t>   glyphSums;      /**< cell brightness sums, sorted */
+    pixels_vector           cellsStorage;   /**< cells with room for alignment */
+    const obj_brightness*   cells;          /**< aligned cells in sums order */
+};
+
+#endif // __PIXEL_MATCHER_H__
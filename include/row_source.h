@@ -0,0 +1,47 @@
+#ifndef __ROW_SOURCE_H__
+#define __ROW_SOURCE_H__
+
+/**
+ * @file row_source.h
+ * @brief Sequential access to image rows for the streaming conversion
+ */
+
+#include "grayscale_bitmap.h"
+
+/**
+ * @brief Source of image pixel rows, turned to gray levels, from top to bottom
+ */
+class ImageRowSource {
+public:
+    virtual ~ImageRowSource() {}
+
+    /**
+     * @brief Read the next rows of the image
+     *
+     * @param count number of rows to read, not more than the rows left
+     * @param grays storage for the gray levels of the rows
+     * @param stride distance between the starts of adjacent rows in grays,
+     * in pixels
+     */
+    virtual void readRows(size_t count, obj_brightness* grays, size_t stride) = 0;
+
+    /**
+     * @brief Get number of pixel rows in the image
+     */
+    size_t rows() const { return imageRows; }
+
+    /**
+     * @brief Get number of pixel columns in the image
+     */
+    size_t columns() const { return imageColumns; }
+
+protected:
+    ImageRowSource()
+        : imageRows(0)
+        , imageColumns(0) {}
+
+    size_t imageRows;
+    size_t imageColumns;
+};
+
+#endif // __ROW_SOURCE_H__
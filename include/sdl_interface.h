@@ -8,13 +8,39 @@
 
 #include <string>
 #include "grayscale_bitmap.h"
+#include "conversion_stats.h"
+#include "frame_colors.h"
 
 /**
  * @brief Load pixel data from image file
+ * @details The decoded image is turned to gray levels in place, no other
+ * copy of the pixels is made; binary PGM and PPM files are mapped into
+ * memory instead of being decoded by the image library
+ * @see mapNetpbmImage()
  *
  * @param filepath File path of the image to load
+ * @param stats collector of the decoding and grayscale timings, nothing is
+ * timed if null
+ * @param colors average frame colors are summed up here in the same pass
+ * over the decoded pixels if not null
  * @return Interface object with image data stored inside
  */
-FramedBitmap loadGrayscaleImage(const std::string& filepath);
+FramedBitmap loadGrayscaleImage(const std::string& filepath,
+                                StatsCollector* stats = NULL,
+                                FrameColors* colors = NULL);
+
+/**
+ * @brief Decode an image file that is already in memory
+ * @details Any format the image library knows is accepted, the decoded
+ * image is turned to gray levels in place
+ *
+ * @param bytes Contents of the image file, not needed after the call
+ * @param size Number of bytes, less than 2 GiB
+ * @param stats collector of the decoding and grayscale timings, nothing is
+ * timed if null
+ * @return Interface object with image data stored inside
+ */
+FramedBitmap decodeGrayscaleImage(  const uint8_t* bytes, size_t size,
+                                    StatsCollector* stats = NULL);
 
 #endif // __SDL_INTERFACE_H__
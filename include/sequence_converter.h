@@ -0,0 +1,141 @@
+#ifndef __SEQUENCE_CONVERTER_H__
+#define __SEQUENCE_CONVERTER_H__
+
+/**
+ * @file sequence_converter.h
+ * @brief Conversion of animations and frame sequences with temporal reuse
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame_matcher.h"
+#include "grayscale_bitmap.h"
+#include "settings.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Source of the pictures of an animation, from the first one
+ */
+class FrameSequence {
+public:
+    virtual ~FrameSequence() {}
+
+    /**
+     * @brief Get the next picture
+     * @details The picture may view memory of the sequence, it stays valid
+     * until the next call
+     *
+     * @return null after the last picture
+     */
+    virtual std::unique_ptr<FramedBitmap> nextPicture() = 0;
+};
+
+/**
+ * @brief Open the pictures of an animation
+ * @details Source is a GIF image with all its frames, a directory or
+ * a glob pattern of numbered images taken in the order of the numbers in
+ * their names ('frame2' goes before 'frame10'), or a manifest file with one
+ * image path per line in the manifest order
+ *
+ * @param source GIF path, directory path, glob pattern or manifest path
+ */
+std::unique_ptr<FrameSequence> openFrameSequence(const std::string& source);
+
+/**
+ * @brief Compare paths so that numbers inside them are ordered by value
+ */
+bool naturalPathLess(const std::string& left, const std::string& right);
+
+/**
+ * @brief Matches pictures of a sequence, only where they change
+ * @details Pixels of the last picture are kept; a frame strip whose pixel
+ * rows are all the same as in the last picture keeps its symbols, and only
+ * the changed frames of the other strips are matched again. The first
+ * picture and pictures of a different size are matched whole
+ */
+class TemporalMatcher {
+public:
+    /**
+     * @param matcher frame-to-symbol matching strategy
+     * @param frameWidth frame width in pixels
+     * @param frameHeight frame height in pixels
+     * @param workersNum number of worker threads matching the strips, the
+     * calling thread does all the work if 1
+     */
+    TemporalMatcher(const FrameMatcher& matcher, size_t frameWidth,
+                    size_t frameHeight, size_t workersNum);
+
+    /**
+     * @brief Match the next picture
+     *
+     * @param map the picture, its frame size is set by the call
+     * @return number of frames matched again
+     */
+    size_t update(FramedBitmap& map);
+
+    /**
+     * @brief Get symbols of the last picture, strip by strip
+     */
+    const std::vector<code_point>& symbols() const;
+
+    /**
+     * @brief Get flags of the frames whose symbols differ from the ones of
+     * the picture before, all set after a whole picture match
+     */
+    const std::vector<char>& changedFrames() const;
+
+    /**
+     * @brief Check whether the last picture was matched whole
+     */
+    bool keyframe() const;
+
+    /**
+     * @brief Get number of frames in one strip
+     */
+    size_t framesInStrip() const;
+
+    /**
+     * @brief Get number of frame strips
+     */
+    size_t strips() const;
+
+private:
+    TemporalMatcher(const TemporalMatcher&);
+    TemporalMatcher& operator=(const TemporalMatcher&);
+
+    size_t updateStrip(const FramedBitmap& map, size_t strip);
+
+    const FrameMatcher&         matcher;
+    size_t                      frameWidth;
+    size_t                      frameHeight;
+    size_t                      workersNum;
+    size_t                      stripFrames;
+    size_t                      stripsTotal;
+    bool                        wholeMatch;     /**< last picture matched whole */
+    pixels_vector               previous;       /**< framed part of the last
+                                                    picture, rows are
+                                                    stripFrames * frameWidth
+                                                    pixels long */
+    std::vector<code_point>     matches;
+    std::vector<char>           changed;
+    std::unique_ptr<ThreadPool> pool;           /**< null if strips are matched
+                                                    in the calling thread */
+};
+
+/**
+ * @brief Convert every picture of the sequence from the settings
+ * @details Font is loaded once for the whole sequence. Every picture is
+ * written as 'picture <number> full' followed by its lines; with the diff
+ * output only the first picture and the pictures of a new size are written
+ * that way, the others are written as 'picture <number> diff <runs>' followed
+ * by '<line> <column> <symbols>' lines of the runs of changed symbols, both
+ * counted from 0. Number of matched frames and the conversion rate are
+ * printed at the end
+ *
+ * @param settings Settings with the sequence source specified
+ */
+void sequenceToText(const Settings& settings);
+
+#endif // __SEQUENCE_CONVERTER_H__
@@ -6,6 +6,21 @@
  * @brief User-input settings parser
  */
 
+#include <string>
+#include <vector>
+
+#include "frame_matcher.h"
+#include "error_diffusion.h"
+#include "output_writer.h"
+
+/**
+ * @brief Ways to calculate average brightness of image frames
+ */
+enum BrightnessEngine {
+    PIXEL_SCAN_ENGINE,      /**< go through every pixel of every frame */
+    INTEGRAL_IMAGE_ENGINE   /**< build summed-area table once after image load,
+                                then use four lookups per frame */
+};
 
 /**
  * @brief Object for application's general settings storage and transportation
@@ -19,9 +34,50 @@ struct Settings {
                                 will be used as a reference point to choose
                                 best matching symbols for parts of the image */
     std::string outfile;    /**< Relative or absolute path to the output file */
+    std::string batchSource;/**< Directory, glob pattern or manifest file with
+                                images to convert in batch mode; batch mode
+                                is off if empty */
+    std::string outdir;     /**< Directory for batch mode output files, files
+                                are placed next to images if empty */
+    std::string vocabularyCacheDir; /**< Directory of the on-disk glyph
+                                vocabulary cache, cache is off if empty */
     uint_fast16_t fontSize; /**< Font size that will be used, the smaller it is,
                                 the more detailed the result will be */
+    std::vector<uint_fast16_t> fontSizes; /**< Font sizes of the multi-size
+                                output, each one is written to a file of its
+                                own; one size is converted if empty */
     bool invert;            /**< Paint in white over black background if true */
+    BrightnessEngine engine;/**< Frame brightness calculation method, results
+                                are identical for all of them */
+    size_t threads;         /**< Number of worker threads, 0 means as much as
+                                the hardware supports */
+    MatchingMode matching;  /**< Strategy of choosing symbols for frames */
+    DitheringMode dithering;/**< Error diffusion of the mean brightness
+                                matching, off if NO_DITHERING */
+    ColorMode color;        /**< Coloring of the output symbols with the
+                                average colors of their frames */
+    size_t shapeGrid;       /**< Number of sub-block rows and columns used
+                                by the shape matching */
+    size_t frameCacheEntries;   /**< Number of frames the frame-to-symbol
+                                    cache remembers, cache is off if 0 */
+    bool stream;            /**< Convert the image in chunks of frame strips
+                                instead of loading it whole */
+    std::string sequenceSource; /**< GIF image, directory, glob pattern or
+                                    manifest with the pictures of an
+                                    animation; sequence mode is off if empty */
+    bool sequenceDiffs;     /**< Write pictures of a sequence as changes to
+                                the picture before */
+    std::string serveSocket;/**< Unix socket path to serve conversion
+                                requests on, server mode is off if empty */
+    size_t maxPending;      /**< Requests the server admits before answering
+                                new connections 'BUSY' */
+    bool printStats;        /**< Print timings of the conversion stages and
+                                worker counters as JSON */
+    std::string statsPath;  /**< File for the statistics, they are printed
+                                to the standard output if empty */
+    std::vector<code_point> charset; /**< Symbols to choose from, printable
+                                        ASCII if empty */
+    bool noVocabularyCache; /**< Do not use the glyph vocabulary cache */
     bool abort;             /**< Invalid settings combination detected if true */
 };
 
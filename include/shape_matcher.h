@@ -0,0 +1,57 @@
+#ifndef __SHAPE_MATCHER_H__
+#define __SHAPE_MATCHER_H__
+
+/**
+ * @file shape_matcher.h
+ * @brief Shape-aware frame matching with sub-block brightness descriptors
+ */
+
+#include <vector>
+
+#include "frame_matcher.h"
+#include "freetype_interface.h"
+
+/**
+ * Largest supported number of sub-block rows and columns in a descriptor
+ */
+const size_t MAX_SHAPE_GRID = 4;
+
+/**
+ * @brief Matches frames to symbols by the brightness of their parts
+ * @details Glyph cells and image frames are split into a grid of sub-blocks;
+ * the descriptor of a cell or a frame is the list of sub-block average
+ * brightness values, and the glyph with the descriptor closest to the frame's
+ * one in the euclidean sense is chosen. Glyph descriptors are mapped to the
+ * full brightness range in the same way the mean brightness vocabulary is
+ */
+class ShapeMatcher : public FrameMatcher {
+public:
+    /**
+     * @brief Build glyph descriptors
+     *
+     * @param vocab Vocabulary with the glyph cells
+     * @param grid Number of sub-block rows and columns, from 1 to
+     * MAX_SHAPE_GRID; reduced for symbol cells smaller than the grid
+     */
+    ShapeMatcher(const GlyphVocabulary& vocab, size_t grid);
+
+    void matchStrip(const FramedBitmap& map, size_t strip,
+                    size_t firstFrame, size_t framesCount,
+                    code_point* matches) const override;
+
+private:
+    void buildGlyphDescriptors(const GlyphVocabulary& vocab);
+
+    void stripDescriptors(  const FramedBitmap& map, size_t strip,
+                            size_t firstFrame, size_t framesCount,
+                            int16_t* descriptors) const;
+
+    size_t              grid;           /**< sub-block rows and columns */
+    size_t              pairsCount;     /**< descriptor component pairs */
+    size_t              glyphsCount;    /**< glyphs including the padding */
+    std::vector<code_point> glyphSymbols;   /**< symbols in descriptors order */
+    std::vector<int16_t> glyphPairs;    /**< glyph descriptors, packed as
+                                            descriptorDistances() expects */
+};
+
+#endif // __SHAPE_MATCHER_H__
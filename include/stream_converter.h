@@ -0,0 +1,67 @@
+#ifndef __STREAM_CONVERTER_H__
+#define __STREAM_CONVERTER_H__
+
+/**
+ * @file stream_converter.h
+ * @brief Conversion of images in bands of frame strips with bounded memory
+ */
+
+#include <memory>
+#include <string>
+
+#include "row_source.h"
+#include "settings.h"
+#include "frame_matcher.h"
+#include "thread_pool.h"
+#include "output_writer.h"
+#include "conversion_stats.h"
+
+/**
+ * @brief Open the image for reading row by row
+ * @details Binary PGM and PPM images are decoded from the file as the rows
+ * are read; other formats are decoded whole and turned to gray levels in
+ * place first
+ *
+ * @param path Path to the image
+ * @param stats collector of the timings of the whole image decoding, nothing
+ * is timed if null
+ */
+std::unique_ptr<ImageRowSource> openImageRows( const std::string& path,
+                                                StatsCollector* stats = NULL);
+
+/**
+ * @brief Match the image rows chunk by chunk and write out the lines
+ * @details Two chunk buffers take turns: workers match the frames of one
+ * while the next chunk is decoded into the other, and the lines of every
+ * chunk are written before its buffer is reused. Rows below the last full
+ * frame strip are not read. The output is flushed at the end; matching
+ * and output of all the chunks count as one pass through their stages
+ *
+ * @param source Rows of the image, none of them read yet
+ * @param matcher Frame-to-symbol matching strategy
+ * @param frameWidth Frame width in pixels
+ * @param frameHeight Frame height in pixels
+ * @param chunkStrips Number of frame strips in one chunk
+ * @param engine Frame brightness calculation method
+ * @param pool Workers to match the frames on
+ * @param outfile Writer the lines are appended to
+ * @param stats Collector of the stage timings and the worker counters,
+ * nothing is counted if null
+ */
+void streamRowsToText(  ImageRowSource& source, const FrameMatcher& matcher,
+                        size_t frameWidth, size_t frameHeight, size_t chunkStrips,
+                        BrightnessEngine engine, ThreadPool& pool,
+                        TextWriter& outfile, StatsCollector* stats = NULL);
+
+/**
+ * @brief Convert the image from the settings chunk by chunk
+ * @details Only a few frame strips of the image are in memory at a time:
+ * workers match one chunk while the next one is decoded into the second
+ * buffer, and the lines of every chunk are written out before its buffer is
+ * reused
+ *
+ * @param settings Valid settings of the single image conversion
+ */
+void streamImageToText(const Settings& settings);
+
+#endif // __STREAM_CONVERTER_H__
@@ -0,0 +1,89 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+/**
+ * @file thread_pool.h
+ * @brief Reusable pool of worker threads
+ */
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of worker threads executing submitted tasks in FIFO order
+ * @details Task completion and task errors are reported through the futures
+ * returned on submission; exception thrown by a task is rethrown from the
+ * corresponding future's get()
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Start worker threads
+     *
+     * @param threadsNum number of workers, hardware concurrency is used if 0
+     */
+    explicit ThreadPool(size_t threadsNum = 0);
+
+    /**
+     * @brief Finish all submitted tasks and join worker threads
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Queue a callable object for execution on one of the workers
+     *
+     * @param task callable object without arguments
+     * @return future that becomes ready when the task is done
+     */
+    template<typename Task>
+    std::future<typename std::result_of<Task()>::type> submit(Task task);
+
+    /**
+     * @brief Get number of worker threads
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the number of workers to use when none was requested
+     */
+    static size_t defaultSize();
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop();
+    void stopWorkers();
+
+    std::vector<std::thread>            workers;
+    std::queue< std::function<void()> > tasks;
+    std::mutex                          tasksMutex;
+    std::condition_variable             tasksAvailable;
+    bool                                stopping;
+};
+
+template<typename Task>
+std::future<typename std::result_of<Task()>::type> ThreadPool::submit(Task task) {
+    typedef typename std::result_of<Task()>::type task_result;
+
+    // std::function requires copyable targets, packaged_task is move-only
+    auto packagedTask = std::make_shared< std::packaged_task<task_result()> >(
+                                                                std::move(task));
+    std::future<task_result> result = packagedTask->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.emplace([packagedTask]() { (*packagedTask)(); });
+    }
+    tasksAvailable.notify_one();
+
+    return result;
+}
+
+#endif // __THREAD_POOL_H__
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <atomic>
+
+#include "band_scheduler.h"
+
+// enough bands for the load to even out, not too many to pay for claiming
+static const size_t BANDS_PER_WORKER    = 16;
+static const size_t MIN_FRAMES_PER_BAND = 512;
+
+std::vector<RowBand> splitIntoRowBands( size_t framesInStrip, size_t stripsTotal,
+                                        size_t workersNum) {
+    workersNum           = std::max<size_t>(workersNum, 1);
+    size_t stripsPerBand = stripsTotal / (workersNum * BANDS_PER_WORKER);
+    size_t minStrips     = (MIN_FRAMES_PER_BAND + framesInStrip - 1)
+                            / std::max<size_t>(framesInStrip, 1);
+    // small images are not left to one worker for the sake of the minimum,
+    // every worker gets a band while there are strips enough
+    size_t maxStrips     = (stripsTotal + workersNum - 1) / workersNum;
+    stripsPerBand        = std::max<size_t>(std::min(std::max(stripsPerBand, minStrips),
+                                                     maxStrips), 1);
+
+    std::vector<RowBand> bands;
+    bands.reserve(stripsTotal / stripsPerBand + 1);
+
+    for (size_t strip = 0; strip < stripsTotal; strip += stripsPerBand) {
+        size_t bandStrips = std::min(stripsPerBand, stripsTotal - strip);
+
+        RowBand band = { strip * framesInStrip, bandStrips * framesInStrip };
+        bands.push_back(band);
+    }
+
+    return bands;
+}
+
+BandScheduler::BandScheduler(size_t bandsTotal, size_t workersNum)
+    : steals(0) {
+    ranges.reserve(workersNum);
+
+    for (size_t worker = 0; worker < workersNum; ++worker) {
+        ranges.emplace_back(new BandRange);
+        ranges.back()->next = bandsTotal *  worker      / workersNum;
+        ranges.back()->end  = bandsTotal * (worker + 1) / workersNum;
+    }
+}
+
+bool BandScheduler::nextBand(size_t worker, size_t& band) {
+    BandRange& own = *ranges.at(worker);
+
+    do {
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (own.next < own.end) {
+            band = own.next++;
+            return true;
+        }
+    } while (stealBands(worker));
+
+    return false;
+}
+
+bool BandScheduler::stealBands(size_t thief) {
+    BandRange& own = *ranges.at(thief);
+
+    while (true) {
+        BandRange* victim = nullptr;
+        size_t victimLeft = 0;
+        const size_t stealsBefore = steals.load();
+
+        // sizes can change right after they are read, so the choice is only
+        // a guess, it is checked again when the victim is locked for stealing
+        for (size_t worker = 0; worker < ranges.size(); ++worker) {
+            if (worker == thief) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(ranges[worker]->lock);
+            size_t left = ranges[worker]->end - ranges[worker]->next;
+            if (left > victimLeft) {
+                victim = ranges[worker].get();
+                victimLeft = left;
+            }
+        }
+
+        if (victim == nullptr) {
+            // bands moved by a steal during the scan may have been missed:
+            // a range can be read before it received them and its victim
+            // after it gave them away
+            if (steals.load() != stealsBefore) {
+                continue;
+            }
+            return false;
+        }
+
+        // the stolen bands move between the ranges while both are locked,
+        // so they are never out of sight of the other thieves
+        std::unique_lock<std::mutex> victimLock(victim->lock, std::defer_lock);
+        std::unique_lock<std::mutex> ownLock(own.lock, std::defer_lock);
+        std::lock(victimLock, ownLock);
+
+        size_t left = victim->end - victim->next;
+        if (left == 0) {
+            // victim finished its bands in the meantime, look again
+            continue;
+        }
+
+        own.end     = victim->end;
+        own.next    = victim->next + left / 2;
+        victim->end = own.next;
+        ++steals;
+
+        return true;
+    }
+}
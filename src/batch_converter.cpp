@@ -0,0 +1,265 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+extern "C" {
+    #include <dirent.h>
+    #include <glob.h>
+    #include <sys/stat.h>
+}
+
+#include "batch_converter.h"
+#include "freetype_interface.h"
+#include "sdl_interface.h"
+#include "image_processor.h"
+#include "thread_pool.h"
+#include "output_writer.h"
+#include "frame_cache.h"
+#include "error_diffusion.h"
+
+static bool isDirectory(const std::string& path) {
+    struct stat pathStat;
+    return stat(path.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode);
+}
+
+static bool hasGlobSymbols(const std::string& path) {
+    return path.find_first_of("*?[") != std::string::npos;
+}
+
+static std::string lowercaseExtension(const std::string& path) {
+    size_t nameStart = path.find_last_of('/');
+    size_t dotPos = path.find_last_of('.');
+    if (    dotPos == std::string::npos
+        ||  (nameStart != std::string::npos && dotPos < nameStart)) {
+        return std::string();
+    }
+
+    std::string extension = path.substr(dotPos + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+bool hasImageExtension(const std::string& path) {
+    static const std::vector<std::string> imageExtensions = {
+        "bmp", "gif", "jpeg", "jpg", "lbm", "pcx", "pgm", "png", "pnm", "ppm",
+        "tga", "tif", "tiff", "webp", "xcf", "xpm", "xv"
+    };
+
+    return std::find(imageExtensions.begin(), imageExtensions.end(),
+                    lowercaseExtension(path)) != imageExtensions.end();
+}
+
+static std::vector<std::string> listDirectoryImages(const std::string& dirPath) {
+    DIR* dir = opendir(dirPath.c_str());
+    if (dir == NULL) {
+        throw std::runtime_error("Unable to open directory '" + dirPath + "'");
+    }
+
+    std::vector<std::string> images;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string path = dirPath + '/' + entry->d_name;
+        if (hasImageExtension(path) && !isDirectory(path)) {
+            images.push_back(path);
+        }
+    }
+    closedir(dir);
+
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+static std::vector<std::string> globImages(const std::string& pattern) {
+    glob_t matches;
+    int error = glob(pattern.c_str(), 0, NULL, &matches);
+
+    std::vector<std::string> images;
+    if (error == 0) {
+        images.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+    }
+    globfree(&matches);
+
+    if (error && error != GLOB_NOMATCH) {
+        throw std::runtime_error("Unable to expand pattern '" + pattern + "'");
+    }
+
+    return images;
+}
+
+static std::vector<std::string> readManifest(const std::string& manifestPath) {
+    std::ifstream manifest(manifestPath);
+    if (!manifest) {
+        throw std::runtime_error("Unable to open manifest '" + manifestPath + "'");
+    }
+
+    std::vector<std::string> images;
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (!line.empty() && line[0] != '#') {
+            images.push_back(line);
+        }
+    }
+
+    return images;
+}
+
+std::vector<std::string> collectBatchImages(const std::string& source) {
+    if (isDirectory(source)) {
+        return listDirectoryImages(source);
+    }
+
+    if (hasGlobSymbols(source)) {
+        return globImages(source);
+    }
+
+    return readManifest(source);
+}
+
+std::string batchOutfilePath(const std::string& imagePath, const std::string& outdir) {
+    size_t nameStart = imagePath.find_last_of('/');
+    nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+
+    size_t dotPos = imagePath.find_last_of('.');
+    if (dotPos == std::string::npos || dotPos < nameStart) {
+        dotPos = imagePath.size();
+    }
+
+    if (outdir.empty()) {
+        return imagePath.substr(0, dotPos) + ".txt";
+    }
+
+    return outdir + '/' + imagePath.substr(nameStart, dotPos - nameStart) + ".txt";
+}
+
+std::vector<std::string> batchOutfilePaths( const std::vector<std::string>& images,
+                                            const std::string& outdir) {
+    std::vector<std::string> outfiles;
+    std::unordered_map<std::string, size_t> imageOfOutfile;
+
+    for (size_t image = 0; image < images.size(); ++image) {
+        outfiles.push_back(batchOutfilePath(images[image], outdir));
+
+        auto inserted = imageOfOutfile.insert(std::make_pair(outfiles.back(), image));
+        if (!inserted.second) {
+            const std::string& other = images[inserted.first->second];
+            if (other == images[image]) {
+                throw std::runtime_error("Image '" + other + "' is listed twice");
+            }
+            throw std::runtime_error(   "Images '" + other + "' and '" + images[image]
+                                    +   "' would both be written to '"
+                                    +   outfiles.back() + "'");
+        }
+    }
+
+    return outfiles;
+}
+
+// single image is matched by one worker, images are converted in parallel
+static size_t convertImageSerially( const std::string& imagePath,
+                                    const std::string& outfilePath,
+                                    BrightnessEngine engine,
+                                    const FrameMatcher& matcher,
+                                    const ErrorDiffusion* diffusion) {
+    FramedBitmap map = loadGrayscaleImage(imagePath);
+    map.setFrameSize(getFontWidth(), getFontHeight());
+
+    if (engine == INTEGRAL_IMAGE_ENGINE) {
+        map.buildIntegralImage();
+    }
+
+    const size_t framesTotal = map.countFrames();
+    ImageToTextResult result(framesTotal);
+    if (diffusion) {
+        DiffusionWavefront wavefront(map);
+        diffusion->matchStrips(map, wavefront, 0);
+        result.frameMatches.swap(wavefront.frameMatches);
+    } else if (framesTotal > 0) {
+        processImagePart(map, 0, framesTotal, matcher, result);
+    }
+
+    // whole image text fits the buffer, so it is written with one call
+    const size_t linesTotal = framesTotal > 0 ? framesTotal / map.framesInStrip() : 0;
+    TextWriter outfile(outfilePath, framesTotal + linesTotal);
+    outfile.writeLines( result.frameMatches.data(), framesTotal,
+                        map.framesInStrip());
+    outfile.flush();
+
+    return framesTotal;
+}
+
+size_t batchToText(const Settings& settings) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+
+    std::vector<std::string> images = collectBatchImages(settings.batchSource);
+    std::vector<std::string> outfiles = batchOutfilePaths(images, settings.outdir);
+    setupFont(settings.fontPath, settings.fontSize, settings.invert,
+                settings.vocabularyCacheDir, settings.charset);
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(settings.matching,
+                                                               settings.shapeGrid);
+    // one cache serves all the images, repeated frames are common among them
+    std::unique_ptr<CachingMatcher> cachingMatcher = createFrameCache(
+                                        *matcher, settings.frameCacheEntries);
+    const FrameMatcher& frameMatcher = cachingMatcher ? *cachingMatcher : *matcher;
+    std::unique_ptr<ErrorDiffusion> diffusion;
+    if (settings.dithering != NO_DITHERING) {
+        diffusion.reset(new ErrorDiffusion(getGlyphVocabulary(), settings.dithering));
+    }
+
+    std::atomic<size_t> framesTotal(0);
+    std::atomic<size_t> failuresTotal(0);
+    std::mutex reportMutex;
+
+    {
+        ThreadPool pool(settings.threads);
+
+        for (size_t image = 0; image < images.size(); ++image) {
+            const std::string& imagePath = images[image];
+            const std::string& outfilePath = outfiles[image];
+            pool.submit([&, imagePath, outfilePath]() {
+                try {
+                    framesTotal += convertImageSerially(imagePath, outfilePath,
+                                    settings.engine, frameMatcher,
+                                    diffusion.get());
+                }
+                catch (const std::exception& error) {
+                    ++failuresTotal;
+                    std::lock_guard<std::mutex> lock(reportMutex);
+                    std::cerr << imagePath << ": " << error.what() << std::endl;
+                }
+                catch (...) {
+                    ++failuresTotal;
+                    std::lock_guard<std::mutex> lock(reportMutex);
+                    std::cerr << imagePath << ": unknown exception caught"
+                              << std::endl;
+                }
+            });
+        }
+    }
+
+    std::chrono::duration<double> elapsed = clock::now() - start;
+    size_t converted = images.size() - failuresTotal;
+
+    std::cout   << "Converted " << converted << " of " << images.size()
+                << " images (" << framesTotal << " symbols) in "
+                << elapsed.count() << " s: "
+                << converted / elapsed.count() << " images/s, "
+                << framesTotal / elapsed.count() << " symbols/s" << std::endl;
+
+    if (cachingMatcher) {
+        printFrameCacheStats(cachingMatcher->stats(), std::cout);
+    }
+
+    return failuresTotal;
+}
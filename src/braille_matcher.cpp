@@ -0,0 +1,83 @@
+#include <stdexcept>
+#include <vector>
+
+#include "braille_matcher.h"
+#include "frame_kernels.h"
+
+static const size_t DOT_COLUMNS = 2;
+static const size_t DOT_ROWS    = 4;
+
+// dots 1-3 and 4-6 go down the columns, dots 7 and 8 were added below them
+static const uint8_t DOT_BITS[DOT_ROWS][DOT_COLUMNS] = {
+    { 0x01, 0x08 },
+    { 0x02, 0x10 },
+    { 0x04, 0x20 },
+    { 0x40, 0x80 }
+};
+
+static const uint32_t DOT_THRESHOLD = (MAX_GRAY_LEVELS + 1) / 2;
+
+// sub-cell borders are spread evenly, so sub-cells differ by one pixel at most
+static inline size_t dotBorder(size_t length, size_t dot, size_t dots) {
+    return length * dot / dots;
+}
+
+BrailleMatcher::BrailleMatcher(const GlyphVocabulary& vocab)
+    : invertMask(vocab.invert ? 0xFF : 0x00) {
+    if (vocab.fontWidth < DOT_COLUMNS || vocab.fontHeight < DOT_ROWS) {
+        throw std::runtime_error("Braille matching requires symbol cells of "
+                                 "at least 2x4 pixels");
+    }
+}
+
+void BrailleMatcher::matchStrip(const FramedBitmap& map, size_t strip,
+                                size_t firstFrame, size_t framesCount,
+                                code_point* matches) const {
+    static thread_local std::vector<uint32_t> dotSums;
+    static thread_local std::vector<uint8_t> dots;
+
+    const size_t width      = map.frameWidth;
+    const size_t height     = map.frameHeight;
+    const size_t stripTop   = strip * height;
+    const size_t stripLeft  = firstFrame * width;
+    const size_t middle     = dotBorder(width, 1, DOT_COLUMNS);
+
+    // sums of the left dots are followed by the ones of the right dots
+    dotSums.resize(framesCount * DOT_COLUMNS);
+    dots.assign(framesCount, 0);
+    uint32_t* leftSums  = dotSums.data();
+    uint32_t* rightSums = dotSums.data() + framesCount;
+
+    for (size_t dotRow = 0; dotRow < DOT_ROWS; ++dotRow) {
+        size_t top    = dotBorder(height, dotRow,     DOT_ROWS);
+        size_t bottom = dotBorder(height, dotRow + 1, DOT_ROWS);
+
+        if (map.hasIntegralImage()) {
+            for (size_t frame = 0; frame < framesCount; ++frame) {
+                size_t frameLeft = stripLeft + frame * width;
+                leftSums[frame]  = map.areaBrightnessSum(frameLeft, stripTop + top,
+                                                        middle, bottom - top);
+                rightSums[frame] = map.areaBrightnessSum(frameLeft + middle,
+                                                        stripTop + top,
+                                                        width - middle,
+                                                        bottom - top);
+            }
+        } else {
+            sumStripFrameHalves(map.rowPixels(stripTop + top) + stripLeft,
+                                map.stride, width, middle, bottom - top,
+                                framesCount, leftSums, rightSums);
+        }
+
+        // sums are compared instead of averages, so nothing is divided
+        const uint32_t rows = bottom - top;
+        markSumsBelow(  leftSums, framesCount, DOT_THRESHOLD * middle * rows,
+                        DOT_BITS[dotRow][0], dots.data());
+        markSumsBelow(  rightSums, framesCount,
+                        DOT_THRESHOLD * (width - middle) * rows,
+                        DOT_BITS[dotRow][1], dots.data());
+    }
+
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        matches[frame] = BRAILLE_PATTERNS_START + (dots[frame] ^ invertMask);
+    }
+}
@@ -0,0 +1,201 @@
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "charset.h"
+
+static const code_point MAX_CODE_POINT = 0x10FFFF;
+
+struct CodePointRange {
+    code_point first;
+    code_point last;
+};
+
+static const std::map<std::string, CodePointRange> NAMED_CHARSETS = {
+    {"ascii",   { FIRST_PRINTABLE_ASCII_SYMBOL, LAST_PRINTABLE_ASCII_SYMBOL }},
+    {"blocks",  { 0x2580, 0x259F }},
+    {"box",     { 0x2500, 0x257F }},
+    {"braille", { 0x2800, 0x28FF }}
+};
+
+// control symbols and lone surrogates have no glyphs to draw
+static bool isDrawable(code_point symbol) {
+    return      symbol >= FIRST_PRINTABLE_ASCII_SYMBOL
+            &&  (symbol < 0x7F || symbol > 0x9F)
+            &&  (symbol < 0xD800 || symbol > 0xDFFF)
+            &&  symbol <= MAX_CODE_POINT;
+}
+
+std::vector<code_point> printableAsciiCharset() {
+    std::vector<code_point> charset;
+    for (code_point symbol = FIRST_PRINTABLE_ASCII_SYMBOL;
+                    symbol <= LAST_PRINTABLE_ASCII_SYMBOL; ++symbol) {
+        charset.push_back(symbol);
+    }
+
+    return charset;
+}
+
+static code_point parseCodePoint(const std::string& text) {
+    if (text.size() < 3 || (text.compare(0, 2, "U+") != 0 && text.compare(0, 2, "u+") != 0)) {
+        throw std::runtime_error("Code point '" + text + "' must look like U+2588");
+    }
+
+    // strtoul() would skip spaces and take a sign before the digits
+    char* end = NULL;
+    unsigned long value = std::strtoul(text.c_str() + 2, &end, 16);
+    if (    !std::isxdigit(static_cast<unsigned char>(text[2])) || *end != '\0'
+        ||  value > MAX_CODE_POINT || !isDrawable(static_cast<code_point>(value))) {
+        throw std::runtime_error("'" + text + "' is not a printable code point");
+    }
+
+    return static_cast<code_point>(value);
+}
+
+static CodePointRange parseRange(const std::string& item) {
+    auto named = NAMED_CHARSETS.find(item);
+    if (named != NAMED_CHARSETS.end()) {
+        return named->second;
+    }
+
+    size_t dash = item.find('-');
+    CodePointRange range;
+    range.first = parseCodePoint(item.substr(0, dash));
+    range.last  = dash == std::string::npos ? range.first
+                                            : parseCodePoint(item.substr(dash + 1));
+    if (range.last < range.first) {
+        throw std::runtime_error("Code point range '" + item + "' is reversed");
+    }
+
+    return range;
+}
+
+std::vector<code_point> parseCharset(const std::string& description) {
+    std::vector<code_point> charset;
+    std::stringstream items(description);
+    std::string item;
+
+    while (std::getline(items, item, ',')) {
+        CodePointRange range = parseRange(item);
+
+        std::vector<code_point> symbols;
+        for (code_point symbol = range.first; symbol <= range.last; ++symbol) {
+            if (isDrawable(symbol)) {
+                symbols.push_back(symbol);
+            }
+        }
+        mergeCharsets(charset, symbols);
+    }
+
+    if (charset.empty()) {
+        throw std::runtime_error("Symbol set '" + description + "' is empty");
+    }
+
+    return charset;
+}
+
+// decodes one symbol starting at pos and moves pos past it
+static code_point decodeUtf8Symbol(const std::string& text, size_t& pos) {
+    const uint8_t lead = text[pos++];
+    if (lead < 0x80) {
+        return lead;
+    }
+
+    size_t continuations = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    if (continuations == 0 || lead > 0xF4 || pos + continuations > text.size()) {
+        throw std::runtime_error("Symbol set file is not valid UTF-8");
+    }
+
+    // overlong forms and code points past U+10FFFF have the leads C0, C1
+    // and F5-FF, or a lead that needs a narrower second byte
+    const uint8_t second = text[pos];
+    if (    lead < 0xC2 || (lead == 0xE0 && second < 0xA0)
+        ||  (lead == 0xF0 && second < 0x90) || (lead == 0xF4 && second > 0x8F)) {
+        throw std::runtime_error("Symbol set file is not valid UTF-8");
+    }
+
+    code_point symbol = lead & (0x3F >> continuations);
+    for (size_t byte = 0; byte < continuations; ++byte) {
+        const uint8_t next = text[pos++];
+        if ((next & 0xC0) != 0x80) {
+            throw std::runtime_error("Symbol set file is not valid UTF-8");
+        }
+        symbol = symbol << 6 | (next & 0x3F);
+    }
+
+    return symbol;
+}
+
+std::vector<code_point> readCharsetFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to open symbol set file '" + path + "'");
+    }
+
+    std::string text((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+
+    std::vector<code_point> symbols;
+    for (size_t pos = 0; pos < text.size(); ) {
+        code_point symbol = decodeUtf8Symbol(text, pos);
+        // byte order mark is not a symbol
+        if (isDrawable(symbol) && symbol != 0xFEFF) {
+            symbols.push_back(symbol);
+        }
+    }
+
+    std::vector<code_point> charset;
+    mergeCharsets(charset, symbols);
+    if (charset.empty()) {
+        throw std::runtime_error("No symbols found in '" + path + "'");
+    }
+
+    return charset;
+}
+
+void mergeCharsets(std::vector<code_point>& charset,
+                    const std::vector<code_point>& symbols) {
+    std::unordered_set<code_point> present(charset.begin(), charset.end());
+    for (code_point symbol : symbols) {
+        if (present.insert(symbol).second) {
+            charset.push_back(symbol);
+        }
+    }
+}
+
+size_t encodeUtf8(const code_point* symbols, size_t count, char* out) {
+    char* start = out;
+
+    for (size_t pos = 0; pos < count; ++pos) {
+        const code_point symbol = symbols[pos];
+
+        if (symbol < 0x80) {
+            *out++ = static_cast<char>(symbol);
+        } else if (symbol < 0x800) {
+            *out++ = static_cast<char>(0xC0 | symbol >> 6);
+            *out++ = static_cast<char>(0x80 | (symbol & 0x3F));
+        } else if (symbol < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | symbol >> 12);
+            *out++ = static_cast<char>(0x80 | (symbol >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (symbol & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | symbol >> 18);
+            *out++ = static_cast<char>(0x80 | (symbol >> 12 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (symbol >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (symbol & 0x3F));
+        }
+    }
+
+    return out - start;
+}
+
+void appendUtf8(const code_point* symbols, size_t count, std::string& text) {
+    const size_t oldSize = text.size();
+    text.resize(oldSize + count * MAX_UTF8_SYMBOL_BYTES);
+    text.resize(oldSize + encodeUtf8(symbols, count, &text[oldSize]));
+}
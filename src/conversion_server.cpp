@@ -0,0 +1,867 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+extern "C" {
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+}
+
+#include "conversion_server.h"
+
+// requests larger than this are refused before anything is read; an 8K UHD
+// frame of rgb888 pixels still fits
+static const size_t MAX_PAYLOAD_BYTES       = 128 << 20;
+static const size_t PAYLOAD_CHUNK_BYTES     = 1 << 20;
+static const size_t MAX_HEADER_BYTES        = 4096;
+// every font size builds a vocabulary of its own glyph size
+static const size_t MAX_FONT_SIZE           = 256;
+static const size_t LATENCY_WINDOW_SAMPLES  = 4096;
+static const size_t DEFAULT_MAX_PENDING     = 64;
+static const size_t DEFAULT_MAX_CONVERTERS  = 16;
+
+// a stalled or trickling client must not hold a worker for long
+static const int    CLIENT_TIMEOUT_SECONDS  = 10;
+static const uint64_t DEFAULT_REQUEST_TIMEOUT_MILLIS = CLIENT_TIMEOUT_SECONDS * 1000ULL;
+static const int    ACCEPT_POLL_MILLISECONDS = 200;
+// kept alive connections with no request for this long are closed
+static const uint64_t IDLE_TIMEOUT_MICROS   = 30 * 1000000ULL;
+
+static uint64_t monotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t bytesPerPixel(PixelFormat format) {
+    return format == GRAY8_PIXELS ? 1 : format == RGB24_PIXELS ? 3 : 4;
+}
+
+ConversionRequest::ConversionRequest()
+    : stats(false)
+    , encodedBytes(0)
+    , width(0)
+    , height(0)
+    , format(GRAY8_PIXELS)
+    , fontSize(0)
+    , overrideMatching(false)
+    , matching(MEAN_BRIGHTNESS_MATCHING)
+    , keepAlive(false) {}
+
+size_t ConversionRequest::payloadBytes() const {
+    return encodedBytes + width * height * bytesPerPixel(format);
+}
+
+static size_t parseSize(const std::string& value, const std::string& field,
+                        size_t maxValue = MAX_PAYLOAD_BYTES) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("Invalid number in '" + field + "'");
+    }
+
+    // longer numbers would overflow the conversion
+    unsigned long long number = value.size() > 18 ? ULLONG_MAX : std::stoull(value);
+    if (number > maxValue) {
+        throw std::runtime_error("Value of '" + field + "' is too large");
+    }
+
+    return number;
+}
+
+static PixelFormat parsePixelFormat(const std::string& name) {
+    static const std::map<std::string, PixelFormat> formats = {
+        {"gray8",   GRAY8_PIXELS    },
+        {"rgb24",   RGB24_PIXELS    },
+        {"rgb888",  RGB888_PIXELS   }
+    };
+
+    auto formatIter = formats.find(name);
+    if (formatIter == formats.end()) {
+        throw std::runtime_error("Unknown pixel format '" + name + "'");
+    }
+
+    return formatIter->second;
+}
+
+static MatchingMode parseMatching(const std::string& name) {
+    static const std::map<std::string, MatchingMode> modes = {
+        {"mean",    MEAN_BRIGHTNESS_MATCHING    },
+        {"shape",   SHAPE_MATCHING              },
+        {"sad",     ABSOLUTE_PIXEL_MATCHING     },
+        {"ssd",     SQUARED_PIXEL_MATCHING      },
+        {"braille", BRAILLE_MATCHING            }
+    };
+
+    auto modeIter = modes.find(name);
+    if (modeIter == modes.end()) {
+        throw std::runtime_error("Unknown matching strategy '" + name + "'");
+    }
+
+    return modeIter->second;
+}
+
+ConversionRequest parseConversionRequest(const std::string& line) {
+    ConversionRequest request;
+    if (line == "stats") {
+        request.stats = true;
+        return request;
+    }
+
+    bool hasPixels = false;
+    size_t fieldStart = 0;
+    while (fieldStart < line.size()) {
+        size_t fieldEnd = line.find(' ', fieldStart);
+        if (line.compare(fieldStart, 6, "image=") == 0) {
+            fieldEnd = line.size();
+        } else if (fieldEnd == std::string::npos) {
+            fieldEnd = line.size();
+        }
+
+        std::string field = line.substr(fieldStart, fieldEnd - fieldStart);
+        fieldStart = fieldEnd + 1;
+        if (field.empty()) {
+            continue;
+        }
+
+        size_t separator = field.find('=');
+        if (separator == std::string::npos) {
+            throw std::runtime_error("Field '" + field + "' has no value");
+        }
+        std::string key   = field.substr(0, separator);
+        std::string value = field.substr(separator + 1);
+
+        if (key == "image") {
+            request.imagePath = value;
+        } else if (key == "encoded") {
+            request.encodedBytes = parseSize(value, key);
+        } else if (key == "pixels") {
+            size_t cross = value.find('x');
+            if (cross == std::string::npos) {
+                throw std::runtime_error("Pixels must be given as <width>x<height>");
+            }
+            request.width  = parseSize(value.substr(0, cross), key);
+            request.height = parseSize(value.substr(cross + 1), key);
+            hasPixels = true;
+        } else if (key == "format") {
+            request.format = parsePixelFormat(value);
+        } else if (key == "font") {
+            request.fontPath = value;
+        } else if (key == "fontsize") {
+            request.fontSize = parseSize(value, key, MAX_FONT_SIZE);
+        } else if (key == "match") {
+            request.matching = parseMatching(value);
+            request.overrideMatching = true;
+        } else if (key == "keep-alive") {
+            if (value != "0" && value != "1") {
+                throw std::runtime_error("Value of 'keep-alive' must be 0 or 1");
+            }
+            request.keepAlive = value == "1";
+        } else {
+            throw std::runtime_error("Unknown field '" + key + "'");
+        }
+    }
+
+    size_t sources = !request.imagePath.empty() + (request.encodedBytes > 0)
+                        + hasPixels;
+    if (sources != 1) {
+        throw std::runtime_error("Exactly one of 'image', 'encoded' and 'pixels' "
+                                    "must be given");
+    }
+
+    if (    hasPixels && request.height > 0
+        &&  request.width > MAX_PAYLOAD_BYTES / request.height
+                                / bytesPerPixel(request.format)) {
+        throw std::runtime_error("Image is too large");
+    }
+
+    return request;
+}
+
+void printServerStats(const ServerStats& stats, std::ostream& out) {
+    out << "served "    << stats.served     << '\n'
+        << "failed "    << stats.failed     << '\n'
+        << "rejected "  << stats.rejected   << '\n'
+        << "p50_us "    << stats.p50Micros  << '\n'
+        << "p90_us "    << stats.p90Micros  << '\n'
+        << "p99_us "    << stats.p99Micros  << '\n'
+        << "max_us "    << stats.maxMicros  << '\n';
+}
+
+LatencyWindow::LatencyWindow(size_t capacity)
+    : samples(std::max<size_t>(capacity, 1))
+    , next(0)
+    , count(0) {}
+
+void LatencyWindow::record(uint64_t micros) {
+    std::lock_guard<std::mutex> guard(lock);
+    samples[next] = micros;
+    next  = (next + 1) % samples.size();
+    count = std::min(count + 1, samples.size());
+}
+
+uint64_t LatencyWindow::percentile(double percent) const {
+    std::vector<uint64_t> sorted;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        sorted.assign(samples.begin(), samples.begin() + count);
+    }
+
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    // nearest-rank percentile
+    size_t rank = static_cast<size_t>(std::ceil(percent / 100 * sorted.size()));
+    size_t index = std::min(std::max<size_t>(rank, 1), sorted.size()) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+    return sorted[index];
+}
+
+/**
+ * @brief Buffered reading of the request header and payload
+ */
+class RequestReader {
+public:
+    explicit RequestReader(int _connection)
+        : connection(_connection)
+        , buffer(MAX_HEADER_BYTES)
+        , pos(0)
+        , end(0)
+        , deadlineMicros(0) {}
+
+    /**
+     * @brief Set the time the whole next request must be read by
+     * @details The time is counted for the request as a whole rather than
+     * for every read, so that a client sending a byte at a time can not hold
+     * the worker either
+     */
+    void setDeadline(uint64_t _deadlineMicros) {
+        deadlineMicros = _deadlineMicros;
+    }
+
+    /**
+     * @brief Wait for the next request
+     * @return false if the client has closed the connection instead
+     */
+    bool waitRequest() {
+        if (pos < end) {
+            return true;
+        }
+
+        ssize_t received = receive(buffer.data(), buffer.size());
+        if (received == 0) {
+            return false;
+        }
+        checkReceived(received);
+        pos = 0;
+        end = received;
+        return true;
+    }
+
+    /**
+     * @brief Check if bytes of a request sent after the current one are read
+     */
+    bool hasBuffered() const {
+        return pos < end;
+    }
+
+    std::string readLine() {
+        std::string line;
+        while (true) {
+            if (pos == end) {
+                fill();
+            }
+
+            const char* start   = buffer.data() + pos;
+            const char* newline = static_cast<const char*>(
+                                    memchr(start, '\n', end - pos));
+            size_t taken = newline ? newline - start : end - pos;
+
+            line.append(start, taken);
+            pos += taken;
+            if (line.size() > MAX_HEADER_BYTES) {
+                throw std::runtime_error("Request header is too long");
+            }
+
+            if (newline) {
+                ++pos;
+                return line;
+            }
+        }
+    }
+
+    // the buffer grows as the bytes arrive, so that a header announcing a
+    // big payload takes no memory until the client actually sends it
+    std::vector<uint8_t> readPayload(size_t count) {
+        std::vector<uint8_t> payload;
+        while (payload.size() < count) {
+            size_t done = payload.size();
+            payload.resize(std::min(count, done + PAYLOAD_CHUNK_BYTES));
+            readBytes(payload.data() + done, payload.size() - done);
+        }
+
+        return payload;
+    }
+
+private:
+    void readBytes(uint8_t* bytes, size_t count) {
+        size_t buffered = std::min(count, end - pos);
+        memcpy(bytes, buffer.data() + pos, buffered);
+        pos += buffered;
+
+        for (size_t done = buffered; done < count; ) {
+            ssize_t received = receive(bytes + done, count - done);
+            checkReceived(received);
+            done += received;
+        }
+    }
+
+    // the stop signal may be delivered to a worker in the middle of a read,
+    // admitted requests are still read to the end
+    ssize_t receive(void* bytes, size_t count) {
+        while (true) {
+            uint64_t nowMicros = monotonicMicros();
+            if (nowMicros >= deadlineMicros) {
+                throw std::runtime_error("Request was not received in time");
+            }
+
+            pollfd readable = { connection, POLLIN, 0 };
+            int waitMillis = static_cast<int>(std::min<uint64_t>(
+                                (deadlineMicros - nowMicros + 999) / 1000, INT_MAX));
+            int polled = poll(&readable, 1, waitMillis);
+            if (polled < 0 && errno != EINTR) {
+                return -1;
+            }
+            if (polled <= 0) {
+                continue;
+            }
+
+            ssize_t received = recv(connection, bytes, count, MSG_DONTWAIT);
+            if (received >= 0 || (errno != EINTR && errno != EAGAIN)) {
+                return received;
+            }
+        }
+    }
+
+    void fill() {
+        ssize_t received = receive(buffer.data(), buffer.size());
+        checkReceived(received);
+        pos = 0;
+        end = received;
+    }
+
+    void checkReceived(ssize_t received) {
+        if (received == 0) {
+            throw std::runtime_error("Request ended early");
+        }
+        if (received < 0) {
+            throw std::runtime_error(std::string("Unable to read request: ")
+                                        + strerror(errno));
+        }
+    }
+
+    int                 connection;
+    std::vector<char>   buffer;
+    size_t              pos;
+    size_t              end;
+    uint64_t            deadlineMicros;
+};
+
+static void sendAll(int connection, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(connection, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0) {
+            throw std::runtime_error(std::string("Unable to send answer: ")
+                                        + strerror(errno));
+        }
+
+        data += sent;
+        size -= sent;
+    }
+}
+
+static void sendAll(int connection, const std::string& data) {
+    sendAll(connection, data.data(), data.size());
+}
+
+static std::string converterKey(const ConverterOptions& options) {
+    std::ostringstream key;
+    key << options.fontPath << '\n' << options.fontSize << '\n' << options.matching;
+    return key.str();
+}
+
+ServerOptions::ServerOptions()
+    : workers(ThreadPool::defaultSize())
+    , maxPending(DEFAULT_MAX_PENDING)
+    , maxConverters(DEFAULT_MAX_CONVERTERS)
+    , requestTimeoutMillis(DEFAULT_REQUEST_TIMEOUT_MILLIS) {
+    defaults.threads = 1;
+}
+
+ConversionServer::ConversionServer(const ServerOptions& _options)
+    : options(_options)
+    , listener(-1)
+    , spareDescriptor(-1)
+    , wakeRead(-1)
+    , wakeWrite(-1)
+    , stopping(false)
+    , pending(0)
+    , served(0)
+    , failed(0)
+    , rejected(0)
+    , latencies(LATENCY_WINDOW_SAMPLES)
+    , converterUses(0) {
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path '" + options.socketPath
+                                    + "' is too long");
+    }
+    strcpy(address.sun_path, options.socketPath.c_str());
+
+    // only sockets are replaced, a mistyped path must not delete a file
+    struct stat pathStat;
+    if (lstat(options.socketPath.c_str(), &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+        unlink(options.socketPath.c_str());
+    }
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (    listener < 0
+        ||  bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        ||  listen(listener, SOMAXCONN) != 0) {
+        std::string error = strerror(errno);
+        if (listener >= 0) {
+            close(listener);
+        }
+        throw std::runtime_error("Unable to listen on '" + options.socketPath
+                                    + "': " + error);
+    }
+
+    int wakePipe[2];
+    if (pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        std::string error = strerror(errno);
+        close(listener);
+        throw std::runtime_error("Unable to create the wake-up pipe: " + error);
+    }
+    wakeRead  = wakePipe[0];
+    wakeWrite = wakePipe[1];
+    spareDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    pool.reset(new ThreadPool(options.workers));
+}
+
+ConversionServer::~ConversionServer() {
+    close(listener);
+    unlink(options.socketPath.c_str());
+    // admitted requests are finished before the converters go away
+    pool.reset();
+
+    for (int connection : parkedConnections) {
+        close(connection);
+    }
+    close(wakeRead);
+    close(wakeWrite);
+    if (spareDescriptor >= 0) {
+        close(spareDescriptor);
+    }
+}
+
+void ConversionServer::addConverter(const ConverterOptions& converterOptions,
+                                    std::unique_ptr<Converter> converter) {
+    std::promise< std::shared_ptr<const Converter> > built;
+    built.set_value(std::shared_ptr<const Converter>(std::move(converter)));
+
+    std::lock_guard<std::mutex> guard(convertersLock);
+    CachedConverter& cached = converters[converterKey(converterOptions)];
+    cached.ready    = built.get_future().share();
+    cached.created  = ++converterUses;
+    cached.lastUse  = cached.created;
+    cached.pinned   = true;
+}
+
+/**
+ * @brief Kept alive connection waiting for its next request
+ */
+struct IdleConnection {
+    int         connection;
+    uint64_t    sinceMicros;
+};
+
+void ConversionServer::run() {
+    std::vector<IdleConnection> idle;
+    std::vector<pollfd> polled;
+
+    while (!stopping) {
+        uint64_t nowMicros = monotonicMicros();
+        {
+            std::lock_guard<std::mutex> guard(parkedLock);
+            for (int connection : parkedConnections) {
+                idle.push_back({ connection, nowMicros });
+            }
+            parkedConnections.clear();
+        }
+
+        polled.clear();
+        polled.push_back({ listener, POLLIN, 0 });
+        polled.push_back({ wakeRead, POLLIN, 0 });
+        for (const IdleConnection& waiting : idle) {
+            polled.push_back({ waiting.connection, POLLIN, 0 });
+        }
+
+        int ready = poll(polled.data(), polled.size(), ACCEPT_POLL_MILLISECONDS);
+        if (ready < 0) {
+            continue;
+        }
+
+        if (polled[1].revents != 0) {
+            char wakeBytes[64];
+            while (read(wakeRead, wakeBytes, sizeof(wakeBytes)) > 0) {}
+        }
+
+        // connections with a new request, or closed by their clients, are
+        // served like the new ones
+        nowMicros = monotonicMicros();
+        size_t kept = 0;
+        for (size_t waiting = 0; waiting < idle.size(); ++waiting) {
+            if (polled[waiting + 2].revents != 0) {
+                admitConnection(idle[waiting].connection, nowMicros);
+            } else if (nowMicros - idle[waiting].sinceMicros > IDLE_TIMEOUT_MICROS) {
+                close(idle[waiting].connection);
+            } else {
+                idle[kept++] = idle[waiting];
+            }
+        }
+        idle.resize(kept);
+
+        if (polled[0].revents != 0) {
+            acceptConnection();
+        }
+    }
+
+    for (const IdleConnection& waiting : idle) {
+        close(waiting.connection);
+    }
+}
+
+void ConversionServer::acceptConnection() {
+    int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+
+    // out of descriptors the listener stays readable, so the waiting client
+    // is taken with the spare descriptor and turned away, or the loop backs
+    // off if there is no spare one left
+    if (connection < 0 && (errno == EMFILE || errno == ENFILE)) {
+        if (spareDescriptor < 0) {
+            poll(NULL, 0, ACCEPT_POLL_MILLISECONDS);
+        } else {
+            close(spareDescriptor);
+            connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+            if (connection >= 0) {
+                ++rejected;
+                try {
+                    sendAll(connection, "BUSY\n");
+                }
+                catch (const std::exception&) {}
+                close(connection);
+            }
+            spareDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+        return;
+    }
+
+    if (connection >= 0) {
+        admitConnection(connection, monotonicMicros());
+    }
+}
+
+void ConversionServer::admitConnection(int connection, uint64_t acceptedMicros) {
+    // answering at once keeps the latency of admitted requests bounded
+    if (pending >= options.maxPending) {
+        ++rejected;
+        try {
+            sendAll(connection, "BUSY\n");
+        }
+        catch (const std::exception&) {}
+        close(connection);
+        return;
+    }
+
+    ++pending;
+    pool->submit([this, connection, acceptedMicros]() {
+        serveConnection(connection, acceptedMicros);
+    });
+}
+
+void ConversionServer::parkConnection(int connection) {
+    {
+        std::lock_guard<std::mutex> guard(parkedLock);
+        parkedConnections.push_back(connection);
+    }
+
+    const char wakeByte = 0;
+    if (write(wakeWrite, &wakeByte, 1) < 0) {
+        // the pipe is full, so the loop is being woken up already
+    }
+}
+
+void ConversionServer::stop() {
+    stopping = true;
+}
+
+ServerStats ConversionServer::stats() const {
+    ServerStats current;
+    current.served      = served;
+    current.failed      = failed;
+    current.rejected    = rejected;
+    current.p50Micros   = latencies.percentile(50);
+    current.p90Micros   = latencies.percentile(90);
+    current.p99Micros   = latencies.percentile(99);
+    current.maxMicros   = latencies.percentile(100);
+
+    return current;
+}
+
+ConverterOptions ConversionServer::requestOptions(const ConversionRequest& request) const {
+    ConverterOptions converterOptions = options.defaults;
+    if (!request.fontPath.empty()) {
+        converterOptions.fontPath = request.fontPath;
+    }
+    if (request.fontSize > 0) {
+        converterOptions.fontSize = request.fontSize;
+    }
+    // default dithering goes with the default matching, requests that pick
+    // a matching without brightness error to diffuse do without it
+    if (request.overrideMatching) {
+        converterOptions.matching = request.matching;
+        if (request.matching != MEAN_BRIGHTNESS_MATCHING) {
+            converterOptions.dithering = NO_DITHERING;
+        }
+    }
+
+    // requests are spread over the server workers, not over converter ones
+    converterOptions.threads = 1;
+
+    return converterOptions;
+}
+
+// the first request of a font builds its converter without holding the lock,
+// so requests with converters ready are not held up by it; the requests that
+// come meanwhile wait for the same build
+std::shared_ptr<const Converter> ConversionServer::converterFor(
+                                    const ConverterOptions& converterOptions) {
+    const std::string key = converterKey(converterOptions);
+    std::promise< std::shared_ptr<const Converter> > building;
+    std::shared_future< std::shared_ptr<const Converter> > ready;
+    uint64_t created = 0;
+    {
+        std::lock_guard<std::mutex> guard(convertersLock);
+        auto cachedIter = converters.find(key);
+        if (cachedIter != converters.end()) {
+            cachedIter->second.lastUse = ++converterUses;
+            ready = cachedIter->second.ready;
+        } else {
+            if (converters.size() >= options.maxConverters) {
+                dropLeastRecentConverter();
+            }
+
+            CachedConverter& cached = converters[key];
+            cached.ready    = building.get_future().share();
+            cached.created  = ++converterUses;
+            cached.lastUse  = cached.created;
+            cached.pinned   = false;
+            ready   = cached.ready;
+            created = cached.created;
+        }
+    }
+
+    // rethrows the error if the build has failed
+    if (created == 0) {
+        return ready.get();
+    }
+
+    try {
+        building.set_value(std::shared_ptr<const Converter>(
+                                new Converter(converterOptions)));
+    }
+    catch (...) {
+        building.set_exception(std::current_exception());
+
+        // failures are not kept, a font fixed meanwhile is loaded next time
+        std::lock_guard<std::mutex> guard(convertersLock);
+        auto cachedIter = converters.find(key);
+        if (cachedIter != converters.end() && cachedIter->second.created == created) {
+            converters.erase(cachedIter);
+        }
+    }
+
+    return ready.get();
+}
+
+// called under the converters lock
+void ConversionServer::dropLeastRecentConverter() {
+    auto leastRecent = converters.end();
+    for (auto cachedIter = converters.begin(); cachedIter != converters.end();
+                                                                ++cachedIter) {
+        if (    !cachedIter->second.pinned
+            &&  (   leastRecent == converters.end()
+                ||  cachedIter->second.lastUse < leastRecent->second.lastUse)) {
+            leastRecent = cachedIter;
+        }
+    }
+
+    if (leastRecent != converters.end()) {
+        converters.erase(leastRecent);
+    }
+}
+
+std::string ConversionServer::convertRequest(   const ConversionRequest& request,
+                                                RequestReader& reader) {
+    std::vector<uint8_t> payload = reader.readPayload(request.payloadBytes());
+
+    std::shared_ptr<const Converter> converter = converterFor(requestOptions(request));
+    if (!request.imagePath.empty()) {
+        return converter->convertFile(request.imagePath);
+    }
+    if (request.encodedBytes > 0) {
+        return converter->convertEncoded(payload.data(), payload.size());
+    }
+
+    size_t stride = request.width * bytesPerPixel(request.format);
+    return converter->convert(payload.data(), request.width, request.height, stride,
+                            request.format);
+}
+
+// requests the client has sent without waiting for the answers are served
+// right away, the connection waits for the later ones in the accept loop
+void ConversionServer::serveConnection(int connection, uint64_t acceptedMicros) {
+    timeval timeout = { CLIENT_TIMEOUT_SECONDS, 0 };
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    RequestReader reader(connection);
+    bool keepAlive = serveRequest(connection, reader, acceptedMicros);
+    while (keepAlive && reader.hasBuffered() && !stopping) {
+        keepAlive = serveRequest(connection, reader, monotonicMicros());
+    }
+
+    if (keepAlive && !stopping) {
+        parkConnection(connection);
+    } else {
+        close(connection);
+    }
+    --pending;
+}
+
+// the connection is kept only after a successful answer to a request asking
+// for it, the rest of an erroneous request can not be told from the next one
+bool ConversionServer::serveRequest(int connection, RequestReader& reader,
+                                    uint64_t startMicros) {
+    bool conversion = false;
+    bool keepAlive  = false;
+    try {
+        reader.setDeadline(startMicros + options.requestTimeoutMillis * 1000);
+        if (!reader.waitRequest()) {
+            return false;
+        }
+
+        ConversionRequest request = parseConversionRequest(reader.readLine());
+
+        std::string text;
+        if (request.stats) {
+            std::ostringstream statsText;
+            printServerStats(stats(), statsText);
+            text = statsText.str();
+        } else {
+            conversion = true;
+            text = convertRequest(request, reader);
+        }
+
+        sendAll(connection, "OK " + std::to_string(text.size()) + "\n");
+        sendAll(connection, text);
+        if (conversion) {
+            ++served;
+        }
+        keepAlive = request.keepAlive;
+    }
+    catch (const std::exception& error) {
+        ++failed;
+        conversion = true;
+
+        std::string message = error.what();
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        try {
+            sendAll(connection, "ERROR " + message + "\n");
+        }
+        catch (const std::exception&) {}
+    }
+
+    if (conversion) {
+        latencies.record(monotonicMicros() - startMicros);
+    }
+
+    return keepAlive;
+}
+
+static ConversionServer* activeServer = NULL;
+
+static void stopActiveServer(int) {
+    if (activeServer != NULL) {
+        activeServer->stop();
+    }
+}
+
+int serveConversions(const Settings& settings) {
+    ServerOptions options;
+    options.socketPath  = settings.serveSocket;
+    options.maxPending  = settings.maxPending;
+    if (settings.threads > 0) {
+        options.workers = settings.threads;
+    }
+
+    options.defaults.fontPath           = settings.fontPath;
+    options.defaults.fontSize           = settings.fontSize;
+    options.defaults.invert             = settings.invert;
+    options.defaults.engine             = settings.engine;
+    options.defaults.matching           = settings.matching;
+    options.defaults.dithering          = settings.dithering;
+    options.defaults.shapeGrid          = settings.shapeGrid;
+    options.defaults.frameCacheEntries  = settings.frameCacheEntries;
+    options.defaults.vocabularyCacheDir = settings.vocabularyCacheDir;
+    options.defaults.charset            = settings.charset;
+    options.defaults.threads            = 1;
+
+    ConversionServer server(options);
+
+    // the default font is loaded before the first request, and a broken one
+    // stops the server right away
+    server.addConverter(options.defaults,
+                        std::unique_ptr<Converter>(new Converter(options.defaults)));
+
+    activeServer = &server;
+    struct sigaction stopAction;
+    memset(&stopAction, 0, sizeof(stopAction));
+    stopAction.sa_handler = stopActiveServer;
+    sigaction(SIGINT,  &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+
+    std::cout << "Serving conversions on '" << options.socketPath << "' with "
+              << options.workers << " workers" << std::endl;
+    server.run();
+
+    activeServer = NULL;
+    printServerStats(server.stats(), std::cout);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "conversion_stats.h"
+
+static const char* STAGE_NAMES[CONVERSION_STAGES_COUNT] = {
+    "font_setup", "decode", "grayscale", "integral_image", "partitioning",
+    "matching", "output"
+};
+
+const char* conversionStageName(ConversionStage stage) {
+    return STAGE_NAMES[stage];
+}
+
+static double toMilliseconds(uint64_t nanoseconds) {
+    return nanoseconds / 1e6;
+}
+
+void printConversionStats(const ConversionStats& stats, std::ostream& out) {
+    uint64_t framesTotal = 0;
+    for (const WorkerCounters& worker : stats.workers) {
+        framesTotal += worker.frames;
+    }
+
+    out << "{\n  \"stages\": {\n";
+    for (size_t stage = 0; stage < CONVERSION_STAGES_COUNT; ++stage) {
+        out << "    \"" << STAGE_NAMES[stage] << "\": { \"calls\": "
+            << stats.stages[stage].calls << ", \"ms\": "
+            << toMilliseconds(stats.stages[stage].nanoseconds) << " }"
+            << (stage + 1 < CONVERSION_STAGES_COUNT ? "," : "") << '\n';
+    }
+
+    out << "  },\n  \"workers\": [\n";
+    for (size_t worker = 0; worker < stats.workers.size(); ++worker) {
+        const WorkerCounters& counters = stats.workers[worker];
+        out << "    { \"bands\": " << counters.bands << ", \"frames\": "
+            << counters.frames << ", \"busy_ms\": "
+            << toMilliseconds(counters.busyNanoseconds) << " }"
+            << (worker + 1 < stats.workers.size() ? "," : "") << '\n';
+    }
+
+    out << "  ],\n  \"frames\": " << framesTotal
+        << ",\n  \"bytes_written\": " << stats.bytesWritten << "\n}" << std::endl;
+}
+
+void saveConversionStats(const ConversionStats& stats, const std::string& path) {
+    if (path.empty()) {
+        printConversionStats(stats, std::cout);
+        return;
+    }
+
+    std::ofstream file(path);
+    printConversionStats(stats, file);
+    if (!file) {
+        throw std::runtime_error("Unable to write statistics to '" + path + "'");
+    }
+}
+
+StatsCollector::StatsCollector(size_t _workersNum)
+    : workersNum(_workersNum > 0 ? _workersNum : 1)
+    , workers(new WorkerSlot[workersNum])
+    , bytesWritten(0) {
+    for (StageCounters& stage : stages) {
+        stage.calls         = 0;
+        stage.nanoseconds   = 0;
+    }
+
+    for (size_t worker = 0; worker < workersNum; ++worker) {
+        workers[worker].bands           = 0;
+        workers[worker].frames          = 0;
+        workers[worker].busyNanoseconds = 0;
+    }
+}
+
+void StatsCollector::addStageTime(ConversionStage stage, uint64_t nanoseconds) {
+    stages[stage].calls.fetch_add(1, std::memory_order_relaxed);
+    stages[stage].nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void StatsCollector::addWorkerBand(size_t worker, size_t frames, uint64_t nanoseconds) {
+    WorkerSlot& slot = workers[worker % workersNum];
+    slot.bands.fetch_add(1, std::memory_order_relaxed);
+    slot.frames.fetch_add(frames, std::memory_order_relaxed);
+    slot.busyNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void StatsCollector::addBytesWritten(uint64_t bytes) {
+    bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+ConversionStats StatsCollector::stats() const {
+    ConversionStats result;
+    for (size_t stage = 0; stage < CONVERSION_STAGES_COUNT; ++stage) {
+        result.stages[stage].calls       = stages[stage].calls.load();
+        result.stages[stage].nanoseconds = stages[stage].nanoseconds.load();
+    }
+
+    result.workers.resize(workersNum);
+    for (size_t worker = 0; worker < workersNum; ++worker) {
+        result.workers[worker].bands            = workers[worker].bands.load();
+        result.workers[worker].frames           = workers[worker].frames.load();
+        result.workers[worker].busyNanoseconds  = workers[worker].busyNanoseconds.load();
+    }
+
+    result.bytesWritten = bytesWritten.load();
+    return result;
+}
+
+uint64_t StatsCollector::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ScopedStageTimer::ScopedStageTimer(StatsCollector* _collector, ConversionStage _stage)
+    : collector(_collector)
+    , stage(_stage)
+    , start(_collector ? StatsCollector::now() : 0) {}
+
+ScopedStageTimer::~ScopedStageTimer() {
+    if (collector) {
+        collector->addStageTime(stage, StatsCollector::now() - start);
+    }
+}
@@ -0,0 +1,172 @@
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "converter.h"
+#include "frame_kernels.h"
+#include "image_processor.h"
+#include "sdl_interface.h"
+
+ConverterOptions::ConverterOptions()
+    : fontSize(6)
+    , invert(false)
+    , engine(PIXEL_SCAN_ENGINE)
+    , matching(MEAN_BRIGHTNESS_MATCHING)
+    , dithering(NO_DITHERING)
+    , shapeGrid(3)
+    , frameCacheEntries(0)
+    , threads(0)
+    , collectStats(false) {}
+
+Converter::Converter(const ConverterOptions& options) {
+    prepareStats(options);
+
+    {
+        ScopedStageTimer timer(stats.get(), FONT_SETUP_STAGE);
+        vocab = loadGlyphVocabulary(options.fontPath, options.fontSize,
+                                    options.invert, options.vocabularyCacheDir,
+                                    options.charset);
+    }
+    prepareMatcher(options);
+}
+
+Converter::Converter(const GlyphVocabulary& _vocab, const ConverterOptions& options)
+    : vocab(_vocab) {
+    prepareStats(options);
+    prepareMatcher(options);
+}
+
+void Converter::prepareStats(const ConverterOptions& options) {
+    workersNum = options.threads > 0 ? options.threads : ThreadPool::defaultSize();
+    if (options.collectStats) {
+        stats.reset(new StatsCollector(workersNum));
+    }
+}
+
+void Converter::prepareMatcher(const ConverterOptions& options) {
+    // error of a frame is diffused by its brightness, which only the mean
+    // brightness matching goes by
+    if (    options.dithering != NO_DITHERING
+        &&  options.matching != MEAN_BRIGHTNESS_MATCHING) {
+        throw std::runtime_error("Dithering requires the mean brightness matching");
+    }
+
+    engine  = options.engine;
+    matcher = createFrameMatcher(vocab, options.matching, options.shapeGrid);
+
+    if (options.frameCacheEntries > 0) {
+        cachingMatcher.reset(new CachingMatcher(*matcher, vocab.fontWidth,
+                                                vocab.fontHeight,
+                                                options.frameCacheEntries));
+    }
+    frameMatcher = cachingMatcher ? cachingMatcher.get() : matcher.get();
+
+    if (options.dithering != NO_DITHERING) {
+        diffusion.reset(new ErrorDiffusion(vocab, options.dithering));
+    }
+
+    if (workersNum > 1) {
+        pool.reset(new ThreadPool(workersNum));
+    }
+}
+
+std::string Converter::convert( const uint8_t* pixels, size_t width, size_t height,
+                                size_t stride, PixelFormat format) const {
+    if (format == GRAY8_PIXELS) {
+        FramedBitmap map(pixels, height, width, stride, shared_owner_ptr());
+        return convertBitmap(map);
+    }
+
+    FramedBitmap map(height, width);
+    obj_brightness* grays = map.pixels->data();
+    {
+        ScopedStageTimer timer(stats.get(), GRAYSCALE_STAGE);
+        for (size_t row = 0; row < height; ++row) {
+            const uint8_t* rowPixels = pixels + row * stride;
+            if (format == RGB24_PIXELS) {
+                rgb24RowToGrayscale(rowPixels, width, grays + row * width);
+            } else {
+                rgb888RowToGrayscale(reinterpret_cast<const uint32_t*>(rowPixels),
+                                    width, grays + row * width);
+            }
+        }
+    }
+
+    return convertBitmap(map);
+}
+
+std::string Converter::convertFile(const std::string& path) const {
+    FramedBitmap map = loadGrayscaleImage(path, stats.get());
+    return convertBitmap(map);
+}
+
+std::string Converter::convertEncoded(const uint8_t* bytes, size_t size) const {
+    FramedBitmap map = decodeGrayscaleImage(bytes, size, stats.get());
+    return convertBitmap(map);
+}
+
+const GlyphVocabulary& Converter::vocabulary() const {
+    return vocab;
+}
+
+FrameCacheStats Converter::frameCacheStats() const {
+    if (!cachingMatcher) {
+        FrameCacheStats noCache = { 0, 0 };
+        return noCache;
+    }
+
+    return cachingMatcher->stats();
+}
+
+ConversionStats Converter::conversionStats() const {
+    if (!stats) {
+        return StatsCollector(workersNum).stats();
+    }
+
+    return stats->stats();
+}
+
+std::string Converter::convertBitmap(FramedBitmap& map) const {
+    map.setFrameSize(vocab.fontWidth, vocab.fontHeight);
+
+    const size_t framesInStrip = map.framesInStrip();
+    const size_t stripsTotal   = map.rows / map.frameHeight;
+    if (framesInStrip == 0 || stripsTotal == 0) {
+        return std::string();
+    }
+
+    if (engine == INTEGRAL_IMAGE_ENGINE) {
+        ScopedStageTimer timer(stats.get(), INTEGRAL_IMAGE_STAGE);
+        map.buildIntegralImage();
+    }
+
+    // concurrent conversions share the workers, every one of them waits only
+    // for its own tasks
+    FrameMatching matching(map, *frameMatcher, diffusion.get(), workersNum, stats.get());
+    uint64_t matchingStart = stats ? StatsCollector::now() : 0;
+    matching.start(pool.get());
+    matching.wait();
+
+    if (stats) {
+        stats->addStageTime(MATCHING_STAGE, StatsCollector::now() - matchingStart);
+    }
+
+    ScopedStageTimer timer(stats.get(), OUTPUT_STAGE);
+
+    std::string text;
+    text.reserve(stripsTotal * (framesInStrip + 1));
+    for (size_t part = 0; part < matching.partsCount(); ++part) {
+        const std::vector<code_point> matches = matching.takePart(part);
+        for (size_t lineStart = 0; lineStart < matches.size();
+                                   lineStart += framesInStrip) {
+            appendUtf8(matches.data() + lineStart, framesInStrip, text);
+            text += '\n';
+        }
+    }
+
+    if (stats) {
+        stats->addBytesWritten(text.size());
+    }
+
+    return text;
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "error_diffusion.h"
+
+// errors and brightness are kept in 1/16 of a gray level, so that the tap
+// shares are whole numbers
+static const int32_t ERROR_SCALE = 16;
+
+// progress of a strip is published once per this many frames, the strip
+// below waits for whole chunks
+static const size_t FRAMES_PER_CHUNK = 64;
+
+DiffusionWavefront::DiffusionWavefront(const FramedBitmap& map)
+    : framesInStrip(map.framesInStrip())
+    , stripsTotal(map.frameHeight > 0 ? map.rows / map.frameHeight : 0)
+    , nextStrip(0)
+    , stripProgress(new std::atomic<size_t>[stripsTotal])
+    , errors(framesInStrip * stripsTotal, 0) {
+    frameMatches.resize(framesInStrip * stripsTotal);
+    for (size_t strip = 0; strip < stripsTotal; ++strip) {
+        stripProgress[strip] = 0;
+    }
+}
+
+ErrorDiffusion::ErrorDiffusion(const GlyphVocabulary& vocab, DitheringMode mode)
+    : brightnessLookup(vocab.brightnessLookup)
+    , reach(0) {
+    for (size_t brightness = 0; brightness <= MAX_GRAY_LEVELS; ++brightness) {
+        symbolBrightness[brightness] = vocab.brightness.at(brightnessLookup[brightness]);
+    }
+
+    if (mode == FLOYD_STEINBERG_DITHERING) {
+        taps = { {0, 1, 7}, {1, -1, 3}, {1, 0, 5}, {1, 1, 1} };
+    } else if (mode == ATKINSON_DITHERING) {
+        taps = { {0, 1, 2}, {0, 2, 2}, {1, -1, 2}, {1, 0, 2}, {1, 1, 2}, {2, 0, 2} };
+    } else {
+        throw std::runtime_error("Error diffusion requires a dithering mode");
+    }
+
+    for (const Tap& tap : taps) {
+        reach = std::max<size_t>(reach, std::max(tap.columns, 0));
+    }
+}
+
+void ErrorDiffusion::matchStrips(   const FramedBitmap& map,
+                                    DiffusionWavefront& wavefront,
+                                    size_t worker, StatsCollector* stats) const {
+    while (true) {
+        size_t strip = wavefront.nextStrip.fetch_add(1);
+        if (strip >= wavefront.stripsTotal) {
+            return;
+        }
+
+        uint64_t start = stats ? StatsCollector::now() : 0;
+        matchStrip(map, wavefront, strip);
+        if (stats) {
+            stats->addWorkerBand(worker, wavefront.framesInStrip,
+                                StatsCollector::now() - start);
+        }
+    }
+}
+
+void ErrorDiffusion::matchStrip(const FramedBitmap& map,
+                                DiffusionWavefront& wavefront,
+                                size_t strip) const {
+    static thread_local std::vector<uint32_t> stripSums;
+
+    const size_t framesInStrip  = wavefront.framesInStrip;
+    const size_t frameSize      = map.frameWidth * map.frameHeight;
+    int32_t* stripErrors        = wavefront.errors.data() + strip * framesInStrip;
+    code_point* matches         = wavefront.frameMatches.data()
+                                    + strip * framesInStrip;
+
+    // brightness does not depend on the strips above, it is taken before
+    // waiting for them
+    stripSums.resize(framesInStrip);
+    map.stripBrightnessSums(strip, 0, framesInStrip, stripSums.data());
+
+    for (size_t chunk = 0; chunk < framesInStrip; chunk += FRAMES_PER_CHUNK) {
+        const size_t chunkEnd = std::min(chunk + FRAMES_PER_CHUNK, framesInStrip);
+
+        // the strip above must be done adding error to the frames of the
+        // chunk and to the ones on the right the chunk passes its error to
+        if (strip > 0) {
+            const size_t needed = std::min(chunkEnd + reach + 1, framesInStrip);
+            const std::atomic<size_t>& above = wavefront.stripProgress[strip - 1];
+            while (above.load(std::memory_order_acquire) < needed) {
+                std::this_thread::yield();
+            }
+        }
+
+        for (size_t frame = chunk; frame < chunkEnd; ++frame) {
+            const int32_t brightness =
+                        static_cast<int32_t>(stripSums[frame] / frameSize)
+                        * ERROR_SCALE + stripErrors[frame];
+            const int32_t level = std::max(0, std::min<int32_t>(
+                            (brightness + ERROR_SCALE / 2) / ERROR_SCALE,
+                            MAX_GRAY_LEVELS));
+
+            matches[frame] = brightnessLookup[level];
+            const int32_t error = brightness - symbolBrightness[level] * ERROR_SCALE;
+
+            for (const Tap& tap : taps) {
+                const size_t targetStrip = strip + tap.rows;
+                const int64_t targetFrame = static_cast<int64_t>(frame) + tap.columns;
+                if (    targetStrip >= wavefront.stripsTotal || targetFrame < 0
+                    ||  targetFrame >= static_cast<int64_t>(framesInStrip)) {
+                    continue;
+                }
+
+                wavefront.errors[targetStrip * framesInStrip + targetFrame] +=
+                                                error * tap.weight / ERROR_SCALE;
+            }
+        }
+
+        wavefront.stripProgress[strip].store(chunkEnd, std::memory_order_release);
+    }
+}
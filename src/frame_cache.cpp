@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "frame_cache.h"
+#include "freetype_interface.h"
+
+// shards are picked by the low hash bits, slots inside them by the high ones
+static const size_t CACHE_SHARDS = 64;
+
+static const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+static inline uint64_t mixHash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// frame pixels are taken eight at a time, the tail is padded with zeroes
+static uint64_t hashFramePixels(const obj_brightness* pixels, size_t count) {
+    uint64_t hash = count;
+    size_t pos = 0;
+
+    for (; pos + sizeof(uint64_t) <= count; pos += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, pixels + pos, sizeof(word));
+        hash = (hash ^ word) * HASH_MULTIPLIER;
+        hash = hash << 31 | hash >> 33;
+    }
+
+    if (pos < count) {
+        uint64_t word = 0;
+        std::memcpy(&word, pixels + pos, count - pos);
+        hash = (hash ^ word) * HASH_MULTIPLIER;
+    }
+
+    return mixHash(hash);
+}
+
+void printFrameCacheStats(const FrameCacheStats& stats, std::ostream& out) {
+    uint64_t lookups = stats.hits + stats.misses;
+    double hitRate = lookups > 0 ? 100.0 * stats.hits / lookups : 0.0;
+
+    out << "Frame cache: " << stats.hits << " hits, " << stats.misses
+        << " misses (" << hitRate << "% hit rate)" << std::endl;
+}
+
+// every shard keeps at least one frame, however large the frames are
+static size_t shardSlots(size_t entries, size_t framePixels) {
+    size_t slots    = (entries + CACHE_SHARDS - 1) / CACHE_SHARDS;
+    size_t maxSlots = MAX_FRAME_CACHE_BYTES / (framePixels * CACHE_SHARDS);
+    return std::max<size_t>(std::min(slots, maxSlots), 1);
+}
+
+CachingMatcher::CachingMatcher( const FrameMatcher& _matcher,
+                                size_t _frameWidth, size_t _frameHeight,
+                                size_t entries)
+    : matcher(_matcher)
+    , frameWidth(_frameWidth)
+    , frameHeight(_frameHeight)
+    , framePixels(_frameWidth * _frameHeight)
+    , slotsPerShard(0) {
+
+    if (entries == 0 || framePixels == 0) {
+        throw std::runtime_error("Frame cache must have room for non-empty frames");
+    }
+    slotsPerShard = shardSlots(entries, framePixels);
+
+    shards.reserve(CACHE_SHARDS);
+    for (size_t shard = 0; shard < CACHE_SHARDS; ++shard) {
+        shards.emplace_back(new Shard);
+        shards.back()->hashes.assign(slotsPerShard, 0);
+        shards.back()->symbols.assign(slotsPerShard, 0);
+        shards.back()->frames.resize(slotsPerShard);
+        shards.back()->storedFrames = 0;
+        shards.back()->hits = 0;
+        shards.back()->misses = 0;
+    }
+}
+
+bool CachingMatcher::lookup(const obj_brightness* frame, uint64_t hash,
+                            code_point& symbol) const {
+    Shard& shard = *shards[hash % CACHE_SHARDS];
+    size_t slot = (hash >> 32) % slotsPerShard;
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (    shard.symbols[slot] != 0
+        &&  shard.hashes[slot] == hash
+        &&  std::equal(frame, frame + framePixels, shard.frames[slot].begin())) {
+        symbol = shard.symbols[slot];
+        ++shard.hits;
+        return true;
+    }
+
+    ++shard.misses;
+    return false;
+}
+
+void CachingMatcher::store(const obj_brightness* frame, uint64_t hash,
+                            code_point symbol) const {
+    Shard& shard = *shards[hash % CACHE_SHARDS];
+    size_t slot = (hash >> 32) % slotsPerShard;
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.hashes[slot] = hash;
+    shard.symbols[slot] = symbol;
+    if (shard.frames[slot].empty()) {
+        ++shard.storedFrames;
+    }
+    shard.frames[slot].assign(frame, frame + framePixels);
+}
+
+void CachingMatcher::matchStrip(const FramedBitmap& map, size_t strip,
+                                size_t firstFrame, size_t framesCount,
+                                code_point* matches) const {
+    static thread_local pixels_vector stripFrames;
+    static thread_local std::vector<uint64_t> frameHashes;
+
+    if (map.frameWidth != frameWidth || map.frameHeight != frameHeight) {
+        throw std::runtime_error("Frame cache was made for another frame size");
+    }
+
+    // frames are gathered into contiguous cells, so that they are hashed and
+    // compared with the stored ones in one go
+    stripFrames.resize(framesCount * framePixels);
+    frameHashes.resize(framesCount);
+    const obj_brightness* stripStart = map.rowPixels(strip * frameHeight)
+                                        + firstFrame * frameWidth;
+
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        obj_brightness* cell = stripFrames.data() + frame * framePixels;
+        for (size_t row = 0; row < frameHeight; ++row) {
+            std::memcpy(cell + row * frameWidth,
+                        stripStart + row * map.stride + frame * frameWidth,
+                        frameWidth * sizeof(obj_brightness));
+        }
+
+        frameHashes[frame] = hashFramePixels(cell, framePixels);
+
+        // symbols are printable, so 0 marks the frames left to match
+        if (!lookup(cell, frameHashes[frame], matches[frame])) {
+            matches[frame] = 0;
+        }
+    }
+
+    for (size_t frame = 0; frame < framesCount; ) {
+        if (matches[frame] != 0) {
+            ++frame;
+            continue;
+        }
+
+        size_t runEnd = frame + 1;
+        while (runEnd < framesCount && matches[runEnd] == 0) {
+            ++runEnd;
+        }
+
+        matcher.matchStrip( map, strip, firstFrame + frame, runEnd - frame,
+                            matches + frame);
+
+        for (; frame < runEnd; ++frame) {
+            store(stripFrames.data() + frame * framePixels, frameHashes[frame],
+                    matches[frame]);
+        }
+    }
+}
+
+FrameCacheStats CachingMatcher::stats() const {
+    FrameCacheStats total = { 0, 0 };
+
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->lock);
+        total.hits   += shard->hits;
+        total.misses += shard->misses;
+    }
+
+    return total;
+}
+
+size_t CachingMatcher::entries() const {
+    return slotsPerShard * CACHE_SHARDS;
+}
+
+size_t CachingMatcher::memoryBytes() const {
+    size_t bytes = 0;
+
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->lock);
+        bytes +=    shard->hashes.capacity() * sizeof(uint64_t)
+                +   shard->symbols.capacity() * sizeof(code_point)
+                +   shard->frames.capacity() * sizeof(pixels_vector)
+                +   shard->storedFrames * framePixels * sizeof(obj_brightness);
+    }
+
+    return bytes;
+}
+
+std::unique_ptr<CachingMatcher> createFrameCache(const FrameMatcher& matcher,
+                                                 size_t entries) {
+    if (entries == 0) {
+        return std::unique_ptr<CachingMatcher>();
+    }
+
+    return std::unique_ptr<CachingMatcher>(new CachingMatcher(
+                            matcher, getFontWidth(), getFontHeight(), entries));
+}
@@ -0,0 +1,108 @@
+#include "frame_colors.h"
+
+FrameColors::FrameColors(size_t _frameWidth, size_t _frameHeight)
+    : frameWidth(_frameWidth)
+    , frameHeight(_frameHeight)
+    , stripFrames(0)
+    , stripsTotal(0)
+    , nextRow(0) {}
+
+void FrameColors::startImage(size_t columns, size_t rows) {
+    stripFrames = frameWidth  > 0 ? columns / frameWidth : 0;
+    stripsTotal = frameHeight > 0 ? rows / frameHeight   : 0;
+    nextRow     = 0;
+
+    sums.assign(stripFrames * 3, 0);
+    frameColors.clear();
+    frameColors.reserve(stripFrames * stripsTotal);
+}
+
+bool FrameColors::rowNeeded() const {
+    return nextRow < stripsTotal * frameHeight;
+}
+
+void FrameColors::addRgbRow(const uint8_t* pixels) {
+    if (rowNeeded()) {
+        for (size_t frame = 0; frame < stripFrames; ++frame) {
+            uint32_t red = 0, green = 0, blue = 0;
+            for (size_t col = 0; col < frameWidth; ++col) {
+                red   += pixels[0];
+                green += pixels[1];
+                blue  += pixels[2];
+                pixels += 3;
+            }
+
+            sums[frame * 3]     += red;
+            sums[frame * 3 + 1] += green;
+            sums[frame * 3 + 2] += blue;
+        }
+    }
+
+    finishRow();
+}
+
+void FrameColors::addRgb888Row(const uint32_t* pixels) {
+    if (rowNeeded()) {
+        for (size_t frame = 0; frame < stripFrames; ++frame) {
+            uint32_t red = 0, green = 0, blue = 0;
+            for (size_t col = 0; col < frameWidth; ++col) {
+                red   += (pixels[col] >> 16) & 0xFF;
+                green += (pixels[col] >> 8)  & 0xFF;
+                blue  +=  pixels[col]        & 0xFF;
+            }
+            pixels += frameWidth;
+
+            sums[frame * 3]     += red;
+            sums[frame * 3 + 1] += green;
+            sums[frame * 3 + 2] += blue;
+        }
+    }
+
+    finishRow();
+}
+
+void FrameColors::addGrayRow(const uint8_t* grays) {
+    if (rowNeeded()) {
+        for (size_t frame = 0; frame < stripFrames; ++frame) {
+            uint32_t level = 0;
+            for (size_t col = 0; col < frameWidth; ++col) {
+                level += grays[col];
+            }
+            grays += frameWidth;
+
+            sums[frame * 3]     += level;
+            sums[frame * 3 + 1] += level;
+            sums[frame * 3 + 2] += level;
+        }
+    }
+
+    finishRow();
+}
+
+// averages of the strip are taken after its last row, and the sums are
+// cleared for the next strip
+void FrameColors::finishRow() {
+    ++nextRow;
+    if (nextRow % frameHeight != 0 || nextRow > stripsTotal * frameHeight) {
+        return;
+    }
+
+    const uint32_t area = frameWidth * frameHeight;
+    for (size_t frame = 0; frame < stripFrames; ++frame) {
+        RgbColor color;
+        color.red   = (sums[frame * 3]     + area / 2) / area;
+        color.green = (sums[frame * 3 + 1] + area / 2) / area;
+        color.blue  = (sums[frame * 3 + 2] + area / 2) / area;
+        frameColors.push_back(color);
+    }
+
+    sums.assign(sums.size(), 0);
+}
+
+const std::vector<RgbColor>& FrameColors::colors() const {
+    return frameColors;
+}
+
+size_t FrameColors::framesInStrip() const {
+    return stripFrames;
+}
@@ -0,0 +1,958 @@
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define FRAME_KERNELS_X86
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define FRAME_KERNELS_NEON
+    #include <arm_neon.h>
+#endif
+
+#include "frame_kernels.h"
+
+static_assert(sizeof(obj_brightness) == 1,
+                "Vectorized kernels expect one byte per pixel");
+
+typedef uint64_t (*row_sum_kernel)(const uint8_t* row, size_t width);
+typedef void (*row_accumulate_kernel)(  const uint8_t* row, size_t width,
+                                        uint16_t* columnSums);
+typedef void (*row_grayscale_kernel)(   const uint32_t* row, size_t width,
+                                        obj_brightness* grays);
+typedef void (*row_rgb24_grayscale_kernel)(const uint8_t* row, size_t width,
+                                            obj_brightness* grays);
+typedef void (*descriptor_distance_kernel)( const int16_t* glyphPairs,
+                                            size_t pairsCount, size_t glyphsCount,
+                                            const int16_t* frameDescriptor,
+                                            uint32_t* distances);
+typedef uint32_t (*cell_distance_kernel)(   const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound);
+typedef void (*mark_sums_kernel)(   const uint32_t* sums, size_t count,
+                                    uint32_t bound, uint8_t bit, uint8_t* flags);
+
+// column sums are 16 bit wide, this many rows of any brightness fit in them
+static const size_t ROWS_PER_ACCUMULATION = UINT16_MAX / MAX_GRAY_LEVELS;
+
+// cell distances are compared with the bound once per this many bytes, more
+// frequent checks cost more than the work they save on small cells
+static const size_t CELL_BOUND_CHECK_BYTES = 64;
+
+static uint64_t sumRowScalar(const uint8_t* row, size_t width) {
+    uint64_t acc = 0;
+    for (size_t col = 0; col < width; ++col) {
+        acc += row[col];
+    }
+
+    return acc;
+}
+
+static void accumulateRowScalar(const uint8_t* row, size_t width,
+                                uint16_t* columnSums) {
+    for (size_t col = 0; col < width; ++col) {
+        columnSums[col] += row[col];
+    }
+}
+
+static void rgb888RowToGrayscaleScalar( const uint32_t* row, size_t width,
+                                        obj_brightness* grays) {
+    for (size_t col = 0; col < width; ++col) {
+        uint32_t pixel = row[col];
+        grays[col] = rgbToGrayscale((pixel >> 16) & 0xFF,
+                                    (pixel >> 8)  & 0xFF,
+                                     pixel        & 0xFF);
+    }
+}
+
+static void rgb24RowToGrayscaleScalar(  const uint8_t* row, size_t width,
+                                        obj_brightness* grays) {
+    for (size_t col = 0; col < width; ++col) {
+        const uint8_t* pixel = row + 3 * col;
+        grays[col] = rgbToGrayscale(pixel[0], pixel[1], pixel[2]);
+    }
+}
+
+static void descriptorDistancesScalar( const int16_t* glyphPairs,
+                                        size_t pairsCount, size_t glyphsCount,
+                                        const int16_t* frameDescriptor,
+                                        uint32_t* distances) {
+    for (size_t glyph = 0; glyph < glyphsCount; ++glyph) {
+        uint32_t distance = 0;
+        for (size_t pair = 0; pair < pairsCount; ++pair) {
+            const int16_t* glyphPair = glyphPairs + 2 * (pair * glyphsCount + glyph);
+            int32_t firstDiff  = glyphPair[0] - frameDescriptor[2 * pair];
+            int32_t secondDiff = glyphPair[1] - frameDescriptor[2 * pair + 1];
+            distance += firstDiff * firstDiff + secondDiff * secondDiff;
+        }
+
+        distances[glyph] = distance;
+    }
+}
+
+static uint32_t cellAbsoluteDifferenceScalar(  const uint8_t* first,
+                                                const uint8_t* second,
+                                                size_t cellBytes, uint32_t bound) {
+    uint32_t distance = 0;
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t pixel = chunk; pixel < chunkEnd; ++pixel) {
+            distance += std::abs(static_cast<int32_t>(first[pixel]) - second[pixel]);
+        }
+
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+
+static uint32_t cellSquaredDifferenceScalar(   const uint8_t* first,
+                                                const uint8_t* second,
+                                                size_t cellBytes, uint32_t bound) {
+    uint32_t distance = 0;
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t pixel = chunk; pixel < chunkEnd; ++pixel) {
+            int32_t diff = static_cast<int32_t>(first[pixel]) - second[pixel];
+            distance += diff * diff;
+        }
+
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+
+static void markSumsBelowScalar(const uint32_t* sums, size_t count,
+                                uint32_t bound, uint8_t bit, uint8_t* flags) {
+    for (size_t pos = 0; pos < count; ++pos) {
+        flags[pos] |= sums[pos] < bound ? bit : 0;
+    }
+}
+
+// the frame's component pair is packed into a single 32-bit value, so that
+// it can be broadcast against every glyph's pair at once
+static inline int32_t packedFramePair(const int16_t* frameDescriptor, size_t pair) {
+    return    static_cast<uint16_t>(frameDescriptor[2 * pair])
+            | static_cast<uint32_t>(static_cast<uint16_t>(frameDescriptor[2 * pair + 1])) << 16;
+}
+
+#ifdef FRAME_KERNELS_X86
+static uint64_t sumRowSse2(const uint8_t* row, size_t width) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+
+    size_t col = 0;
+    for (; col + 16 <= width; col += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + col));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(bytes, zero));
+    }
+
+    uint64_t halves[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(halves), acc);
+
+    return halves[0] + halves[1] + sumRowScalar(row + col, width - col);
+}
+
+static void accumulateRowSse2(  const uint8_t* row, size_t width,
+                                uint16_t* columnSums) {
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t col = 0;
+    for (; col + 16 <= width; col += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + col));
+        __m128i* lowSums  = reinterpret_cast<__m128i*>(columnSums + col);
+        __m128i* highSums = reinterpret_cast<__m128i*>(columnSums + col + 8);
+
+        _mm_storeu_si128(lowSums,  _mm_add_epi16(_mm_loadu_si128(lowSums),
+                                            _mm_unpacklo_epi8(bytes, zero)));
+        _mm_storeu_si128(highSums, _mm_add_epi16(_mm_loadu_si128(highSums),
+                                            _mm_unpackhi_epi8(bytes, zero)));
+    }
+
+    accumulateRowScalar(row + col, width - col, columnSums + col);
+}
+
+// 0x00RRGGBB pixel is split into 16-bit [B, R] and [G, 0] lane pairs, so that
+// every multiply-add instruction produces two terms of the pixel's gray level
+static inline __m128i fourPixelsToGrayscaleSse2(__m128i pixels) {
+    const __m128i lowBytesMask  = _mm_set1_epi32(0x00FF00FF);
+    const __m128i blueRedCoeffs = _mm_set1_epi32(   (RED_LUMINANCE << 16)
+                                                    | BLUE_LUMINANCE);
+    const __m128i greenCoeffs   = _mm_set1_epi32(GREEN_LUMINANCE);
+
+    __m128i blueRed = _mm_and_si128(pixels, lowBytesMask);
+    __m128i green   = _mm_and_si128(_mm_srli_epi32(pixels, 8), lowBytesMask);
+
+    __m128i gray = _mm_add_epi32(   _mm_madd_epi16(blueRed, blueRedCoeffs),
+                                    _mm_madd_epi16(green,   greenCoeffs));
+
+    return _mm_srli_epi32(gray, GRAY_FIXED_POINT_SHIFT);
+}
+
+static void rgb888RowToGrayscaleSse2(   const uint32_t* row, size_t width,
+                                        obj_brightness* grays) {
+    size_t col = 0;
+    for (; col + 16 <= width; col += 16) {
+        const __m128i* pixels = reinterpret_cast<const __m128i*>(row + col);
+        __m128i gray0 = fourPixelsToGrayscaleSse2(_mm_loadu_si128(pixels));
+        __m128i gray1 = fourPixelsToGrayscaleSse2(_mm_loadu_si128(pixels + 1));
+        __m128i gray2 = fourPixelsToGrayscaleSse2(_mm_loadu_si128(pixels + 2));
+        __m128i gray3 = fourPixelsToGrayscaleSse2(_mm_loadu_si128(pixels + 3));
+
+        __m128i packed = _mm_packus_epi16(  _mm_packs_epi32(gray0, gray1),
+                                            _mm_packs_epi32(gray2, gray3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(grays + col), packed);
+    }
+
+    rgb888RowToGrayscaleScalar(row + col, width - col, grays + col);
+}
+
+__attribute__((target("avx2")))
+static uint64_t sumRowAvx2(const uint8_t* row, size_t width) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+
+    size_t col = 0;
+    for (; col + 32 <= width; col += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + col));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, zero));
+    }
+
+    uint64_t quarters[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(quarters), acc);
+
+    return    quarters[0] + quarters[1] + quarters[2] + quarters[3]
+            + sumRowSse2(row + col, width - col);
+}
+
+__attribute__((target("avx2")))
+static void accumulateRowAvx2(  const uint8_t* row, size_t width,
+                                uint16_t* columnSums) {
+    size_t col = 0;
+    for (; col + 16 <= width; col += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + col));
+        __m256i* sums = reinterpret_cast<__m256i*>(columnSums + col);
+
+        _mm256_storeu_si256(sums, _mm256_add_epi16(_mm256_loadu_si256(sums),
+                                            _mm256_cvtepu8_epi16(bytes)));
+    }
+
+    accumulateRowScalar(row + col, width - col, columnSums + col);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i eightPixelsToGrayscaleAvx2(__m256i pixels) {
+    const __m256i lowBytesMask  = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i blueRedCoeffs = _mm256_set1_epi32((RED_LUMINANCE << 16)
+                                                    | BLUE_LUMINANCE);
+    const __m256i greenCoeffs   = _mm256_set1_epi32(GREEN_LUMINANCE);
+
+    __m256i blueRed = _mm256_and_si256(pixels, lowBytesMask);
+    __m256i green   = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), lowBytesMask);
+
+    __m256i gray = _mm256_add_epi32(_mm256_madd_epi16(blueRed, blueRedCoeffs),
+                                    _mm256_madd_epi16(green,   greenCoeffs));
+
+    return _mm256_srli_epi32(gray, GRAY_FIXED_POINT_SHIFT);
+}
+
+__attribute__((target("avx2")))
+static void rgb888RowToGrayscaleAvx2(   const uint32_t* row, size_t width,
+                                        obj_brightness* grays) {
+    // packing works inside 128-bit lanes, this restores the pixel order
+    const __m256i laneOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t col = 0;
+    for (; col + 32 <= width; col += 32) {
+        const __m256i* pixels = reinterpret_cast<const __m256i*>(row + col);
+        __m256i gray0 = eightPixelsToGrayscaleAvx2(_mm256_loadu_si256(pixels));
+        __m256i gray1 = eightPixelsToGrayscaleAvx2(_mm256_loadu_si256(pixels + 1));
+        __m256i gray2 = eightPixelsToGrayscaleAvx2(_mm256_loadu_si256(pixels + 2));
+        __m256i gray3 = eightPixelsToGrayscaleAvx2(_mm256_loadu_si256(pixels + 3));
+
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(gray0, gray1),
+                                             _mm256_packs_epi32(gray2, gray3));
+        packed = _mm256_permutevar8x32_epi32(packed, laneOrder);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(grays + col), packed);
+    }
+
+    rgb888RowToGrayscaleSse2(row + col, width - col, grays + col);
+}
+
+// every lane gets four packed pixels expanded to the 0x00RRGGBB layout
+__attribute__((target("avx2")))
+static inline __m256i eightRgb24PixelsAvx2(const uint8_t* pixels) {
+    const __m256i toRgb888 = _mm256_setr_epi8(
+                        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+
+    __m128i low  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 12));
+
+    return _mm256_shuffle_epi8(
+                _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1),
+                toRgb888);
+}
+
+__attribute__((target("avx2")))
+static void rgb24RowToGrayscaleAvx2(const uint8_t* row, size_t width,
+                                    obj_brightness* grays) {
+    const __m256i laneOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    // loads of the last pixels run 4 bytes past them, the rest of the row
+    // is left to the scalar loop
+    size_t col = 0;
+    for (; col + 36 <= width; col += 32) {
+        const uint8_t* pixels = row + 3 * col;
+        __m256i gray0 = eightPixelsToGrayscaleAvx2(eightRgb24PixelsAvx2(pixels));
+        __m256i gray1 = eightPixelsToGrayscaleAvx2(eightRgb24PixelsAvx2(pixels + 24));
+        __m256i gray2 = eightPixelsToGrayscaleAvx2(eightRgb24PixelsAvx2(pixels + 48));
+        __m256i gray3 = eightPixelsToGrayscaleAvx2(eightRgb24PixelsAvx2(pixels + 72));
+
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(gray0, gray1),
+                                             _mm256_packs_epi32(gray2, gray3));
+        packed = _mm256_permutevar8x32_epi32(packed, laneOrder);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(grays + col), packed);
+    }
+
+    rgb24RowToGrayscaleScalar(row + 3 * col, width - col, grays + col);
+}
+
+// every multiply-add squares the differences of a component pair and sums
+// them into one 32-bit distance lane per glyph
+static void descriptorDistancesSse2(const int16_t* glyphPairs,
+                                    size_t pairsCount, size_t glyphsCount,
+                                    const int16_t* frameDescriptor,
+                                    uint32_t* distances) {
+    for (size_t glyph = 0; glyph < glyphsCount; glyph += 4) {
+        __m128i acc = _mm_setzero_si128();
+
+        for (size_t pair = 0; pair < pairsCount; ++pair) {
+            const int16_t* pairs = glyphPairs + 2 * (pair * glyphsCount + glyph);
+            __m128i diff = _mm_sub_epi16(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs)),
+                        _mm_set1_epi32(packedFramePair(frameDescriptor, pair)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(diff, diff));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + glyph), acc);
+    }
+}
+
+__attribute__((target("avx2")))
+static void descriptorDistancesAvx2(const int16_t* glyphPairs,
+                                    size_t pairsCount, size_t glyphsCount,
+                                    const int16_t* frameDescriptor,
+                                    uint32_t* distances) {
+    for (size_t glyph = 0; glyph < glyphsCount; glyph += 8) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (size_t pair = 0; pair < pairsCount; ++pair) {
+            const int16_t* pairs = glyphPairs + 2 * (pair * glyphsCount + glyph);
+            __m256i diff = _mm256_sub_epi16(
+                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs)),
+                        _mm256_set1_epi32(packedFramePair(frameDescriptor, pair)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(diff, diff));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(distances + glyph), acc);
+    }
+}
+
+// 32-bit comparison masks are narrowed to bytes by saturating packs, which
+// keep 0 and -1 as they are; sums below 2^31 compare right as signed ones
+static void markSumsBelowSse2(  const uint32_t* sums, size_t count,
+                                uint32_t bound, uint8_t bit, uint8_t* flags) {
+    const __m128i bounds = _mm_set1_epi32(bound);
+    const __m128i bits   = _mm_set1_epi8(bit);
+
+    size_t pos = 0;
+    for (; pos + 16 <= count; pos += 16) {
+        const __m128i* quads = reinterpret_cast<const __m128i*>(sums + pos);
+        __m128i below0 = _mm_cmplt_epi32(_mm_loadu_si128(quads),     bounds);
+        __m128i below1 = _mm_cmplt_epi32(_mm_loadu_si128(quads + 1), bounds);
+        __m128i below2 = _mm_cmplt_epi32(_mm_loadu_si128(quads + 2), bounds);
+        __m128i below3 = _mm_cmplt_epi32(_mm_loadu_si128(quads + 3), bounds);
+
+        __m128i below = _mm_packs_epi16(_mm_packs_epi32(below0, below1),
+                                        _mm_packs_epi32(below2, below3));
+        __m128i* target = reinterpret_cast<__m128i*>(flags + pos);
+        _mm_storeu_si128(target, _mm_or_si128(_mm_loadu_si128(target),
+                                              _mm_and_si128(below, bits)));
+    }
+
+    markSumsBelowScalar(sums + pos, count - pos, bound, bit, flags + pos);
+}
+
+static inline uint32_t horizontalSum32(__m128i acc) {
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+// absolute differences of unsigned bytes are taken as the larger one of the
+// two saturated subtractions
+static inline __m128i absoluteDifferenceSse2(__m128i first, __m128i second) {
+    return _mm_or_si128(_mm_subs_epu8(first, second), _mm_subs_epu8(second, first));
+}
+
+static uint32_t cellAbsoluteDifferenceSse2(const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound) {
+    __m128i acc = _mm_setzero_si128();
+    uint32_t distance = 0;
+
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t byte = chunk; byte < chunkEnd; byte += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + byte)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + byte))));
+        }
+
+        // both 64-bit lanes hold sums small enough for their low halves
+        distance = horizontalSum32(acc);
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+
+static uint32_t cellSquaredDifferenceSse2( const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    uint32_t distance = 0;
+
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t byte = chunk; byte < chunkEnd; byte += 16) {
+            __m128i diff = absoluteDifferenceSse2(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + byte)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + byte)));
+            __m128i low  = _mm_unpacklo_epi8(diff, zero);
+            __m128i high = _mm_unpackhi_epi8(diff, zero);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(low, low),
+                                                   _mm_madd_epi16(high, high)));
+        }
+
+        distance = horizontalSum32(acc);
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+
+__attribute__((target("avx2")))
+static uint32_t cellAbsoluteDifferenceAvx2(const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound) {
+    __m256i acc = _mm256_setzero_si256();
+    uint32_t distance = 0;
+
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t byte = chunk; byte < chunkEnd; byte += 32) {
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + byte)),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + byte))));
+        }
+
+        distance = horizontalSum32(_mm_add_epi32(_mm256_castsi256_si128(acc),
+                                                 _mm256_extracti128_si256(acc, 1)));
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+
+__attribute__((target("avx2")))
+static uint32_t cellSquaredDifferenceAvx2( const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    uint32_t distance = 0;
+
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t byte = chunk; byte < chunkEnd; byte += 32) {
+            __m256i firstPixels  = _mm256_loadu_si256(
+                                    reinterpret_cast<const __m256i*>(first + byte));
+            __m256i secondPixels = _mm256_loadu_si256(
+                                    reinterpret_cast<const __m256i*>(second + byte));
+            __m256i diff = _mm256_or_si256(_mm256_subs_epu8(firstPixels, secondPixels),
+                                           _mm256_subs_epu8(secondPixels, firstPixels));
+            __m256i low  = _mm256_unpacklo_epi8(diff, zero);
+            __m256i high = _mm256_unpackhi_epi8(diff, zero);
+            acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_madd_epi16(low, low),
+                                                         _mm256_madd_epi16(high, high)));
+        }
+
+        distance = horizontalSum32(_mm_add_epi32(_mm256_castsi256_si128(acc),
+                                                 _mm256_extracti128_si256(acc, 1)));
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+#endif // FRAME_KERNELS_X86
+
+#ifdef FRAME_KERNELS_NEON
+static uint64_t sumRowNeon(const uint8_t* row, size_t width) {
+    uint64x2_t acc = vdupq_n_u64(0);
+
+    size_t col = 0;
+    for (; col + 16 <= width; col += 16) {
+        uint16x8_t pairs = vpaddlq_u8(vld1q_u8(row + col));
+        acc = vpadalq_u32(acc, vpaddlq_u16(pairs));
+    }
+
+    return    vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1)
+            + sumRowScalar(row + col, width - col);
+}
+
+static void accumulateRowNeon(  const uint8_t* row, size_t width,
+                                uint16_t* columnSums) {
+    size_t col = 0;
+    for (; col + 16 <= width; col += 16) {
+        uint8x16_t bytes = vld1q_u8(row + col);
+        uint16_t* lowSums  = columnSums + col;
+        uint16_t* highSums = columnSums + col + 8;
+
+        vst1q_u16(lowSums,  vaddw_u8(vld1q_u16(lowSums),  vget_low_u8(bytes)));
+        vst1q_u16(highSums, vaddw_u8(vld1q_u16(highSums), vget_high_u8(bytes)));
+    }
+
+    accumulateRowScalar(row + col, width - col, columnSums + col);
+}
+
+static void rgb888RowToGrayscaleNeon(   const uint32_t* row, size_t width,
+                                        obj_brightness* grays) {
+    size_t col = 0;
+    for (; col + 8 <= width; col += 8) {
+        // native byte order of 0x00RRGGBB pixels is B, G, R, 0
+        uint8x8x4_t channels = vld4_u8(reinterpret_cast<const uint8_t*>(row + col));
+        uint16x8_t blue  = vmovl_u8(channels.val[0]);
+        uint16x8_t green = vmovl_u8(channels.val[1]);
+        uint16x8_t red   = vmovl_u8(channels.val[2]);
+
+        uint32x4_t low  = vmull_n_u16(vget_low_u16(red), RED_LUMINANCE);
+        low  = vmlal_n_u16(low,  vget_low_u16(green),  GREEN_LUMINANCE);
+        low  = vmlal_n_u16(low,  vget_low_u16(blue),   BLUE_LUMINANCE);
+        uint32x4_t high = vmull_n_u16(vget_high_u16(red), RED_LUMINANCE);
+        high = vmlal_n_u16(high, vget_high_u16(green), GREEN_LUMINANCE);
+        high = vmlal_n_u16(high, vget_high_u16(blue),  BLUE_LUMINANCE);
+
+        uint16x8_t gray = vcombine_u16( vshrn_n_u32(low,  GRAY_FIXED_POINT_SHIFT),
+                                        vshrn_n_u32(high, GRAY_FIXED_POINT_SHIFT));
+        vst1_u8(grays + col, vmovn_u16(gray));
+    }
+
+    rgb888RowToGrayscaleScalar(row + col, width - col, grays + col);
+}
+
+static void rgb24RowToGrayscaleNeon(const uint8_t* row, size_t width,
+                                    obj_brightness* grays) {
+    size_t col = 0;
+    for (; col + 8 <= width; col += 8) {
+        uint8x8x3_t channels = vld3_u8(row + 3 * col);
+        uint16x8_t red   = vmovl_u8(channels.val[0]);
+        uint16x8_t green = vmovl_u8(channels.val[1]);
+        uint16x8_t blue  = vmovl_u8(channels.val[2]);
+
+        uint32x4_t low  = vmull_n_u16(vget_low_u16(red), RED_LUMINANCE);
+        low  = vmlal_n_u16(low,  vget_low_u16(green),  GREEN_LUMINANCE);
+        low  = vmlal_n_u16(low,  vget_low_u16(blue),   BLUE_LUMINANCE);
+        uint32x4_t high = vmull_n_u16(vget_high_u16(red), RED_LUMINANCE);
+        high = vmlal_n_u16(high, vget_high_u16(green), GREEN_LUMINANCE);
+        high = vmlal_n_u16(high, vget_high_u16(blue),  BLUE_LUMINANCE);
+
+        uint16x8_t gray = vcombine_u16( vshrn_n_u32(low,  GRAY_FIXED_POINT_SHIFT),
+                                        vshrn_n_u32(high, GRAY_FIXED_POINT_SHIFT));
+        vst1_u8(grays + col, vmovn_u16(gray));
+    }
+
+    rgb24RowToGrayscaleScalar(row + 3 * col, width - col, grays + col);
+}
+
+#ifdef __aarch64__
+static void descriptorDistancesNeon(const int16_t* glyphPairs,
+                                    size_t pairsCount, size_t glyphsCount,
+                                    const int16_t* frameDescriptor,
+                                    uint32_t* distances) {
+    for (size_t glyph = 0; glyph < glyphsCount; glyph += 4) {
+        int32x4_t acc = vdupq_n_s32(0);
+
+        for (size_t pair = 0; pair < pairsCount; ++pair) {
+            const int16_t* pairs = glyphPairs + 2 * (pair * glyphsCount + glyph);
+            int16x8_t framePair = vreinterpretq_s16_s32(
+                            vdupq_n_s32(packedFramePair(frameDescriptor, pair)));
+            int16x8_t diff = vsubq_s16(vld1q_s16(pairs), framePair);
+
+            int32x4_t lowSquares  = vmull_s16(vget_low_s16(diff),  vget_low_s16(diff));
+            int32x4_t highSquares = vmull_s16(vget_high_s16(diff), vget_high_s16(diff));
+            acc = vaddq_s32(acc, vpaddq_s32(lowSquares, highSquares));
+        }
+
+        vst1q_u32(distances + glyph, vreinterpretq_u32_s32(acc));
+    }
+}
+#endif // __aarch64__
+
+static inline uint16x8_t eightSumsBelowNeon(const uint32_t* sums, uint32x4_t bounds) {
+    return vcombine_u16(vmovn_u32(vcltq_u32(vld1q_u32(sums),     bounds)),
+                        vmovn_u32(vcltq_u32(vld1q_u32(sums + 4), bounds)));
+}
+
+static void markSumsBelowNeon(  const uint32_t* sums, size_t count,
+                                uint32_t bound, uint8_t bit, uint8_t* flags) {
+    const uint32x4_t bounds = vdupq_n_u32(bound);
+    const uint8x16_t bits   = vdupq_n_u8(bit);
+
+    size_t pos = 0;
+    for (; pos + 16 <= count; pos += 16) {
+        uint8x16_t below = vcombine_u8(vmovn_u16(eightSumsBelowNeon(sums + pos, bounds)),
+                                       vmovn_u16(eightSumsBelowNeon(sums + pos + 8, bounds)));
+        vst1q_u8(flags + pos, vorrq_u8(vld1q_u8(flags + pos), vandq_u8(below, bits)));
+    }
+
+    markSumsBelowScalar(sums + pos, count - pos, bound, bit, flags + pos);
+}
+
+static inline uint32_t horizontalSumNeon(uint32x4_t acc) {
+    uint64x2_t pairs = vpaddlq_u32(acc);
+    return vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1);
+}
+
+static uint32_t cellAbsoluteDifferenceNeon(const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound) {
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t distance = 0;
+
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t byte = chunk; byte < chunkEnd; byte += 16) {
+            uint8x16_t diff = vabdq_u8(vld1q_u8(first + byte), vld1q_u8(second + byte));
+            acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+        }
+
+        distance = horizontalSumNeon(acc);
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+
+static uint32_t cellSquaredDifferenceNeon( const uint8_t* first,
+                                            const uint8_t* second,
+                                            size_t cellBytes, uint32_t bound) {
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t distance = 0;
+
+    for (size_t chunk = 0; chunk < cellBytes; chunk += CELL_BOUND_CHECK_BYTES) {
+        size_t chunkEnd = std::min(chunk + CELL_BOUND_CHECK_BYTES, cellBytes);
+        for (size_t byte = chunk; byte < chunkEnd; byte += 16) {
+            uint8x16_t diff = vabdq_u8(vld1q_u8(first + byte), vld1q_u8(second + byte));
+            uint8x8_t lowDiff  = vget_low_u8(diff);
+            uint8x8_t highDiff = vget_high_u8(diff);
+            acc = vpadalq_u16(acc, vmull_u8(lowDiff,  lowDiff));
+            acc = vpadalq_u16(acc, vmull_u8(highDiff, highDiff));
+        }
+
+        distance = horizontalSumNeon(acc);
+        if (distance > bound) {
+            break;
+        }
+    }
+
+    return distance;
+}
+#endif // FRAME_KERNELS_NEON
+
+struct FrameKernels {
+    const char* isa;
+    row_sum_kernel sumRow;
+    row_accumulate_kernel accumulateRow;
+    row_grayscale_kernel rgb888ToGrayscale;
+    row_rgb24_grayscale_kernel rgb24ToGrayscale;
+    descriptor_distance_kernel descriptorDistances;
+    cell_distance_kernel cellAbsoluteDifference;
+    cell_distance_kernel cellSquaredDifference;
+    mark_sums_kernel markSumsBelow;
+};
+
+static FrameKernels scalarKernels() {
+    FrameKernels table;
+    table.isa = "scalar";
+    table.sumRow = sumRowScalar;
+    table.accumulateRow = accumulateRowScalar;
+    table.rgb888ToGrayscale = rgb888RowToGrayscaleScalar;
+    table.rgb24ToGrayscale = rgb24RowToGrayscaleScalar;
+    table.descriptorDistances = descriptorDistancesScalar;
+    table.cellAbsoluteDifference = cellAbsoluteDifferenceScalar;
+    table.cellSquaredDifference = cellSquaredDifferenceScalar;
+    table.markSumsBelow = markSumsBelowScalar;
+    return table;
+}
+
+#ifdef FRAME_KERNELS_X86
+static FrameKernels sse2Kernels() {
+    FrameKernels table = scalarKernels();
+    table.isa = "sse2";
+    table.sumRow = sumRowSse2;
+    table.accumulateRow = accumulateRowSse2;
+    table.rgb888ToGrayscale = rgb888RowToGrayscaleSse2;
+    // 24-bit pixels take byte shuffles SSE2 lacks, they stay scalar
+    table.descriptorDistances = descriptorDistancesSse2;
+    table.cellAbsoluteDifference = cellAbsoluteDifferenceSse2;
+    table.cellSquaredDifference = cellSquaredDifferenceSse2;
+    table.markSumsBelow = markSumsBelowSse2;
+    return table;
+}
+
+static FrameKernels avx2Kernels() {
+    FrameKernels table = sse2Kernels();
+    table.isa = "avx2";
+    table.sumRow = sumRowAvx2;
+    table.accumulateRow = accumulateRowAvx2;
+    table.rgb888ToGrayscale = rgb888RowToGrayscaleAvx2;
+    table.rgb24ToGrayscale = rgb24RowToGrayscaleAvx2;
+    table.descriptorDistances = descriptorDistancesAvx2;
+    table.cellAbsoluteDifference = cellAbsoluteDifferenceAvx2;
+    table.cellSquaredDifference = cellSquaredDifferenceAvx2;
+    // 256-bit packs work within 128-bit lanes, the reordering they need
+    // costs more than the wider comparisons save, so SSE2 one is kept
+    return table;
+}
+#endif // FRAME_KERNELS_X86
+
+#ifdef FRAME_KERNELS_NEON
+static FrameKernels neonKernels() {
+    FrameKernels table = scalarKernels();
+    table.isa = "neon";
+    table.sumRow = sumRowNeon;
+    table.accumulateRow = accumulateRowNeon;
+    table.rgb888ToGrayscale = rgb888RowToGrayscaleNeon;
+    table.rgb24ToGrayscale = rgb24RowToGrayscaleNeon;
+    table.cellAbsoluteDifference = cellAbsoluteDifferenceNeon;
+    table.cellSquaredDifference = cellSquaredDifferenceNeon;
+    table.markSumsBelow = markSumsBelowNeon;
+    #ifdef __aarch64__
+    table.descriptorDistances = descriptorDistancesNeon;
+    #endif
+    return table;
+}
+#endif // FRAME_KERNELS_NEON
+
+// kernel tables the CPU can run, the fastest first
+static std::vector<FrameKernels> supportedKernels() {
+    std::vector<FrameKernels> tables;
+
+#if defined(FRAME_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        tables.push_back(avx2Kernels());
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        tables.push_back(sse2Kernels());
+    }
+#elif defined(FRAME_KERNELS_NEON)
+    tables.push_back(neonKernels());
+#endif
+
+    tables.push_back(scalarKernels());
+    return tables;
+}
+
+static FrameKernels kernels = supportedKernels().front();
+
+uint64_t sumAreaPixels( const obj_brightness* topLeft, size_t stride,
+                        size_t width, size_t height) {
+    const uint8_t* row = reinterpret_cast<const uint8_t*>(topLeft);
+
+    uint64_t acc = 0;
+    for (size_t rowNum = 0; rowNum < height; ++rowNum, row += stride) {
+        acc += kernels.sumRow(row, width);
+    }
+
+    return acc;
+}
+
+void sumStripFrames(const obj_brightness* topLeft, size_t stride,
+                    size_t frameWidth, size_t frameHeight,
+                    size_t framesCount, uint32_t* sums) {
+    static thread_local std::vector<uint16_t> columnSums;
+
+    const size_t stripWidth = frameWidth * framesCount;
+    const uint8_t* row = reinterpret_cast<const uint8_t*>(topLeft);
+
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        sums[frame] = 0;
+    }
+
+    size_t rowsLeft = frameHeight;
+    while (rowsLeft > 0) {
+        size_t rowsNow = std::min(rowsLeft, ROWS_PER_ACCUMULATION);
+        columnSums.assign(stripWidth, 0);
+
+        for (size_t rowNum = 0; rowNum < rowsNow; ++rowNum, row += stride) {
+            kernels.accumulateRow(row, stripWidth, columnSums.data());
+        }
+
+        const uint16_t* frameColumns = columnSums.data();
+        for (size_t frame = 0; frame < framesCount; ++frame) {
+            uint32_t frameSum = 0;
+            for (size_t col = 0; col < frameWidth; ++col) {
+                frameSum += frameColumns[col];
+            }
+
+            sums[frame] += frameSum;
+            frameColumns += frameWidth;
+        }
+
+        rowsLeft -= rowsNow;
+    }
+}
+
+void sumStripFrameHalves(   const obj_brightness* topLeft, size_t stride,
+                            size_t frameWidth, size_t leftWidth, size_t height,
+                            size_t framesCount, uint32_t* leftSums,
+                            uint32_t* rightSums) {
+    static thread_local std::vector<uint16_t> columnSums;
+
+    const size_t stripWidth = frameWidth * framesCount;
+    const uint8_t* row = reinterpret_cast<const uint8_t*>(topLeft);
+
+    std::fill(leftSums,  leftSums  + framesCount, 0);
+    std::fill(rightSums, rightSums + framesCount, 0);
+
+    size_t rowsLeft = height;
+    while (rowsLeft > 0) {
+        size_t rowsNow = std::min(rowsLeft, ROWS_PER_ACCUMULATION);
+        columnSums.assign(stripWidth, 0);
+
+        for (size_t rowNum = 0; rowNum < rowsNow; ++rowNum, row += stride) {
+            kernels.accumulateRow(row, stripWidth, columnSums.data());
+        }
+
+        const uint16_t* frameColumns = columnSums.data();
+        for (size_t frame = 0; frame < framesCount; ++frame) {
+            uint32_t leftSum = 0;
+            uint32_t rightSum = 0;
+            for (size_t col = 0; col < leftWidth; ++col) {
+                leftSum += frameColumns[col];
+            }
+            for (size_t col = leftWidth; col < frameWidth; ++col) {
+                rightSum += frameColumns[col];
+            }
+
+            leftSums[frame]  += leftSum;
+            rightSums[frame] += rightSum;
+            frameColumns += frameWidth;
+        }
+
+        rowsLeft -= rowsNow;
+    }
+}
+
+void sumStripColumns(const obj_brightness* topLeft, size_t stride,
+                    size_t width, size_t height, uint32_t* columnSums) {
+    static thread_local std::vector<uint16_t> partialSums;
+
+    const uint8_t* row = reinterpret_cast<const uint8_t*>(topLeft);
+    std::fill(columnSums, columnSums + width, 0);
+
+    size_t rowsLeft = height;
+    while (rowsLeft > 0) {
+        size_t rowsNow = std::min(rowsLeft, ROWS_PER_ACCUMULATION);
+        partialSums.assign(width, 0);
+
+        for (size_t rowNum = 0; rowNum < rowsNow; ++rowNum, row += stride) {
+            kernels.accumulateRow(row, width, partialSums.data());
+        }
+
+        for (size_t col = 0; col < width; ++col) {
+            columnSums[col] += partialSums[col];
+        }
+
+        rowsLeft -= rowsNow;
+    }
+}
+
+void descriptorDistances(   const int16_t* glyphPairs, size_t pairsCount,
+                            size_t glyphsCount, const int16_t* frameDescriptor,
+                            uint32_t* distances) {
+    kernels.descriptorDistances(glyphPairs, pairsCount, glyphsCount,
+                                frameDescriptor, distances);
+}
+
+uint32_t cellAbsoluteDifference(const obj_brightness* first,
+                                const obj_brightness* second,
+                                size_t cellBytes, uint32_t bound) {
+    return kernels.cellAbsoluteDifference(  reinterpret_cast<const uint8_t*>(first),
+                                            reinterpret_cast<const uint8_t*>(second),
+                                            cellBytes, bound);
+}
+
+uint32_t cellSquaredDifference( const obj_brightness* first,
+                                const obj_brightness* second,
+                                size_t cellBytes, uint32_t bound) {
+    return kernels.cellSquaredDifference(   reinterpret_cast<const uint8_t*>(first),
+                                            reinterpret_cast<const uint8_t*>(second),
+                                            cellBytes, bound);
+}
+
+void markSumsBelow( const uint32_t* sums, size_t count, uint32_t bound,
+                    uint8_t bit, uint8_t* flags) {
+    kernels.markSumsBelow(sums, count, bound, bit, flags);
+}
+
+void rgb888RowToGrayscale(const uint32_t* row, size_t width, obj_brightness* grays) {
+    kernels.rgb888ToGrayscale(row, width, grays);
+}
+
+void rgb24RowToGrayscale(const uint8_t* row, size_t width, obj_brightness* grays) {
+    kernels.rgb24ToGrayscale(row, width, grays);
+}
+
+const char* frameKernelsIsa() {
+    return kernels.isa;
+}
+
+std::vector<std::string> supportedFrameKernelsIsas() {
+    std::vector<std::string> isas;
+    for (const FrameKernels& table : supportedKernels()) {
+        isas.push_back(table.isa);
+    }
+
+    return isas;
+}
+
+bool selectFrameKernelsIsa(const std::string& isa) {
+    for (const FrameKernels& table : supportedKernels()) {
+        if (isa == table.isa) {
+            kernels = table;
+            return true;
+        }
+    }
+
+    return false;
+}
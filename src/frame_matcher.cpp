@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <vector>
+
+#include "frame_matcher.h"
+#include "freetype_interface.h"
+#include "shape_matcher.h"
+#include "pixel_matcher.h"
+#include "braille_matcher.h"
+#include "frame_kernels.h"
+
+FrameMatcher::~FrameMatcher() {}
+
+GlyphBrightnessScale::GlyphBrightnessScale(const GlyphVocabulary& vocab)
+    : invert(vocab.invert)
+    , darkest(MAX_GRAY_LEVELS)
+    , range(1) {
+
+    const size_t cellSize = vocab.fontWidth * vocab.fontHeight;
+    int32_t brightest = 0;
+
+    for (size_t glyph = 0; glyph < vocab.glyphSymbols.size(); ++glyph) {
+        const obj_brightness* cell = vocab.glyphCells.data() + glyph * cellSize;
+        int32_t cellMean = sumAreaPixels(cell, cellSize, cellSize, 1) / cellSize;
+        if (invert) {
+            cellMean = MAX_GRAY_LEVELS - cellMean;
+        }
+
+        darkest   = std::min(darkest, cellMean);
+        brightest = std::max(brightest, cellMean);
+    }
+
+    range = std::max(brightest - darkest, 1);
+}
+
+obj_brightness GlyphBrightnessScale::operator()(uint32_t cellBrightness) const {
+    int32_t brightness = invert ? MAX_GRAY_LEVELS - cellBrightness : cellBrightness;
+    brightness = (brightness - darkest) * MAX_GRAY_LEVELS / range;
+
+    return std::max(0, std::min<int32_t>(brightness, MAX_GRAY_LEVELS));
+}
+
+MeanBrightnessMatcher::MeanBrightnessMatcher(const GlyphVocabulary& vocab)
+    : brightnessLookup(vocab.brightnessLookup) {}
+
+void MeanBrightnessMatcher::matchStrip( const FramedBitmap& map, size_t strip,
+                                        size_t firstFrame, size_t framesCount,
+                                        code_point* matches) const {
+    static thread_local std::vector<uint32_t> stripSums;
+    stripSums.resize(framesCount);
+
+    map.stripBrightnessSums(strip, firstFrame, framesCount, stripSums.data());
+
+    const size_t frameSize = map.frameWidth * map.frameHeight;
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        obj_brightness frameBrightness = stripSums[frame] / frameSize;
+        matches[frame] = brightnessLookup[frameBrightness];
+    }
+}
+
+std::unique_ptr<FrameMatcher> createFrameMatcher(   const GlyphVocabulary& vocab,
+                                                    MatchingMode mode,
+                                                    size_t shapeGrid) {
+    if (mode == SHAPE_MATCHING) {
+        return std::unique_ptr<FrameMatcher>(new ShapeMatcher(vocab, shapeGrid));
+    }
+
+    if (mode == ABSOLUTE_PIXEL_MATCHING || mode == SQUARED_PIXEL_MATCHING) {
+        PixelMetric metric = mode == ABSOLUTE_PIXEL_MATCHING
+                                ? SUM_OF_ABSOLUTE_DIFFERENCES
+                                : SUM_OF_SQUARED_DIFFERENCES;
+        return std::unique_ptr<FrameMatcher>(new PixelMatcher(vocab, metric));
+    }
+
+    if (mode == BRAILLE_MATCHING) {
+        return std::unique_ptr<FrameMatcher>(new BrailleMatcher(vocab));
+    }
+
+    return std::unique_ptr<FrameMatcher>(new MeanBrightnessMatcher(vocab));
+}
+
+std::unique_ptr<FrameMatcher> createFrameMatcher(MatchingMode mode, size_t shapeGrid) {
+    return createFrameMatcher(getGlyphVocabulary(), mode, shapeGrid);
+}
@@ -1,6 +1,9 @@
 #include <exception>
 #include <sstream>
 #include <algorithm>
+#include <array>
+#include <future>
+#include <memory>
 
 extern "C" {
     #include "ft2build.h"
@@ -9,8 +12,12 @@ extern "C" {
 
 #include "freetype_interface.h"
 #include "grayscale_bitmap.h"
+#include "glyph_cache.h"
+#include "thread_pool.h"
 
-static class FreetypeMaintainer {
+// every vocabulary build gets its own library instance, FreeType objects of
+// different instances can be used from different threads at once
+class FreetypeMaintainer {
 public:
     FreetypeMaintainer() : library(nullptr), fontFace(nullptr) {
 
@@ -30,20 +37,17 @@ public:
 
     FT_Library library;
     FT_Face fontFace;
-    brihgtness_map brightnessVocab;
 
 private:
     FreetypeMaintainer(const FreetypeMaintainer&);
-} ft;
+};
 
-static obj_brightness averageBitmapBrightness(const GrayscaleBitmap& bitmap) {
-    uint64_t acc = 0;
-    for (obj_brightness brightness : *bitmap.pixels) {
-        acc += brightness;
-    }
+// vocabulary of the legacy process-wide interface used by the tool
+static GlyphVocabulary processVocabulary;
 
-    return acc / bitmap.pixels->size();
-}
+// smaller symbol sets are rendered by the calling thread alone, opening the
+// font again costs more than rendering them
+static const size_t GLYPHS_PER_RENDER_WORKER = 512;
 
 static void checkGlyphFormat(const FT_GlyphSlot& glyph) {
     if (glyph->format != FT_GLYPH_FORMAT_BITMAP) {
@@ -55,17 +59,16 @@ static void checkGlyphFormat(const FT_GlyphSlot& glyph) {
     }
 }
 
-static GrayscaleBitmap asciiSymbolToBitmap(char symbol) {
-    int error = FT_Load_Char(   ft.fontFace, static_cast<FT_ULong>(symbol),
-                                FT_LOAD_RENDER);
+static GrayscaleBitmap symbolToBitmap(FT_Face fontFace, code_point symbol) {
+    int error = FT_Load_Char(fontFace, static_cast<FT_ULong>(symbol), FT_LOAD_RENDER);
 
     if (error) {
         throw std::runtime_error("Error while loading char");
     }
 
-    checkGlyphFormat(ft.fontFace->glyph);
+    checkGlyphFormat(fontFace->glyph);
 
-    return GrayscaleBitmap(ft.fontFace);
+    return GrayscaleBitmap(fontFace);
 }
 
 template<typename T> static bool compareSecond(const T& lhs, const T& rhs) {
@@ -79,6 +82,11 @@ static void expandBrightnessRange(brihgtness_map& brMap) {
     obj_brightness minBr = std::min_element(brMap.begin(), brMap.end(),
                                 compareSecond<symbol_brightness_pair>)->second;
 
+    // glyphs of the same brightness have nothing to spread
+    if (maxBr == minBr) {
+        return;
+    }
+
     for (symbol_brightness_pair& entry : brMap) {
         uint16_t correctedBr = entry.second - minBr;
         correctedBr *= MAX_GRAY_LEVELS;
@@ -87,21 +95,149 @@ static void expandBrightnessRange(brihgtness_map& brMap) {
     }
 }
 
-static void initVocabulary(bool invertBrightness) {
-    ft.brightnessVocab.clear();
+// symbols are indexed by their brightness first, so that filling the table
+// takes the same time for a hundred symbols and for thousands of them; of
+// equally close symbols the one with the lowest code point is taken
+static void initBrightnessLookup(GlyphVocabulary& vocab) {
+    static const code_point NO_SYMBOL = 0;
+    static const int LEVELS = MAX_GRAY_LEVELS + 1;
+
+    std::array<code_point, MAX_GRAY_LEVELS + 1> symbolOfLevel;
+    symbolOfLevel.fill(NO_SYMBOL);
+    // the vocabulary is ordered by code point
+    for (const symbol_brightness_pair& entry : vocab.brightness) {
+        if (symbolOfLevel[entry.second] == NO_SYMBOL) {
+            symbolOfLevel[entry.second] = entry.first;
+        }
+    }
+
+    for (int target = 0; target < LEVELS; ++target) {
+        for (int distance = 0; distance < LEVELS; ++distance) {
+            code_point darker   = target - distance >= 0
+                                    ? symbolOfLevel[target - distance] : NO_SYMBOL;
+            code_point brighter = target + distance < LEVELS
+                                    ? symbolOfLevel[target + distance] : NO_SYMBOL;
+
+            if (darker != NO_SYMBOL || brighter != NO_SYMBOL) {
+                vocab.brightnessLookup[target] =
+                        darker == NO_SYMBOL ? brighter
+                      : brighter == NO_SYMBOL ? darker
+                      : std::min(darker, brighter);
+                break;
+            }
+        }
+    }
+}
+
+// symbols without a glyph in the font are skipped instead of being drawn
+// as the 'missing glyph' box
+static void renderGlyphs(   FT_Face fontFace, const code_point* symbols,
+                            size_t symbolsCount, std::vector<code_point>& rendered,
+                            pixels_vector& cells) {
+    for (size_t pos = 0; pos < symbolsCount; ++pos) {
+        if (FT_Get_Char_Index(fontFace, static_cast<FT_ULong>(symbols[pos])) == 0) {
+            continue;
+        }
+
+        GrayscaleBitmap bitmap = symbolToBitmap(fontFace, symbols[pos]);
+        rendered.push_back(symbols[pos]);
+        cells.insert(cells.end(), bitmap.pixels->begin(), bitmap.pixels->end());
+    }
+}
+
+static void openSizedFace(  const std::string& fontpath, uint_fast16_t fontSize,
+                            FreetypeMaintainer& ft);
+
+// every rendering worker opens the font with its own FreeType instance, the
+// calling thread renders the first part of the symbols with the given face
+static void initVocabulary( const std::string& fontpath, uint_fast16_t fontSize,
+                            FT_Face fontFace, bool invertBrightness,
+                            const std::vector<code_point>& charset,
+                            GlyphVocabulary& vocab) {
+    const std::vector<code_point> symbols = charset.empty() ? printableAsciiCharset()
+                                                            : charset;
+    const size_t workersNum = std::max<size_t>(1, std::min(ThreadPool::defaultSize(),
+                                        symbols.size() / GLYPHS_PER_RENDER_WORKER));
+    const size_t partSize = (symbols.size() + workersNum - 1) / workersNum;
+
+    std::vector< std::vector<code_point> > rendered(workersNum);
+    std::vector<pixels_vector> cells(workersNum);
+    std::vector< std::future<void> > workersDone;
+
+    // declared after the data the workers fill, so that they are joined first
+    std::unique_ptr<ThreadPool> pool;
+    if (workersNum > 1) {
+        pool.reset(new ThreadPool(workersNum - 1));
+    }
+
+    for (size_t worker = 1; worker < workersNum; ++worker) {
+        workersDone.push_back(pool->submit([&, worker]() {
+            FreetypeMaintainer ft;
+            openSizedFace(fontpath, fontSize, ft);
+
+            size_t first = std::min(worker * partSize, symbols.size());
+            size_t count = std::min(partSize, symbols.size() - first);
+            renderGlyphs(ft.fontFace, symbols.data() + first, count,
+                         rendered[worker], cells[worker]);
+        }));
+    }
+
+    renderGlyphs(fontFace, symbols.data(), std::min(partSize, symbols.size()),
+                 rendered[0], cells[0]);
+    for (std::future<void>& done : workersDone) {
+        done.get();
+    }
+
+    std::vector<code_point> allRendered;
+    pixels_vector allCells;
+    for (size_t worker = 0; worker < workersNum; ++worker) {
+        allRendered.insert(allRendered.end(), rendered[worker].begin(),
+                            rendered[worker].end());
+        allCells.insert(allCells.end(), cells[worker].begin(), cells[worker].end());
+    }
+
+    if (allRendered.empty()) {
+        throw std::runtime_error("The font has no glyphs for the chosen symbols");
+    }
+
+    vocab = buildGlyphVocabulary(vocab.fontWidth, vocab.fontHeight,
+                                invertBrightness, allRendered, allCells);
+}
+
+GlyphVocabulary buildGlyphVocabulary(   uint_fast16_t fontWidth,
+                                        uint_fast16_t fontHeight, bool invert,
+                                        const std::vector<code_point>& symbols,
+                                        const pixels_vector& glyphCells) {
+    const size_t cellSize = fontWidth * fontHeight;
+    if (symbols.empty() || cellSize == 0 || glyphCells.size() != symbols.size() * cellSize) {
+        throw std::runtime_error("Glyph cells do not match the symbols");
+    }
+
+    GlyphVocabulary vocab;
+    vocab.fontWidth     = fontWidth;
+    vocab.fontHeight    = fontHeight;
+    vocab.invert        = invert;
+    vocab.glyphSymbols  = symbols;
+    vocab.glyphCells    = glyphCells;
+
+    for (size_t glyph = 0; glyph < symbols.size(); ++glyph) {
+        const obj_brightness* cell = glyphCells.data() + glyph * cellSize;
+        uint64_t acc = 0;
+        for (size_t pixel = 0; pixel < cellSize; ++pixel) {
+            acc += cell[pixel];
+        }
 
-    for (char   symbol = FIRST_PRINTABLE_ASCII_SYMBOL;
-                symbol <= LAST_PRINTABLE_ASCII_SYMBOL; ++symbol) {
-        GrayscaleBitmap bitmap = asciiSymbolToBitmap(symbol);
-        obj_brightness brightness =
-                            invertBrightness
-                            ? MAX_GRAY_LEVELS - averageBitmapBrightness(bitmap)
-                            : averageBitmapBrightness(bitmap);
-        symbol_brightness_pair entry(symbol, brightness);
-        ft.brightnessVocab.insert(entry);
+        obj_brightness brightness = acc / cellSize;
+        if (invert) {
+            brightness = MAX_GRAY_LEVELS - brightness;
+        }
+        vocab.brightness.insert(symbol_brightness_pair(symbols[glyph], brightness));
     }
 
-    expandBrightnessRange(ft.brightnessVocab);
+    expandBrightnessRange(vocab.brightness);
+    initBrightnessLookup(vocab);
+
+    return vocab;
 }
 
 static void loadDefaultFaceFromFontFile(const std::string& fontPath,
@@ -149,46 +285,75 @@ static void setCharSizeInPoints(FT_Face& face, uint32_t size,
     }
 }
 
-void setupFont(const std::string& fontpath, uint_fast16_t fontSize, bool invert) {
-    static const FT_UInt DEFAULT_HORIZ_RES          = 72;
-    static const FT_UInt DEFAULT_VERTICAL_RES       = DEFAULT_HORIZ_RES;
+static const FT_UInt DEFAULT_HORIZ_RES      = 72;
+static const FT_UInt DEFAULT_VERTICAL_RES   = DEFAULT_HORIZ_RES;
 
+static void openSizedFace(  const std::string& fontpath, uint_fast16_t fontSize,
+                            FreetypeMaintainer& ft) {
     loadDefaultFaceFromFontFile(fontpath, ft.library, ft.fontFace);
     checkFontfaceFormat(ft.fontFace);
     setCharSizeInPoints(ft.fontFace, fontSize, DEFAULT_HORIZ_RES,
                         DEFAULT_VERTICAL_RES);
+}
+
+GlyphVocabulary loadGlyphVocabulary( const std::string& fontpath,
+                                    uint_fast16_t fontSize, bool invert,
+                                    const std::string& cacheDir,
+                                    const std::vector<code_point>& charset) {
+    GlyphVocabulary vocab;
+
+    VocabularyCacheKey cacheKey;
+    if (!cacheDir.empty()) {
+        cacheKey = makeVocabularyCacheKey(fontpath, fontSize, DEFAULT_HORIZ_RES,
+                                            invert, charset);
+        if (loadVocabularyCache(cacheDir, cacheKey, vocab)) {
+            return vocab;
+        }
+    }
+
+    FreetypeMaintainer ft;
+    openSizedFace(fontpath, fontSize, ft);
+
+    vocab.fontHeight = ft.fontFace->size->metrics.height
+                            / FIXED_POINT_26_6_COEFF;
+    vocab.fontWidth  = ft.fontFace->size->metrics.max_advance
+                            / FIXED_POINT_26_6_COEFF;
+    vocab.invert     = invert;
+    initVocabulary(fontpath, fontSize, ft.fontFace, invert, charset, vocab);
+
+    if (!cacheDir.empty()) {
+        storeVocabularyCache(cacheDir, cacheKey, vocab);
+    }
 
-    initVocabulary(invert);
+    return vocab;
+}
+
+void setupFont(const std::string& fontpath, uint_fast16_t fontSize, bool invert,
+                const std::string& cacheDir, const std::vector<code_point>& charset) {
+    processVocabulary = loadGlyphVocabulary(fontpath, fontSize, invert, cacheDir,
+                                            charset);
 }
 
 uint_fast16_t getFontHeight() {
-    return ft.fontFace->size->metrics.height / FIXED_POINT_26_6_COEFF;
+    return processVocabulary.fontHeight;
 }
 
 uint_fast16_t getFontWidth() {
-    return ft.fontFace->size->metrics.max_advance / FIXED_POINT_26_6_COEFF;
+    return processVocabulary.fontWidth;
 }
 
-obj_brightness getSymbolBrightness(char symbol) {
-    return ft.brightnessVocab.at(symbol);
+obj_brightness getSymbolBrightness(code_point symbol) {
+    return processVocabulary.brightness.at(symbol);
 }
 
 const brihgtness_map& getBrightnessVocabulary() {
-    return ft.brightnessVocab;
+    return processVocabulary.brightness;
 }
 
-char symbolWithBrightnessClosestTo(obj_brightness targetBrightness) {
-    obj_brightness leastBrDiff = MAX_GRAY_LEVELS;
-    char bestMatch = ft.brightnessVocab.begin()->first;
-
-    for (const symbol_brightness_pair& entry : ft.brightnessVocab) {
-        obj_brightness brDiff = abs(static_cast<int>(targetBrightness)
-                                    - entry.second);
-        if (brDiff < leastBrDiff) {
-            leastBrDiff = brDiff;
-            bestMatch = entry.first;
-        }
-    }
+const GlyphVocabulary& getGlyphVocabulary() {
+    return processVocabulary;
+}
 
-    return bestMatch;
+code_point symbolWithBrightnessClosestTo(obj_brightness targetBrightness) {
+    return processVocabulary.brightnessLookup[targetBrightness];
 }
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "gif_decoder.h"
+#include "frame_kernels.h"
+
+static const size_t MAX_LZW_CODES = 4096;
+static const size_t MAX_LZW_CODE_SIZE = 12;
+
+static const uint8_t EXTENSION_INTRODUCER = 0x21;
+static const uint8_t IMAGE_SEPARATOR      = 0x2C;
+static const uint8_t TRAILER              = 0x3B;
+static const uint8_t GRAPHIC_CONTROL      = 0xF9;
+
+static const uint8_t HAS_COLOR_TABLE      = 0x80;
+static const uint8_t INTERLACED           = 0x40;
+
+enum GifDisposal {
+    KEEP_FRAME          = 1,
+    RESTORE_BACKGROUND  = 2,
+    RESTORE_PREVIOUS    = 3
+};
+
+bool isGifFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char signature[6] = { 0 };
+    file.read(signature, sizeof(signature));
+
+    return      file
+            &&  (   memcmp(signature, "GIF87a", sizeof(signature)) == 0
+                ||  memcmp(signature, "GIF89a", sizeof(signature)) == 0);
+}
+
+GifDecoder::GifDecoder(const std::string& _path)
+    : path(_path)
+    , pos(0)
+    , background(MAX_GRAY_LEVELS)
+    , transparentIndex(-1)
+    , disposal(0)
+    , lastDisposal(0)
+    , lastLeft(0)
+    , lastTop(0)
+    , lastWidth(0)
+    , lastHeight(0) {
+
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Unable to open image '" + path + "'");
+    }
+    file.assign(std::istreambuf_iterator<char>(input),
+                std::istreambuf_iterator<char>());
+
+    if (!isGifFile(path)) {
+        throw std::runtime_error("Image '" + path + "' is not a GIF image");
+    }
+    pos = 6;
+
+    canvasWidth  = nextWord();
+    canvasHeight = nextWord();
+    uint8_t flags = nextByte();
+    uint8_t backgroundIndex = nextByte();
+    nextByte(); // pixel aspect ratio
+
+    if (canvasWidth == 0 || canvasHeight == 0) {
+        throw std::runtime_error("Image '" + path + "' has no pixels");
+    }
+
+    std::fill(globalGrays, globalGrays + 256, 0);
+    if (flags & HAS_COLOR_TABLE) {
+        readPalette(2 << (flags & 7), globalGrays);
+        background = globalGrays[backgroundIndex];
+    }
+
+    pixels.assign(canvasWidth * canvasHeight, background);
+}
+
+bool GifDecoder::nextFrame() {
+    while (pos < file.size()) {
+        uint8_t blockType = nextByte();
+
+        if (blockType == IMAGE_SEPARATOR) {
+            disposePreviousFrame();
+            drawImage();
+            return true;
+        }
+
+        if (blockType == TRAILER) {
+            return false;
+        }
+
+        if (blockType != EXTENSION_INTRODUCER) {
+            throw std::runtime_error("Image '" + path + "' is corrupt");
+        }
+
+        if (nextByte() == GRAPHIC_CONTROL) {
+            readGraphicControl();
+        } else {
+            skipSubBlocks();
+        }
+    }
+
+    // some encoders leave the trailer out
+    return false;
+}
+
+const obj_brightness* GifDecoder::canvas() const {
+    return pixels.data();
+}
+
+size_t GifDecoder::width() const {
+    return canvasWidth;
+}
+
+size_t GifDecoder::height() const {
+    return canvasHeight;
+}
+
+uint8_t GifDecoder::nextByte() {
+    if (pos >= file.size()) {
+        throw std::runtime_error("Image '" + path + "' is truncated");
+    }
+
+    return file[pos++];
+}
+
+uint16_t GifDecoder::nextWord() {
+    uint16_t low = nextByte();
+    return low | nextByte() << 8;
+}
+
+void GifDecoder::readPalette(size_t colors, obj_brightness* grays) {
+    if (file.size() - pos < colors * 3) {
+        throw std::runtime_error("Image '" + path + "' is truncated");
+    }
+
+    rgb24RowToGrayscale(file.data() + pos, colors, grays);
+    pos += colors * 3;
+}
+
+void GifDecoder::skipSubBlocks() {
+    while (size_t blockSize = nextByte()) {
+        if (file.size() - pos < blockSize) {
+            throw std::runtime_error("Image '" + path + "' is truncated");
+        }
+        pos += blockSize;
+    }
+}
+
+// the settings apply to the image that follows
+void GifDecoder::readGraphicControl() {
+    size_t blockSize = nextByte();
+    if (blockSize >= 4) {
+        uint8_t flags = nextByte();
+        nextWord(); // frame delay
+        uint8_t transparent = nextByte();
+
+        disposal = (flags >> 2) & 7;
+        transparentIndex = flags & 1 ? transparent : -1;
+        blockSize -= 4;
+    }
+
+    if (file.size() - pos < blockSize) {
+        throw std::runtime_error("Image '" + path + "' is truncated");
+    }
+    pos += blockSize;
+    skipSubBlocks();
+}
+
+void GifDecoder::disposePreviousFrame() {
+    if (lastDisposal == RESTORE_BACKGROUND) {
+        for (size_t row = lastTop; row < lastTop + lastHeight; ++row) {
+            obj_brightness* rowStart = pixels.data() + row * canvasWidth;
+            std::fill(rowStart + lastLeft, rowStart + lastLeft + lastWidth, background);
+        }
+    } else if (lastDisposal == RESTORE_PREVIOUS && !savedPixels.empty()) {
+        pixels = savedPixels;
+    }
+}
+
+void GifDecoder::drawImage() {
+    size_t left   = nextWord();
+    size_t top    = nextWord();
+    size_t width  = nextWord();
+    size_t height = nextWord();
+    uint8_t flags = nextByte();
+
+    obj_brightness localGrays[256];
+    const obj_brightness* grays = globalGrays;
+    if (flags & HAS_COLOR_TABLE) {
+        std::fill(localGrays, localGrays + 256, 0);
+        readPalette(2 << (flags & 7), localGrays);
+        grays = localGrays;
+    }
+
+    std::vector<uint8_t> indices(width * height);
+    size_t decoded = decodeIndices(nextByte(), indices);
+
+    if (disposal == RESTORE_PREVIOUS) {
+        savedPixels = pixels;
+    }
+
+    // interlaced rows come in four passes
+    std::vector<size_t> rowOrder;
+    rowOrder.reserve(height);
+    if (flags & INTERLACED) {
+        const size_t passStart[] = { 0, 4, 2, 1 };
+        const size_t passStep[]  = { 8, 8, 4, 2 };
+        for (size_t pass = 0; pass < 4; ++pass) {
+            for (size_t row = passStart[pass]; row < height; row += passStep[pass]) {
+                rowOrder.push_back(row);
+            }
+        }
+    } else {
+        for (size_t row = 0; row < height; ++row) {
+            rowOrder.push_back(row);
+        }
+    }
+
+    // frames are allowed to stick out of the canvas, the outside is cut off
+    lastLeft   = std::min(left, canvasWidth);
+    lastTop    = std::min(top, canvasHeight);
+    lastWidth  = std::min(width, canvasWidth - lastLeft);
+    lastHeight = std::min(height, canvasHeight - lastTop);
+
+    for (size_t line = 0; line < height; ++line) {
+        size_t row = rowOrder[line];
+        if (row >= lastHeight) {
+            continue;
+        }
+
+        // image data missing at the end leaves the canvas as is, as most
+        // viewers do
+        size_t lineStart = line * width;
+        size_t lineDecoded = decoded > lineStart ? decoded - lineStart : 0;
+
+        const uint8_t* lineIndices = indices.data() + lineStart;
+        obj_brightness* canvasRow = pixels.data() + (lastTop + row) * canvasWidth
+                                    + lastLeft;
+        for (size_t col = 0; col < std::min(lastWidth, lineDecoded); ++col) {
+            if (lineIndices[col] != transparentIndex) {
+                canvasRow[col] = grays[lineIndices[col]];
+            }
+        }
+    }
+
+    lastDisposal = disposal;
+    disposal = 0;
+    transparentIndex = -1;
+}
+
+size_t GifDecoder::decodeIndices(size_t minCodeSize, std::vector<uint8_t>& indices) {
+    if (minCodeSize < 1 || minCodeSize >= MAX_LZW_CODE_SIZE) {
+        throw std::runtime_error("Image '" + path + "' is corrupt");
+    }
+
+    std::vector<uint8_t> codes;
+    while (size_t blockSize = nextByte()) {
+        if (file.size() - pos < blockSize) {
+            throw std::runtime_error("Image '" + path + "' is truncated");
+        }
+        codes.insert(codes.end(), file.begin() + pos, file.begin() + pos + blockSize);
+        pos += blockSize;
+    }
+
+    const size_t clearCode = 1 << minCodeSize;
+    const size_t endCode   = clearCode + 1;
+
+    uint16_t prefix[MAX_LZW_CODES];
+    uint8_t  suffix[MAX_LZW_CODES];
+    uint8_t  stack[MAX_LZW_CODES + 1];
+    for (size_t code = 0; code < clearCode; ++code) {
+        suffix[code] = code;
+    }
+
+    size_t codeSize = minCodeSize + 1;
+    size_t nextCode = clearCode + 2;
+    size_t previous = MAX_LZW_CODES;
+    uint8_t firstSymbol = 0;
+
+    size_t written = 0;
+    size_t bitPos  = 0;
+    const size_t bitsTotal = codes.size() * 8;
+
+    while (written < indices.size() && bitPos + codeSize <= bitsTotal) {
+        size_t code = 0;
+        for (size_t bit = 0; bit < codeSize; ++bit, ++bitPos) {
+            code |= ((codes[bitPos >> 3] >> (bitPos & 7)) & 1) << bit;
+        }
+
+        if (code == clearCode) {
+            codeSize = minCodeSize + 1;
+            nextCode = clearCode + 2;
+            previous = MAX_LZW_CODES;
+            continue;
+        }
+
+        if (code == endCode) {
+            break;
+        }
+
+        if (previous == MAX_LZW_CODES) {
+            if (code >= clearCode) {
+                throw std::runtime_error("Image '" + path + "' is corrupt");
+            }
+
+            indices[written++] = code;
+            firstSymbol = code;
+            previous = code;
+            continue;
+        }
+
+        if (code > nextCode) {
+            throw std::runtime_error("Image '" + path + "' is corrupt");
+        }
+
+        size_t stackSize = 0;
+        size_t current = code;
+        if (code == nextCode) {
+            stack[stackSize++] = firstSymbol;
+            current = previous;
+        }
+
+        while (current >= clearCode) {
+            stack[stackSize++] = suffix[current];
+            current = prefix[current];
+        }
+        firstSymbol = current;
+        stack[stackSize++] = firstSymbol;
+
+        if (nextCode < MAX_LZW_CODES) {
+            prefix[nextCode] = previous;
+            suffix[nextCode] = firstSymbol;
+            ++nextCode;
+            if (nextCode == (size_t(1) << codeSize) && codeSize < MAX_LZW_CODE_SIZE) {
+                ++codeSize;
+            }
+        }
+        previous = code;
+
+        while (stackSize > 0 && written < indices.size()) {
+            indices[written++] = stack[--stackSize];
+        }
+    }
+
+    return written;
+}
@@ -0,0 +1,288 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+extern "C" {
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+#include "glyph_cache.h"
+
+static const char     CACHE_MAGIC[8]    = { 'I', 'M', 'G', 'G', 'L', 'Y', 'P', 'H' };
+static const uint32_t CACHE_VERSION     = 2;
+
+/**
+ * Cache file layout: header, then symbolsCount records, then the brightness
+ * lookup table of 32-bit code points, then symbolsCount glyph cells if
+ * hasGlyphCells is set; all numbers are stored in native byte order
+ */
+struct CacheFileHeader {
+    char                magic[8];
+    uint32_t            version;
+    uint32_t            headerSize;
+    VocabularyCacheKey  key;
+    uint32_t            fontWidth;
+    uint32_t            fontHeight;
+    uint32_t            symbolsCount;
+    uint32_t            hasGlyphCells;
+};
+
+struct CacheSymbolRecord {
+    uint32_t symbol;
+    uint32_t brightness;
+};
+
+static const size_t LOOKUP_SIZE = (MAX_GRAY_LEVELS + 1) * sizeof(uint32_t);
+
+// keeps the file mapped only while the vocabulary is being copied out of it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path)
+        : data(MAP_FAILED)
+        , size(0) {
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+            size = fileStat.st_size;
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (isMapped()) {
+            munmap(data, size);
+        }
+    }
+
+    bool isMapped() const {
+        return data != MAP_FAILED;
+    }
+
+    const uint8_t* bytes() const {
+        return static_cast<const uint8_t*>(data);
+    }
+
+    void*   data;
+    size_t  size;
+
+private:
+    MappedFile(const MappedFile&);
+};
+
+// FNV-1a, the font file is hashed once per run, so it does not have to be
+// faster than reading the file
+static uint64_t hashBytes(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t byte = 0; byte < size; ++byte) {
+        hash ^= data[byte];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+VocabularyCacheKey makeVocabularyCacheKey(  const std::string& fontpath,
+                                            uint32_t fontSize,
+                                            uint32_t resolution, bool invert,
+                                            const std::vector<code_point>& charset) {
+    MappedFile font(fontpath);
+    const std::vector<code_point> symbols = charset.empty() ? printableAsciiCharset()
+                                                            : charset;
+
+    VocabularyCacheKey key;
+    memset(&key, 0, sizeof(key));
+    key.fontHash        = font.isMapped() ? hashBytes(font.bytes(), font.size) : 0;
+    key.fontFileSize    = font.size;
+    key.fontSize        = fontSize;
+    key.resolution      = resolution;
+    key.invert          = invert ? 1 : 0;
+    key.charsetHash     = hashBytes(reinterpret_cast<const uint8_t*>(symbols.data()),
+                                    symbols.size() * sizeof(code_point));
+
+    return key;
+}
+
+std::string defaultVocabularyCacheDir() {
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome != NULL && cacheHome[0] != '\0') {
+        return std::string(cacheHome) + "/img_glypher";
+    }
+
+    const char* home = getenv("HOME");
+    if (home != NULL && home[0] != '\0') {
+        return std::string(home) + "/.cache/img_glypher";
+    }
+
+    return std::string();
+}
+
+static std::string cacheFilePath(const std::string& cacheDir,
+                                const VocabularyCacheKey& key) {
+    std::stringstream path;
+    path << cacheDir << '/' << std::hex << key.fontHash << '-' << key.fontFileSize
+         << std::dec << "-s" << key.fontSize << "-r" << key.resolution
+         << (key.invert ? "-inv" : "") << "-c" << std::hex << key.charsetHash
+         << ".vocab";
+
+    return path.str();
+}
+
+static bool sameKey(const VocabularyCacheKey& lhs, const VocabularyCacheKey& rhs) {
+    return     lhs.fontHash     == rhs.fontHash
+            && lhs.fontFileSize == rhs.fontFileSize
+            && lhs.fontSize     == rhs.fontSize
+            && lhs.resolution   == rhs.resolution
+            && lhs.invert       == rhs.invert
+            && lhs.charsetHash  == rhs.charsetHash;
+}
+
+bool loadVocabularyCache(   const std::string& cacheDir,
+                            const VocabularyCacheKey& key,
+                            GlyphVocabulary& vocab) {
+    MappedFile cache(cacheFilePath(cacheDir, key));
+    if (!cache.isMapped() || cache.size < sizeof(CacheFileHeader)) {
+        return false;
+    }
+
+    CacheFileHeader header;
+    memcpy(&header, cache.bytes(), sizeof(header));
+
+    if (    memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        ||  header.version != CACHE_VERSION
+        ||  header.headerSize != sizeof(CacheFileHeader)
+        ||  !sameKey(header.key, key)
+        ||  header.symbolsCount == 0) {
+        return false;
+    }
+
+    const size_t cellSize = header.fontWidth * header.fontHeight;
+    const size_t recordsSize = header.symbolsCount * sizeof(CacheSymbolRecord);
+    const size_t cellsSize = header.hasGlyphCells
+                            ? header.symbolsCount * cellSize : 0;
+    if (cache.size != sizeof(header) + recordsSize + LOOKUP_SIZE + cellsSize) {
+        return false;
+    }
+
+    GlyphVocabulary restored;
+    restored.fontWidth  = header.fontWidth;
+    restored.fontHeight = header.fontHeight;
+    restored.invert     = header.key.invert != 0;
+
+    const uint8_t* records = cache.bytes() + sizeof(header);
+    for (uint32_t recordNum = 0; recordNum < header.symbolsCount; ++recordNum) {
+        CacheSymbolRecord record;
+        memcpy(&record, records + recordNum * sizeof(record), sizeof(record));
+
+        code_point symbol = record.symbol;
+        if (    record.brightness > MAX_GRAY_LEVELS
+            ||  !restored.brightness.insert(
+                    symbol_brightness_pair(symbol, record.brightness)).second) {
+            return false;
+        }
+        restored.glyphSymbols.push_back(symbol);
+    }
+
+    // the matchers look the symbols of the table up in the brightness map,
+    // a damaged file is a cache miss rather than a failed conversion
+    const uint8_t* lookup = records + recordsSize;
+    memcpy(restored.brightnessLookup.data(), lookup, LOOKUP_SIZE);
+    for (code_point symbol : restored.brightnessLookup) {
+        if (restored.brightness.count(symbol) == 0) {
+            return false;
+        }
+    }
+
+    const uint8_t* cells = lookup + LOOKUP_SIZE;
+    restored.glyphCells.assign(cells, cells + cellsSize);
+
+    vocab = std::move(restored);
+    return true;
+}
+
+static bool makeDirectories(const std::string& path) {
+    for (size_t slashPos = path.find('/', 1); ; slashPos = path.find('/', slashPos + 1)) {
+        std::string dir = path.substr(0, slashPos);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+
+        if (slashPos == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+void storeVocabularyCache(  const std::string& cacheDir,
+                            const VocabularyCacheKey& key,
+                            const GlyphVocabulary& vocab) {
+    if (!makeDirectories(cacheDir)) {
+        return;
+    }
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version          = CACHE_VERSION;
+    header.headerSize       = sizeof(CacheFileHeader);
+    header.key              = key;
+    header.fontWidth        = vocab.fontWidth;
+    header.fontHeight       = vocab.fontHeight;
+    header.symbolsCount     = vocab.glyphSymbols.size();
+    header.hasGlyphCells    = vocab.glyphCells.size()
+                                == header.symbolsCount * vocab.fontWidth
+                                                       * vocab.fontHeight;
+
+    // every writer, a thread or a process, gets a file of its own, and the
+    // complete one replaces the cache file at once
+    std::string path = cacheFilePath(cacheDir, key);
+    std::vector<char> tmpPath(path.begin(), path.end());
+    const char tmpSuffix[] = ".tmpXXXXXX";
+    tmpPath.insert(tmpPath.end(), tmpSuffix, tmpSuffix + sizeof(tmpSuffix));
+
+    int fd = mkstemp(tmpPath.data());
+    if (fd < 0) {
+        return;
+    }
+    fchmod(fd, 0644);
+    close(fd);
+
+    {
+        std::ofstream cache(tmpPath.data(), std::ios::binary);
+        cache.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (code_point symbol : vocab.glyphSymbols) {
+            CacheSymbolRecord record = { symbol, vocab.brightness.at(symbol) };
+            cache.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+
+        cache.write(reinterpret_cast<const char*>(vocab.brightnessLookup.data()),
+                    LOOKUP_SIZE);
+
+        if (header.hasGlyphCells) {
+            cache.write(reinterpret_cast<const char*>(vocab.glyphCells.data()),
+                        vocab.glyphCells.size());
+        }
+
+        if (!cache) {
+            cache.close();
+            remove(tmpPath.data());
+            return;
+        }
+    }
+
+    if (rename(tmpPath.data(), path.c_str()) != 0) {
+        remove(tmpPath.data());
+    }
+}
@@ -1,35 +1,50 @@
+#include <algorithm>
 #include <exception>
+#include <stdexcept>
+#include <cstring>
 #include "grayscale_bitmap.h"
+#include "frame_kernels.h"
+#include "frame_colors.h"
 
 static const uint32_t FIXED_POINT_26_6_COEFF = 1<<6;
 GrayscaleBitmap::GrayscaleBitmap(const FT_Face fontFace)
     : rows(fontFace->size->metrics.height / FIXED_POINT_26_6_COEFF)
     , columns(fontFace->size->metrics.max_advance / FIXED_POINT_26_6_COEFF)
+    , stride(columns)
     , pixels(new pixels_vector(rows*columns, MAX_GRAY_LEVELS))
-    , num_grays(fontFace->glyph->bitmap.num_grays) {
+    , num_grays(fontFace->glyph->bitmap.num_grays)
+    , data(pixels->data()) {
 
-    size_t baselineRow         = fontFace->size->metrics.ascender
+    long baselineRow           = fontFace->size->metrics.ascender
                                     / FIXED_POINT_26_6_COEFF;
-    size_t leftBearing         = fontFace->glyph->bitmap_left;
-    size_t fromTopToSymbol     = baselineRow - fontFace->glyph->bitmap_top;
+    long leftBearing           = fontFace->glyph->bitmap_left;
+    long fromTopToSymbol       = baselineRow - fontFace->glyph->bitmap_top;
     const FT_Bitmap& ftBitmap  = fontFace->glyph->bitmap;
-    const size_t vectorSize    = pixels->size();
-
-    size_t symbolRows = static_cast<size_t>(ftBitmap.rows);
-    size_t symbolCols = static_cast<size_t>(ftBitmap.width);
-
-    for (size_t symbolRow = 0; symbolRow < symbolRows; ++symbolRow) {
-        for (size_t symbolCol = 0; symbolCol < symbolCols; ++symbolCol) {
-            size_t bitmapRow = fromTopToSymbol + symbolRow;
-            size_t bitmapCol = leftBearing + symbolCol;
-
-            size_t vectorPos = bitmapRow*columns + bitmapCol;
-            // to not crash on symbols that are bigger then their box borders
-            if (vectorPos < vectorSize) {
-                size_t bufferPos = symbolRow*ftBitmap.width + symbolCol;
-                pixels->at(vectorPos) = MAX_GRAY_LEVELS
-                                        - ftBitmap.buffer[bufferPos];
+
+    long symbolRows = static_cast<long>(ftBitmap.rows);
+    long symbolCols = static_cast<long>(ftBitmap.width);
+
+    // rows of a bitmap with a negative pitch are stored from the bottom up,
+    // the buffer starts with the last of them
+    long rowBytes = ftBitmap.pitch < 0 ? -static_cast<long>(ftBitmap.pitch)
+                                       : ftBitmap.pitch;
+
+    for (long symbolRow = 0; symbolRow < symbolRows; ++symbolRow) {
+        long bufferRow = ftBitmap.pitch < 0 ? symbolRows - 1 - symbolRow : symbolRow;
+        for (long symbolCol = 0; symbolCol < symbolCols; ++symbolCol) {
+            long bitmapRow = fromTopToSymbol + symbolRow;
+            long bitmapCol = leftBearing + symbolCol;
+
+            // parts of symbols that stick out of their box, as block and box
+            // drawing symbols often do, are cut off
+            if (    bitmapRow < 0 || bitmapRow >= static_cast<long>(rows)
+                ||  bitmapCol < 0 || bitmapCol >= static_cast<long>(columns)) {
+                continue;
             }
+
+            long bufferPos = bufferRow * rowBytes + symbolCol;
+            pixels->at(bitmapRow * columns + bitmapCol) = MAX_GRAY_LEVELS
+                                                - ftBitmap.buffer[bufferPos];
         }
     }
 }
@@ -40,41 +55,229 @@ GrayscaleBitmap::GrayscaleBitmap(const FT_Face fontFace)
 
 static inline uint_fast8_t rgbPixelToGrayscale( uint32_t rgbPixel,
                                                 const SDL_PixelFormat* fmt) {
-    uint_fast8_t r = COLOR_BYTE(R, rgbPixel, fmt);
-    uint_fast8_t g = COLOR_BYTE(G, rgbPixel, fmt);
-    uint_fast8_t b = COLOR_BYTE(B, rgbPixel, fmt);
+    return rgbToGrayscale(  COLOR_BYTE(R, rgbPixel, fmt),
+                            COLOR_BYTE(G, rgbPixel, fmt),
+                            COLOR_BYTE(B, rgbPixel, fmt));
+}
+
+// gray levels are written row by row with the given stride, every gray level
+// is written after the pixel data under it is read, so grays may point to
+// the surface pixels themselves; colors of a row are taken before its gray
+// levels are written
+static void convertRgb888Surface(   const SDL_Surface* surface,
+                                    obj_brightness* grays, size_t graysStride,
+                                    FrameColors* colors) {
+    const uint8_t* row = static_cast<const uint8_t*>(surface->pixels);
+
+    for (int rowNum = 0; rowNum < surface->h; ++rowNum) {
+        if (colors) {
+            colors->addRgb888Row(reinterpret_cast<const uint32_t*>(row));
+        }
+        rgb888RowToGrayscale(reinterpret_cast<const uint32_t*>(row),
+                            surface->w, grays);
+        row   += surface->pitch;
+        grays += graysStride;
+    }
+}
+
+static void convertAnySurface(  const SDL_Surface* surface,
+                                obj_brightness* grays, size_t graysStride,
+                                FrameColors* colors) {
+    const uint8_t* row = static_cast<const uint8_t*>(surface->pixels);
+    const uint_fast8_t bytesPerPixel = surface->format->BytesPerPixel;
+    const SDL_PixelFormat* fmt = surface->format;
+    std::vector<uint8_t> rgbRow(colors ? surface->w * 3 : 0);
+
+    for (int rowNum = 0; rowNum < surface->h; ++rowNum) {
+        const uint8_t* pixelData = row;
+        for (int col = 0; col < surface->w; ++col) {
+            // pixels narrower than 4 bytes are not read past their end
+            uint32_t rgbPixel = 0;
+            memcpy(&rgbPixel, pixelData, bytesPerPixel);
+
+            if (colors) {
+                rgbRow[col * 3]     = COLOR_BYTE(R, rgbPixel, fmt);
+                rgbRow[col * 3 + 1] = COLOR_BYTE(G, rgbPixel, fmt);
+                rgbRow[col * 3 + 2] = COLOR_BYTE(B, rgbPixel, fmt);
+            }
 
-    uint_fast8_t grayLevel =      0.212671f * r
-                                + 0.715160f * g
-                                + 0.072169f * b;
+            grays[col] = rgbPixelToGrayscale(rgbPixel, fmt);
+            pixelData += bytesPerPixel;
+        }
 
-    return grayLevel;
+        if (colors) {
+            colors->addRgbRow(rgbRow.data());
+        }
+
+        row   += surface->pitch;
+        grays += graysStride;
+    }
+}
+
+static void paletteGrayLevels(const SDL_Palette* palette, obj_brightness* levels) {
+    for (int color = 0; color <= MAX_GRAY_LEVELS; ++color) {
+        levels[color] = 0;
+        if (color < palette->ncolors) {
+            const SDL_Color& rgb = palette->colors[color];
+            levels[color] = rgbToGrayscale(rgb.r, rgb.g, rgb.b);
+        }
+    }
+}
+
+static void convertPalettedSurface( const SDL_Surface* surface,
+                                    obj_brightness* grays, size_t graysStride,
+                                    FrameColors* colors) {
+    const SDL_Palette* palette = surface->format->palette;
+    obj_brightness levels[MAX_GRAY_LEVELS + 1];
+    paletteGrayLevels(palette, levels);
+    std::vector<uint8_t> rgbRow(colors ? surface->w * 3 : 0);
+
+    const uint8_t* row = static_cast<const uint8_t*>(surface->pixels);
+    for (int rowNum = 0; rowNum < surface->h; ++rowNum) {
+        for (int col = 0; col < surface->w; ++col) {
+            if (colors) {
+                const SDL_Color black = { 0, 0, 0, 0 };
+                const SDL_Color& rgb = row[col] < palette->ncolors
+                                        ? palette->colors[row[col]] : black;
+                rgbRow[col * 3]     = rgb.r;
+                rgbRow[col * 3 + 1] = rgb.g;
+                rgbRow[col * 3 + 2] = rgb.b;
+            }
+
+            grays[col] = levels[row[col]];
+        }
+
+        if (colors) {
+            colors->addRgbRow(rgbRow.data());
+        }
+
+        row   += surface->pitch;
+        grays += graysStride;
+    }
+}
+
+// color indices of such surfaces are their gray levels already
+static bool hasGrayPalette(const SDL_Surface* surface) {
+    const SDL_Palette* palette = surface->format->palette;
+    if (palette == NULL || surface->format->BytesPerPixel != 1) {
+        return false;
+    }
+
+    obj_brightness levels[MAX_GRAY_LEVELS + 1];
+    paletteGrayLevels(palette, levels);
+    for (int color = 0; color < std::min(palette->ncolors, MAX_GRAY_LEVELS + 1); ++color) {
+        if (levels[color] != color) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// 32-bit formats with the color bytes where RGB888 has them, alpha or padding
+// byte is ignored by the vectorized kernels
+static bool hasRgb888Layout(const SDL_PixelFormat* format) {
+    return      format->BytesPerPixel == sizeof(uint32_t)
+            &&  format->Rmask == 0x00FF0000
+            &&  format->Gmask == 0x0000FF00
+            &&  format->Bmask == 0x000000FF;
+}
+
+static void convertSurface( const SDL_Surface* surface,
+                            obj_brightness* grays, size_t graysStride,
+                            FrameColors* colors = NULL) {
+    if (surface->format->BytesPerPixel > sizeof(uint32_t)) {
+        throw std::runtime_error("Unsupported image pixel format");
+    }
+
+    if (colors) {
+        colors->startImage(surface->w, surface->h);
+    }
+
+    if (surface->format->palette != NULL && surface->format->BytesPerPixel == 1) {
+        convertPalettedSurface(surface, grays, graysStride, colors);
+    } else if (hasRgb888Layout(surface->format)) {
+        convertRgb888Surface(surface, grays, graysStride, colors);
+    } else {
+        convertAnySurface(surface, grays, graysStride, colors);
+    }
 }
 
 GrayscaleBitmap::GrayscaleBitmap(SDL_Surface* surface)
     : rows(surface->h)
     , columns(surface->w)
+    , stride(surface->w)
     , pixels(new pixels_vector(surface->h * surface->w, 0))
-    , num_grays(MAX_GRAY_LEVELS) {
+    , num_grays(MAX_GRAY_LEVELS)
+    , data(pixels->data()) {
 
-    const uint_fast8_t bytesPerPixel = surface->format->BytesPerPixel;
-    for (size_t row = 0; row < rows; ++row) {
-        for (size_t col = 0; col < columns; ++col) {
-            size_t pixelNum = row * columns + col;
-            uint8_t* pixelDataStart = reinterpret_cast<uint8_t*>(surface->pixels)
-                                        + pixelNum * bytesPerPixel;
-            uint32_t rgbPixel = *reinterpret_cast<uint32_t*>(pixelDataStart);
+    convertSurface(surface, pixels->data(), stride);
+}
 
-            pixels->at(pixelNum) = rgbPixelToGrayscale(rgbPixel, surface->format);
+GrayscaleBitmap::GrayscaleBitmap(shared_surface_ptr _surface, FrameColors* colors)
+    : rows(_surface->h)
+    , columns(_surface->w)
+    , stride(_surface->pitch)
+    , pixels()
+    , num_grays(MAX_GRAY_LEVELS)
+    , data(static_cast<const obj_brightness*>(_surface->pixels))
+    , owner(_surface) {
+
+    if (!hasGrayPalette(_surface.get())) {
+        convertSurface(_surface.get(), static_cast<obj_brightness*>(_surface->pixels),
+                        stride, colors);
+    } else if (colors) {
+        colors->startImage(columns, rows);
+        for (size_t row = 0; row < rows; ++row) {
+            colors->addGrayRow(rowPixels(row));
         }
     }
 }
 
+GrayscaleBitmap::GrayscaleBitmap(size_t _rows, size_t _columns)
+    : rows(_rows)
+    , columns(_columns)
+    , stride(_columns)
+    , pixels(new pixels_vector(_rows * _columns, 0))
+    , num_grays(MAX_GRAY_LEVELS)
+    , data(pixels->data()) {}
+
+GrayscaleBitmap::GrayscaleBitmap(   const obj_brightness* _data,
+                                    size_t _rows, size_t _columns, size_t _stride,
+                                    shared_owner_ptr _owner)
+    : rows(_rows)
+    , columns(_columns)
+    , stride(_stride)
+    , pixels()
+    , num_grays(MAX_GRAY_LEVELS)
+    , data(_data)
+    , owner(_owner) {}
+
 GrayscaleBitmap::GrayscaleBitmap(const GrayscaleBitmap& toCopy)
     : rows(toCopy.rows)
     , columns(toCopy.columns)
-    , pixels(new pixels_vector(*toCopy.pixels))
-    , num_grays(toCopy.num_grays) {}
+    , stride(toCopy.columns)
+    , pixels(new pixels_vector(toCopy.rows * toCopy.columns))
+    , num_grays(toCopy.num_grays)
+    , data(pixels->data()) {
+
+    for (size_t row = 0; row < rows; ++row) {
+        std::copy(  toCopy.rowPixels(row), toCopy.rowPixels(row) + columns,
+                    pixels->begin() + row * columns);
+    }
+}
+
+GrayscaleBitmap::GrayscaleBitmap(GrayscaleBitmap&& toMove)
+    : rows(toMove.rows)
+    , columns(toMove.columns)
+    , stride(toMove.stride)
+    , pixels(std::move(toMove.pixels))
+    , num_grays(toMove.num_grays)
+    , data(toMove.data)
+    , owner(std::move(toMove.owner)) {
+
+    toMove.data = NULL;
+}
 
 GrayscaleBitmap::~GrayscaleBitmap() {}
 
@@ -83,10 +286,37 @@ FramedBitmap::FramedBitmap(SDL_Surface* surface)
     : GrayscaleBitmap(surface)
     , frameWidth(1)
     , frameHeight(1) {}
+FramedBitmap::FramedBitmap(shared_surface_ptr surface, FrameColors* colors)
+    : GrayscaleBitmap(surface, colors)
+    , frameWidth(1)
+    , frameHeight(1) {}
+FramedBitmap::FramedBitmap(size_t rows, size_t columns)
+    : GrayscaleBitmap(rows, columns)
+    , frameWidth(1)
+    , frameHeight(1) {}
+FramedBitmap::FramedBitmap( const obj_brightness* data,
+                            size_t rows, size_t columns, size_t stride,
+                            shared_owner_ptr owner)
+    : GrayscaleBitmap(data, rows, columns, stride, owner)
+    , frameWidth(1)
+    , frameHeight(1) {}
 FramedBitmap::FramedBitmap(const FramedBitmap& toCopy)
     : GrayscaleBitmap(toCopy)
     , frameWidth(toCopy.frameWidth)
-    , frameHeight(toCopy.frameHeight) {}
+    , frameHeight(toCopy.frameHeight)
+    , integral(toCopy.integral) {}
+FramedBitmap::FramedBitmap(FramedBitmap&& toMove)
+    : GrayscaleBitmap(std::move(toMove))
+    , frameWidth(toMove.frameWidth)
+    , frameHeight(toMove.frameHeight)
+    , integral(std::move(toMove.integral)) {}
+
+FramedBitmap FramedBitmap::view() const {
+    FramedBitmap viewed(rowPixels(0), rows, columns, stride, owner);
+    viewed.setFrameSize(frameWidth, frameHeight);
+    viewed.integral = integral;
+    return viewed;
+}
 
 FrameSlider FramedBitmap::firstFrame() const {
     return FrameSlider(*this);
@@ -108,6 +338,61 @@ size_t FramedBitmap::countFrames() const {
     return (columns / frameWidth) * (rows / frameHeight);
 }
 
+void FramedBitmap::buildIntegralImage() {
+    const size_t integralColumns = columns + 1;
+    std::shared_ptr<integral_vector> table(
+                            new integral_vector((rows + 1) * integralColumns, 0));
+
+    for (size_t row = 0; row < rows; ++row) {
+        const obj_brightness* pixelRow = rowPixels(row);
+        const uint32_t* rowAbove = table->data() + row * integralColumns;
+        uint32_t* integralRow    = table->data() + (row + 1) * integralColumns;
+
+        uint32_t rowSum = 0;
+        for (size_t col = 0; col < columns; ++col) {
+            rowSum += pixelRow[col];
+            integralRow[col + 1] = rowAbove[col + 1] + rowSum;
+        }
+    }
+
+    integral = table;
+}
+
+bool FramedBitmap::hasIntegralImage() const {
+    return integral != nullptr;
+}
+
+uint32_t FramedBitmap::areaBrightnessSum(size_t leftCol, size_t topRow,
+                                        size_t width,   size_t height) const {
+    const size_t integralColumns = columns + 1;
+    const size_t top    = topRow * integralColumns;
+    const size_t bottom = (topRow + height) * integralColumns;
+    const uint32_t* table = integral->data();
+
+    return    table[bottom + leftCol + width] - table[bottom + leftCol]
+            - table[top    + leftCol + width] + table[top    + leftCol];
+}
+
+void FramedBitmap::stripBrightnessSums( size_t strip, size_t firstFrame,
+                                        size_t framesCount, uint32_t* sums) const {
+    size_t topRow  = strip * frameHeight;
+    size_t leftCol = firstFrame * frameWidth;
+
+    if (hasIntegralImage()) {
+        for (size_t frame = 0; frame < framesCount; ++frame) {
+            sums[frame] = areaBrightnessSum(leftCol + frame * frameWidth, topRow,
+                                            frameWidth, frameHeight);
+        }
+    } else {
+        sumStripFrames( rowPixels(topRow) + leftCol, stride,
+                        frameWidth, frameHeight, framesCount, sums);
+    }
+}
+
+size_t FramedBitmap::framesInStrip() const {
+    return columns / frameWidth;
+}
+
 FrameSlider::FrameSlider(const FramedBitmap& _map,
                         size_t _leftBorderCol, size_t _topBorderRow)
     : map(&_map)
@@ -148,13 +433,23 @@ obj_brightness FrameSlider::at(size_t pos) const {
     size_t mapRow    = topBorderRow  + pos / map->frameWidth;
     size_t mapColumn = leftBorderCol + pos % map->frameWidth;
 
-    return map->pixels->at(mapRow * map->columns + mapColumn);
+    return map->rowPixels(mapRow)[mapColumn];
 }
 
 size_t FrameSlider::size() const {
     return map->frameWidth * map->frameHeight;
 }
 
+uint64_t FrameSlider::brightnessSum() const {
+    if (map->hasIntegralImage()) {
+        return map->areaBrightnessSum(  leftBorderCol,   topBorderRow,
+                                        map->frameWidth, map->frameHeight);
+    }
+
+    return sumAreaPixels(   map->rowPixels(topBorderRow) + leftBorderCol,
+                            map->stride, map->frameWidth, map->frameHeight);
+}
+
 bool FrameSlider::operator==(const FrameSlider& toCompare) const {
     return     map == toCompare.map
             && map->frameWidth == toCompare.map->frameWidth
@@ -1,51 +1,168 @@
-#include <iostream>
+#include <algorithm>
 #include <exception>
 
 #include "image_processor.h"
-#include "freetype_interface.h"
 
-ImageToTextResult::ImageToTextResult(size_t framesQuantity)
-    : done(false) {
+ImageToTextResult::ImageToTextResult(size_t framesQuantity) {
     frameMatches.reserve(framesQuantity);
 }
 
-ImageToTextResult::ImageToTextResult(const ImageToTextResult& toCopy)
-    : frameMatches(toCopy.frameMatches)
-    , done(toCopy.done.load()) {
-}
+void processImagePart(  const FramedBitmap& map,
+                        size_t firstFrame, size_t framesCount,
+                        const FrameMatcher& matcher,
+                        ImageToTextResult& result) {
+    const size_t framesInStrip  = map.framesInStrip();
+    const size_t lastFrame      = firstFrame + framesCount - 1;
+
+    // frames are matched strip by strip, so that the pixel data of the whole
+    // strip part is reduced in a single pass over its rows
+    for (size_t frame = firstFrame; frame <= lastFrame; ) {
+        size_t strip        = frame / framesInStrip;
+        size_t firstInStrip = frame % framesInStrip;
+        size_t stripFrames  = std::min(framesInStrip - firstInStrip,
+                                       lastFrame - frame + 1);
 
-static obj_brightness averageFrameBrightness(const FrameSlider& imgPart) {
-    uint64_t acc = 0;
-    size_t frameSize = imgPart.size();
-    for (size_t pixelNum = 0; pixelNum < frameSize; ++pixelNum) {
-        acc += imgPart.at(pixelNum);
+        size_t matchesBefore = result.frameMatches.size();
+        result.frameMatches.resize(matchesBefore + stripFrames);
+        matcher.matchStrip( map, strip, firstInStrip, stripFrames,
+                            result.frameMatches.data() + matchesBefore);
+
+        frame += stripFrames;
     }
+}
 
-    return acc / frameSize;
+void processImageBands( const FramedBitmap& map,
+                        const std::vector<RowBand>& bands,
+                        BandScheduler& scheduler, size_t worker,
+                        const FrameMatcher& matcher,
+                        std::vector<ImageToTextResult>& results,
+                        StatsCollector* stats) {
+    size_t bandNum;
+    while (scheduler.nextBand(worker, bandNum)) {
+        const RowBand& band = bands.at(bandNum);
+        ImageToTextResult& result = results.at(bandNum);
+
+        try {
+            uint64_t start = stats ? StatsCollector::now() : 0;
+            processImagePart(map, band.firstFrame, band.framesCount, matcher,
+                            result);
+            if (stats) {
+                stats->addWorkerBand(worker, band.framesCount,
+                                    StatsCollector::now() - start);
+            }
+            result.done.set_value();
+        }
+        catch (...) {
+            result.done.set_exception(std::current_exception());
+        }
+    }
 }
 
-static char matchFrameToSymbol(const FrameSlider& imgPart) {
-    obj_brightness frameBrightness = averageFrameBrightness(imgPart);
+FrameMatching::FrameMatching(   const FramedBitmap& _map, const FrameMatcher& _matcher,
+                                const ErrorDiffusion* _diffusion, size_t _workersNum,
+                                StatsCollector* _stats)
+    : map(_map)
+    , matcher(_matcher)
+    , diffusion(_diffusion)
+    , workersNum(std::max<size_t>(_workersNum, 1))
+    , stats(_stats) {
+
+    if (diffusion) {
+        wavefront.reset(new DiffusionWavefront(map));
+        return;
+    }
+
+    {
+        ScopedStageTimer timer(stats, PARTITIONING_STAGE);
+        bands = splitIntoRowBands(  map.framesInStrip(), map.rows / map.frameHeight,
+                                    workersNum);
+    }
+    scheduler.reset(new BandScheduler(bands.size(), workersNum));
 
-    return symbolWithBrightnessClosestTo(frameBrightness);
+    bandResults.reserve(bands.size());
+    bandDone.reserve(bands.size());
+    for (const RowBand& band : bands) {
+        bandResults.emplace_back(band.framesCount);
+        bandDone.push_back(bandResults.back().done.get_future());
+    }
 }
 
-void processImagePart(  FrameSlider& start, const FrameSlider& end,
-                        ImageToTextResult& result) {
+FrameMatching::~FrameMatching() {
+    wait();
+}
+
+void FrameMatching::start(ThreadPool* pool) {
+    if (pool) {
+        for (size_t worker = 0; worker < workersNum; ++worker) {
+            workersDone.push_back(pool->submit([this, worker]() {
+                matchAsWorker(worker);
+            }));
+        }
+        return;
+    }
+
+    // the only worker claims the ranges of all the others
+    std::promise<void> done;
+    workersDone.push_back(done.get_future());
     try {
-        for (FrameSlider frame = start; frame != end; frame.slide()) {
-            char match = matchFrameToSymbol(frame);
-            result.frameMatches.push_back(match);
+        matchAsWorker(0);
+        done.set_value();
+    }
+    catch (...) {
+        done.set_exception(std::current_exception());
+    }
+}
+
+void FrameMatching::wait() {
+    for (std::future<void>& done : workersDone) {
+        done.wait();
+    }
+}
+
+size_t FrameMatching::partsCount() const {
+    return wavefront ? 1 : bands.size();
+}
+
+std::vector<code_point> FrameMatching::takePart(size_t part) {
+    std::vector<code_point> matches;
+
+    // the dithered frames are done when every worker is
+    if (wavefront) {
+        wait();
+        for (std::future<void>& done : workersDone) {
+            done.get();
         }
+        workersDone.clear();
 
-        char match = matchFrameToSymbol(end);
-        result.frameMatches.push_back(match);
-        result.done = true;
+        matches.swap(wavefront->frameMatches);
+        return matches;
     }
-    catch (std::exception& err) {
-        std::cerr << err.what() << std::endl;
+
+    // rethrows the error if processing of the band has failed
+    bandDone.at(part).get();
+    matches.swap(bandResults.at(part).frameMatches);
+    return matches;
+}
+
+std::vector<code_point> FrameMatching::takeAll() {
+    std::vector<code_point> matches;
+    for (size_t part = 0; part < partsCount(); ++part) {
+        std::vector<code_point> partMatches = takePart(part);
+        if (matches.empty()) {
+            matches.swap(partMatches);
+            matches.reserve(map.countFrames());
+        } else {
+            matches.insert(matches.end(), partMatches.begin(), partMatches.end());
+        }
     }
-    catch (...) {
-        std::cerr << "Unknown exception caught" << std::endl;
+
+    return matches;
+}
+
+void FrameMatching::matchAsWorker(size_t worker) {
+    if (diffusion) {
+        diffusion->matchStrips(map, *wavefront, worker, stats);
+    } else {
+        processImageBands(map, bands, *scheduler, worker, matcher, bandResults, stats);
     }
 }
@@ -1,85 +1,130 @@
 #include <iostream>
-#include <fstream>
 #include <cstdlib>
 #include <algorithm>
 #include <exception>
-#include <thread>
+#include <future>
+#include <memory>
 
 #include "settings.h"
 #include "grayscale_bitmap.h"
 #include "freetype_interface.h"
 #include "sdl_interface.h"
 #include "image_processor.h"
+#include "thread_pool.h"
+#include "batch_converter.h"
+#include "output_writer.h"
+#include "frame_cache.h"
+#include "stream_converter.h"
+#include "conversion_server.h"
+#include "sequence_converter.h"
+#include "conversion_stats.h"
+#include "error_diffusion.h"
+#include "multi_size_converter.h"
+
+// parts are written in order as soon as each of them is matched, while the
+// parts below are still being matched; the time spent writing them is
+// counted as one pass through the output stage
+static void writeMatchesToFile( const Settings& settings, FrameMatching& matching,
+                                size_t symbolsInLine, const FrameColors* colors,
+                                StatsCollector* stats, uint64_t matchingStart) {
+    TextWriter outfile(settings.outfile);
+    std::unique_ptr<ColorTextWriter> colored;
+    if (colors) {
+        colored.reset(new ColorTextWriter(outfile, settings.color, settings.invert));
+    }
 
-static void writeThreadsOutputToFile(const std::string& outfilePath,
-                                    const std::vector<ImageToTextResult>& thResults,
-                                    size_t symbolsInLine) {
-    std::ofstream outfile(outfilePath);
-
-    size_t symbolsInFile = 0;
-    for (const ImageToTextResult& oneThResult : thResults) {
-        while (!oneThResult.done.load());
-
-        for (char frameMatch : oneThResult.frameMatches) {
-            outfile << frameMatch;
+    uint64_t outputTime = 0;
+    size_t framesWritten = 0;
+    for (size_t part = 0; part < matching.partsCount(); ++part) {
+        std::vector<code_point> matches = matching.takePart(part);
 
-            if (++symbolsInFile % symbolsInLine == 0) {
-                outfile << '\n';
-            }
+        uint64_t outputStart = stats ? StatsCollector::now() : 0;
+        if (stats && part + 1 == matching.partsCount()) {
+            stats->addStageTime(MATCHING_STAGE, outputStart - matchingStart);
         }
-    }
-}
 
-typedef std::pair<FrameSlider, FrameSlider> img_data_range;
-static void assignThreadTasks(  const FramedBitmap& map,
-                                std::vector<img_data_range>& tasks,
-                                uint_fast8_t threadsNum) {
-    size_t framesTotal = map.countFrames();
-    size_t framesPerThread = framesTotal % threadsNum == 0
-                            ? framesTotal / threadsNum
-                            : framesTotal / threadsNum + 1;
-
-    FrameSlider slider  = map.firstFrame();
-    FrameSlider imgEnd  = map.lastFrame();
-    for (uint_fast8_t threadNum = 0; threadNum < threadsNum; ++threadNum) {
-        FrameSlider taskStart = slider;
-        for (size_t frame = 0; frame < framesPerThread; ++frame) {
-            if (slider == imgEnd) {
-                break;
-            }
-
-            slider.slide();
+        if (colored) {
+            colored->writeLines(matches.data(), colors->colors().data() + framesWritten,
+                                matches.size(), symbolsInLine);
+        } else {
+            outfile.writeLines(matches.data(), matches.size(), symbolsInLine);
         }
+        framesWritten += matches.size();
 
-        tasks.emplace_back(taskStart, slider);
-
-        if (slider != imgEnd) {
-            slider.slide();
+        if (stats) {
+            outputTime += StatsCollector::now() - outputStart;
         }
     }
+
+    uint64_t outputStart = stats ? StatsCollector::now() : 0;
+    if (colored) {
+        colored->finish();
+    }
+    outfile.flush();
+    if (stats) {
+        stats->addStageTime(OUTPUT_STAGE,
+                            outputTime + StatsCollector::now() - outputStart);
+        stats->addBytesWritten(outfile.bytesWritten());
+    }
 }
 
-uint_fast8_t const THREADS_TOTAL = 4;
 void imageToText(const Settings& settings) {
-    setupFont(settings.fontPath, settings.fontSize, settings.invert);
-    FramedBitmap map = loadGrayscaleImage(settings.imagePath);
+    size_t workersNum = settings.threads > 0 ? settings.threads
+                                             : ThreadPool::defaultSize();
+    std::unique_ptr<StatsCollector> stats;
+    if (settings.printStats) {
+        stats.reset(new StatsCollector(workersNum));
+    }
+
+    {
+        ScopedStageTimer timer(stats.get(), FONT_SETUP_STAGE);
+        setupFont(settings.fontPath, settings.fontSize, settings.invert,
+                    settings.vocabularyCacheDir, settings.charset);
+    }
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(settings.matching,
+                                                               settings.shapeGrid);
+    std::unique_ptr<CachingMatcher> cachingMatcher = createFrameCache(
+                                        *matcher, settings.frameCacheEntries);
+    const FrameMatcher& frameMatcher = cachingMatcher ? *cachingMatcher : *matcher;
+
+    // colors of the frames are summed up while the image is turned to gray
+    std::unique_ptr<FrameColors> colors;
+    if (settings.color != NO_COLOR) {
+        colors.reset(new FrameColors(getFontWidth(), getFontHeight()));
+    }
+
+    FramedBitmap map = loadGrayscaleImage(settings.imagePath, stats.get(),
+                                          colors.get());
     map.setFrameSize(getFontWidth(), getFontHeight());
 
-    ImageToTextResult resDummy(map.countFrames());
-    std::vector<ImageToTextResult> threadResults(THREADS_TOTAL, resDummy);
-    std::vector<img_data_range> threadTasks;
+    if (settings.engine == INTEGRAL_IMAGE_ENGINE) {
+        ScopedStageTimer timer(stats.get(), INTEGRAL_IMAGE_STAGE);
+        map.buildIntegralImage();
+    }
+
+    std::unique_ptr<ErrorDiffusion> diffusion;
+    if (settings.dithering != NO_DITHERING) {
+        diffusion.reset(new ErrorDiffusion(getGlyphVocabulary(), settings.dithering));
+    }
 
-    assignThreadTasks(map, threadTasks, THREADS_TOTAL);
+    // strips of dithered frames are matched by all the workers at once, each
+    // behind the one above it; the matching waits for its workers when it
+    // goes out of scope, even if writing the output fails
+    ThreadPool pool(workersNum);
+    FrameMatching matching(map, frameMatcher, diffusion.get(), workersNum, stats.get());
+    uint64_t matchingStart = stats ? StatsCollector::now() : 0;
+    matching.start(&pool);
 
-    for (uint_fast8_t threadNum = 0; threadNum < THREADS_TOTAL; ++threadNum) {
-        std::thread(processImagePart,
-                    std::ref(threadTasks.at(threadNum).first),
-                    std::ref(threadTasks.at(threadNum).second),
-                    std::ref(threadResults.at(threadNum))).detach();
+    writeMatchesToFile( settings, matching, map.framesInStrip(), colors.get(),
+                        stats.get(), matchingStart);
+
+    if (cachingMatcher) {
+        printFrameCacheStats(cachingMatcher->stats(), std::cout);
     }
 
-    size_t framesInRow = map.columns / map.frameWidth;
-    writeThreadsOutputToFile(settings.outfile, threadResults, framesInRow);
+    if (stats) {
+        saveConversionStats(stats->stats(), settings.statsPath);
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -91,7 +136,26 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        imageToText(settings);
+        if (!settings.serveSocket.empty()) {
+            return serveConversions(settings);
+        }
+
+        if (!settings.sequenceSource.empty()) {
+            sequenceToText(settings);
+            return 0;
+        }
+
+        if (!settings.batchSource.empty()) {
+            return batchToText(settings) == 0 ? 0 : 1;
+        }
+
+        if (!settings.fontSizes.empty()) {
+            multiSizeImageToText(settings);
+        } else if (settings.stream) {
+            streamImageToText(settings);
+        } else {
+            imageToText(settings);
+        }
 
         return 0;
     }
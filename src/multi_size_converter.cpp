@@ -0,0 +1,186 @@
+#include <iostream>
+#include <future>
+#include <memory>
+
+#include "multi_size_converter.h"
+#include "sdl_interface.h"
+#include "image_processor.h"
+#include "error_diffusion.h"
+#include "output_writer.h"
+
+/**
+ * @brief Matching state of one font size
+ */
+struct SizeMatching {
+    explicit SizeMatching(FramedBitmap&& _map)
+        : map(std::move(_map)) {}
+
+    FramedBitmap                        map;    /**< view with the frame size
+                                                    of the font */
+    std::unique_ptr<FrameMatcher>       matcher;
+    std::unique_ptr<CachingMatcher>     cachingMatcher;
+    std::unique_ptr<ErrorDiffusion>     diffusion;  /**< null if the frames
+                                                        are not dithered */
+    std::unique_ptr<FrameMatching>      matching;   /**< declared last, waits
+                                                        for the workers before
+                                                        the rest goes away */
+};
+
+static std::unique_ptr<SizeMatching> prepareSize(   const FramedBitmap& map,
+                                                    const GlyphVocabulary& vocab,
+                                                    const Settings& settings,
+                                                    size_t workersNum,
+                                                    StatsCollector* stats) {
+    std::unique_ptr<SizeMatching> size(new SizeMatching(map.view()));
+    size->map.setFrameSize(vocab.fontWidth, vocab.fontHeight);
+
+    size->matcher = createFrameMatcher(vocab, settings.matching, settings.shapeGrid);
+    if (settings.frameCacheEntries > 0) {
+        size->cachingMatcher.reset(new CachingMatcher(  *size->matcher,
+                                                        vocab.fontWidth,
+                                                        vocab.fontHeight,
+                                                        settings.frameCacheEntries));
+    }
+    if (settings.dithering != NO_DITHERING) {
+        size->diffusion.reset(new ErrorDiffusion(vocab, settings.dithering));
+    }
+
+    const FrameMatcher& frameMatcher = size->cachingMatcher ? *size->cachingMatcher
+                                                            : *size->matcher;
+    size->matching.reset(new FrameMatching( size->map, frameMatcher,
+                                            size->diffusion.get(), workersNum,
+                                            stats));
+    return size;
+}
+
+std::vector<SizeMatches> matchImageSizes(   const FramedBitmap& map,
+                                            const std::vector<GlyphVocabulary>& vocabs,
+                                            const Settings& settings,
+                                            ThreadPool& pool,
+                                            StatsCollector* stats) {
+    std::vector< std::unique_ptr<SizeMatching> > sizes;
+    for (const GlyphVocabulary& vocab : vocabs) {
+        sizes.push_back(prepareSize(map, vocab, settings, pool.size(), stats));
+    }
+
+    // tasks of a size end only when all its bands are claimed, so the tasks
+    // of the next size take over the workers one by one
+    for (std::unique_ptr<SizeMatching>& size : sizes) {
+        size->matching->start(&pool);
+    }
+
+    // every size waits for its workers when it goes away, even if the symbols
+    // of a size above have failed
+    std::vector<SizeMatches> matches;
+    for (std::unique_ptr<SizeMatching>& size : sizes) {
+        SizeMatches sizeMatches;
+        sizeMatches.framesInStrip   = size->map.framesInStrip();
+        sizeMatches.frameMatches    = size->matching->takeAll();
+        sizeMatches.frameCache.hits   = 0;
+        sizeMatches.frameCache.misses = 0;
+        if (size->cachingMatcher) {
+            size->matching->wait();
+            sizeMatches.frameCache = size->cachingMatcher->stats();
+        }
+
+        matches.push_back(std::move(sizeMatches));
+    }
+
+    return matches;
+}
+
+std::string sizedOutfilePath(const std::string& outfile, uint_fast16_t fontSize) {
+    size_t nameStart = outfile.find_last_of('/');
+    nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+
+    size_t dotPos = outfile.find_last_of('.');
+    if (dotPos == std::string::npos || dotPos < nameStart) {
+        dotPos = outfile.size();
+    }
+
+    return  outfile.substr(0, dotPos) + '.' + std::to_string(fontSize)
+          + outfile.substr(dotPos);
+}
+
+void multiSizeImageToText(const Settings& settings) {
+    size_t workersNum = settings.threads > 0 ? settings.threads
+                                             : ThreadPool::defaultSize();
+    std::unique_ptr<StatsCollector> stats;
+    if (settings.printStats) {
+        stats.reset(new StatsCollector(workersNum));
+    }
+
+    ThreadPool pool(workersNum);
+
+    // vocabularies are built by the workers while the image is decoded
+    uint64_t fontSetupStart = stats ? StatsCollector::now() : 0;
+    std::vector< std::future<GlyphVocabulary> > vocabsReady;
+    for (uint_fast16_t fontSize : settings.fontSizes) {
+        vocabsReady.push_back(pool.submit([&settings, fontSize]() {
+            return loadGlyphVocabulary( settings.fontPath, fontSize, settings.invert,
+                                        settings.vocabularyCacheDir,
+                                        settings.charset);
+        }));
+    }
+
+    FramedBitmap map = loadGrayscaleImage(settings.imagePath, stats.get());
+
+    std::vector<GlyphVocabulary> vocabs;
+    for (std::future<GlyphVocabulary>& ready : vocabsReady) {
+        vocabs.push_back(ready.get());
+    }
+    if (stats) {
+        stats->addStageTime(FONT_SETUP_STAGE, StatsCollector::now() - fontSetupStart);
+    }
+
+    // the table does not depend on the frame size, one serves all the sizes
+    if (settings.engine == INTEGRAL_IMAGE_ENGINE) {
+        ScopedStageTimer timer(stats.get(), INTEGRAL_IMAGE_STAGE);
+        map.buildIntegralImage();
+    }
+
+    std::vector<SizeMatches> matches;
+    {
+        ScopedStageTimer timer(stats.get(), MATCHING_STAGE);
+        matches = matchImageSizes(map, vocabs, settings, pool, stats.get());
+    }
+
+    {
+        ScopedStageTimer timer(stats.get(), OUTPUT_STAGE);
+        std::vector< std::future<uint64_t> > outputsDone;
+        for (size_t size = 0; size < matches.size(); ++size) {
+            const SizeMatches& sizeMatches = matches[size];
+            const std::string outfilePath = sizedOutfilePath(settings.outfile,
+                                                        settings.fontSizes[size]);
+            outputsDone.push_back(pool.submit([&sizeMatches, outfilePath]() {
+                TextWriter outfile(outfilePath);
+                outfile.writeLines( sizeMatches.frameMatches.data(),
+                                    sizeMatches.frameMatches.size(),
+                                    sizeMatches.framesInStrip);
+                outfile.flush();
+                return outfile.bytesWritten();
+            }));
+        }
+
+        for (std::future<uint64_t>& done : outputsDone) {
+            done.wait();
+        }
+        for (std::future<uint64_t>& done : outputsDone) {
+            uint64_t bytes = done.get();
+            if (stats) {
+                stats->addBytesWritten(bytes);
+            }
+        }
+    }
+
+    if (settings.frameCacheEntries > 0 && settings.dithering == NO_DITHERING) {
+        for (size_t size = 0; size < matches.size(); ++size) {
+            std::cout << "Font size " << settings.fontSizes[size] << ": ";
+            printFrameCacheStats(matches[size].frameCache, std::cout);
+        }
+    }
+
+    if (stats) {
+        saveConversionStats(stats->stats(), settings.statsPath);
+    }
+}
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+}
+
+#include "netpbm_reader.h"
+#include "frame_kernels.h"
+#include "frame_colors.h"
+
+static const size_t READ_AHEAD_BYTES = 1 << 16;
+
+static const uint32_t MAX_SAMPLE_VALUE = 65535;
+
+bool isRawNetpbmFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    char signature[2] = { 0, 0 };
+    ssize_t bytesRead = read(fd, signature, sizeof(signature));
+    close(fd);
+
+    return      bytesRead == sizeof(signature)
+            &&  signature[0] == 'P'
+            &&  (signature[1] == '5' || signature[1] == '6');
+}
+
+// samples above the maximum value are treated as the maximum
+static inline obj_brightness scaleSample(uint32_t sample, uint32_t maxValue) {
+    sample = std::min(sample, maxValue);
+    return (sample * MAX_GRAY_LEVELS + maxValue / 2) / maxValue;
+}
+
+/**
+ * Image properties from the netpbm header
+ */
+struct NetpbmHeader {
+    size_t      rows;
+    size_t      columns;
+    size_t      channels;       /**< 1 for PGM, 3 for PPM */
+    uint32_t    maxValue;       /**< largest sample value */
+};
+
+// numbers are separated by whitespace and comments running to the line end;
+// nextByte returns a negative value at the end of the file
+template <typename NextByte>
+static size_t parseHeaderNumber(NextByte& nextByte, const std::string& path) {
+    int byte = nextByte();
+    while (byte == '#' || (byte >= 0 && isspace(byte))) {
+        if (byte == '#') {
+            while (byte >= 0 && byte != '\n') {
+                byte = nextByte();
+            }
+        }
+        byte = nextByte();
+    }
+
+    if (byte < '0' || byte > '9') {
+        throw std::runtime_error("Malformed header of image '" + path + "'");
+    }
+
+    size_t number = 0;
+    while (byte >= '0' && byte <= '9') {
+        number = number * 10 + (byte - '0');
+        if (number > SIZE_MAX / 10) {
+            throw std::runtime_error("Malformed header of image '" + path + "'");
+        }
+        byte = nextByte();
+    }
+
+    // the single whitespace after the last number is where the raster starts
+    if (byte < 0 || !isspace(byte)) {
+        throw std::runtime_error("Malformed header of image '" + path + "'");
+    }
+
+    return number;
+}
+
+template <typename NextByte>
+static NetpbmHeader parseHeader(NextByte nextByte, const std::string& path) {
+    int signature  = nextByte();
+    int formatCode = nextByte();
+    if (signature != 'P' || (formatCode != '5' && formatCode != '6')) {
+        throw std::runtime_error("Image '" + path + "' is not a binary PGM or PPM");
+    }
+
+    NetpbmHeader header;
+    header.channels  = formatCode == '5' ? 1 : 3;
+    header.columns   = parseHeaderNumber(nextByte, path);
+    header.rows      = parseHeaderNumber(nextByte, path);
+    size_t maxSample = parseHeaderNumber(nextByte, path);
+
+    if (    header.columns == 0 || header.rows == 0
+        ||  maxSample == 0 || maxSample > MAX_SAMPLE_VALUE) {
+        throw std::runtime_error("Unsupported size or depth of image '" + path + "'");
+    }
+
+    header.maxValue = maxSample;
+    return header;
+}
+
+NetpbmReader::NetpbmReader(const std::string& _path, FrameColors* _colors)
+    : path(_path)
+    , fd(open(_path.c_str(), O_RDONLY))
+    , buffer(READ_AHEAD_BYTES)
+    , bufferPos(0)
+    , bufferEnd(0)
+    , channels(1)
+    , maxValue(MAX_GRAY_LEVELS)
+    , sampleBytes(1)
+    , colors(_colors) {
+
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open image '" + path + "': "
+                                    + strerror(errno));
+    }
+
+    try {
+        readHeader();
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+
+    for (uint32_t sample = 0; sample <= MAX_GRAY_LEVELS; ++sample) {
+        levels[sample] = scaleSample(sample, maxValue);
+    }
+
+    rowBytes.resize(imageColumns * channels * sampleBytes);
+    if (colors) {
+        colors->startImage(imageColumns, imageRows);
+    }
+}
+
+NetpbmReader::~NetpbmReader() {
+    close(fd);
+}
+
+int NetpbmReader::nextHeaderByte() {
+    if (bufferPos == bufferEnd) {
+        ssize_t bytesRead;
+        do {
+            bytesRead = read(fd, buffer.data(), buffer.size());
+        } while (bytesRead < 0 && errno == EINTR);
+
+        if (bytesRead <= 0) {
+            return -1;
+        }
+
+        bufferPos = 0;
+        bufferEnd = bytesRead;
+    }
+
+    return buffer[bufferPos++];
+}
+
+void NetpbmReader::readHeader() {
+    NetpbmHeader header = parseHeader([this]() { return nextHeaderByte(); }, path);
+
+    imageRows    = header.rows;
+    imageColumns = header.columns;
+    channels     = header.channels;
+    maxValue     = header.maxValue;
+    sampleBytes  = maxValue > MAX_GRAY_LEVELS ? 2 : 1;
+}
+
+void NetpbmReader::readBytes(uint8_t* bytes, size_t count) {
+    size_t buffered = std::min(count, bufferEnd - bufferPos);
+    std::memcpy(bytes, buffer.data() + bufferPos, buffered);
+    bufferPos += buffered;
+    bytes     += buffered;
+    count     -= buffered;
+
+    while (count > 0) {
+        // large reads go straight to the caller's memory
+        uint8_t* destination = count >= buffer.size() ? bytes : buffer.data();
+        size_t   capacity    = count >= buffer.size() ? count : buffer.size();
+
+        ssize_t bytesRead = read(fd, destination, capacity);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0) {
+            throw std::runtime_error("Unable to read image '" + path + "': "
+                                        + strerror(errno));
+        }
+        if (bytesRead == 0) {
+            throw std::runtime_error("Image '" + path + "' is truncated");
+        }
+
+        if (destination == bytes) {
+            bytes += bytesRead;
+            count -= bytesRead;
+        } else {
+            bufferPos = 0;
+            bufferEnd = bytesRead;
+            readBytes(bytes, count);
+            return;
+        }
+    }
+}
+
+void NetpbmReader::rowToGrayscale(const uint8_t* row, obj_brightness* grays) {
+    const size_t samples = imageColumns * channels;
+
+    // samples are scaled to 8 bits in place, two-byte ones are big-endian
+    uint8_t* scaled = rowBytes.data();
+    if (sampleBytes == 2) {
+        for (size_t sample = 0; sample < samples; ++sample) {
+            scaled[sample] = scaleSample(   row[2 * sample] << 8 | row[2 * sample + 1],
+                                            maxValue);
+        }
+    } else if (maxValue != MAX_GRAY_LEVELS) {
+        for (size_t sample = 0; sample < samples; ++sample) {
+            scaled[sample] = levels[row[sample]];
+        }
+    }
+
+    if (channels == 1) {
+        std::memcpy(grays, scaled, imageColumns);
+    } else {
+        rgb24RowToGrayscale(scaled, imageColumns, grays);
+    }
+
+    if (colors && channels == 1) {
+        colors->addGrayRow(scaled);
+    } else if (colors) {
+        colors->addRgbRow(scaled);
+    }
+}
+
+void NetpbmReader::readRows(size_t count, obj_brightness* grays, size_t stride) {
+    const bool rawGrays = channels == 1 && sampleBytes == 1
+                            && maxValue == MAX_GRAY_LEVELS;
+
+    for (size_t row = 0; row < count; ++row) {
+        obj_brightness* rowGrays = grays + row * stride;
+
+        // 8-bit PGM rows are the gray levels already
+        if (rawGrays) {
+            readBytes(rowGrays, imageColumns);
+            if (colors) {
+                colors->addGrayRow(rowGrays);
+            }
+            continue;
+        }
+
+        readBytes(rowBytes.data(), rowBytes.size());
+        rowToGrayscale(rowBytes.data(), rowGrays);
+    }
+}
+
+// the file stays mapped for as long as any bitmap views it
+static shared_owner_ptr mapWholeFile(const std::string& path, size_t& fileSize) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open image '" + path + "': "
+                                    + strerror(errno));
+    }
+
+    struct stat fileStat;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        fileSize = fileStat.st_size;
+        mapping  = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    int mapError = errno;
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Unable to map image '" + path + "': "
+                                    + strerror(mapError));
+    }
+
+    // the whole raster is about to be read, so page reads are started early
+    madvise(mapping, fileSize, MADV_WILLNEED);
+
+    const size_t mappingSize = fileSize;
+    return shared_owner_ptr(mapping, [mappingSize](void* address) {
+        munmap(address, mappingSize);
+    });
+}
+
+FramedBitmap mapNetpbmImage(const std::string& path, FrameColors* colors) {
+    size_t fileSize = 0;
+    shared_owner_ptr mapping = mapWholeFile(path, fileSize);
+    const uint8_t* bytes = static_cast<const uint8_t*>(mapping.get());
+
+    size_t rasterPos = 0;
+    NetpbmHeader header = parseHeader([&]() -> int {
+        return rasterPos < fileSize ? bytes[rasterPos++] : -1;
+    }, path);
+
+    // every row takes at least a byte per pixel, this keeps the row size
+    // from overflowing
+    const size_t rasterBytes = fileSize - rasterPos;
+    const size_t sampleBytes = header.maxValue > MAX_GRAY_LEVELS ? 2 : 1;
+    if (header.columns > rasterBytes) {
+        throw std::runtime_error("Image '" + path + "' is truncated");
+    }
+    const size_t rowBytes = header.columns * header.channels * sampleBytes;
+    if (header.rows > rasterBytes / rowBytes) {
+        throw std::runtime_error("Image '" + path + "' is truncated");
+    }
+
+    const uint8_t* raster = bytes + rasterPos;
+
+    if (colors) {
+        colors->startImage(header.columns, header.rows);
+    }
+
+    // 8-bit PGM raster is the gray levels already
+    if (header.channels == 1 && header.maxValue == MAX_GRAY_LEVELS) {
+        for (size_t row = 0; colors && row < header.rows; ++row) {
+            colors->addGrayRow(raster + row * rowBytes);
+        }
+        return FramedBitmap(raster, header.rows, header.columns, header.columns,
+                            mapping);
+    }
+
+    FramedBitmap map(header.rows, header.columns);
+    obj_brightness* grays = map.pixels->data();
+
+    if (header.channels == 3 && header.maxValue == MAX_GRAY_LEVELS) {
+        for (size_t row = 0; row < header.rows; ++row) {
+            if (colors) {
+                colors->addRgbRow(raster + row * rowBytes);
+            }
+            rgb24RowToGrayscale(raster + row * rowBytes, header.columns,
+                                grays + row * header.columns);
+        }
+        return map;
+    }
+
+    // other sample depths are rare, they are scaled by the row reader
+    NetpbmReader reader(path, colors);
+    reader.readRows(header.rows, grays, header.columns);
+    return map;
+}
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+    #include <fcntl.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+}
+
+#include "output_writer.h"
+
+static void throwWriteError(const std::string& path) {
+    throw std::runtime_error("Unable to write output file '" + path + "': "
+                                + strerror(errno));
+}
+
+// writes all the given blocks, retrying on partial writes and interrupts
+static void writeAll(int fd, iovec* blocks, int blocksCount, const std::string& path) {
+    while (blocksCount > 0) {
+        ssize_t written = writev(fd, blocks, blocksCount);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throwWriteError(path);
+        }
+
+        size_t left = written;
+        while (blocksCount > 0 && left >= blocks->iov_len) {
+            left -= blocks->iov_len;
+            ++blocks;
+            --blocksCount;
+        }
+
+        if (blocksCount > 0) {
+            blocks->iov_base = static_cast<char*>(blocks->iov_base) + left;
+            blocks->iov_len -= left;
+        }
+    }
+}
+
+TextWriter::TextWriter(const std::string& _path, size_t bufferSize)
+    : path(_path)
+    , fd(open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644))
+    , buffer(bufferSize)
+    , bufferUsed(0)
+    , bytesTotal(0) {
+
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open output file '" + path + "': "
+                                    + strerror(errno));
+    }
+}
+
+TextWriter::~TextWriter() {
+    try {
+        flush();
+    }
+    catch (...) {
+    }
+
+    close(fd);
+}
+
+void TextWriter::writeLines(const code_point* symbols, size_t symbolsCount,
+                            size_t symbolsInLine) {
+    if (symbolsCount == 0) {
+        return;
+    }
+
+    // room is reserved for the longest encoding of every symbol
+    const size_t maxLineSize = symbolsInLine * MAX_UTF8_SYMBOL_BYTES + 1;
+
+    for (size_t lineStart = 0; lineStart < symbolsCount; lineStart += symbolsInLine) {
+        if (bufferUsed + maxLineSize > buffer.size()) {
+            flush();
+        }
+
+        if (maxLineSize > buffer.size()) {
+            writeLineDirectly(symbols + lineStart, symbolsInLine);
+            continue;
+        }
+
+        size_t lineSize = encodeUtf8(symbols + lineStart, symbolsInLine,
+                                     buffer.data() + bufferUsed);
+        buffer[bufferUsed + lineSize] = '\n';
+        bufferUsed += lineSize + 1;
+        bytesTotal += lineSize + 1;
+    }
+}
+
+void TextWriter::write(const char* bytes, size_t size) {
+    if (bufferUsed + size > buffer.size()) {
+        flush();
+    }
+
+    if (size > buffer.size()) {
+        iovec block = { const_cast<char*>(bytes), size };
+        writeAll(fd, &block, 1, path);
+    } else {
+        memcpy(buffer.data() + bufferUsed, bytes, size);
+        bufferUsed += size;
+    }
+
+    bytesTotal += size;
+}
+
+void TextWriter::flush() {
+    if (bufferUsed == 0) {
+        return;
+    }
+
+    iovec block = { buffer.data(), bufferUsed };
+    bufferUsed = 0;
+    writeAll(fd, &block, 1, path);
+}
+
+size_t TextWriter::bytesWritten() const {
+    return bytesTotal;
+}
+
+void TextWriter::writeLineDirectly(const code_point* symbols, size_t symbolsInLine) {
+    std::string line;
+    appendUtf8(symbols, symbolsInLine, line);
+    line += '\n';
+
+    iovec block = { &line[0], line.size() };
+    writeAll(fd, &block, 1, path);
+    bytesTotal += line.size();
+}
+
+// color of a symbol is kept as 0x00RRGGBB, or as the palette index for the
+// 256-color output, so that equal colors are found by one comparison
+static const uint32_t NO_CURRENT_COLOR = UINT32_MAX;
+
+// levels of the 6x6x6 color cube of the 256-color palette, starting at 16
+static const uint8_t CUBE_LEVELS[] = { 0, 95, 135, 175, 215, 255 };
+static const uint8_t CUBE_START    = 16;
+// gray ramp from 8 to 238 in steps of 10, starting at 232
+static const uint8_t RAMP_START    = 232;
+static const uint8_t RAMP_STEPS    = 24;
+
+static void appendDecimal(uint32_t number, std::string& text) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+
+    while (count > 0) {
+        text += digits[--count];
+    }
+}
+
+static void appendHexByte(uint8_t byte, std::string& text) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    text += HEX_DIGITS[byte >> 4];
+    text += HEX_DIGITS[byte & 0x0F];
+}
+
+static uint8_t nearestCubeLevel(uint8_t channel) {
+    size_t nearest = 0;
+    for (size_t level = 1; level < sizeof(CUBE_LEVELS); ++level) {
+        if (    std::abs(channel - CUBE_LEVELS[level])
+            <   std::abs(channel - CUBE_LEVELS[nearest])) {
+            nearest = level;
+        }
+    }
+
+    return nearest;
+}
+
+static int squaredDistance(const RgbColor& color, int red, int green, int blue) {
+    return      (color.red - red)     * (color.red - red)
+            +   (color.green - green) * (color.green - green)
+            +   (color.blue - blue)   * (color.blue - blue);
+}
+
+uint8_t ColorTextWriter::paletteIndex(const RgbColor& color) {
+    const uint8_t red   = nearestCubeLevel(color.red);
+    const uint8_t green = nearestCubeLevel(color.green);
+    const uint8_t blue  = nearestCubeLevel(color.blue);
+    const int cubeDistance = squaredDistance(color, CUBE_LEVELS[red],
+                                            CUBE_LEVELS[green], CUBE_LEVELS[blue]);
+
+    const int average = (color.red + color.green + color.blue) / 3;
+    const int step    = std::min<int>(std::max(average - 3, 0) / 10, RAMP_STEPS - 1);
+    const int gray    = 8 + step * 10;
+    const int rampDistance = squaredDistance(color, gray, gray, gray);
+
+    if (rampDistance < cubeDistance) {
+        return RAMP_START + step;
+    }
+
+    return CUBE_START + red * 36 + green * 6 + blue;
+}
+
+ColorTextWriter::ColorTextWriter(TextWriter& _out, ColorMode _mode, bool darkBackground)
+    : out(_out)
+    , mode(_mode) {
+
+    if (mode == HTML_COLOR) {
+        std::string header = "<!DOCTYPE html>\n<html>\n<head><meta charset=\"utf-8\">"
+                             "</head>\n<body style=\"background:";
+        header += darkBackground ? "#000000" : "#ffffff";
+        header += "\">\n<pre style=\"line-height:1\">\n";
+        out.write(header.data(), header.size());
+    }
+}
+
+void ColorTextWriter::writeLines(   const code_point* symbols, const RgbColor* colors,
+                                    size_t symbolsCount, size_t symbolsInLine) {
+    for (size_t lineStart = 0; lineStart < symbolsCount; lineStart += symbolsInLine) {
+        line.clear();
+        uint32_t currentColor = NO_CURRENT_COLOR;
+
+        for (size_t symbol = lineStart; symbol < lineStart + symbolsInLine; ++symbol) {
+            if (symbols[symbol] != ' ') {
+                const RgbColor& color = colors[symbol];
+                uint32_t key = mode == ANSI_256_COLOR
+                                ? paletteIndex(color)
+                                : color.red << 16 | color.green << 8 | color.blue;
+
+                if (key != currentColor) {
+                    if (mode == HTML_COLOR && currentColor != NO_CURRENT_COLOR) {
+                        line += "</span>";
+                    }
+                    appendColor(color);
+                    currentColor = key;
+                }
+            }
+
+            appendSymbol(symbols[symbol]);
+        }
+
+        if (currentColor != NO_CURRENT_COLOR) {
+            line += mode == HTML_COLOR ? "</span>" : "\x1b[0m";
+        }
+        line += '\n';
+
+        out.write(line.data(), line.size());
+    }
+}
+
+void ColorTextWriter::finish() {
+    if (mode == HTML_COLOR) {
+        static const std::string footer = "</pre>\n</body>\n</html>\n";
+        out.write(footer.data(), footer.size());
+    }
+}
+
+void ColorTextWriter::appendColor(const RgbColor& color) {
+    if (mode == HTML_COLOR) {
+        line += "<span style=\"color:#";
+        appendHexByte(color.red, line);
+        appendHexByte(color.green, line);
+        appendHexByte(color.blue, line);
+        line += "\">";
+    } else if (mode == ANSI_256_COLOR) {
+        line += "\x1b[38;5;";
+        appendDecimal(paletteIndex(color), line);
+        line += 'm';
+    } else {
+        line += "\x1b[38;2;";
+        appendDecimal(color.red, line);
+        line += ';';
+        appendDecimal(color.green, line);
+        line += ';';
+        appendDecimal(color.blue, line);
+        line += 'm';
+    }
+}
+
+void ColorTextWriter::appendSymbol(code_point symbol) {
+    if (mode == HTML_COLOR) {
+        switch (symbol) {
+            case '<': line += "&lt;";  return;
+            case '>': line += "&gt;";  return;
+            case '&': line += "&amp;"; return;
+            default: break;
+        }
+    }
+
+    appendUtf8(&symbol, 1, line);
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#include "pixel_matcher.h"
+#include "frame_kernels.h"
+
+// largest cell whose squared differences sum fits the 32-bit distance
+static const size_t MAX_CELL_PIXELS = UINT32_MAX / (MAX_GRAY_LEVELS * MAX_GRAY_LEVELS);
+
+PixelMatcher::PixelMatcher(const GlyphVocabulary& vocab, PixelMetric _metric)
+    : metric(_metric)
+    , cellPixels(vocab.fontWidth * vocab.fontHeight)
+    , cellBytes((cellPixels + CELL_ALIGNMENT - 1) / CELL_ALIGNMENT * CELL_ALIGNMENT)
+    , cells(NULL) {
+
+    if (    vocab.glyphSymbols.empty()
+        ||  vocab.glyphCells.size() != vocab.glyphSymbols.size() * cellPixels) {
+        throw std::runtime_error("Pixel matching requires rendered glyph cells");
+    }
+
+    if (cellPixels > MAX_CELL_PIXELS) {
+        throw std::runtime_error("Font size is too big for pixel matching");
+    }
+
+    buildGlyphCells(vocab);
+}
+
+void PixelMatcher::buildGlyphCells(const GlyphVocabulary& vocab) {
+    const size_t symbols = vocab.glyphSymbols.size();
+    const GlyphBrightnessScale scale(vocab);
+
+    pixels_vector mappedCells(symbols * cellPixels);
+    std::vector<uint32_t> mappedSums(symbols, 0);
+    for (size_t glyph = 0; glyph < symbols; ++glyph) {
+        for (size_t pixel = 0; pixel < cellPixels; ++pixel) {
+            obj_brightness brightness = scale(vocab.glyphCells[glyph * cellPixels + pixel]);
+            mappedCells[glyph * cellPixels + pixel] = brightness;
+            mappedSums[glyph] += brightness;
+        }
+    }
+
+    glyphOrder.resize(symbols);
+    std::iota(glyphOrder.begin(), glyphOrder.end(), 0);
+    std::stable_sort(glyphOrder.begin(), glyphOrder.end(),
+                    [&mappedSums](uint32_t lhs, uint32_t rhs) {
+                        return mappedSums[lhs] < mappedSums[rhs];
+                    });
+
+    // padding pixels stay zero, frame cells are padded the same way
+    cellsStorage.assign(symbols * cellBytes + CELL_ALIGNMENT, 0);
+    uintptr_t address = reinterpret_cast<uintptr_t>(cellsStorage.data());
+    size_t alignmentOffset = (CELL_ALIGNMENT - address % CELL_ALIGNMENT) % CELL_ALIGNMENT;
+    obj_brightness* alignedCells = cellsStorage.data() + alignmentOffset;
+
+    for (size_t position = 0; position < symbols; ++position) {
+        uint32_t glyph = glyphOrder[position];
+        std::copy(  mappedCells.begin() + glyph * cellPixels,
+                    mappedCells.begin() + (glyph + 1) * cellPixels,
+                    alignedCells + position * cellBytes);
+        glyphSymbols.push_back(vocab.glyphSymbols[glyph]);
+        glyphSums.push_back(mappedSums[glyph]);
+    }
+
+    cells = alignedCells;
+}
+
+// SAD is never less than the difference of sums, and SSD is never less than
+// its square divided by the pixels count
+uint32_t PixelMatcher::sumGapBound(uint32_t firstSum, uint32_t secondSum) const {
+    uint64_t gap = firstSum > secondSum ? firstSum - secondSum : secondSum - firstSum;
+
+    if (metric == SUM_OF_SQUARED_DIFFERENCES) {
+        return gap * gap / cellPixels;
+    }
+
+    return gap;
+}
+
+code_point PixelMatcher::closestGlyph(  const obj_brightness* frameCell,
+                                        uint32_t frameSum) const {
+    const size_t glyphsCount = glyphSums.size();
+
+    // glyphs are tried in the order of growing sums gap, taking the closer of
+    // the two neighbours on both sides of the frame's sum every time
+    size_t above = std::lower_bound(glyphSums.begin(), glyphSums.end(), frameSum)
+                    - glyphSums.begin();
+    size_t below = above;
+
+    uint64_t bestKey = UINT64_MAX;
+    uint32_t bestDistance = UINT32_MAX;
+    size_t bestPosition = 0;
+
+    while (below > 0 || above < glyphsCount) {
+        size_t position = 0;
+        if (    above < glyphsCount
+            &&  (below == 0 || glyphSums[above] - frameSum <= frameSum - glyphSums[below - 1])) {
+            position = above++;
+        } else {
+            position = --below;
+        }
+
+        // the gaps of all the glyphs left are not smaller than this one
+        if (sumGapBound(frameSum, glyphSums[position]) > bestDistance) {
+            break;
+        }
+
+        const obj_brightness* cell = cells + position * cellBytes;
+        uint32_t distance = metric == SUM_OF_SQUARED_DIFFERENCES
+                            ? cellSquaredDifference(frameCell, cell, cellBytes, bestDistance)
+                            : cellAbsoluteDifference(frameCell, cell, cellBytes, bestDistance);
+
+        // pruned candidates return distances greater than the best one
+        uint64_t key = static_cast<uint64_t>(distance) << 32 | glyphOrder[position];
+        if (key < bestKey) {
+            bestKey = key;
+            bestDistance = distance;
+            bestPosition = position;
+        }
+    }
+
+    return glyphSymbols[bestPosition];
+}
+
+void PixelMatcher::matchStrip(  const FramedBitmap& map, size_t strip,
+                                size_t firstFrame, size_t framesCount,
+                                code_point* matches) const {
+    static thread_local std::vector<uint32_t> frameSums;
+    static thread_local pixels_vector frameCell;
+
+    const size_t width  = map.frameWidth;
+    const size_t height = map.frameHeight;
+
+    frameSums.resize(framesCount);
+    map.stripBrightnessSums(strip, firstFrame, framesCount, frameSums.data());
+
+    // frame pixels are gathered into a cell laid out as the glyph ones are
+    frameCell.assign(cellBytes, 0);
+    const obj_brightness* stripStart = map.rowPixels(strip * height)
+                                        + firstFrame * width;
+
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        const obj_brightness* frameStart = stripStart + frame * width;
+        for (size_t row = 0; row < height; ++row) {
+            std::memcpy(frameCell.data() + row * width,
+                        frameStart + row * map.stride, width);
+        }
+
+        matches[frame] = closestGlyph(frameCell.data(), frameSums[frame]);
+    }
+}
@@ -1,4 +1,6 @@
+#include <climits>
 #include <exception>
+#include <stdexcept>
 
 extern "C" {
     #include "SDL.h"
@@ -6,10 +8,11 @@ extern "C" {
 }
 
 #include "sdl_interface.h"
+#include "netpbm_reader.h"
 
 static const uint16_t NO_EXTRA_SUBMODULES = 0;
 
-static class SdlMaintainer {
+class SdlMaintainer {
 public:
     SdlMaintainer() {
         int error = SDL_Init(NO_EXTRA_SUBMODULES);
@@ -31,7 +34,7 @@ public:
 
 private:
     SdlMaintainer(const SdlMaintainer&);
-} sdl;
+};
 
 static void safeLockSurface(SDL_Surface* surface) {
     int error = SDL_LockSurface(surface);
@@ -41,23 +44,70 @@ static void safeLockSurface(SDL_Surface* surface) {
     }
 }
 
-FramedBitmap loadGrayscaleImage(const std::string& filepath) {
-    SDL_Surface* source = IMG_Load(filepath.c_str());
+// unlocking a surface that was never locked does nothing
+static void unlockAndFreeSurface(SDL_Surface* surface) {
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+}
+
+// libraries are set up on the first decoded image, not at program start,
+// so that programs linking the converter without decoding anything skip it
+static void setupSdlOnce() {
+    static SdlMaintainer sdl;
+}
 
+// decoded pixels are turned to gray levels in place and stay locked for
+// as long as the bitmap views them
+static FramedBitmap viewDecodedSurface(SDL_Surface* source, StatsCollector* stats,
+                                        FrameColors* colors = NULL) {
     if (source == NULL) {
         throw std::runtime_error(IMG_GetError());
     }
 
-    static const uint32_t UNUSED_FLAGS = 0;
-    SDL_Surface* converted = SDL_ConvertSurfaceFormat(  source,
-                                                        SDL_PIXELFORMAT_RGB888,
-                                                        UNUSED_FLAGS);
-    safeLockSurface(converted);
-    FramedBitmap bitmap(converted);
-    SDL_UnlockSurface(converted);
+    shared_surface_ptr surface(source, unlockAndFreeSurface);
+    safeLockSurface(surface.get());
+
+    ScopedStageTimer timer(stats, GRAYSCALE_STAGE);
+    return FramedBitmap(surface, colors);
+}
+
+FramedBitmap loadGrayscaleImage(const std::string& filepath, StatsCollector* stats,
+                                FrameColors* colors) {
+    if (isRawNetpbmFile(filepath)) {
+        ScopedStageTimer timer(stats, DECODE_STAGE);
+        return mapNetpbmImage(filepath, colors);
+    }
+
+    setupSdlOnce();
+
+    SDL_Surface* surface;
+    {
+        ScopedStageTimer timer(stats, DECODE_STAGE);
+        surface = IMG_Load(filepath.c_str());
+    }
+
+    return viewDecodedSurface(surface, stats, colors);
+}
 
-    SDL_FreeSurface(source);
-    SDL_FreeSurface(converted);
+FramedBitmap decodeGrayscaleImage(  const uint8_t* bytes, size_t size,
+                                    StatsCollector* stats) {
+    setupSdlOnce();
+
+    if (size > static_cast<size_t>(INT_MAX)) {
+        throw std::runtime_error("Encoded image is too large");
+    }
+
+    SDL_RWops* stream = SDL_RWFromConstMem(bytes, static_cast<int>(size));
+    if (stream == NULL) {
+        throw std::runtime_error(SDL_GetError());
+    }
+
+    static const int CLOSE_STREAM_AFTER_LOAD = 1;
+    SDL_Surface* surface;
+    {
+        ScopedStageTimer timer(stats, DECODE_STAGE);
+        surface = IMG_Load_RW(stream, CLOSE_STREAM_AFTER_LOAD);
+    }
 
-    return bitmap;
+    return viewDecodedSurface(surface, stats);
 }
@@ -0,0 +1,409 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+
+extern "C" {
+    #include <sys/stat.h>
+}
+
+#include "sequence_converter.h"
+#include "batch_converter.h"
+#include "freetype_interface.h"
+#include "gif_decoder.h"
+#include "sdl_interface.h"
+#include "output_writer.h"
+#include "frame_cache.h"
+
+/**
+ * @brief Pictures drawn by the frames of a GIF image
+ */
+class GifSequence : public FrameSequence {
+public:
+    explicit GifSequence(const std::string& path)
+        : decoder(path) {}
+
+    // pictures view the decoder canvas, which is redrawn by the next call
+    std::unique_ptr<FramedBitmap> nextPicture() override {
+        if (!decoder.nextFrame()) {
+            return std::unique_ptr<FramedBitmap>();
+        }
+
+        return std::unique_ptr<FramedBitmap>(new FramedBitmap(decoder.canvas(),
+                                                decoder.height(), decoder.width(),
+                                                decoder.width(), shared_owner_ptr()));
+    }
+
+private:
+    GifDecoder decoder;
+};
+
+/**
+ * @brief Pictures stored in separate image files
+ */
+class ImageListSequence : public FrameSequence {
+public:
+    explicit ImageListSequence(const std::vector<std::string>& _paths)
+        : paths(_paths)
+        , next(0) {}
+
+    std::unique_ptr<FramedBitmap> nextPicture() override {
+        if (next == paths.size()) {
+            return std::unique_ptr<FramedBitmap>();
+        }
+
+        return std::unique_ptr<FramedBitmap>(new FramedBitmap(
+                                                loadGrayscaleImage(paths[next++])));
+    }
+
+private:
+    std::vector<std::string>    paths;
+    size_t                      next;
+};
+
+static bool isRegularFile(const std::string& path) {
+    struct stat pathStat;
+    return stat(path.c_str(), &pathStat) == 0 && S_ISREG(pathStat.st_mode);
+}
+
+std::unique_ptr<FrameSequence> openFrameSequence(const std::string& source) {
+    if (isGifFile(source)) {
+        return std::unique_ptr<FrameSequence>(new GifSequence(source));
+    }
+
+    std::vector<std::string> images;
+    if (isRegularFile(source) && hasImageExtension(source)) {
+        images.push_back(source);
+    } else {
+        images = collectBatchImages(source);
+
+        // manifests list the pictures in their order already
+        if (!isRegularFile(source)) {
+            std::stable_sort(images.begin(), images.end(), naturalPathLess);
+        }
+    }
+
+    if (images.empty()) {
+        throw std::runtime_error("No pictures found in '" + source + "'");
+    }
+
+    return std::unique_ptr<FrameSequence>(new ImageListSequence(images));
+}
+
+// numbers are compared by value without leading zeroes, the rest of the
+// characters one by one
+bool naturalPathLess(const std::string& left, const std::string& right) {
+    size_t leftPos = 0;
+    size_t rightPos = 0;
+
+    while (leftPos < left.size() && rightPos < right.size()) {
+        if (!isdigit(left[leftPos]) || !isdigit(right[rightPos])) {
+            if (left[leftPos] != right[rightPos]) {
+                return left[leftPos] < right[rightPos];
+            }
+            ++leftPos;
+            ++rightPos;
+            continue;
+        }
+
+        size_t leftEnd = leftPos;
+        size_t rightEnd = rightPos;
+        while (leftEnd < left.size() && isdigit(left[leftEnd])) {
+            ++leftEnd;
+        }
+        while (rightEnd < right.size() && isdigit(right[rightEnd])) {
+            ++rightEnd;
+        }
+
+        while (leftPos + 1 < leftEnd && left[leftPos] == '0') {
+            ++leftPos;
+        }
+        while (rightPos + 1 < rightEnd && right[rightPos] == '0') {
+            ++rightPos;
+        }
+
+        if (leftEnd - leftPos != rightEnd - rightPos) {
+            return leftEnd - leftPos < rightEnd - rightPos;
+        }
+
+        int order = left.compare(leftPos, leftEnd - leftPos,
+                                right, rightPos, rightEnd - rightPos);
+        if (order != 0) {
+            return order < 0;
+        }
+
+        leftPos = leftEnd;
+        rightPos = rightEnd;
+    }
+
+    if (left.size() - leftPos != right.size() - rightPos) {
+        return left.size() - leftPos < right.size() - rightPos;
+    }
+
+    // paths differing only by leading zeroes keep a stable order
+    return left < right;
+}
+
+TemporalMatcher::TemporalMatcher(   const FrameMatcher& _matcher, size_t _frameWidth,
+                                    size_t _frameHeight, size_t _workersNum)
+    : matcher(_matcher)
+    , frameWidth(_frameWidth)
+    , frameHeight(_frameHeight)
+    , workersNum(std::max<size_t>(_workersNum, 1))
+    , stripFrames(0)
+    , stripsTotal(0)
+    , wholeMatch(true) {
+
+    if (workersNum > 1) {
+        pool.reset(new ThreadPool(workersNum));
+    }
+}
+
+size_t TemporalMatcher::update(FramedBitmap& map) {
+    map.setFrameSize(frameWidth, frameHeight);
+
+    const size_t frames = map.framesInStrip();
+    const size_t strips = map.rows / frameHeight;
+    wholeMatch = matches.empty() || frames != stripFrames || strips != stripsTotal;
+
+    if (wholeMatch) {
+        stripFrames = frames;
+        stripsTotal = strips;
+        previous.assign(stripsTotal * frameHeight * stripFrames * frameWidth, 0);
+        matches.assign(stripsTotal * stripFrames, ' ');
+        changed.assign(stripsTotal * stripFrames, true);
+    }
+
+    if (matches.empty()) {
+        return 0;
+    }
+
+    // strips are taken one at a time, changes of a picture are often
+    // gathered in one place
+    std::atomic<size_t> nextStrip(0);
+    std::atomic<size_t> rematched(0);
+    auto updateStrips = [&]() {
+        size_t stripRematched = 0;
+        for (size_t strip = nextStrip++; strip < stripsTotal; strip = nextStrip++) {
+            stripRematched += updateStrip(map, strip);
+        }
+        rematched += stripRematched;
+    };
+
+    if (pool) {
+        std::vector< std::future<void> > workersDone;
+        for (size_t worker = 0; worker < workersNum; ++worker) {
+            workersDone.push_back(pool->submit(updateStrips));
+        }
+
+        // all the workers are done with the picture before an error is
+        // passed on
+        for (std::future<void>& done : workersDone) {
+            done.wait();
+        }
+        for (std::future<void>& done : workersDone) {
+            done.get();
+        }
+    } else {
+        updateStrips();
+    }
+
+    return rematched;
+}
+
+size_t TemporalMatcher::updateStrip(const FramedBitmap& map, size_t strip) {
+    const size_t rowLength  = stripFrames * frameWidth;
+    const size_t firstRow   = strip * frameHeight;
+    code_point* stripMatches = matches.data() + strip * stripFrames;
+    char* stripChanged       = changed.data() + strip * stripFrames;
+
+    if (wholeMatch) {
+        matcher.matchStrip(map, strip, 0, stripFrames, stripMatches);
+        for (size_t row = firstRow; row < firstRow + frameHeight; ++row) {
+            memcpy(previous.data() + row * rowLength, map.rowPixels(row), rowLength);
+        }
+
+        return stripFrames;
+    }
+
+    std::fill(stripChanged, stripChanged + stripFrames, false);
+
+    // rows are compared whole first, unchanged rows are the common case
+    static thread_local std::vector<char> dirty;
+    dirty.assign(stripFrames, false);
+    bool stripDirty = false;
+
+    for (size_t row = firstRow; row < firstRow + frameHeight; ++row) {
+        const obj_brightness* current = map.rowPixels(row);
+        obj_brightness* kept = previous.data() + row * rowLength;
+        if (memcmp(current, kept, rowLength) == 0) {
+            continue;
+        }
+
+        for (size_t frame = 0; frame < stripFrames; ++frame) {
+            size_t frameStart = frame * frameWidth;
+            if (    !dirty[frame]
+                &&  memcmp(current + frameStart, kept + frameStart, frameWidth) != 0) {
+                dirty[frame] = true;
+            }
+        }
+
+        memcpy(kept, current, rowLength);
+        stripDirty = true;
+    }
+
+    if (!stripDirty) {
+        return 0;
+    }
+
+    // runs of adjacent changed frames are matched with one call
+    static thread_local std::vector<code_point> runMatches;
+    size_t rematched = 0;
+    for (size_t frame = 0; frame < stripFrames; ) {
+        if (!dirty[frame]) {
+            ++frame;
+            continue;
+        }
+
+        size_t runEnd = frame;
+        while (runEnd < stripFrames && dirty[runEnd]) {
+            ++runEnd;
+        }
+
+        runMatches.resize(runEnd - frame);
+        matcher.matchStrip(map, strip, frame, runEnd - frame, runMatches.data());
+        for (size_t runFrame = frame; runFrame < runEnd; ++runFrame) {
+            code_point symbol = runMatches[runFrame - frame];
+            stripChanged[runFrame] = stripMatches[runFrame] != symbol;
+            stripMatches[runFrame] = symbol;
+        }
+
+        rematched += runEnd - frame;
+        frame = runEnd;
+    }
+
+    return rematched;
+}
+
+const std::vector<code_point>& TemporalMatcher::symbols() const {
+    return matches;
+}
+
+const std::vector<char>& TemporalMatcher::changedFrames() const {
+    return changed;
+}
+
+bool TemporalMatcher::keyframe() const {
+    return wholeMatch;
+}
+
+size_t TemporalMatcher::framesInStrip() const {
+    return stripFrames;
+}
+
+size_t TemporalMatcher::strips() const {
+    return stripsTotal;
+}
+
+static void writeWholePicture(  TextWriter& outfile, size_t picture,
+                                const TemporalMatcher& temporal) {
+    std::string header = "picture " + std::to_string(picture) + " full\n";
+    outfile.write(header.data(), header.size());
+
+    const std::vector<code_point>& symbols = temporal.symbols();
+    outfile.writeLines(symbols.data(), symbols.size(), temporal.framesInStrip());
+}
+
+static void writePictureDiff(   TextWriter& outfile, size_t picture,
+                                const TemporalMatcher& temporal) {
+    const std::vector<code_point>& symbols = temporal.symbols();
+    const std::vector<char>& changed = temporal.changedFrames();
+    const size_t stripFrames = temporal.framesInStrip();
+
+    std::string runs;
+    size_t runsCount = 0;
+    for (size_t strip = 0; strip < temporal.strips(); ++strip) {
+        const size_t stripStart = strip * stripFrames;
+
+        for (size_t frame = 0; frame < stripFrames; ) {
+            if (!changed[stripStart + frame]) {
+                ++frame;
+                continue;
+            }
+
+            size_t runEnd = frame;
+            while (runEnd < stripFrames && changed[stripStart + runEnd]) {
+                ++runEnd;
+            }
+
+            runs += std::to_string(strip) + ' ' + std::to_string(frame) + ' ';
+            appendUtf8(symbols.data() + stripStart + frame, runEnd - frame, runs);
+            runs += '\n';
+
+            ++runsCount;
+            frame = runEnd;
+        }
+    }
+
+    std::string header = "picture " + std::to_string(picture) + " diff "
+                            + std::to_string(runsCount) + "\n";
+    outfile.write(header.data(), header.size());
+    outfile.write(runs.data(), runs.size());
+}
+
+void sequenceToText(const Settings& settings) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+
+    setupFont(settings.fontPath, settings.fontSize, settings.invert,
+                settings.vocabularyCacheDir, settings.charset);
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(settings.matching,
+                                                               settings.shapeGrid);
+    std::unique_ptr<CachingMatcher> cachingMatcher = createFrameCache(
+                                        *matcher, settings.frameCacheEntries);
+    const FrameMatcher& frameMatcher = cachingMatcher ? *cachingMatcher : *matcher;
+
+    std::unique_ptr<FrameSequence> sequence = openFrameSequence(settings.sequenceSource);
+
+    size_t workersNum = settings.threads > 0 ? settings.threads
+                                             : ThreadPool::defaultSize();
+    TemporalMatcher temporal(frameMatcher, getFontWidth(), getFontHeight(), workersNum);
+    TextWriter outfile(settings.outfile);
+
+    size_t picturesTotal  = 0;
+    size_t framesTotal    = 0;
+    size_t rematchedTotal = 0;
+    while (std::unique_ptr<FramedBitmap> picture = sequence->nextPicture()) {
+        if (settings.engine == INTEGRAL_IMAGE_ENGINE) {
+            picture->buildIntegralImage();
+        }
+
+        rematchedTotal += temporal.update(*picture);
+        framesTotal += temporal.symbols().size();
+
+        if (settings.sequenceDiffs && !temporal.keyframe()) {
+            writePictureDiff(outfile, picturesTotal, temporal);
+        } else {
+            writeWholePicture(outfile, picturesTotal, temporal);
+        }
+        ++picturesTotal;
+    }
+    outfile.flush();
+
+    std::chrono::duration<double> elapsed = clock::now() - start;
+    std::cout   << "Converted " << picturesTotal << " pictures in "
+                << elapsed.count() << " s: "
+                << picturesTotal / elapsed.count() << " pictures/s, "
+                << rematchedTotal << " of " << framesTotal << " frames matched ("
+                << (framesTotal ? 100.0 * rematchedTotal / framesTotal : 0)
+                << "%)" << std::endl;
+
+    if (cachingMatcher) {
+        printFrameCacheStats(cachingMatcher->stats(), std::cout);
+    }
+}
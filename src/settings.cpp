@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -10,16 +12,39 @@ extern "C" {
 }
 
 #include "settings.h"
+#include "batch_converter.h"
+#include "glyph_cache.h"
+#include "shape_matcher.h"
+
+// frame cache size is chosen by the matching strategy unless it is given
+static const size_t AUTO_FRAME_CACHE_ENTRIES    = SIZE_MAX;
+static const size_t DEFAULT_FRAME_CACHE_ENTRIES = 16384;
 
 Settings::Settings()
     : imagePath("image_unspecified")
     , fontPath("font_unspecified")
     , fontSize(6)
     , invert(false)
+    , engine(PIXEL_SCAN_ENGINE)
+    , threads(0)
+    , matching(MEAN_BRIGHTNESS_MATCHING)
+    , dithering(NO_DITHERING)
+    , color(NO_COLOR)
+    , shapeGrid(3)
+    , frameCacheEntries(AUTO_FRAME_CACHE_ENTRIES)
+    , stream(false)
+    , sequenceDiffs(false)
+    , maxPending(64)
+    , printStats(false)
+    , noVocabularyCache(false)
     , abort(false) {}
 
 enum ArguementCodes {
-    IMAGE_ID = 1, FONT_ID, FONTSIZE_ID, INVERT_ID, OUTFILE_ID, HELP_ID
+    IMAGE_ID = 1, FONT_ID, FONTSIZE_ID, INVERT_ID, OUTFILE_ID, ENGINE_ID,
+    THREADS_ID, BATCH_ID, OUTDIR_ID, GLYPH_CACHE_ID, NO_GLYPH_CACHE_ID,
+    MATCH_ID, SHAPE_GRID_ID, FRAME_CACHE_ID, STREAM_ID, SEQUENCE_ID,
+    SEQUENCE_DIFFS_ID, SERVE_ID, MAX_PENDING_ID, STATS_ID, CHARSET_ID,
+    CHARSET_FILE_ID, DITHER_ID, COLOR_ID, HELP_ID
 };
 
 static std::vector<option> options = {
@@ -28,6 +53,25 @@ static std::vector<option> options = {
     {"fontsize",required_argument, NULL, FONTSIZE_ID    },
     {"outfile", required_argument, NULL, OUTFILE_ID     },
     {"invert",  no_argument,       NULL, INVERT_ID      },
+    {"engine",  required_argument, NULL, ENGINE_ID      },
+    {"threads", required_argument, NULL, THREADS_ID     },
+    {"batch",   required_argument, NULL, BATCH_ID       },
+    {"outdir",  required_argument, NULL, OUTDIR_ID      },
+    {"glyph-cache",     required_argument, NULL, GLYPH_CACHE_ID     },
+    {"no-glyph-cache",  no_argument,       NULL, NO_GLYPH_CACHE_ID  },
+    {"match",   required_argument, NULL, MATCH_ID       },
+    {"shape-grid",      required_argument, NULL, SHAPE_GRID_ID      },
+    {"frame-cache",     required_argument, NULL, FRAME_CACHE_ID     },
+    {"stream",  no_argument,       NULL, STREAM_ID      },
+    {"sequence",        required_argument, NULL, SEQUENCE_ID        },
+    {"sequence-diffs",  no_argument,       NULL, SEQUENCE_DIFFS_ID  },
+    {"serve",   required_argument, NULL, SERVE_ID       },
+    {"max-pending",     required_argument, NULL, MAX_PENDING_ID     },
+    {"stats",   optional_argument, NULL, STATS_ID       },
+    {"charset", required_argument, NULL, CHARSET_ID     },
+    {"charset-file",    required_argument, NULL, CHARSET_FILE_ID    },
+    {"dither",  required_argument, NULL, DITHER_ID      },
+    {"color",   required_argument, NULL, COLOR_ID       },
     {"help",    no_argument,       NULL, HELP_ID        },
     {0,         0,                 NULL, 0              }
 };
@@ -36,13 +80,37 @@ static std::map<std::string, std::string> settingsHelp = {
     {"image",   "path to *.bmp image you want to convert"},
     {"font",    "path to font file you want to use as a base for conversion (font must be monospaced)"},
     {"outfile", "path to the output file; if not specified, image file path will be used"},
-    {"fontsize","defines how detailed the output will be, must be 1 or more"},
+    {"fontsize","defines how detailed the output will be, must be 1 or more; a comma-separated list of sizes such as 6,10,16 converts a single image with all of them at once, the size is added to the name of every output file"},
     {"invert",  "generate output as if painting with white on black"},
+    {"engine",  "frame brightness calculation method: 'scan' (default) or 'integral'; 'integral' pays off on big images and small font sizes"},
+    {"threads", "number of worker threads, defaults to the number of hardware threads"},
+    {"batch",   "convert many images with the same font: directory, quoted glob pattern or manifest file with one image path per line"},
+    {"outdir",  "directory for batch mode output files; if not specified, output is placed next to the images"},
+    {"glyph-cache",     "directory of the glyph vocabulary cache, $XDG_CACHE_HOME/img_glypher or ~/.cache/img_glypher by default"},
+    {"no-glyph-cache",  "always build the glyph vocabulary from the font file"},
+    {"match",   "symbol matching strategy: 'mean' (default) compares average brightness, 'shape' also compares brightness of frame parts and keeps edges sharper, 'sad' and 'ssd' compare every pixel of frames and symbols by the sum of absolute or squared differences, 'braille' makes a Braille pattern of every frame with a dot for each of its 2x4 parts darker than middle gray"},
+    {"shape-grid",      "number of part rows and columns compared by the 'shape' matching, from 1 to 4, 3 by default"},
+    {"frame-cache",     "number of distinct frames whose matched symbols are remembered, 0 turns the cache off; 16384 by default for 'shape', 'sad' and 'ssd' matching, off for 'mean' and 'braille'; stored frames never take more than 64 MiB"},
+    {"stream",  "convert the image a few frame rows at a time to bound memory use; binary PGM and PPM images are also read from the file a few rows at a time, other formats are decoded whole"},
+    {"sequence",        "convert every picture of an animation with the same font: GIF image, directory or quoted glob pattern of numbered images, or manifest file; pictures are written one after another to the output file"},
+    {"sequence-diffs",  "write every picture of the sequence but the first as the runs of symbols changed since the picture before"},
+    {"serve",   "run as a conversion daemon listening on the given Unix socket path; fonts stay loaded between requests, see README for the protocol"},
+    {"max-pending",     "number of requests the daemon queues before answering new connections 'BUSY', 64 by default"},
+    {"stats",   "print timings of the conversion stages, frames matched by every worker thread and bytes written as JSON, to the given file or to the standard output; single image conversions only"},
+    {"charset", "symbols to choose from, printable ASCII by default: comma-separated list of 'ascii', 'blocks' (block elements), 'box' (box drawing), 'braille', code points such as U+2588 and ranges such as U+2580-U+259F; output is UTF-8"},
+    {"charset-file",    "file with the symbols to choose from in UTF-8, added to the ones of --charset"},
+    {"dither",  "error diffusion of the 'mean' matching: 'none' (default), 'floyd-steinberg' or 'atkinson'; symbols of neighbouring frames alternate so that gradients do not turn into bands; not available with --stream and --sequence"},
+    {"color",   "color every symbol with the average color of its frame: 'none' (default), 'ansi' (24-bit terminal colors), 'ansi256' (256-color terminal palette) or 'html' (web page, written to a *.html file by default); single image conversions only"},
     {"help",    "print help"}
 };
 
 static void printHelp();
+static void parseFontSizes(const std::string& list, Settings& settings);
 static void applyDefaultsIfNeeded(Settings& settings);
+static BrightnessEngine parseEngine(const std::string& name, Settings& settings);
+static MatchingMode parseMatchingMode(const std::string& name, Settings& settings);
+static DitheringMode parseDitheringMode(const std::string& name, Settings& settings);
+static ColorMode parseColorMode(const std::string& name, Settings& settings);
 
 
 Settings parseArguments(int argc, char* argv[]) {
@@ -79,7 +147,7 @@ Settings parseArguments(int argc, char* argv[]) {
 
             case FONTSIZE_ID: {
                 if (optarg) {
-                    settings.fontSize = std::stoull(optarg);
+                    parseFontSizes(optarg, settings);
                 }
             }
             break;
@@ -89,6 +157,134 @@ Settings parseArguments(int argc, char* argv[]) {
             }
             break;
 
+            case ENGINE_ID: {
+                if (optarg) {
+                    settings.engine = parseEngine(optarg, settings);
+                }
+            }
+            break;
+
+            case THREADS_ID: {
+                if (optarg) {
+                    settings.threads = std::stoull(optarg);
+                }
+            }
+            break;
+
+            case BATCH_ID: {
+                if (optarg) {
+                    settings.batchSource.assign(optarg);
+                }
+            }
+            break;
+
+            case OUTDIR_ID: {
+                if (optarg) {
+                    settings.outdir.assign(optarg);
+                }
+            }
+            break;
+
+            case GLYPH_CACHE_ID: {
+                if (optarg) {
+                    settings.vocabularyCacheDir.assign(optarg);
+                }
+            }
+            break;
+
+            case NO_GLYPH_CACHE_ID: {
+                settings.noVocabularyCache = true;
+            }
+            break;
+
+            case MATCH_ID: {
+                if (optarg) {
+                    settings.matching = parseMatchingMode(optarg, settings);
+                }
+            }
+            break;
+
+            case SHAPE_GRID_ID: {
+                if (optarg) {
+                    settings.shapeGrid = std::stoull(optarg);
+                }
+            }
+            break;
+
+            case FRAME_CACHE_ID: {
+                if (optarg) {
+                    settings.frameCacheEntries = std::stoull(optarg);
+                }
+            }
+            break;
+
+            case STREAM_ID: {
+                settings.stream = true;
+            }
+            break;
+
+            case SEQUENCE_ID: {
+                if (optarg) {
+                    settings.sequenceSource.assign(optarg);
+                }
+            }
+            break;
+
+            case SEQUENCE_DIFFS_ID: {
+                settings.sequenceDiffs = true;
+            }
+            break;
+
+            case SERVE_ID: {
+                if (optarg) {
+                    settings.serveSocket.assign(optarg);
+                }
+            }
+            break;
+
+            case MAX_PENDING_ID: {
+                if (optarg) {
+                    settings.maxPending = std::stoull(optarg);
+                }
+            }
+            break;
+
+            case STATS_ID: {
+                settings.printStats = true;
+                if (optarg) {
+                    settings.statsPath.assign(optarg);
+                }
+            }
+            break;
+
+            case CHARSET_ID: {
+                if (optarg) {
+                    mergeCharsets(settings.charset, parseCharset(optarg));
+                }
+            }
+            break;
+
+            case CHARSET_FILE_ID: {
+                if (optarg) {
+                    mergeCharsets(settings.charset, readCharsetFile(optarg));
+                }
+            }
+            break;
+
+            case DITHER_ID: {
+                if (optarg) {
+                    settings.dithering = parseDitheringMode(optarg, settings);
+                }
+            }
+            break;
+
+            case COLOR_ID: {
+                if (optarg) {
+                    settings.color = parseColorMode(optarg, settings);
+                }
+            }
+            break;
+
             case HELP_ID: {
                 printHelp();
                 settings.abort = true;
@@ -112,6 +308,97 @@ Settings parseArguments(int argc, char* argv[]) {
     return settings;
 }
 
+static void parseFontSizes(const std::string& list, Settings& settings) {
+    std::vector<uint_fast16_t> sizes;
+    std::stringstream sizesStream(list);
+    std::string size;
+    while (std::getline(sizesStream, size, ',')) {
+        sizes.push_back(std::stoull(size));
+    }
+
+    if (sizes.empty()) {
+        std::cerr << "Font size is not given" << std::endl;
+        settings.abort = true;
+        return;
+    }
+
+    settings.fontSize = sizes.front();
+    settings.fontSizes.clear();
+    if (sizes.size() > 1) {
+        settings.fontSizes = sizes;
+    }
+}
+
+static BrightnessEngine parseEngine(const std::string& name, Settings& settings) {
+    static const std::map<std::string, BrightnessEngine> engines = {
+        {"scan",     PIXEL_SCAN_ENGINE      },
+        {"integral", INTEGRAL_IMAGE_ENGINE  }
+    };
+
+    auto engineIter = engines.find(name);
+    if (engineIter == engines.end()) {
+        std::cerr << "Unknown brightness engine '" << name << "'" << std::endl;
+        settings.abort = true;
+        return settings.engine;
+    }
+
+    return engineIter->second;
+}
+
+static MatchingMode parseMatchingMode(const std::string& name, Settings& settings) {
+    static const std::map<std::string, MatchingMode> modes = {
+        {"mean",    MEAN_BRIGHTNESS_MATCHING    },
+        {"shape",   SHAPE_MATCHING              },
+        {"sad",     ABSOLUTE_PIXEL_MATCHING     },
+        {"ssd",     SQUARED_PIXEL_MATCHING      },
+        {"braille", BRAILLE_MATCHING            }
+    };
+
+    auto modeIter = modes.find(name);
+    if (modeIter == modes.end()) {
+        std::cerr << "Unknown matching strategy '" << name << "'" << std::endl;
+        settings.abort = true;
+        return settings.matching;
+    }
+
+    return modeIter->second;
+}
+
+static DitheringMode parseDitheringMode(const std::string& name, Settings& settings) {
+    static const std::map<std::string, DitheringMode> modes = {
+        {"none",            NO_DITHERING                },
+        {"floyd-steinberg", FLOYD_STEINBERG_DITHERING   },
+        {"atkinson",        ATKINSON_DITHERING          }
+    };
+
+    auto modeIter = modes.find(name);
+    if (modeIter == modes.end()) {
+        std::cerr << "Unknown dithering '" << name << "'" << std::endl;
+        settings.abort = true;
+        return settings.dithering;
+    }
+
+    return modeIter->second;
+}
+
+static ColorMode parseColorMode(const std::string& name, Settings& settings) {
+    static const std::map<std::string, ColorMode> modes = {
+        {"none",    NO_COLOR        },
+        {"ansi",    ANSI_TRUECOLOR  },
+        {"ansi256", ANSI_256_COLOR  },
+        {"html",    HTML_COLOR      }
+    };
+
+    auto modeIter = modes.find(name);
+    if (modeIter == modes.end()) {
+        std::cerr << "Unknown color mode '" << name << "'" << std::endl;
+        settings.abort = true;
+        return settings.color;
+    }
+
+    return modeIter->second;
+}
+
 static void printHelp() {
     std::cout << "Image glypher accepts the following options:\n";
     for (option& opt : options) {
@@ -134,11 +421,92 @@ static void printHelp() {
 
 
 static void defaultOutfile(Settings& settings);
+static void sequenceOutfile(Settings& settings);
 
 static void applyDefaultsIfNeeded(Settings& settings) {
-    if (settings.outfile.empty()) {
+    // sequences are written to one file named after the source, batch and
+    // server modes derive output file paths from every image path
+    if (settings.outfile.empty() && !settings.sequenceSource.empty()) {
+        sequenceOutfile(settings);
+    } else if ( settings.outfile.empty() && settings.batchSource.empty()
+            &&  settings.serveSocket.empty()) {
         defaultOutfile(settings);
     }
+
+    if (settings.shapeGrid < 1 || settings.shapeGrid > MAX_SHAPE_GRID) {
+        std::cerr << "Shape grid must be from 1 to " << MAX_SHAPE_GRID << std::endl;
+        settings.abort = true;
+    }
+
+    // error of a frame depends on the frames matched before it, so the
+    // image is matched whole and by brightness only
+    if (settings.dithering != NO_DITHERING) {
+        if (settings.matching != MEAN_BRIGHTNESS_MATCHING) {
+            std::cerr << "Dithering requires 'mean' matching" << std::endl;
+            settings.abort = true;
+        }
+        if (settings.stream || !settings.sequenceSource.empty()) {
+            std::cerr << "Dithering is not available with --stream and --sequence"
+                      << std::endl;
+            settings.abort = true;
+        }
+    }
+
+    // several sizes share one decoded image, the other modes go through
+    // many images or pieces of one
+    if (!settings.fontSizes.empty()) {
+        std::vector<uint_fast16_t> sorted = settings.fontSizes;
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+            std::cerr << "Font sizes must differ" << std::endl;
+            settings.abort = true;
+        }
+        if (    settings.stream || !settings.sequenceSource.empty()
+            ||  !settings.batchSource.empty() || !settings.serveSocket.empty()) {
+            std::cerr << "Several font sizes are only available for a single image"
+                      << std::endl;
+            settings.abort = true;
+        }
+    }
+
+    // colors are taken while a whole image is decoded
+    if (settings.color != NO_COLOR) {
+        if (    settings.stream || !settings.sequenceSource.empty()
+            ||  !settings.batchSource.empty() || !settings.serveSocket.empty()
+            ||  !settings.fontSizes.empty()) {
+            std::cerr << "Colored output is only available for a single image "
+                      << "and font size" << std::endl;
+            settings.abort = true;
+        }
+    }
+
+    // stages are timed by the single image conversions only
+    if (settings.printStats) {
+        if (    !settings.sequenceSource.empty() || !settings.batchSource.empty()
+            ||  !settings.serveSocket.empty()) {
+            std::cerr << "Statistics are not available with --batch, --serve "
+                      << "and --sequence" << std::endl;
+            settings.abort = true;
+        }
+    }
+
+    // cache lookup costs about as much as the mean brightness or the Braille
+    // matching itself
+    if (settings.frameCacheEntries == AUTO_FRAME_CACHE_ENTRIES) {
+        settings.frameCacheEntries =    settings.matching == MEAN_BRIGHTNESS_MATCHING
+                                    ||  settings.matching == BRAILLE_MATCHING
+                                        ? 0 : DEFAULT_FRAME_CACHE_ENTRIES;
+    }
+    // dithered frames depend on their neighbours, they are never looked up
+    if (settings.dithering != NO_DITHERING) {
+        settings.frameCacheEntries = 0;
+    }
+
+    if (settings.noVocabularyCache) {
+        settings.vocabularyCacheDir.clear();
+    } else if (settings.vocabularyCacheDir.empty()) {
+        settings.vocabularyCacheDir = defaultVocabularyCacheDir();
+    }
 }
 
 static void defaultOutfile(Settings& settings) {
@@ -149,10 +517,28 @@ static void defaultOutfile(Settings& settings) {
         std::string imagePathNoExtension = subMatch.str();
 
         std::stringstream outfile;
-        outfile << imagePathNoExtension << ".txt";
+        outfile << imagePathNoExtension
+                << (settings.color == HTML_COLOR ? ".html" : ".txt");
         settings.outfile.assign(outfile.str());
     }
     else {
         settings.abort = true;
     }
 }
+
+// sequence of a directory 'frames/' is written to 'frames.txt'
+static void sequenceOutfile(Settings& settings) {
+    std::string source = settings.sequenceSource;
+    while (source.size() > 1 && source.back() == '/') {
+        source.pop_back();
+    }
+
+    if (source.find_first_of("*?[") != std::string::npos) {
+        std::cerr << "Output file must be given for glob pattern sequences"
+                  << std::endl;
+        settings.abort = true;
+        return;
+    }
+
+    settings.outfile = batchOutfilePath(source, std::string());
+}
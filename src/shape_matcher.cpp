@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "shape_matcher.h"
+#include "frame_kernels.h"
+
+// never closer to any frame than a real glyph, small enough not to overflow
+// the 32-bit distance sums
+static const int16_t PADDING_GLYPH_COMPONENT = 1024;
+
+// sub-block borders are spread evenly, so blocks differ by one pixel at most
+static inline size_t blockBorder(size_t length, size_t block, size_t grid) {
+    return length * block / grid;
+}
+
+ShapeMatcher::ShapeMatcher(const GlyphVocabulary& vocab, size_t _grid)
+    : grid(std::min<size_t>(_grid, MAX_SHAPE_GRID))
+    , pairsCount(0)
+    , glyphsCount(0)
+    , glyphSymbols(vocab.glyphSymbols) {
+
+    // every sub-block must have at least one pixel
+    grid = std::min<size_t>(grid, vocab.fontWidth);
+    grid = std::min<size_t>(grid, vocab.fontHeight);
+    grid = std::max<size_t>(grid, 1);
+    pairsCount = (grid * grid + 1) / 2;
+
+    const size_t cellSize = vocab.fontWidth * vocab.fontHeight;
+    if (glyphSymbols.empty() || vocab.glyphCells.size() != glyphSymbols.size() * cellSize) {
+        throw std::runtime_error("Shape matching requires rendered glyph cells");
+    }
+
+    buildGlyphDescriptors(vocab);
+}
+
+void ShapeMatcher::buildGlyphDescriptors(const GlyphVocabulary& vocab) {
+    const size_t width      = vocab.fontWidth;
+    const size_t height     = vocab.fontHeight;
+    const size_t components = grid * grid;
+    const size_t symbols    = glyphSymbols.size();
+
+    const GlyphBrightnessScale scale(vocab);
+
+    glyphsCount = (symbols + DESCRIPTOR_GLYPHS_ALIGNMENT - 1)
+                    / DESCRIPTOR_GLYPHS_ALIGNMENT * DESCRIPTOR_GLYPHS_ALIGNMENT;
+    glyphPairs.assign(pairsCount * glyphsCount * 2, PADDING_GLYPH_COMPONENT);
+
+    for (size_t glyph = 0; glyph < symbols; ++glyph) {
+        const obj_brightness* cell = vocab.glyphCells.data() + glyph * width * height;
+
+        for (size_t blockRow = 0; blockRow < grid; ++blockRow) {
+            size_t top    = blockBorder(height, blockRow,     grid);
+            size_t bottom = blockBorder(height, blockRow + 1, grid);
+
+            for (size_t blockCol = 0; blockCol < grid; ++blockCol) {
+                size_t left  = blockBorder(width, blockCol,     grid);
+                size_t right = blockBorder(width, blockCol + 1, grid);
+
+                uint64_t blockSum = sumAreaPixels(  cell + top * width + left, width,
+                                                    right - left, bottom - top);
+                size_t component = blockRow * grid + blockCol;
+                glyphPairs[2 * (component / 2 * glyphsCount + glyph) + component % 2] =
+                                scale(blockSum / ((right - left) * (bottom - top)));
+            }
+        }
+
+        // odd descriptors are padded with a component equal to the frame's one
+        if (components % 2) {
+            glyphPairs[2 * (components / 2 * glyphsCount + glyph) + 1] = 0;
+        }
+    }
+}
+
+void ShapeMatcher::stripDescriptors(const FramedBitmap& map, size_t strip,
+                                    size_t firstFrame, size_t framesCount,
+                                    int16_t* descriptors) const {
+    static thread_local std::vector<uint32_t> columnSums;
+
+    const size_t width      = map.frameWidth;
+    const size_t height     = map.frameHeight;
+    const size_t stripTop   = strip * height;
+    const size_t stripLeft  = firstFrame * width;
+    const size_t components = pairsCount * 2;
+
+    for (size_t blockRow = 0; blockRow < grid; ++blockRow) {
+        size_t top    = blockBorder(height, blockRow,     grid);
+        size_t bottom = blockBorder(height, blockRow + 1, grid);
+
+        if (!map.hasIntegralImage()) {
+            columnSums.resize(framesCount * width);
+            sumStripColumns(map.rowPixels(stripTop + top) + stripLeft,
+                            map.stride, framesCount * width, bottom - top,
+                            columnSums.data());
+        }
+
+        for (size_t frame = 0; frame < framesCount; ++frame) {
+            int16_t* descriptor = descriptors + frame * components;
+
+            for (size_t blockCol = 0; blockCol < grid; ++blockCol) {
+                size_t left  = blockBorder(width, blockCol,     grid);
+                size_t right = blockBorder(width, blockCol + 1, grid);
+
+                uint32_t blockSum = 0;
+                if (map.hasIntegralImage()) {
+                    blockSum = map.areaBrightnessSum(stripLeft + frame * width + left,
+                                                    stripTop + top,
+                                                    right - left, bottom - top);
+                } else {
+                    const uint32_t* blockColumns = columnSums.data() + frame * width;
+                    for (size_t col = left; col < right; ++col) {
+                        blockSum += blockColumns[col];
+                    }
+                }
+
+                descriptor[blockRow * grid + blockCol] =
+                                    blockSum / ((right - left) * (bottom - top));
+            }
+        }
+    }
+
+    if (grid * grid < components) {
+        for (size_t frame = 0; frame < framesCount; ++frame) {
+            descriptors[frame * components + components - 1] = 0;
+        }
+    }
+}
+
+void ShapeMatcher::matchStrip(  const FramedBitmap& map, size_t strip,
+                                size_t firstFrame, size_t framesCount,
+                                code_point* matches) const {
+    static thread_local std::vector<int16_t> descriptors;
+    static thread_local std::vector<uint32_t> distances;
+
+    const size_t components = pairsCount * 2;
+    descriptors.resize(framesCount * components);
+    distances.resize(glyphsCount);
+
+    stripDescriptors(map, strip, firstFrame, framesCount, descriptors.data());
+
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        descriptorDistances(glyphPairs.data(), pairsCount, glyphsCount,
+                            descriptors.data() + frame * components,
+                            distances.data());
+
+        // distance and glyph number are compared as one key, so the loop has
+        // no branches and the first of the equally close glyphs wins
+        uint64_t bestKey = UINT64_MAX;
+        for (size_t glyph = 0; glyph < glyphsCount; ++glyph) {
+            bestKey = std::min(bestKey, static_cast<uint64_t>(distances[glyph]) << 32
+                                        | glyph);
+        }
+        matches[frame] = glyphSymbols[static_cast<uint32_t>(bestKey)];
+    }
+}
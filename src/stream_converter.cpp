@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <vector>
+
+#include "stream_converter.h"
+#include "netpbm_reader.h"
+#include "sdl_interface.h"
+#include "freetype_interface.h"
+#include "image_processor.h"
+#include "thread_pool.h"
+#include "output_writer.h"
+#include "frame_cache.h"
+
+// pixel budget of one chunk buffer, every worker still gets a strip or more
+static const size_t CHUNK_PIXELS = 1 << 24;
+
+/**
+ * @brief Rows of an image decoded whole by the image library
+ */
+class BitmapRowSource : public ImageRowSource {
+public:
+    explicit BitmapRowSource(FramedBitmap&& _bitmap)
+        : bitmap(std::move(_bitmap))
+        , nextRow(0) {
+        imageRows    = bitmap.rows;
+        imageColumns = bitmap.columns;
+    }
+
+    void readRows(size_t count, obj_brightness* grays, size_t stride) override {
+        for (size_t row = 0; row < count; ++row) {
+            std::memcpy(grays + row * stride, bitmap.rowPixels(nextRow + row),
+                        imageColumns);
+        }
+
+        nextRow += count;
+    }
+
+private:
+    FramedBitmap    bitmap;
+    size_t          nextRow;
+};
+
+std::unique_ptr<ImageRowSource> openImageRows( const std::string& path,
+                                                StatsCollector* stats) {
+    if (isRawNetpbmFile(path)) {
+        return std::unique_ptr<ImageRowSource>(new NetpbmReader(path));
+    }
+
+    return std::unique_ptr<ImageRowSource>(
+                                new BitmapRowSource(loadGrayscaleImage(path, stats)));
+}
+
+// lines of a chunk are written once every worker is done with it; the
+// workers are waited for even if decoding of the next chunk fails, since
+// they use the chunk's data. Time spent matching and writing is added to
+// the conversion totals
+static void writeChunkOutput(   TextWriter& outfile, FrameMatching& matching,
+                                std::exception_ptr decodeError,
+                                size_t symbolsInLine, StatsCollector* stats,
+                                uint64_t matchingStart, uint64_t& matchingTime,
+                                uint64_t& outputTime) {
+    matching.wait();
+
+    uint64_t outputStart = stats ? StatsCollector::now() : 0;
+    matchingTime += outputStart - matchingStart;
+
+    if (decodeError) {
+        std::rethrow_exception(decodeError);
+    }
+
+    for (size_t part = 0; part < matching.partsCount(); ++part) {
+        std::vector<code_point> matches = matching.takePart(part);
+        outfile.writeLines(matches.data(), matches.size(), symbolsInLine);
+    }
+
+    if (stats) {
+        outputTime += StatsCollector::now() - outputStart;
+    }
+}
+
+void streamRowsToText(  ImageRowSource& source, const FrameMatcher& matcher,
+                        size_t frameWidth, size_t frameHeight, size_t chunkStrips,
+                        BrightnessEngine engine, ThreadPool& pool,
+                        TextWriter& outfile, StatsCollector* stats) {
+    const size_t columns        = source.columns();
+    const size_t framesInStrip  = columns / frameWidth;
+    const size_t stripsTotal    = source.rows() / frameHeight;
+    if (framesInStrip == 0 || stripsTotal == 0) {
+        ScopedStageTimer timer(stats, OUTPUT_STAGE);
+        outfile.flush();
+        return;
+    }
+
+    chunkStrips = std::max<size_t>(std::min(chunkStrips, stripsTotal), 1);
+    FramedBitmap chunks[2] = { FramedBitmap(chunkStrips * frameHeight, columns),
+                               FramedBitmap(chunkStrips * frameHeight, columns) };
+
+    uint64_t matchingTime = 0;
+    uint64_t outputTime = 0;
+    size_t current = 0;
+    size_t stripsRead = chunkStrips;
+    {
+        ScopedStageTimer timer(stats, DECODE_STAGE);
+        source.readRows(stripsRead * frameHeight, chunks[current].pixels->data(),
+                        columns);
+    }
+
+    for (size_t firstStrip = 0; firstStrip < stripsTotal; ) {
+        // the last chunk may fill only a part of its buffer
+        const size_t strips = stripsRead - firstStrip;
+        FramedBitmap chunk( chunks[current].rowPixels(0), strips * frameHeight, columns,
+                            columns, shared_owner_ptr());
+        chunk.setFrameSize(frameWidth, frameHeight);
+
+        if (engine == INTEGRAL_IMAGE_ENGINE) {
+            ScopedStageTimer timer(stats, INTEGRAL_IMAGE_STAGE);
+            chunk.buildIntegralImage();
+        }
+
+        FrameMatching matching(chunk, matcher, NULL, pool.size(), stats);
+        uint64_t matchingStart = stats ? StatsCollector::now() : 0;
+        matching.start(&pool);
+
+        // the next chunk is decoded while this one is being matched, there
+        // is nothing left to decode after the last one
+        std::exception_ptr decodeError;
+        size_t nextStrips = std::min(chunkStrips, stripsTotal - stripsRead);
+        try {
+            if (nextStrips > 0) {
+                ScopedStageTimer timer(stats, DECODE_STAGE);
+                source.readRows(nextStrips * frameHeight,
+                                chunks[1 - current].pixels->data(), columns);
+            }
+        }
+        catch (...) {
+            decodeError = std::current_exception();
+        }
+
+        writeChunkOutput(outfile, matching, decodeError, framesInStrip, stats,
+                            matchingStart, matchingTime, outputTime);
+
+        firstStrip  = stripsRead;
+        stripsRead += nextStrips;
+        current     = 1 - current;
+    }
+
+    uint64_t flushStart = stats ? StatsCollector::now() : 0;
+    outfile.flush();
+    if (stats) {
+        stats->addStageTime(MATCHING_STAGE, matchingTime);
+        stats->addStageTime(OUTPUT_STAGE, outputTime + StatsCollector::now() - flushStart);
+    }
+}
+
+void streamImageToText(const Settings& settings) {
+    size_t workersNum = settings.threads > 0 ? settings.threads
+                                             : ThreadPool::defaultSize();
+    std::unique_ptr<StatsCollector> stats;
+    if (settings.printStats) {
+        stats.reset(new StatsCollector(workersNum));
+    }
+
+    {
+        ScopedStageTimer timer(stats.get(), FONT_SETUP_STAGE);
+        setupFont(settings.fontPath, settings.fontSize, settings.invert,
+                    settings.vocabularyCacheDir, settings.charset);
+    }
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(settings.matching,
+                                                               settings.shapeGrid);
+    std::unique_ptr<CachingMatcher> cachingMatcher = createFrameCache(
+                                        *matcher, settings.frameCacheEntries);
+    const FrameMatcher& frameMatcher = cachingMatcher ? *cachingMatcher : *matcher;
+
+    std::unique_ptr<ImageRowSource> source = openImageRows(settings.imagePath,
+                                                           stats.get());
+    const size_t frameHeight = getFontHeight();
+    const size_t chunkStrips = std::max(CHUNK_PIXELS / std::max<size_t>(
+                                            source->columns() * frameHeight, 1),
+                                        workersNum);
+
+    TextWriter outfile(settings.outfile);
+    ThreadPool pool(workersNum);
+    streamRowsToText(   *source, frameMatcher, getFontWidth(), frameHeight,
+                        chunkStrips, settings.engine, pool, outfile, stats.get());
+
+    if (cachingMatcher) {
+        printFrameCacheStats(cachingMatcher->stats(), std::cout);
+    }
+
+    if (stats) {
+        stats->addBytesWritten(outfile.bytesWritten());
+        saveConversionStats(stats->stats(), settings.statsPath);
+    }
+}
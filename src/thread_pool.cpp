@@ -0,0 +1,70 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threadsNum)
+    : stopping(false) {
+
+    if (threadsNum == 0) {
+        threadsNum = defaultSize();
+    }
+
+    // destructor is not called if the constructor throws, so the workers
+    // started before a thread failed to start are stopped here
+    try {
+        workers.reserve(threadsNum);
+        for (size_t thread = 0; thread < threadsNum; ++thread) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+    catch (...) {
+        stopWorkers();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+void ThreadPool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksAvailable.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+size_t ThreadPool::defaultSize() {
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            tasksAvailable.wait(lock, [this]() {
+                return stopping || !tasks.empty();
+            });
+
+            // queue is drained before stopping, so no future is left broken
+            if (tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+#include "freetype_interface.h"
+
+// the way symbols were matched before the lookup table was introduced
+static code_point linearVocabularyScan(obj_brightness targetBrightness) {
+    const brihgtness_map& vocab = getBrightnessVocabulary();
+    obj_brightness leastBrDiff = MAX_GRAY_LEVELS;
+    code_point bestMatch = vocab.begin()->first;
+
+    for (const symbol_brightness_pair& entry : vocab) {
+        obj_brightness brDiff = abs(static_cast<int>(targetBrightness)
+                                    - entry.second);
+        if (brDiff < leastBrDiff) {
+            leastBrDiff = brDiff;
+            bestMatch = entry.first;
+        }
+    }
+
+    return bestMatch;
+}
+
+template<typename Matcher>
+static double nanosecondsPerFrame(  const std::vector<obj_brightness>& frames,
+                                    Matcher matcher, uint64_t& checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (obj_brightness frameBrightness : frames) {
+        checksum += matcher(frameBrightness);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / frames.size();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <path_to_font> [fontsize] [frames]"
+                  << std::endl;
+        return 1;
+    }
+
+    uint_fast16_t fontSize = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 6;
+    size_t framesTotal = argc > 3 ? std::strtoull(argv[3], NULL, 10) : 10000000;
+
+    try {
+        setupFont(argv[1], fontSize, false);
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> brightness(0, MAX_GRAY_LEVELS);
+    std::vector<obj_brightness> frames(framesTotal);
+    for (obj_brightness& frame : frames) {
+        frame = brightness(generator);
+    }
+
+    for (size_t level = 0; level <= MAX_GRAY_LEVELS; ++level) {
+        if (linearVocabularyScan(level) != symbolWithBrightnessClosestTo(level)) {
+            std::cerr << "Lookup table mismatch at brightness " << level
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t checksum = 0;
+    double scanNs   = nanosecondsPerFrame(frames, linearVocabularyScan, checksum);
+    double lookupNs = nanosecondsPerFrame(frames, symbolWithBrightnessClosestTo,
+                                          checksum);
+
+    std::cout << "frames:        " << framesTotal << '\n'
+              << "vocabulary:    " << getBrightnessVocabulary().size()
+                                   << " symbols\n"
+              << "linear scan:   " << scanNs   << " ns/frame\n"
+              << "lookup table:  " << lookupNs << " ns/frame\n"
+              << "speedup:       " << scanNs / lookupNs << "x\n"
+              << "(checksum "      << checksum << ")" << std::endl;
+
+    return 0;
+}
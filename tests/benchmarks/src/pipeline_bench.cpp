@@ -0,0 +1,351 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+extern "C" {
+    #include <getopt.h>
+    #include <unistd.h>
+    #include "SDL.h"
+    #include "SDL_image.h"
+}
+
+#include "freetype_interface.h"
+#include "error_diffusion.h"
+#include "frame_kernels.h"
+#include "frame_matcher.h"
+#include "image_processor.h"
+#include "netpbm_reader.h"
+#include "output_writer.h"
+#include "thread_pool.h"
+
+/**
+ * Benchmark settings, every one has a command-line option
+ */
+struct BenchSettings {
+    size_t width        = 4096;
+    size_t height       = 4096;
+    double entropy      = 0.5;  /**< 0 repeats one tile, 1 is pure noise */
+    size_t glyphWidth   = 6;
+    size_t glyphHeight  = 11;
+    size_t repeats      = 5;
+    size_t threads      = 0;
+    std::string workDir = "/tmp";
+    std::string output;         /**< JSON goes to stdout if empty */
+};
+
+/**
+ * Timings of one pipeline stage over all the repeats
+ */
+struct StageResult {
+    std::string         name;
+    std::vector<double> seconds;
+    double              items;      /**< pixels, frames or bytes per run */
+    std::string         unit;
+};
+
+static const char* USAGE =
+    "Usage: pipeline_bench [--width=<pixels>] [--height=<pixels>]\n"
+    "                      [--entropy=<0..1>] [--glyph-size=<w>x<h>]\n"
+    "                      [--repeats=<n>] [--threads=<n>] [--workdir=<dir>]\n"
+    "                      [--output=<json_path>]\n";
+
+static bool parseBenchArguments(int argc, char* argv[], BenchSettings& settings) {
+    static const option options[] = {
+        {"width",       required_argument, NULL, 'w'},
+        {"height",      required_argument, NULL, 'h'},
+        {"entropy",     required_argument, NULL, 'e'},
+        {"glyph-size",  required_argument, NULL, 'g'},
+        {"repeats",     required_argument, NULL, 'r'},
+        {"threads",     required_argument, NULL, 't'},
+        {"workdir",     required_argument, NULL, 'd'},
+        {"output",      required_argument, NULL, 'o'},
+        {0,             0,                 NULL, 0  }
+    };
+
+    int code;
+    while ((code = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (code) {
+            case 'w': settings.width    = std::strtoul(optarg, NULL, 10); break;
+            case 'h': settings.height   = std::strtoul(optarg, NULL, 10); break;
+            case 'e': settings.entropy  = std::strtod(optarg, NULL); break;
+            case 'r': settings.repeats  = std::strtoul(optarg, NULL, 10); break;
+            case 't': settings.threads  = std::strtoul(optarg, NULL, 10); break;
+            case 'd': settings.workDir  = optarg; break;
+            case 'o': settings.output   = optarg; break;
+            case 'g': {
+                char* cross = NULL;
+                settings.glyphWidth  = std::strtoul(optarg, &cross, 10);
+                settings.glyphHeight = *cross == 'x' ? std::strtoul(cross + 1, NULL, 10)
+                                                     : 0;
+            }
+            break;
+            default:
+                return false;
+        }
+    }
+
+    return      settings.width > 0 && settings.height > 0
+            &&  settings.entropy >= 0 && settings.entropy <= 1
+            &&  settings.glyphWidth > 0 && settings.glyphHeight > 0
+            &&  settings.repeats > 0;
+}
+
+// tiled diagonal gradient with noise on top; repeated tiles make repeated
+// frames when there is little noise, as in flat or tiled pictures
+static std::vector<uint8_t> makeImagePixels(const BenchSettings& settings) {
+    static const size_t TILE = 64;
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> noise(-128, 127);
+
+    std::vector<uint8_t> pixels(settings.width * settings.height * 3);
+    uint8_t* pixel = pixels.data();
+    for (size_t row = 0; row < settings.height; ++row) {
+        for (size_t col = 0; col < settings.width; ++col) {
+            int base = ((row % TILE) + (col % TILE)) * 2;
+            for (size_t channel = 0; channel < 3; ++channel) {
+                int value = base + channel * 16
+                            + static_cast<int>(noise(generator) * settings.entropy * 2);
+                *pixel++ = static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+            }
+        }
+    }
+
+    return pixels;
+}
+
+static void writePpm(   const std::string& path, const BenchSettings& settings,
+                        const std::vector<uint8_t>& pixels) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << settings.width << ' ' << settings.height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+    if (!file) {
+        throw std::runtime_error("Unable to write '" + path + "'");
+    }
+}
+
+// printable ASCII cells with more and more dark pixels, no font needed
+static void makeGlyphSet(   const BenchSettings& settings,
+                            std::vector<code_point>& symbols,
+                            pixels_vector& cells) {
+    const size_t cellSize = settings.glyphWidth * settings.glyphHeight;
+    const size_t symbolsCount = LAST_PRINTABLE_ASCII_SYMBOL
+                                - FIRST_PRINTABLE_ASCII_SYMBOL + 1;
+
+    std::mt19937 generator(7);
+    for (size_t glyph = 0; glyph < symbolsCount; ++glyph) {
+        symbols.push_back(FIRST_PRINTABLE_ASCII_SYMBOL + glyph);
+        for (size_t pixel = 0; pixel < cellSize; ++pixel) {
+            bool dark = generator() % symbolsCount < glyph;
+            cells.push_back(dark ? generator() % 64 : MAX_GRAY_LEVELS);
+        }
+    }
+}
+
+static StageResult timeStage(   const std::string& name, double items,
+                                const std::string& unit, size_t repeats,
+                                const std::function<void()>& stage) {
+    StageResult result;
+    result.name  = name;
+    result.items = items;
+    result.unit  = unit;
+
+    for (size_t run = 0; run < repeats; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        stage();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()
+                                                - start;
+        result.seconds.push_back(elapsed.count());
+    }
+
+    return result;
+}
+
+static void matchImage( const FramedBitmap& map, const FrameMatcher& matcher,
+                        const ErrorDiffusion* diffusion, ThreadPool& pool,
+                        std::vector<code_point>& matches) {
+    FrameMatching matching(map, matcher, diffusion, pool.size());
+    matching.start(&pool);
+    matches = matching.takeAll();
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle]
+                             : (values[middle - 1] + values[middle]) / 2;
+}
+
+static void printJson(  std::ostream& out, const BenchSettings& settings,
+                        size_t threads, const std::vector<StageResult>& stages) {
+    out << "{\n"
+        << "  \"image\": { \"width\": " << settings.width
+        << ", \"height\": " << settings.height
+        << ", \"entropy\": " << settings.entropy << " },\n"
+        << "  \"glyphs\": { \"width\": " << settings.glyphWidth
+        << ", \"height\": " << settings.glyphHeight << " },\n"
+        << "  \"threads\": " << threads << ",\n"
+        << "  \"repeats\": " << settings.repeats << ",\n"
+        << "  \"kernels\": \"" << frameKernelsIsa() << "\",\n"
+        << "  \"stages\": [\n";
+
+    for (size_t stage = 0; stage < stages.size(); ++stage) {
+        const StageResult& result = stages[stage];
+        double best = *std::min_element(result.seconds.begin(), result.seconds.end());
+        double middle = median(result.seconds);
+
+        out << "    { \"name\": \"" << result.name << "\""
+            << ", \"min_ms\": " << best * 1e3
+            << ", \"median_ms\": " << middle * 1e3
+            << ", \"" << result.unit << "\": " << result.items
+            << ", \"" << result.unit << "_per_s\": " << result.items / best
+            << " }" << (stage + 1 < stages.size() ? "," : "") << '\n';
+    }
+
+    out << "  ]\n}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchSettings settings;
+    if (!parseBenchArguments(argc, argv, settings)) {
+        std::cerr << USAGE;
+        return 1;
+    }
+
+    const size_t threads = settings.threads > 0 ? settings.threads
+                                                : ThreadPool::defaultSize();
+    std::ostringstream imageName;
+    imageName << settings.workDir << "/pipeline_bench_" << getpid() << ".ppm";
+    const std::string imagePath = imageName.str();
+    const std::string textPath  = settings.workDir + "/pipeline_bench_output.txt";
+
+    std::vector<StageResult> stages;
+    try {
+        SDL_Init(0);
+        IMG_Init(0);
+
+        const double pixelsCount = settings.width * settings.height;
+        writePpm(imagePath, settings, makeImagePixels(settings));
+
+        stages.push_back(timeStage("decode", pixelsCount, "pixels", settings.repeats,
+                            [&]() {
+            SDL_Surface* surface = IMG_Load(imagePath.c_str());
+            if (surface == NULL) {
+                throw std::runtime_error(IMG_GetError());
+            }
+            SDL_FreeSurface(surface);
+        }));
+
+        // decoding is repeated outside of the timed part
+        StageResult grayscale;
+        grayscale.name  = "grayscale";
+        grayscale.items = pixelsCount;
+        grayscale.unit  = "pixels";
+        for (size_t run = 0; run < settings.repeats; ++run) {
+            shared_surface_ptr surface(IMG_Load(imagePath.c_str()), SDL_FreeSurface);
+            auto start = std::chrono::steady_clock::now();
+            FramedBitmap view(surface);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()
+                                                    - start;
+            grayscale.seconds.push_back(elapsed.count());
+        }
+        stages.push_back(grayscale);
+
+        stages.push_back(timeStage("map_netpbm", pixelsCount, "pixels",
+                            settings.repeats, [&]() {
+            mapNetpbmImage(imagePath);
+        }));
+
+        std::vector<code_point> symbols;
+        pixels_vector cells;
+        makeGlyphSet(settings, symbols, cells);
+        GlyphVocabulary vocab;
+        stages.push_back(timeStage("vocabulary", symbols.size(), "glyphs",
+                            settings.repeats, [&]() {
+            vocab = buildGlyphVocabulary(settings.glyphWidth, settings.glyphHeight,
+                                        false, symbols, cells);
+        }));
+
+        FramedBitmap map = mapNetpbmImage(imagePath);
+        map.setFrameSize(vocab.fontWidth, vocab.fontHeight);
+        const double framesCount = map.countFrames();
+
+        stages.push_back(timeStage("partitioning", framesCount, "frames",
+                            settings.repeats, [&]() {
+            std::vector<RowBand> bands = splitIntoRowBands(map.framesInStrip(),
+                                                map.rows / map.frameHeight, threads);
+            BandScheduler scheduler(bands.size(), threads);
+        }));
+
+        ThreadPool pool(threads);
+        std::vector<code_point> matches;
+        const char* modeNames[] = { "mean", "shape", "sad", "ssd", "braille" };
+        const MatchingMode modes[] = {  MEAN_BRIGHTNESS_MATCHING, SHAPE_MATCHING,
+                                        ABSOLUTE_PIXEL_MATCHING,
+                                        SQUARED_PIXEL_MATCHING, BRAILLE_MATCHING };
+        for (size_t mode = 0; mode < 5; ++mode) {
+            std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(vocab,
+                                                                modes[mode], 3);
+            stages.push_back(timeStage(std::string("matching_") + modeNames[mode],
+                                framesCount, "frames", settings.repeats, [&]() {
+                matchImage(map, *matcher, NULL, pool, matches);
+            }));
+        }
+
+        // dithered strips wait for the ones above, so this shows how much of
+        // the parallelism the wavefront keeps
+        ErrorDiffusion diffusion(vocab, FLOYD_STEINBERG_DITHERING);
+        std::unique_ptr<FrameMatcher> meanMatcher = createFrameMatcher(vocab,
+                                                    MEAN_BRIGHTNESS_MATCHING, 3);
+        stages.push_back(timeStage("matching_mean_dithered", framesCount, "frames",
+                            settings.repeats, [&]() {
+            matchImage(map, *meanMatcher, &diffusion, pool, matches);
+        }));
+
+        stages.push_back(timeStage("integral_image", pixelsCount, "pixels",
+                            settings.repeats, [&]() {
+            map.buildIntegralImage();
+        }));
+
+        stages.push_back(timeStage("matching_mean_integral", framesCount, "frames",
+                            settings.repeats, [&]() {
+            matchImage(map, *meanMatcher, NULL, pool, matches);
+        }));
+
+        const size_t framesInStrip = map.framesInStrip();
+        const double outputBytes = matches.size() + matches.size() / framesInStrip;
+        stages.push_back(timeStage("output", outputBytes, "bytes", settings.repeats,
+                            [&]() {
+            TextWriter outfile(textPath);
+            outfile.writeLines(matches.data(), matches.size(), framesInStrip);
+            outfile.flush();
+        }));
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        std::remove(imagePath.c_str());
+        return 1;
+    }
+
+    std::remove(imagePath.c_str());
+    std::remove(textPath.c_str());
+
+    if (settings.output.empty()) {
+        printJson(std::cout, settings, threads, stages);
+    } else {
+        std::ofstream json(settings.output);
+        printJson(json, settings, threads, stages);
+        std::cout << "Results written to '" << settings.output << "'" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+#include "freetype_interface.h"
+#include "frame_kernels.h"
+#include "frame_matcher.h"
+#include "shape_matcher.h"
+#include "pixel_matcher.h"
+
+// diagonal stripes over noise, so that frames have both flat areas and edges
+static SDL_Surface* makeStripesSurface(int width, int height) {
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32,
+                                                0x00FF0000, 0x0000FF00,
+                                                0x000000FF, 0);
+    if (surface == NULL) {
+        return NULL;
+    }
+
+    std::mt19937 generator(42);
+    for (int row = 0; row < height; ++row) {
+        uint32_t* pixelRow = reinterpret_cast<uint32_t*>(
+                    static_cast<uint8_t*>(surface->pixels) + row * surface->pitch);
+        for (int col = 0; col < width; ++col) {
+            uint32_t gray = ((row + col) / 24) % 2 ? 0xE0 : 0x20;
+            gray += generator() % 0x10;
+            pixelRow[col] = gray << 16 | gray << 8 | gray;
+        }
+    }
+
+    return surface;
+}
+
+static double nanosecondsPerFrame(  const FramedBitmap& map,
+                                    const FrameMatcher& matcher,
+                                    std::vector<code_point>& matches) {
+    const size_t framesInStrip = map.framesInStrip();
+    const size_t strips = map.rows / map.frameHeight;
+    matches.resize(framesInStrip * strips);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t strip = 0; strip < strips; ++strip) {
+        matcher.matchStrip( map, strip, 0, framesInStrip,
+                            matches.data() + strip * framesInStrip);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / matches.size();
+}
+
+static size_t countDifferences( const std::vector<code_point>& first,
+                                const std::vector<code_point>& second) {
+    size_t differences = 0;
+    for (size_t frame = 0; frame < first.size(); ++frame) {
+        differences += first[frame] != second[frame];
+    }
+
+    return differences;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <path_to_font> [fontsize] [side]"
+                  << std::endl;
+        return 1;
+    }
+
+    uint_fast16_t fontSize = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 6;
+    int side = argc > 3 ? std::atoi(argv[3]) : 4096;
+
+    try {
+        setupFont(argv[1], fontSize, false);
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    SDL_Surface* surface = makeStripesSurface(side, side);
+    if (surface == NULL) {
+        std::cerr << "Failed to create the test surface" << std::endl;
+        return 1;
+    }
+    FramedBitmap scanMap(surface);
+    SDL_FreeSurface(surface);
+
+    FramedBitmap integralMap(scanMap);
+    scanMap.setFrameSize(getFontWidth(), getFontHeight());
+    integralMap.setFrameSize(getFontWidth(), getFontHeight());
+    integralMap.buildIntegralImage();
+
+    std::vector<code_point> meanMatches;
+    std::vector<code_point> shapeMatches;
+    MeanBrightnessMatcher meanMatcher(getGlyphVocabulary());
+
+    std::cout << "image:         " << side << "x" << side << ", "
+              << getFontWidth() << "x" << getFontHeight() << " frames\n"
+              << "mean (scan):   "
+              << nanosecondsPerFrame(scanMap, meanMatcher, meanMatches)
+              << " ns/frame\n"
+              << "mean (integr): "
+              << nanosecondsPerFrame(integralMap, meanMatcher, meanMatches)
+              << " ns/frame\n";
+
+    for (size_t grid = 2; grid <= MAX_SHAPE_GRID; ++grid) {
+        ShapeMatcher shapeMatcher(getGlyphVocabulary(), grid);
+
+        double scanNs = nanosecondsPerFrame(scanMap, shapeMatcher, shapeMatches);
+        std::vector<code_point> scanMatches(shapeMatches);
+        double integralNs = nanosecondsPerFrame(integralMap, shapeMatcher,
+                                                shapeMatches);
+        if (scanMatches != shapeMatches) {
+            std::cerr << "Engines disagree for " << grid << "x" << grid
+                      << " shape grid" << std::endl;
+            return 1;
+        }
+
+        std::cout << "shape " << grid << "x" << grid << " (scan):   "
+                  << scanNs << " ns/frame\n"
+                  << "shape " << grid << "x" << grid << " (integr): "
+                  << integralNs << " ns/frame, "
+                  << countDifferences(meanMatches, shapeMatches)
+                  << " of " << shapeMatches.size()
+                  << " frames differ from mean\n";
+    }
+
+    const char* metricNames[] = { "sad", "ssd" };
+    const PixelMetric metrics[] = { SUM_OF_ABSOLUTE_DIFFERENCES,
+                                    SUM_OF_SQUARED_DIFFERENCES };
+    for (size_t metric = 0; metric < 2; ++metric) {
+        PixelMatcher pixelMatcher(getGlyphVocabulary(), metrics[metric]);
+        std::vector<code_point> pixelMatches;
+
+        std::cout << metricNames[metric] << " (scan):     "
+                  << nanosecondsPerFrame(scanMap, pixelMatcher, pixelMatches)
+                  << " ns/frame, "
+                  << countDifferences(meanMatches, pixelMatches)
+                  << " of " << pixelMatches.size()
+                  << " frames differ from mean\n";
+    }
+
+    std::cout << "kernels:       " << frameKernelsIsa() << std::endl;
+    return 0;
+}
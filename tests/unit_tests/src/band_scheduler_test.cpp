@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "band_scheduler.h"
+
+static bool checkBandsCoverImage(size_t framesInStrip, size_t stripsTotal,
+                                size_t workersNum) {
+    std::vector<RowBand> bands = splitIntoRowBands( framesInStrip, stripsTotal,
+                                                    workersNum);
+    size_t nextFrame = 0;
+    for (const RowBand& band : bands) {
+        if (    band.firstFrame != nextFrame
+            ||  band.framesCount == 0
+            ||  band.framesCount % framesInStrip != 0) {
+            std::cerr << "Bands do not split the frame grid into whole strips"
+                      << std::endl;
+            return false;
+        }
+
+        nextFrame += band.framesCount;
+    }
+
+    if (nextFrame != framesInStrip * stripsTotal) {
+        std::cerr << "Bands do not cover all the frames" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// images too small for the minimum band size still keep every worker busy,
+// as far as their strips allow
+static bool checkSmallImageSpread(  size_t framesInStrip, size_t stripsTotal,
+                                    size_t workersNum) {
+    size_t bandsTotal = splitIntoRowBands(framesInStrip, stripsTotal, workersNum).size();
+    if (bandsTotal < std::min(stripsTotal, workersNum)) {
+        std::cerr   << stripsTotal << " strips of " << framesInStrip << " frames are "
+                    << "split into " << bandsTotal << " bands for " << workersNum
+                    << " workers" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// the first worker is slowed down, so the others have to steal from it
+static bool checkEveryBandClaimedOnce(size_t bandsTotal, size_t workersNum) {
+    BandScheduler scheduler(bandsTotal, workersNum);
+    std::vector< std::atomic<int> > claims(bandsTotal);
+    for (std::atomic<int>& claim : claims) {
+        claim = 0;
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < workersNum; ++worker) {
+        workers.emplace_back([&, worker]() {
+            size_t band;
+            while (scheduler.nextBand(worker, band)) {
+                ++claims.at(band);
+                if (worker == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t band = 0; band < bandsTotal; ++band) {
+        if (claims[band] != 1) {
+            std::cerr << "Band #" << band << " was claimed " << claims[band]
+                      << " times" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    const size_t gridSizes[][3] = { {1, 1, 1}, {7, 3, 64}, {1000, 1000, 4},
+                                    {100, 999, 64}, {4096, 17, 8} };
+    for (const size_t* grid : gridSizes) {
+        if (!checkBandsCoverImage(grid[0], grid[1], grid[2])) {
+            return 1;
+        }
+    }
+
+    const size_t smallGrids[][3] = {    {40, 12, 4}, {40, 3, 8}, {7, 5, 3},
+                                        {100, 1, 16}, {500, 64, 64} };
+    for (const size_t* grid : smallGrids) {
+        if (    !checkBandsCoverImage(grid[0], grid[1], grid[2])
+            ||  !checkSmallImageSpread(grid[0], grid[1], grid[2])) {
+            return 1;
+        }
+    }
+
+    // workers outnumber bands, most of them only steal or find nothing
+    const size_t schedules[][2] = { {0, 4}, {1, 4}, {3, 8}, {5, 8}, {2, 32},
+                                    {1000, 1}, {10000, 7} };
+    for (const size_t* schedule : schedules) {
+        if (!checkEveryBandClaimedOnce(schedule[0], schedule[1])) {
+            return 1;
+        }
+    }
+
+    std::cout << "band scheduler test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "batch_converter.h"
+
+static bool refused(const std::vector<std::string>& images, const std::string& outdir) {
+    try {
+        batchOutfilePaths(images, outdir);
+    }
+    catch (const std::runtime_error&) {
+        return true;
+    }
+
+    std::cerr << "Images sharing an output file were accepted" << std::endl;
+    return false;
+}
+
+int main() {
+    const std::vector<std::string> images = { "a/cat.png", "b/cat.png", "dog.JPG" };
+
+    std::vector<std::string> beside = batchOutfilePaths(images, "");
+    if (beside != std::vector<std::string>({ "a/cat.txt", "b/cat.txt", "dog.txt" })) {
+        std::cerr << "Wrong output paths beside the images" << std::endl;
+        return 1;
+    }
+
+    // the same names from different directories meet in one output directory
+    if (    !refused(images, "out")
+        ||  !refused({ "cat.png", "cat.jpg" }, "")
+        ||  !refused({ "a/cat.png", "b/x.png", "a/cat.png" }, "")) {
+        return 1;
+    }
+
+    std::vector<std::string> gathered = batchOutfilePaths({ "a/cat.png", "b/dog.png" },
+                                                          "out");
+    if (gathered != std::vector<std::string>({ "out/cat.txt", "out/dog.txt" })) {
+        std::cerr << "Wrong output paths in the output directory" << std::endl;
+        return 1;
+    }
+
+    std::cout << "batch converter test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "braille_matcher.h"
+
+static const size_t FRAME_WIDTH  = 5;
+static const size_t FRAME_HEIGHT = 9;
+static const size_t FRAMES_IN_STRIP = 37;
+static const size_t STRIPS = 3;
+
+// dot numbers of the Unicode Braille patterns, row by row
+static const unsigned DOT_NUMBERS[4][2] = { {1, 4}, {2, 5}, {3, 6}, {7, 8} };
+
+static GlyphVocabulary makeVocabulary(size_t width, size_t height, bool invert) {
+    GlyphVocabulary vocab;
+    vocab.fontWidth  = width;
+    vocab.fontHeight = height;
+    vocab.invert     = invert;
+    return vocab;
+}
+
+// pattern with a dot for every sub-cell on the ink side of the middle gray,
+// found by going through the frame pixels
+static code_point expectedPattern(  const pixels_vector& pixels, size_t stride,
+                                    size_t strip, size_t frame, bool invert) {
+    unsigned pattern = 0;
+    for (size_t dotRow = 0; dotRow < 4; ++dotRow) {
+        for (size_t dotCol = 0; dotCol < 2; ++dotCol) {
+            size_t top    = strip * FRAME_HEIGHT + FRAME_HEIGHT * dotRow / 4;
+            size_t bottom = strip * FRAME_HEIGHT + FRAME_HEIGHT * (dotRow + 1) / 4;
+            size_t left   = frame * FRAME_WIDTH + FRAME_WIDTH * dotCol / 2;
+            size_t right  = frame * FRAME_WIDTH + FRAME_WIDTH * (dotCol + 1) / 2;
+
+            double sum = 0;
+            for (size_t row = top; row < bottom; ++row) {
+                for (size_t col = left; col < right; ++col) {
+                    sum += pixels[row * stride + col];
+                }
+            }
+
+            bool dark = sum / ((bottom - top) * (right - left)) < 128;
+            if (dark != invert) {
+                pattern |= 1 << (DOT_NUMBERS[dotRow][dotCol] - 1);
+            }
+        }
+    }
+
+    return BRAILLE_PATTERNS_START + pattern;
+}
+
+static bool checkPatterns(FramedBitmap& map, const pixels_vector& pixels,
+                            size_t stride, bool invert) {
+    BrailleMatcher matcher(makeVocabulary(FRAME_WIDTH, FRAME_HEIGHT, invert));
+    std::vector<code_point> matches(FRAMES_IN_STRIP);
+
+    for (size_t strip = 0; strip < STRIPS; ++strip) {
+        // a strip part starting in the middle checks the frame offsets
+        const size_t firstFrame = strip == 1 ? 3 : 0;
+        matcher.matchStrip( map, strip, firstFrame, FRAMES_IN_STRIP - firstFrame,
+                            matches.data());
+
+        for (size_t frame = firstFrame; frame < FRAMES_IN_STRIP; ++frame) {
+            if (matches[frame - firstFrame]
+                    != expectedPattern(pixels, stride, strip, frame, invert)) {
+                std::cerr << "Wrong pattern of frame #" << frame << " in strip #"
+                          << strip << (invert ? ", inverted" : "")
+                          << (map.hasIntegralImage() ? ", integral image" : "")
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    const size_t columns = FRAME_WIDTH * FRAMES_IN_STRIP;
+    const size_t stride  = columns + 11;
+    const size_t rows    = FRAME_HEIGHT * STRIPS;
+
+    // pixels close to the middle gray, so that both dot states are common
+    std::mt19937 generator(stride);
+    pixels_vector pixels(stride * rows);
+    for (obj_brightness& pixel : pixels) {
+        pixel = 64 + generator() % 128;
+    }
+
+    FramedBitmap map(pixels.data(), rows, columns, stride, shared_owner_ptr());
+    map.setFrameSize(FRAME_WIDTH, FRAME_HEIGHT);
+
+    for (bool invert : { false, true }) {
+        if (!checkPatterns(map, pixels, stride, invert)) {
+            return 1;
+        }
+    }
+
+    map.buildIntegralImage();
+    if (!checkPatterns(map, pixels, stride, false)) {
+        return 1;
+    }
+
+    try {
+        BrailleMatcher tooSmall(makeVocabulary(FRAME_WIDTH, 3, false));
+        std::cerr << "Cells without room for every dot accepted" << std::endl;
+        return 1;
+    }
+    catch (const std::runtime_error&) {}
+
+    std::cout << "braille matcher test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "charset.h"
+
+static bool throwsOn(const std::string& description) {
+    try {
+        parseCharset(description);
+    }
+    catch (const std::runtime_error&) {
+        return true;
+    }
+
+    return false;
+}
+
+static bool checkParsing() {
+    std::vector<code_point> ascii = parseCharset("ascii");
+    if (ascii != printableAsciiCharset() || ascii.size() != 95) {
+        std::cerr << "Wrong ASCII symbol set" << std::endl;
+        return false;
+    }
+
+    // repeated symbols stay where they first appeared
+    std::vector<code_point> mixed = parseCharset("U+2588,blocks,U+41-U+43,u+42");
+    if (    mixed.size() != 32 + 3 || mixed[0] != 0x2588 || mixed[1] != 0x2580
+        ||  mixed[32] != 'A' || mixed[34] != 'C') {
+        std::cerr << "Wrong mixed symbol set" << std::endl;
+        return false;
+    }
+
+    // control symbols in a range are dropped, not refused
+    if (parseCharset("U+7E-U+A1").size() != 3) {
+        std::cerr << "Control symbols taken into the set" << std::endl;
+        return false;
+    }
+
+    if (    !throwsOn("") || !throwsOn("latin") || !throwsOn("U+ZZ")
+        ||  !throwsOn("U+0A") || !throwsOn("U+D800") || !throwsOn("U+42-U+41")
+        ||  !throwsOn("U+100000041") || !throwsOn("U+110000") || !throwsOn("U+ 41")
+        ||  !throwsOn("U+-41") || !throwsOn("U++41")) {
+        std::cerr << "Bad symbol set accepted" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool checkUtf8(const std::string& dir) {
+    const std::vector<code_point> symbols = { 'a', 0xE9, 0x2588, 0x1F600, 'z' };
+    std::string text;
+    appendUtf8(symbols.data(), symbols.size(), text);
+    if (text != "a\xC3\xA9\xE2\x96\x88\xF0\x9F\x98\x80z") {
+        std::cerr << "Wrong UTF-8 encoding" << std::endl;
+        return false;
+    }
+
+    const std::string path = dir + "/charset_test.txt";
+    std::ofstream(path) << "\xEF\xBB\xBF" << text << "\na" << text;
+    if (readCharsetFile(path) != symbols) {
+        std::cerr << "Symbol set file read wrong" << std::endl;
+        return false;
+    }
+
+    // truncated symbol, overlong forms of '/', U+7F, U+20AC and U+FFFF, and
+    // a code point past U+10FFFF
+    const char* invalid[] = {   "ab\xE2\x96", "\xC0\xAF", "\xC1\xBF",
+                                "\xE0\x82\xAC", "\xF0\x8F\xBF\xBF",
+                                "\xF4\x90\x80\x80" };
+    for (const char* bytes : invalid) {
+        std::ofstream(path) << bytes;
+        try {
+            readCharsetFile(path);
+            std::cerr << "Invalid UTF-8 accepted" << std::endl;
+            return false;
+        }
+        catch (const std::runtime_error&) {}
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (!checkParsing() || !checkUtf8(argc > 1 ? argv[1] : ".")) {
+        return 1;
+    }
+
+    std::cout << "charset test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+}
+
+#include "conversion_server.h"
+#include "test_vocabulary.h"
+
+static const size_t FONT_WIDTH  = 2;
+static const size_t FONT_HEIGHT = 3;
+
+static bool expectParseError(const std::string& line) {
+    try {
+        parseConversionRequest(line);
+    }
+    catch (const std::runtime_error&) {
+        return true;
+    }
+
+    std::cerr << "Request '" << line << "' was accepted" << std::endl;
+    return false;
+}
+
+static bool checkParsing() {
+    ConversionRequest pixels = parseConversionRequest(
+                                    "pixels=4x3 format=rgb24 fontsize=9 match=ssd");
+    if (    pixels.width != 4 || pixels.height != 3 || pixels.format != RGB24_PIXELS
+        ||  pixels.fontSize != 9 || !pixels.overrideMatching
+        ||  pixels.matching != SQUARED_PIXEL_MATCHING || pixels.payloadBytes() != 36
+        ||  pixels.keepAlive) {
+        std::cerr << "Pixels request parsed wrong" << std::endl;
+        return false;
+    }
+
+    ConversionRequest image = parseConversionRequest(
+                                    "font=a.ttf keep-alive=1 image=my dir/a b.png");
+    if (    image.imagePath != "my dir/a b.png" || image.fontPath != "a.ttf"
+        ||  !image.keepAlive
+        ||  image.payloadBytes() != 0 || image.overrideMatching) {
+        std::cerr << "Image request parsed wrong" << std::endl;
+        return false;
+    }
+
+    if (    !parseConversionRequest("stats").stats
+        ||  parseConversionRequest("encoded=100").payloadBytes() != 100) {
+        std::cerr << "Stats or encoded request parsed wrong" << std::endl;
+        return false;
+    }
+
+    return  expectParseError("")
+        &&  expectParseError("pixels=4x3 encoded=10")
+        &&  expectParseError("pixels=4by3")
+        &&  expectParseError("pixels=4x-3")
+        &&  expectParseError("pixels=100000x100000 format=rgb888")
+        &&  expectParseError("pixels=8192x8192 format=rgb888")
+        &&  expectParseError("encoded=1073741824")
+        &&  expectParseError("encoded=99999999999999999999999")
+        &&  expectParseError("pixels=4x3 fontsize=1000")
+        &&  expectParseError("pixels=4x3 keep-alive=yes")
+        &&  expectParseError("pixels=4x3 format=yuv")
+        &&  expectParseError("pixels=4x3 match=best")
+        &&  expectParseError("pixels=4x3 colour=red")
+        &&  expectParseError("image");
+}
+
+static bool checkLatencyWindow() {
+    LatencyWindow window(100);
+    if (window.percentile(50) != 0) {
+        std::cerr << "Empty window has latencies" << std::endl;
+        return false;
+    }
+
+    // the first samples are pushed out of the window by the later ones
+    for (uint64_t sample = 1; sample <= 150; ++sample) {
+        window.record(sample > 50 ? sample - 50 : 1000000);
+    }
+
+    if (    window.percentile(50) != 50 || window.percentile(99) != 99
+        ||  window.percentile(100) != 100 || window.percentile(0) != 1) {
+        std::cerr << "Wrong latency percentiles" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static int connectTo(const std::string& socketPath) {
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+    if (connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(connection);
+        throw std::runtime_error("Unable to connect to the server");
+    }
+
+    return connection;
+}
+
+static std::string exchange(const std::string& socketPath, const std::string& request) {
+    int connection = connectTo(socketPath);
+    send(connection, request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string answer;
+    char buffer[256];
+    ssize_t received;
+    while ((received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+        answer.append(buffer, received);
+    }
+    close(connection);
+
+    return answer;
+}
+
+// answer of a kept alive connection is read up to its end only
+static std::string readAnswer(int connection) {
+    std::string answer;
+    char byte;
+    while (answer.empty() || answer.back() != '\n') {
+        if (recv(connection, &byte, 1, 0) != 1) {
+            return answer;
+        }
+        answer += byte;
+    }
+
+    if (answer.compare(0, 3, "OK ") == 0) {
+        size_t textBytes = std::stoull(answer.substr(3));
+        std::vector<char> text(textBytes);
+        size_t done = 0;
+        ssize_t received;
+        while (done < textBytes
+                && (received = recv(connection, text.data() + done,
+                                    textBytes - done, 0)) > 0) {
+            done += received;
+        }
+        answer.append(text.data(), done);
+    }
+
+    return answer;
+}
+
+static bool checkKeepAlive(const std::string& socketPath, const std::string& request) {
+    const std::string keptRequest = "keep-alive=1 " + request;
+    const std::string answer = "OK 3\n# \n";
+
+    // requests sent at once are answered in order, the last one closes
+    if (exchange(socketPath, keptRequest + keptRequest + request) != answer + answer + answer) {
+        std::cerr << "Requests sent at once were answered wrong" << std::endl;
+        return false;
+    }
+
+    // the connection waits for the next request in the accept loop
+    int connection = connectTo(socketPath);
+    bool ok = true;
+    for (size_t round = 0; round < 3 && ok; ++round) {
+        send(connection, keptRequest.data(), keptRequest.size(), MSG_NOSIGNAL);
+        ok = readAnswer(connection) == answer;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    close(connection);
+    if (!ok) {
+        std::cerr << "Kept alive connection was answered wrong" << std::endl;
+    }
+
+    return ok;
+}
+
+static bool checkServer(const std::string& socketPath) {
+    ServerOptions options;
+    options.socketPath = socketPath;
+    options.workers    = 2;
+    // the added converter stays, converters of other fonts come and go
+    options.maxConverters = 1;
+
+    ConversionServer server(options);
+    server.addConverter(options.defaults,
+                        std::unique_ptr<Converter>(new Converter(
+                            flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "),
+                            options.defaults)));
+    std::thread serverThread([&server]() { server.run(); });
+
+    // two frames in a row, black and white, the last pixel row is ignored
+    std::string request = "pixels=4x4 format=gray8\n";
+    for (size_t row = 0; row < 4; ++row) {
+        request += std::string(2, '\0') + std::string(2, '\xff');
+    }
+
+    bool ok = true;
+    for (size_t round = 0; round < 3 && ok; ++round) {
+        std::string answer = exchange(socketPath, request);
+        if (answer != "OK 3\n# \n") {
+            std::cerr << "Wrong conversion answer '" << answer << "'" << std::endl;
+            ok = false;
+        }
+    }
+
+    std::string error = exchange(socketPath, "pixels=4x4 format=cmyk\n");
+    if (error.compare(0, 6, "ERROR ") != 0) {
+        std::cerr << "Wrong error answer '" << error << "'" << std::endl;
+        ok = false;
+    }
+
+    ok = ok && checkKeepAlive(socketPath, request);
+
+    // failed font loads are not kept and do not push out the added converter
+    std::string missingFontRequest = "font=/nonexistent/font.ttf " + request;
+    for (size_t round = 0; round < 2 && ok; ++round) {
+        std::string missingFont = exchange(socketPath, missingFontRequest);
+        if (missingFont.compare(0, 6, "ERROR ") != 0) {
+            std::cerr << "Missing font was loaded: '" << missingFont << "'" << std::endl;
+            ok = false;
+        }
+    }
+    if (ok && exchange(socketPath, request) != "OK 3\n# \n") {
+        std::cerr << "Added converter was dropped" << std::endl;
+        ok = false;
+    }
+
+    std::string stats = exchange(socketPath, "stats\n");
+    if (stats.find("served 10\nfailed 3\nrejected 0\n") == std::string::npos) {
+        std::cerr << "Wrong stats answer '" << stats << "'" << std::endl;
+        ok = false;
+    }
+
+    server.stop();
+    serverThread.join();
+
+    return ok;
+}
+
+static bool checkAdmission(const std::string& socketPath) {
+    ServerOptions options;
+    options.socketPath = socketPath;
+    options.workers    = 1;
+    options.maxPending = 0;
+
+    ConversionServer server(options);
+    std::thread serverThread([&server]() { server.run(); });
+
+    std::string answer = exchange(socketPath, "stats\n");
+
+    server.stop();
+    serverThread.join();
+
+    if (answer != "BUSY\n" || server.stats().rejected != 1) {
+        std::cerr << "Request was admitted over the limit: '" << answer << "'"
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static void ignoreSignal(int) {}
+
+// the signal handler is installed without SA_RESTART, as the daemon's one is,
+// and only the worker can take the signal; its reads must not fail on it
+static bool checkInterruptedRead(const std::string& socketPath) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = ignoreSignal;
+    sigaction(SIGUSR1, &action, NULL);
+
+    sigset_t usr1;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+
+    ServerOptions options;
+    options.socketPath = socketPath;
+    options.workers    = 1;
+
+    pthread_sigmask(SIG_UNBLOCK, &usr1, NULL);
+    ConversionServer server(options);
+    pthread_sigmask(SIG_BLOCK, &usr1, NULL);
+    server.addConverter(options.defaults,
+                        std::unique_ptr<Converter>(new Converter(
+                            flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "),
+                            options.defaults)));
+    std::thread serverThread([&server]() { server.run(); });
+
+    std::string request = "pixels=4x4 format=gray8\n";
+    for (size_t row = 0; row < 4; ++row) {
+        request += std::string(2, '\0') + std::string(2, '\xff');
+    }
+
+    int connection = connectTo(socketPath);
+    const size_t half = request.size() / 2;
+    send(connection, request.data(), half, MSG_NOSIGNAL);
+    for (size_t signal = 0; signal < 5; ++signal) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        kill(getpid(), SIGUSR1);
+    }
+    send(connection, request.data() + half, request.size() - half, MSG_NOSIGNAL);
+    std::string answer = readAnswer(connection);
+    close(connection);
+
+    server.stop();
+    serverThread.join();
+    pthread_sigmask(SIG_UNBLOCK, &usr1, NULL);
+
+    if (answer != "OK 3\n# \n") {
+        std::cerr << "Interrupted read was answered '" << answer << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// a client sending the request a byte at a time never makes a single read
+// wait for long, the worker still gives up on the request as a whole
+static bool checkTrickle(const std::string& socketPath) {
+    ServerOptions options;
+    options.socketPath              = socketPath;
+    options.workers                 = 1;
+    options.requestTimeoutMillis    = 300;
+
+    ConversionServer server(options);
+    server.addConverter(options.defaults,
+                        std::unique_ptr<Converter>(new Converter(
+                            flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "),
+                            options.defaults)));
+    std::thread serverThread([&server]() { server.run(); });
+
+    std::string request = "pixels=4x4 format=gray8\n";
+    for (size_t row = 0; row < 4; ++row) {
+        request += std::string(2, '\0') + std::string(2, '\xff');
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int connection = connectTo(socketPath);
+    for (size_t sent = 0; sent < request.size(); ++sent) {
+        pollfd answered = { connection, POLLIN, 0 };
+        if (poll(&answered, 1, 50) != 0) {
+            break;
+        }
+        send(connection, request.data() + sent, 1, MSG_NOSIGNAL);
+    }
+    std::string answer = readAnswer(connection);
+    close(connection);
+    std::chrono::steady_clock::duration took = std::chrono::steady_clock::now() - start;
+
+    std::string next = exchange(socketPath, request);
+
+    server.stop();
+    serverThread.join();
+
+    if (answer != "ERROR Request was not received in time\n") {
+        std::cerr << "Trickling client was answered '" << answer << "'" << std::endl;
+        return false;
+    }
+    if (took > std::chrono::seconds(2)) {
+        std::cerr << "Trickling client was cut off late" << std::endl;
+        return false;
+    }
+    if (next != "OK 3\n# \n") {
+        std::cerr << "Request after a trickling client was answered '" << next << "'"
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string socketPath = std::string(argc > 1 ? argv[1] : ".")
+                                + "/conversion_server_test.sock";
+
+    if (!checkParsing() || !checkLatencyWindow()) {
+        return 1;
+    }
+
+    if (    !checkServer(socketPath) || !checkAdmission(socketPath)
+        ||  !checkInterruptedRead(socketPath) || !checkTrickle(socketPath)) {
+        return 1;
+    }
+
+    if (access(socketPath.c_str(), F_OK) == 0) {
+        std::cerr << "Socket file was left behind" << std::endl;
+        return 1;
+    }
+
+    std::cout << "conversion server test passed" << std::endl;
+    return 0;
+}
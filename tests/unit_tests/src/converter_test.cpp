@@ -0,0 +1,224 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "converter.h"
+#include "test_vocabulary.h"
+
+static const size_t FONT_WIDTH  = 2;
+static const size_t FONT_HEIGHT = 3;
+static const size_t FRAME_COLS  = 7;
+static const size_t FRAME_ROWS  = 5;
+
+// image is one pixel wider and two pixels taller than the frames, the rest
+// must be ignored
+static const size_t WIDTH  = FRAME_COLS * FONT_WIDTH + 1;
+static const size_t HEIGHT = FRAME_ROWS * FONT_HEIGHT + 2;
+
+static size_t frameLevel(size_t row, size_t col) {
+    return (row / FONT_HEIGHT + col / FONT_WIDTH) % 3;
+}
+
+static std::string expectedText(const std::string& symbols) {
+    std::string text;
+    for (size_t frameRow = 0; frameRow < FRAME_ROWS; ++frameRow) {
+        for (size_t frameCol = 0; frameCol < FRAME_COLS; ++frameCol) {
+            text += symbols[(frameRow + frameCol) % 3];
+        }
+        text += '\n';
+    }
+
+    return text;
+}
+
+// every format gets rows padded beyond the image width
+static std::vector<uint8_t> makePixels(PixelFormat format, size_t& stride) {
+    const size_t pixelBytes = format == GRAY8_PIXELS ? 1
+                            : format == RGB24_PIXELS ? 3 : 4;
+    stride = (WIDTH + 5) * pixelBytes;
+
+    std::vector<uint8_t> pixels(HEIGHT * stride, 77);
+    for (size_t row = 0; row < HEIGHT; ++row) {
+        for (size_t col = 0; col < WIDTH; ++col) {
+            uint8_t level = FLAT_LEVELS[frameLevel(row, col)];
+            uint8_t* pixel = pixels.data() + row * stride + col * pixelBytes;
+
+            if (format == RGB888_PIXELS) {
+                uint32_t rgb = level << 16 | level << 8 | level;
+                *reinterpret_cast<uint32_t*>(pixel) = rgb;
+            } else {
+                for (size_t byte = 0; byte < pixelBytes; ++byte) {
+                    pixel[byte] = level;
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
+
+static bool checkConverter(const Converter& converter, const std::string& symbols) {
+    const PixelFormat formats[] = { GRAY8_PIXELS, RGB24_PIXELS, RGB888_PIXELS };
+    for (PixelFormat format : formats) {
+        size_t stride;
+        std::vector<uint8_t> pixels = makePixels(format, stride);
+
+        std::string text = converter.convert(pixels.data(), WIDTH, HEIGHT, stride,
+                                            format);
+        if (text != expectedText(symbols)) {
+            std::cerr << "Wrong text of the pixel format #" << format << ":\n"
+                      << text << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// every conversion of checkConverter() is counted, the pixel formats
+// other than GRAY8_PIXELS are turned to gray levels by the converter
+static bool checkConversionStats(size_t threadsNum) {
+    ConverterOptions options;
+    options.threads      = threadsNum;
+    options.engine       = INTEGRAL_IMAGE_ENGINE;
+    options.collectStats = true;
+
+    Converter converter(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "), options);
+    for (size_t round = 0; round < 2; ++round) {
+        if (!checkConverter(converter, "#+ ")) {
+            return false;
+        }
+    }
+
+    const uint64_t conversions = 2 * 3;
+    ConversionStats stats = converter.conversionStats();
+    uint64_t frames = 0;
+    uint64_t bands  = 0;
+    for (const WorkerCounters& worker : stats.workers) {
+        frames += worker.frames;
+        bands  += worker.bands;
+    }
+
+    if (    stats.workers.size() != threadsNum
+        ||  frames != conversions * FRAME_COLS * FRAME_ROWS || bands < conversions
+        ||  stats.bytesWritten != conversions * expectedText("#+ ").size()) {
+        std::cerr << "Wrong worker counters" << std::endl;
+        return false;
+    }
+
+    if (    stats.stages[GRAYSCALE_STAGE].calls         != conversions * 2 / 3
+        ||  stats.stages[INTEGRAL_IMAGE_STAGE].calls    != conversions
+        ||  stats.stages[PARTITIONING_STAGE].calls      != conversions
+        ||  stats.stages[MATCHING_STAGE].calls          != conversions
+        ||  stats.stages[OUTPUT_STAGE].calls            != conversions
+        ||  stats.stages[FONT_SETUP_STAGE].calls        != 0
+        ||  stats.stages[DECODE_STAGE].calls            != 0) {
+        std::cerr << "Wrong number of stage passes" << std::endl;
+        return false;
+    }
+
+    options.collectStats = false;
+    Converter quiet(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "), options);
+    if (!checkConverter(quiet, "#+ ") || quiet.conversionStats().bytesWritten != 0) {
+        std::cerr << "Statistics collected while turned off" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// dithering is never dropped silently
+static bool checkDitheringMatching() {
+    ConverterOptions options;
+    options.threads   = 1;
+    options.dithering = ATKINSON_DITHERING;
+
+    options.matching = SHAPE_MATCHING;
+    try {
+        Converter refused(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "), options);
+        std::cerr << "Dithering accepted with shape matching" << std::endl;
+        return false;
+    }
+    catch (const std::runtime_error&) {}
+
+    options.matching = MEAN_BRIGHTNESS_MATCHING;
+    Converter dithered(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "), options);
+    return true;
+}
+
+int main() {
+    const MatchingMode modes[] = {  MEAN_BRIGHTNESS_MATCHING, SHAPE_MATCHING,
+                                    ABSOLUTE_PIXEL_MATCHING,
+                                    SQUARED_PIXEL_MATCHING };
+    const size_t threads[] = { 1, 3 };
+
+    for (MatchingMode mode : modes) {
+        for (size_t threadsNum : threads) {
+            ConverterOptions options;
+            options.matching          = mode;
+            options.threads           = threadsNum;
+            options.frameCacheEntries = threadsNum > 1 ? 64 : 0;
+            options.engine            = threadsNum > 1 ? INTEGRAL_IMAGE_ENGINE
+                                                       : PIXEL_SCAN_ENGINE;
+
+            Converter converter(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "),
+                                options);
+            if (!checkConverter(converter, "#+ ")) {
+                std::cerr << "Matching mode #" << mode << ", " << threadsNum
+                          << " threads" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    for (size_t threadsNum : threads) {
+        if (!checkConversionStats(threadsNum)) {
+            std::cerr << threadsNum << " threads" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!checkDitheringMatching()) {
+        return 1;
+    }
+
+    // converters with different fonts are used from several threads at once
+    ConverterOptions options;
+    options.threads = 2;
+    options.frameCacheEntries = 16;
+    Converter first(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "), options);
+    Converter second(flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "@o."), options);
+
+    std::vector<char> passed(8, false);
+    std::vector<std::thread> callers;
+    for (size_t caller = 0; caller < passed.size(); ++caller) {
+        callers.emplace_back([&, caller]() {
+            bool ok = true;
+            for (size_t round = 0; round < 20 && ok; ++round) {
+                ok = caller % 2 ? checkConverter(second, "@o.")
+                                : checkConverter(first, "#+ ");
+            }
+            passed[caller] = ok;
+        });
+    }
+    for (std::thread& caller : callers) {
+        caller.join();
+    }
+
+    for (char ok : passed) {
+        if (!ok) {
+            std::cerr << "Concurrent conversion failed" << std::endl;
+            return 1;
+        }
+    }
+
+    if (first.frameCacheStats().hits == 0) {
+        std::cerr << "Repeated frames were not taken from the cache" << std::endl;
+        return 1;
+    }
+
+    std::cout << "converter test passed" << std::endl;
+    return 0;
+}
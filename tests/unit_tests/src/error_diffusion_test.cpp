@@ -0,0 +1,183 @@
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "error_diffusion.h"
+
+static const size_t FRAME_WIDTH  = 3;
+static const size_t FRAME_HEIGHT = 4;
+static const size_t FRAMES_IN_STRIP = 150;
+static const size_t STRIPS = 23;
+static const size_t WORKERS = 4;
+
+// dark, middle and bright symbols; every brightness gets the closest one
+static GlyphVocabulary makeVocabulary() {
+    GlyphVocabulary vocab;
+    vocab.fontWidth  = FRAME_WIDTH;
+    vocab.fontHeight = FRAME_HEIGHT;
+    vocab.invert     = false;
+    vocab.brightness = { {'#', 0}, {'+', 128}, {' ', 255} };
+
+    for (size_t brightness = 0; brightness <= MAX_GRAY_LEVELS; ++brightness) {
+        vocab.brightnessLookup[brightness] = brightness < 64  ? '#'
+                                           : brightness < 192 ? '+' : ' ';
+    }
+
+    return vocab;
+}
+
+// frames matched one after another in the raster order, the same arithmetic
+// as the wavefront without any concurrency
+static std::vector<code_point> rasterDiffusion( const pixels_vector& pixels,
+                                                size_t stride,
+                                                const GlyphVocabulary& vocab,
+                                                DitheringMode mode) {
+    struct Tap { int rows, columns, weight; };
+    const std::vector<Tap> taps = mode == FLOYD_STEINBERG_DITHERING
+        ? std::vector<Tap>{ {0, 1, 7}, {1, -1, 3}, {1, 0, 5}, {1, 1, 1} }
+        : std::vector<Tap>{ {0, 1, 2}, {0, 2, 2}, {1, -1, 2}, {1, 0, 2},
+                            {1, 1, 2}, {2, 0, 2} };
+
+    std::vector<int32_t> errors(FRAMES_IN_STRIP * STRIPS, 0);
+    std::vector<code_point> matches(FRAMES_IN_STRIP * STRIPS);
+    for (size_t strip = 0; strip < STRIPS; ++strip) {
+        for (size_t frame = 0; frame < FRAMES_IN_STRIP; ++frame) {
+            uint32_t sum = 0;
+            for (size_t row = 0; row < FRAME_HEIGHT; ++row) {
+                for (size_t col = 0; col < FRAME_WIDTH; ++col) {
+                    sum += pixels[(strip * FRAME_HEIGHT + row) * stride
+                                    + frame * FRAME_WIDTH + col];
+                }
+            }
+
+            int32_t brightness = static_cast<int32_t>(sum / (FRAME_WIDTH * FRAME_HEIGHT))
+                                * 16 + errors[strip * FRAMES_IN_STRIP + frame];
+            int32_t level = std::max(0, std::min(255, (brightness + 8) / 16));
+            code_point symbol = vocab.brightnessLookup[level];
+            matches[strip * FRAMES_IN_STRIP + frame] = symbol;
+
+            int32_t error = brightness - vocab.brightness.at(symbol) * 16;
+            for (const Tap& tap : taps) {
+                int targetStrip = strip + tap.rows;
+                int targetFrame = static_cast<int>(frame) + tap.columns;
+                if (    targetStrip < static_cast<int>(STRIPS) && targetFrame >= 0
+                    &&  targetFrame < static_cast<int>(FRAMES_IN_STRIP)) {
+                    errors[targetStrip * FRAMES_IN_STRIP + targetFrame] +=
+                                                        error * tap.weight / 16;
+                }
+            }
+        }
+    }
+
+    return matches;
+}
+
+static std::vector<code_point> wavefrontDiffusion(  const FramedBitmap& map,
+                                                    const ErrorDiffusion& diffusion,
+                                                    size_t workersNum) {
+    DiffusionWavefront wavefront(map);
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < workersNum; ++worker) {
+        workers.emplace_back([&, worker]() {
+            diffusion.matchStrips(map, wavefront, worker);
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return wavefront.frameMatches;
+}
+
+static bool checkMatchesRasterOrder(const FramedBitmap& map,
+                                    const pixels_vector& pixels, size_t stride,
+                                    const GlyphVocabulary& vocab,
+                                    DitheringMode mode) {
+    ErrorDiffusion diffusion(vocab, mode);
+    std::vector<code_point> expected = rasterDiffusion(pixels, stride, vocab, mode);
+
+    for (size_t workersNum : { size_t(1), WORKERS }) {
+        if (wavefrontDiffusion(map, diffusion, workersNum) != expected) {
+            std::cerr << "Symbols of " << workersNum << " workers differ from "
+                      << "the raster order ones, mode " << mode << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// flat gray between two symbols is drawn by a mix of both that is about as
+// bright on average
+static bool checkFlatGrayMix(const GlyphVocabulary& vocab) {
+    const obj_brightness gray = 90;
+    const size_t columns = FRAME_WIDTH * FRAMES_IN_STRIP;
+    const size_t rows    = FRAME_HEIGHT * STRIPS;
+    pixels_vector pixels(columns * rows, gray);
+
+    FramedBitmap map(pixels.data(), rows, columns, columns, shared_owner_ptr());
+    map.setFrameSize(FRAME_WIDTH, FRAME_HEIGHT);
+
+    ErrorDiffusion diffusion(vocab, FLOYD_STEINBERG_DITHERING);
+    std::vector<code_point> matches = wavefrontDiffusion(map, diffusion, WORKERS);
+
+    size_t dark = 0;
+    double brightnessSum = 0;
+    for (code_point symbol : matches) {
+        dark += symbol == '#';
+        brightnessSum += vocab.brightness.at(symbol);
+    }
+
+    double average = brightnessSum / matches.size();
+    if (dark == 0 || dark == matches.size() || average < gray - 4 || average > gray + 4) {
+        std::cerr << "Flat gray " << int(gray) << " is drawn with " << dark
+                  << " dark symbols of " << matches.size() << ", average "
+                  << average << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    const GlyphVocabulary vocab = makeVocabulary();
+
+    const size_t columns = FRAME_WIDTH * FRAMES_IN_STRIP;
+    const size_t stride  = columns + 7;
+    const size_t rows    = FRAME_HEIGHT * STRIPS;
+
+    std::mt19937 generator(stride);
+    pixels_vector pixels(stride * rows);
+    for (obj_brightness& pixel : pixels) {
+        pixel = generator() % (MAX_GRAY_LEVELS + 1);
+    }
+
+    FramedBitmap map(pixels.data(), rows, columns, stride, shared_owner_ptr());
+    map.setFrameSize(FRAME_WIDTH, FRAME_HEIGHT);
+
+    for (DitheringMode mode : { FLOYD_STEINBERG_DITHERING, ATKINSON_DITHERING }) {
+        // thread timing varies between runs, so the wavefront is run a few times
+        for (size_t run = 0; run < 5; ++run) {
+            if (!checkMatchesRasterOrder(map, pixels, stride, vocab, mode)) {
+                return 1;
+            }
+        }
+    }
+
+    if (!checkFlatGrayMix(vocab)) {
+        return 1;
+    }
+
+    try {
+        ErrorDiffusion none(vocab, NO_DITHERING);
+        std::cerr << "Error diffusion without a dithering mode accepted" << std::endl;
+        return 1;
+    }
+    catch (const std::runtime_error&) {}
+
+    std::cout << "error diffusion test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "frame_cache.h"
+
+static const size_t FRAME_WIDTH  = 5;
+static const size_t FRAME_HEIGHT = 9;
+
+// symbol depends on every pixel of the frame, so that a wrong cache hit shows
+class ChecksumMatcher : public FrameMatcher {
+public:
+    ChecksumMatcher() : matchedFrames(0) {}
+
+    void matchStrip(const FramedBitmap& map, size_t strip,
+                    size_t firstFrame, size_t framesCount,
+                    code_point* matches) const override {
+        for (size_t frame = 0; frame < framesCount; ++frame) {
+            FrameSlider slider(map, (firstFrame + frame) * map.frameWidth,
+                                strip * map.frameHeight);
+            uint32_t checksum = 0;
+            for (size_t pos = 0; pos < slider.size(); ++pos) {
+                checksum = checksum * 31 + slider.at(pos);
+            }
+
+            matches[frame] = ' ' + checksum % 95;
+        }
+
+        matchedFrames += framesCount;
+    }
+
+    mutable std::atomic<size_t> matchedFrames;
+};
+
+// a few tiles repeat over the whole image, one strip is noise
+static SDL_Surface* makeTiledSurface(int width, int height) {
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32,
+                                                0x00FF0000, 0x0000FF00,
+                                                0x000000FF, 0);
+    if (surface == NULL) {
+        return NULL;
+    }
+
+    std::mt19937 generator(width + height);
+    for (int row = 0; row < height; ++row) {
+        uint32_t* pixelRow = reinterpret_cast<uint32_t*>(
+                    static_cast<uint8_t*>(surface->pixels) + row * surface->pitch);
+        for (int col = 0; col < width; ++col) {
+            uint32_t gray = (col / FRAME_WIDTH % 3) * 60 + (row + col) % 7;
+            if (row / FRAME_HEIGHT == 2) {
+                gray = generator() & 0xFF;
+            }
+            pixelRow[col] = gray << 16 | gray << 8 | gray;
+        }
+    }
+
+    return surface;
+}
+
+static std::vector<code_point> matchAll(const FramedBitmap& map,
+                                        const FrameMatcher& matcher,
+                                        size_t threadsNum) {
+    const size_t framesInStrip = map.framesInStrip();
+    const size_t strips = map.rows / map.frameHeight;
+    std::vector<code_point> matches(framesInStrip * strips);
+
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < threadsNum; ++thread) {
+        threads.emplace_back([&, thread]() {
+            for (size_t strip = thread; strip < strips; strip += threadsNum) {
+                matcher.matchStrip( map, strip, 0, framesInStrip,
+                                    matches.data() + strip * framesInStrip);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return matches;
+}
+
+static bool checkCache( const FramedBitmap& map, const std::vector<code_point>& expected,
+                        size_t entries, size_t threadsNum) {
+    ChecksumMatcher matcher;
+    CachingMatcher cache(matcher, FRAME_WIDTH, FRAME_HEIGHT, entries);
+
+    // the second pass over the same image must be served by the cache
+    for (size_t pass = 0; pass < 2; ++pass) {
+        if (matchAll(map, cache, threadsNum) != expected) {
+            std::cerr << "Cached matches differ with " << entries
+                      << " entries on pass #" << pass << std::endl;
+            return false;
+        }
+    }
+
+    FrameCacheStats stats = cache.stats();
+    if (stats.hits + stats.misses != 2 * expected.size()) {
+        std::cerr << "Cache counters do not add up to the frames count" << std::endl;
+        return false;
+    }
+
+    if (stats.misses != matcher.matchedFrames) {
+        std::cerr << "Cache misses differ from the frames matched" << std::endl;
+        return false;
+    }
+
+    if (entries >= 2 * expected.size() && stats.misses >= expected.size()) {
+        std::cerr << "Repeated frames were matched again with " << entries
+                  << " entries" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// frames of a large font on a small image: the default number of entries
+// is cut to the byte budget, and only the frames seen take pixel storage
+static bool checkMemoryBound() {
+    const size_t frameWidth  = 120;
+    const size_t frameHeight = 200;
+    const size_t framePixels = frameWidth * frameHeight;
+    const size_t distinctFrames = 10;
+
+    FramedBitmap map(3 * frameHeight, 30 * frameWidth);
+    for (size_t row = 0; row < map.rows; ++row) {
+        for (size_t col = 0; col < map.columns; ++col) {
+            (*map.pixels)[row * map.columns + col] = static_cast<obj_brightness>(
+                            (col / frameWidth % distinctFrames) * 20 + row % 2);
+        }
+    }
+    map.setFrameSize(frameWidth, frameHeight);
+
+    ChecksumMatcher matcher;
+    std::vector<code_point> expected = matchAll(map, matcher, 1);
+    CachingMatcher cache(matcher, frameWidth, frameHeight, 16384);
+    if (    matchAll(map, cache, 2) != expected
+        ||  cache.entries() * framePixels > MAX_FRAME_CACHE_BYTES) {
+        std::cerr << "Large frame cache is wrong or over the byte budget" << std::endl;
+        return false;
+    }
+
+    const size_t tableBytes = cache.entries() * (   sizeof(uint64_t) + sizeof(code_point)
+                                                +   sizeof(pixels_vector));
+    if (cache.memoryBytes() > tableBytes + distinctFrames * framePixels) {
+        std::cerr << "Frame cache takes " << cache.memoryBytes() << " bytes for "
+                  << distinctFrames << " distinct frames" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    SDL_Surface* surface = makeTiledSurface(FRAME_WIDTH * 70, FRAME_HEIGHT * 20);
+    if (surface == NULL) {
+        std::cerr << "Unable to create test surface" << std::endl;
+        return 1;
+    }
+
+    FramedBitmap map(surface);
+    SDL_FreeSurface(surface);
+    map.setFrameSize(FRAME_WIDTH, FRAME_HEIGHT);
+
+    ChecksumMatcher matcher;
+    std::vector<code_point> expected = matchAll(map, matcher, 1);
+
+    const size_t entriesCounts[] = { 1, 100, 4096 };
+    for (size_t entries : entriesCounts) {
+        if (    !checkCache(map, expected, entries, 1)
+            ||  !checkCache(map, expected, entries, 4)) {
+            return 1;
+        }
+    }
+
+    if (!checkMemoryBound()) {
+        return 1;
+    }
+
+    std::cout << "frame cache test passed" << std::endl;
+    return 0;
+}
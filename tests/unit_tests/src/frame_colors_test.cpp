@@ -0,0 +1,111 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "frame_colors.h"
+
+static const size_t IMAGE_ROWS    = 53;
+static const size_t IMAGE_COLUMNS = 71;
+
+// average of one frame summed pixel by pixel
+static RgbColor frameAverage(   const std::vector<uint8_t>& rgb, size_t frame,
+                                size_t frameWidth, size_t frameHeight) {
+    const size_t framesInStrip = IMAGE_COLUMNS / frameWidth;
+    const size_t firstRow = frame / framesInStrip * frameHeight;
+    const size_t firstCol = frame % framesInStrip * frameWidth;
+
+    uint32_t sums[3] = { 0, 0, 0 };
+    for (size_t row = firstRow; row < firstRow + frameHeight; ++row) {
+        for (size_t col = firstCol; col < firstCol + frameWidth; ++col) {
+            for (size_t channel = 0; channel < 3; ++channel) {
+                sums[channel] += rgb[(row * IMAGE_COLUMNS + col) * 3 + channel];
+            }
+        }
+    }
+
+    const uint32_t area = frameWidth * frameHeight;
+    RgbColor color;
+    color.red   = (sums[0] + area / 2) / area;
+    color.green = (sums[1] + area / 2) / area;
+    color.blue  = (sums[2] + area / 2) / area;
+    return color;
+}
+
+static bool checkColors(const FrameColors& colors, const std::vector<uint8_t>& rgb,
+                        size_t frameWidth, size_t frameHeight, const char* name) {
+    const size_t framesTotal =      (IMAGE_COLUMNS / frameWidth)
+                                *   (IMAGE_ROWS / frameHeight);
+    if (    colors.framesInStrip() != IMAGE_COLUMNS / frameWidth
+        ||  colors.colors().size() != framesTotal) {
+        std::cerr << name << ": " << colors.colors().size() << " colors of "
+                  << frameWidth << "x" << frameHeight << " frames instead of "
+                  << framesTotal << std::endl;
+        return false;
+    }
+
+    for (size_t frame = 0; frame < framesTotal; ++frame) {
+        RgbColor expected = frameAverage(rgb, frame, frameWidth, frameHeight);
+        const RgbColor& actual = colors.colors()[frame];
+        if (    actual.red != expected.red || actual.green != expected.green
+            ||  actual.blue != expected.blue) {
+            std::cerr << name << ": wrong color of frame " << frame << " of "
+                      << frameWidth << "x" << frameHeight << " frames" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    std::mt19937 generator(IMAGE_COLUMNS);
+    std::vector<uint8_t> rgb(IMAGE_ROWS * IMAGE_COLUMNS * 3);
+    for (uint8_t& channel : rgb) {
+        channel = generator() % 256;
+    }
+
+    std::vector<uint32_t> rgb888(IMAGE_ROWS * IMAGE_COLUMNS);
+    std::vector<uint8_t> grays(IMAGE_ROWS * IMAGE_COLUMNS);
+    std::vector<uint8_t> grayRgb(rgb.size());
+    for (size_t pixel = 0; pixel < rgb888.size(); ++pixel) {
+        rgb888[pixel] =     rgb[pixel * 3] << 16 | rgb[pixel * 3 + 1] << 8
+                        |   rgb[pixel * 3 + 2];
+        grays[pixel] = rgb[pixel * 3 + 1];
+        grayRgb[pixel * 3] = grayRgb[pixel * 3 + 1] = grayRgb[pixel * 3 + 2]
+                           = grays[pixel];
+    }
+
+    // frames that divide the image and frames that leave partial ones out
+    const size_t frameSizes[][2] = { {1, 1}, {4, 7}, {71, 53}, {9, 2}, {13, 17} };
+    for (const size_t* frameSize : frameSizes) {
+        FrameColors colors(frameSize[0], frameSize[1]);
+
+        colors.startImage(IMAGE_COLUMNS, IMAGE_ROWS);
+        for (size_t row = 0; row < IMAGE_ROWS; ++row) {
+            colors.addRgbRow(rgb.data() + row * IMAGE_COLUMNS * 3);
+        }
+        if (!checkColors(colors, rgb, frameSize[0], frameSize[1], "rgb rows")) {
+            return 1;
+        }
+
+        // the previous image is dropped
+        colors.startImage(IMAGE_COLUMNS, IMAGE_ROWS);
+        for (size_t row = 0; row < IMAGE_ROWS; ++row) {
+            colors.addRgb888Row(rgb888.data() + row * IMAGE_COLUMNS);
+        }
+        if (!checkColors(colors, rgb, frameSize[0], frameSize[1], "rgb888 rows")) {
+            return 1;
+        }
+
+        colors.startImage(IMAGE_COLUMNS, IMAGE_ROWS);
+        for (size_t row = 0; row < IMAGE_ROWS; ++row) {
+            colors.addGrayRow(grays.data() + row * IMAGE_COLUMNS);
+        }
+        if (!checkColors(colors, grayRgb, frameSize[0], frameSize[1], "gray rows")) {
+            return 1;
+        }
+    }
+
+    std::cout << "frame colors test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frame_kernels.h"
+
+static uint64_t naiveAreaSum(   const obj_brightness* topLeft, size_t stride,
+                                size_t width, size_t height) {
+    uint64_t acc = 0;
+    for (size_t row = 0; row < height; ++row) {
+        for (size_t col = 0; col < width; ++col) {
+            acc += topLeft[row * stride + col];
+        }
+    }
+
+    return acc;
+}
+
+// frames are placed with an offset from the buffer start, so that unaligned
+// loads and row tails of every length are exercised
+static bool checkFrameSize( const pixels_vector& pixels, size_t stride,
+                            size_t frameWidth, size_t frameHeight) {
+    const size_t offset = 3;
+    const size_t framesCount = (stride - offset) / frameWidth;
+    const obj_brightness* topLeft = pixels.data() + offset;
+    std::vector<uint32_t> sums(framesCount);
+
+    std::vector<uint32_t> leftSums(framesCount);
+    std::vector<uint32_t> rightSums(framesCount);
+    const size_t leftWidth = frameWidth / 2;
+
+    sumStripFrames( topLeft, stride, frameWidth, frameHeight, framesCount,
+                    sums.data());
+    sumStripFrameHalves(topLeft, stride, frameWidth, leftWidth, frameHeight,
+                        framesCount, leftSums.data(), rightSums.data());
+
+    for (size_t frame = 0; frame < framesCount; ++frame) {
+        const obj_brightness* frameStart = topLeft + frame * frameWidth;
+        uint64_t expected = naiveAreaSum(frameStart, stride,
+                                        frameWidth, frameHeight);
+        uint64_t expectedLeft = naiveAreaSum(frameStart, stride,
+                                            leftWidth, frameHeight);
+
+        if (    sums[frame] != expected
+            ||  leftSums[frame] != expectedLeft
+            ||  rightSums[frame] != expected - expectedLeft
+            ||  sumAreaPixels(frameStart, stride, frameWidth, frameHeight)
+                    != expected) {
+            std::cerr << "Sum mismatch for " << frameWidth << "x" << frameHeight
+                      << " frame #" << frame << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool checkColumnSums(const pixels_vector& pixels, size_t stride,
+                            size_t width, size_t height) {
+    const size_t offset = 5;
+    std::vector<uint32_t> columnSums(width);
+
+    sumStripColumns(pixels.data() + offset, stride, width, height,
+                    columnSums.data());
+
+    for (size_t col = 0; col < width; ++col) {
+        if (columnSums[col] != naiveAreaSum(pixels.data() + offset + col, stride,
+                                            1, height)) {
+            std::cerr << "Column sum mismatch for " << width << "x" << height
+                      << " strip at column #" << col << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the largest component difference is the one of glyph padding descriptors
+static bool checkDescriptorDistances(std::mt19937& generator) {
+    const size_t pairsCounts[] = { 1, 2, 5, 8 };
+    const size_t glyphsCounts[] = { 8, 96, 200 };
+
+    for (size_t pairsCount : pairsCounts) {
+        for (size_t glyphsCount : glyphsCounts) {
+            std::vector<int16_t> glyphPairs(2 * pairsCount * glyphsCount);
+            std::vector<int16_t> frameDescriptor(2 * pairsCount);
+            for (int16_t& component : glyphPairs) {
+                component = generator() % 1025;
+            }
+            for (int16_t& component : frameDescriptor) {
+                component = generator() % (MAX_GRAY_LEVELS + 1);
+            }
+
+            std::vector<uint32_t> distances(glyphsCount);
+            descriptorDistances(glyphPairs.data(), pairsCount, glyphsCount,
+                                frameDescriptor.data(), distances.data());
+
+            for (size_t glyph = 0; glyph < glyphsCount; ++glyph) {
+                uint32_t expected = 0;
+                for (size_t comp = 0; comp < 2 * pairsCount; ++comp) {
+                    int32_t diff = glyphPairs[2 * (comp / 2 * glyphsCount + glyph)
+                                                + comp % 2]
+                                    - frameDescriptor[comp];
+                    expected += diff * diff;
+                }
+
+                if (distances[glyph] != expected) {
+                    std::cerr << "Descriptor distance mismatch for "
+                              << pairsCount << " pairs at glyph #" << glyph
+                              << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// exact distances are required up to the bound, beyond it only some larger value
+static bool checkCellDistances(std::mt19937& generator) {
+    const size_t cellSizes[] = { CELL_ALIGNMENT, 3 * CELL_ALIGNMENT, 8 * CELL_ALIGNMENT,
+                                 33 * CELL_ALIGNMENT };
+
+    for (size_t cellBytes : cellSizes) {
+        pixels_vector first(cellBytes);
+        pixels_vector second(cellBytes);
+        for (size_t pixel = 0; pixel < cellBytes; ++pixel) {
+            first[pixel]  = generator() % (MAX_GRAY_LEVELS + 1);
+            second[pixel] = generator() % (MAX_GRAY_LEVELS + 1);
+        }
+        first[0]  = MAX_GRAY_LEVELS;
+        second[0] = 0;
+
+        uint32_t absolute = 0;
+        uint32_t squared  = 0;
+        for (size_t pixel = 0; pixel < cellBytes; ++pixel) {
+            int32_t diff = static_cast<int32_t>(first[pixel]) - second[pixel];
+            absolute += std::abs(diff);
+            squared  += diff * diff;
+        }
+
+        const uint32_t absoluteBounds[] = { UINT32_MAX, absolute, absolute / 2, 0 };
+        for (uint32_t bound : absoluteBounds) {
+            uint32_t distance = cellAbsoluteDifference( first.data(), second.data(),
+                                                        cellBytes, bound);
+            if (bound >= absolute ? distance != absolute : distance <= bound) {
+                std::cerr << "SAD mismatch for " << cellBytes
+                          << " bytes cell with bound " << bound << std::endl;
+                return false;
+            }
+        }
+
+        const uint32_t squaredBounds[] = { UINT32_MAX, squared, squared / 2, 0 };
+        for (uint32_t bound : squaredBounds) {
+            uint32_t distance = cellSquaredDifference(  first.data(), second.data(),
+                                                        cellBytes, bound);
+            if (bound >= squared ? distance != squared : distance <= bound) {
+                std::cerr << "SSD mismatch for " << cellBytes
+                          << " bytes cell with bound " << bound << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// padding byte of the pixels is filled with noise too, it must be ignored
+static bool checkGrayscaleConversion(std::mt19937& generator) {
+    const size_t widths[] = { 1, 7, 16, 31, 32, 33, 35, 36, 37, 100, 1001 };
+
+    for (size_t width : widths) {
+        std::vector<uint32_t> row(width);
+        for (uint32_t& pixel : row) {
+            pixel = generator();
+        }
+        row[0] = 0x00FFFFFF;
+
+        pixels_vector grays(width);
+        rgb888RowToGrayscale(row.data(), width, grays.data());
+
+        for (size_t col = 0; col < width; ++col) {
+            obj_brightness expected = rgbToGrayscale(   (row[col] >> 16) & 0xFF,
+                                                        (row[col] >> 8)  & 0xFF,
+                                                         row[col]        & 0xFF);
+            if (grays[col] != expected) {
+                std::cerr << "Gray level mismatch in " << width
+                          << " pixels wide row at pixel #" << col << std::endl;
+                return false;
+            }
+        }
+
+        if (grays[0] != MAX_GRAY_LEVELS) {
+            std::cerr << "White pixel is not converted to white" << std::endl;
+            return false;
+        }
+
+        // the same colors packed in three bytes give the same gray levels
+        std::vector<uint8_t> packedRow(3 * width);
+        for (size_t col = 0; col < width; ++col) {
+            packedRow[3 * col]     = (row[col] >> 16) & 0xFF;
+            packedRow[3 * col + 1] = (row[col] >> 8)  & 0xFF;
+            packedRow[3 * col + 2] =  row[col]        & 0xFF;
+        }
+
+        pixels_vector packedGrays(width);
+        rgb24RowToGrayscale(packedRow.data(), width, packedGrays.data());
+        if (packedGrays != grays) {
+            std::cerr << "Gray levels of " << width << " packed 24-bit pixels "
+                      << "differ from 32-bit ones" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// counts not divisible by the vector width leave a tail for the scalar code
+static bool checkSumThresholds(std::mt19937& generator) {
+    const size_t counts[] = { 1, 15, 16, 33, 1000 };
+    for (size_t count : counts) {
+        std::vector<uint32_t> sums(count);
+        std::vector<uint8_t> flags(count);
+        for (size_t pos = 0; pos < count; ++pos) {
+            sums[pos]  = generator() % 2000;
+            flags[pos] = generator() & 0x55;
+        }
+
+        const uint32_t bound = 1000;
+        std::vector<uint8_t> expected(flags);
+        for (size_t pos = 0; pos < count; ++pos) {
+            expected[pos] |= sums[pos] < bound ? 0x80 : 0;
+        }
+
+        markSumsBelow(sums.data(), count, bound, 0x80, flags.data());
+        if (flags != expected) {
+            std::cerr << "Threshold flags mismatch for " << count << " sums"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// every supported implementation is checked against the same naive sums
+static bool checkKernels() {
+    const size_t stride = 1021;
+    const size_t rows = 600;
+
+    std::mt19937 generator(stride);
+    pixels_vector pixels(stride * rows);
+    for (obj_brightness& pixel : pixels) {
+        pixel = generator() % (MAX_GRAY_LEVELS + 1);
+    }
+
+    const size_t frameSizes[][2] = { {1, 1}, {6, 11}, {7, 13}, {15, 20},
+                                     {16, 1}, {33, 40}, {64, 600} };
+    for (const size_t* frameSize : frameSizes) {
+        if (!checkFrameSize(pixels, stride, frameSize[0], frameSize[1])) {
+            return false;
+        }
+    }
+
+    // all-white frames taller than the 16-bit column accumulator can hold
+    pixels_vector white(stride * rows, MAX_GRAY_LEVELS);
+    if (!checkFrameSize(white, stride, 9, rows)) {
+        return false;
+    }
+
+    const size_t stripWidths[] = { 1, 15, 32, 33, 1000 };
+    for (size_t width : stripWidths) {
+        if (    !checkColumnSums(pixels, stride, width, 7)
+            ||  !checkColumnSums(white, stride, width, rows)) {
+            return false;
+        }
+    }
+
+    return      checkGrayscaleConversion(generator)
+            &&  checkDescriptorDistances(generator)
+            &&  checkCellDistances(generator)
+            &&  checkSumThresholds(generator);
+}
+
+int main() {
+    const std::string chosenIsa = frameKernelsIsa();
+    const std::vector<std::string> isas = supportedFrameKernelsIsas();
+    if (isas.empty() || isas.front() != chosenIsa || isas.back() != "scalar") {
+        std::cerr << "Supported instruction sets do not start with the chosen one "
+                  << "or do not end with the scalar code" << std::endl;
+        return 1;
+    }
+
+    for (const std::string& isa : isas) {
+        if (!selectFrameKernelsIsa(isa) || frameKernelsIsa() != isa) {
+            std::cerr << "Unable to select " << isa << " kernels" << std::endl;
+            return 1;
+        }
+
+        if (!checkKernels()) {
+            std::cerr << "Instruction set: " << isa << std::endl;
+            return 1;
+        }
+    }
+
+    if (selectFrameKernelsIsa("unknown") || frameKernelsIsa() != isas.back()) {
+        std::cerr << "Unsupported instruction set selected" << std::endl;
+        return 1;
+    }
+    selectFrameKernelsIsa(chosenIsa);
+
+    std::cout << "frame kernels test passed (";
+    for (size_t isa = 0; isa < isas.size(); ++isa) {
+        std::cout << (isa > 0 ? ", " : "") << isas[isa];
+    }
+    std::cout << ")" << std::endl;
+    return 0;
+}
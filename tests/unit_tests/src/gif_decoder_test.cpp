@@ -0,0 +1,259 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gif_decoder.h"
+#include "frame_kernels.h"
+
+static const size_t WIDTH   = 23;
+static const size_t HEIGHT  = 17;
+static const size_t MIN_CODE_SIZE = 2;
+
+static const uint8_t GLOBAL_PALETTE[] = {   0,   0,   0,
+                                          255, 255, 255,
+                                          128, 128, 128,
+                                          200,  40,  90 };
+static const uint8_t LOCAL_PALETTE[]  = {  10,  20,  30,
+                                           40,  50,  60,
+                                           70,  80,  90,
+                                          100, 110, 120 };
+static const uint8_t BACKGROUND_INDEX = 1;
+static const uint8_t TRANSPARENT_INDEX = 0;
+
+// second picture covers a part of the canvas and sticks out of it
+static const size_t PATCH_LEFT   = 15;
+static const size_t PATCH_TOP    = 12;
+static const size_t PATCH_WIDTH  = 10;
+static const size_t PATCH_HEIGHT = 7;
+
+static uint8_t firstIndex(size_t row, size_t col) {
+    return (col / 5 + row) % 4;
+}
+
+static uint8_t patchIndex(size_t row, size_t col) {
+    return (row * 3 + col) % 4;
+}
+
+class BitWriter {
+public:
+    void write(size_t code, size_t size) {
+        for (size_t bit = 0; bit < size; ++bit, ++bitsTotal) {
+            if (bitsTotal % 8 == 0) {
+                bytes.push_back(0);
+            }
+            bytes.back() |= ((code >> bit) & 1) << (bitsTotal % 8);
+        }
+    }
+
+    std::vector<uint8_t> bytes;
+    size_t bitsTotal = 0;
+};
+
+// plain LZW, so that long runs, repeated strings and growing code sizes
+// are all seen by the decoder
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& indices) {
+    const size_t clearCode = 1 << MIN_CODE_SIZE;
+    std::map<std::pair<size_t, uint8_t>, size_t> table;
+    size_t nextCode = clearCode + 2;
+    size_t codeSize = MIN_CODE_SIZE + 1;
+
+    BitWriter bits;
+    bits.write(clearCode, codeSize);
+
+    size_t current = indices[0];
+    for (size_t pos = 1; pos < indices.size(); ++pos) {
+        auto entry = table.find(std::make_pair(current, indices[pos]));
+        if (entry != table.end()) {
+            current = entry->second;
+            continue;
+        }
+
+        bits.write(current, codeSize);
+        table[std::make_pair(current, indices[pos])] = nextCode++;
+        if (nextCode > (size_t(1) << codeSize)) {
+            ++codeSize;
+        }
+        current = indices[pos];
+    }
+
+    bits.write(current, codeSize);
+    if (nextCode == (size_t(1) << codeSize)) {
+        ++codeSize;
+    }
+    bits.write(clearCode + 1, codeSize);
+
+    return bits.bytes;
+}
+
+static void putWord(std::string& gif, size_t word) {
+    gif += static_cast<char>(word & 0xFF);
+    gif += static_cast<char>(word >> 8);
+}
+
+static void putImage(   std::string& gif, size_t left, size_t top, size_t width,
+                        size_t height, uint8_t flags,
+                        const std::vector<uint8_t>& indices) {
+    gif += '\x2C';
+    putWord(gif, left);
+    putWord(gif, top);
+    putWord(gif, width);
+    putWord(gif, height);
+    gif += static_cast<char>(flags);
+    if (flags & 0x80) {
+        gif.append(reinterpret_cast<const char*>(LOCAL_PALETTE), sizeof(LOCAL_PALETTE));
+    }
+
+    gif += static_cast<char>(MIN_CODE_SIZE);
+    std::vector<uint8_t> data = compress(indices);
+    for (size_t blockStart = 0; blockStart < data.size(); blockStart += 255) {
+        size_t blockSize = std::min<size_t>(255, data.size() - blockStart);
+        gif += static_cast<char>(blockSize);
+        gif.append(reinterpret_cast<const char*>(data.data()) + blockStart, blockSize);
+    }
+    gif += '\0';
+}
+
+static void putGraphicControl(std::string& gif, uint8_t disposal, bool transparent) {
+    gif += "\x21\xF9\x04";
+    gif += static_cast<char>(disposal << 2 | (transparent ? 1 : 0));
+    putWord(gif, 10);
+    gif += static_cast<char>(TRANSPARENT_INDEX);
+    gif += '\0';
+}
+
+// interlaced first picture, transparent patch disposed to the background,
+// then one pixel with its own palette
+static std::string makeGif() {
+    std::string gif = "GIF89a";
+    putWord(gif, WIDTH);
+    putWord(gif, HEIGHT);
+    gif += '\x81';
+    gif += static_cast<char>(BACKGROUND_INDEX);
+    gif += '\0';
+    gif.append(reinterpret_cast<const char*>(GLOBAL_PALETTE), sizeof(GLOBAL_PALETTE));
+
+    gif += "\x21\xFE\x05" "hello";
+    gif += '\0';
+
+    std::vector<uint8_t> first;
+    const size_t passStart[] = { 0, 4, 2, 1 };
+    const size_t passStep[]  = { 8, 8, 4, 2 };
+    for (size_t pass = 0; pass < 4; ++pass) {
+        for (size_t row = passStart[pass]; row < HEIGHT; row += passStep[pass]) {
+            for (size_t col = 0; col < WIDTH; ++col) {
+                first.push_back(firstIndex(row, col));
+            }
+        }
+    }
+    putImage(gif, 0, 0, WIDTH, HEIGHT, 0x40, first);
+
+    std::vector<uint8_t> patch;
+    for (size_t row = 0; row < PATCH_HEIGHT; ++row) {
+        for (size_t col = 0; col < PATCH_WIDTH; ++col) {
+            patch.push_back(patchIndex(row, col));
+        }
+    }
+    putGraphicControl(gif, 2, true);
+    putImage(gif, PATCH_LEFT, PATCH_TOP, PATCH_WIDTH, PATCH_HEIGHT, 0, patch);
+
+    putImage(gif, 0, 0, 1, 1, 0x81, std::vector<uint8_t>(1, 3));
+    gif += '\x3B';
+
+    return gif;
+}
+
+static bool checkCanvas(const GifDecoder& decoder,
+                        const std::vector<obj_brightness>& expected,
+                        size_t picture) {
+    for (size_t pixel = 0; pixel < expected.size(); ++pixel) {
+        if (decoder.canvas()[pixel] != expected[pixel]) {
+            std::cerr << "Wrong pixel " << pixel << " of picture " << picture
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = std::string(argc > 1 ? argv[1] : ".") + "/gif_decoder_test.gif";
+    std::string gif = makeGif();
+    std::ofstream(path, std::ios::binary) << gif;
+
+    obj_brightness globalGrays[4];
+    obj_brightness localGrays[4];
+    rgb24RowToGrayscale(GLOBAL_PALETTE, 4, globalGrays);
+    rgb24RowToGrayscale(LOCAL_PALETTE, 4, localGrays);
+
+    if (!isGifFile(path)) {
+        std::cerr << "GIF signature not recognized" << std::endl;
+        return 1;
+    }
+
+    GifDecoder decoder(path);
+    if (decoder.width() != WIDTH || decoder.height() != HEIGHT) {
+        std::cerr << "Wrong canvas size" << std::endl;
+        return 1;
+    }
+
+    std::vector<obj_brightness> expected(WIDTH * HEIGHT);
+    for (size_t row = 0; row < HEIGHT; ++row) {
+        for (size_t col = 0; col < WIDTH; ++col) {
+            expected[row * WIDTH + col] = globalGrays[firstIndex(row, col)];
+        }
+    }
+    if (!decoder.nextFrame() || !checkCanvas(decoder, expected, 0)) {
+        return 1;
+    }
+
+    std::vector<obj_brightness> firstPicture = expected;
+    for (size_t row = PATCH_TOP; row < HEIGHT; ++row) {
+        for (size_t col = PATCH_LEFT; col < WIDTH; ++col) {
+            uint8_t index = patchIndex(row - PATCH_TOP, col - PATCH_LEFT);
+            if (index != TRANSPARENT_INDEX) {
+                expected[row * WIDTH + col] = globalGrays[index];
+            }
+        }
+    }
+    if (!decoder.nextFrame() || !checkCanvas(decoder, expected, 1)) {
+        return 1;
+    }
+
+    expected = firstPicture;
+    for (size_t row = PATCH_TOP; row < HEIGHT; ++row) {
+        for (size_t col = PATCH_LEFT; col < WIDTH; ++col) {
+            expected[row * WIDTH + col] = globalGrays[BACKGROUND_INDEX];
+        }
+    }
+    expected[0] = localGrays[3];
+    if (!decoder.nextFrame() || !checkCanvas(decoder, expected, 2)) {
+        return 1;
+    }
+
+    if (decoder.nextFrame()) {
+        std::cerr << "Picture found after the trailer" << std::endl;
+        return 1;
+    }
+
+    // cut in the middle of the image data
+    std::ofstream(path, std::ios::binary) << gif.substr(0, gif.size() / 2);
+    try {
+        GifDecoder truncated(path);
+        while (truncated.nextFrame()) {
+        }
+
+        std::cerr << "Truncated image was accepted" << std::endl;
+        return 1;
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    std::cout << "GIF decoder test passed" << std::endl;
+    return 0;
+}
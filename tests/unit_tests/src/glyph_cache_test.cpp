@@ -0,0 +1,227 @@
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+    #include <dirent.h>
+    #include <unistd.h>
+}
+
+#include "glyph_cache.h"
+
+static GlyphVocabulary makeTestVocabulary() {
+    GlyphVocabulary vocab;
+    vocab.fontWidth  = 3;
+    vocab.fontHeight = 5;
+    vocab.invert     = true;
+
+    for (code_point symbol = FIRST_PRINTABLE_ASCII_SYMBOL;
+              symbol <= LAST_PRINTABLE_ASCII_SYMBOL; ++symbol) {
+        vocab.brightness.insert(symbol_brightness_pair(symbol, symbol * 2));
+        vocab.glyphSymbols.push_back(symbol);
+        vocab.glyphCells.insert(vocab.glyphCells.end(),
+                                vocab.fontWidth * vocab.fontHeight, symbol);
+    }
+
+    for (size_t brightness = 0; brightness <= MAX_GRAY_LEVELS; ++brightness) {
+        vocab.brightnessLookup[brightness] = FIRST_PRINTABLE_ASCII_SYMBOL
+                                            + brightness % 95;
+    }
+
+    return vocab;
+}
+
+static bool sameVocabulary(const GlyphVocabulary& lhs, const GlyphVocabulary& rhs) {
+    return     lhs.fontWidth        == rhs.fontWidth
+            && lhs.fontHeight       == rhs.fontHeight
+            && lhs.invert           == rhs.invert
+            && lhs.brightness       == rhs.brightness
+            && lhs.brightnessLookup == rhs.brightnessLookup
+            && lhs.glyphSymbols     == rhs.glyphSymbols
+            && lhs.glyphCells       == rhs.glyphCells;
+}
+
+// threads of one process storing the same vocabulary write files of their
+// own, the cache file is always a complete one and no temporary file is left
+static bool checkConcurrentStores(  const std::string& cacheDir,
+                                    const VocabularyCacheKey& key,
+                                    const GlyphVocabulary& stored) {
+    std::vector<std::thread> writers;
+    for (size_t writer = 0; writer < 4; ++writer) {
+        writers.push_back(std::thread([&]() {
+            for (size_t store = 0; store < 20; ++store) {
+                storeVocabularyCache(cacheDir, key, stored);
+            }
+        }));
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+
+    GlyphVocabulary restored;
+    if (    !loadVocabularyCache(cacheDir, key, restored)
+        ||  !sameVocabulary(stored, restored)) {
+        std::cerr << "Concurrently stored vocabulary was not restored" << std::endl;
+        return false;
+    }
+
+    DIR* dir = opendir(cacheDir.c_str());
+    bool leftovers = false;
+    for (dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        leftovers = leftovers || std::string(entry->d_name).find(".tmp")
+                                    != std::string::npos;
+    }
+    closedir(dir);
+
+    if (leftovers) {
+        std::cerr << "Temporary cache files were left" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+}
+
+// overwrites the bytes at the offset from the end of the only cache file of
+// the directory
+static void damageCacheFile(const std::string& cacheDir, const std::string& original,
+                            size_t offsetFromEnd, const std::string& bytes) {
+    std::string damaged = original;
+    damaged.replace(damaged.size() - offsetFromEnd, bytes.size(), bytes);
+
+    DIR* dir = opendir(cacheDir.c_str());
+    for (dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            std::ofstream(cacheDir + "/" + entry->d_name, std::ios::binary) << damaged;
+        }
+    }
+    closedir(dir);
+}
+
+// files of the right size whose lookup table or records do not match the
+// symbols are cache misses
+static bool checkDamagedFiles(const std::string& argDir) {
+    const std::string cacheDir = argDir + "/glyph_cache_damaged_test_dir";
+    const std::string fontPath = cacheDir + "_font.bin";
+    std::ofstream(fontPath) << "damaged font "
+                    << std::chrono::system_clock::now().time_since_epoch().count();
+    VocabularyCacheKey key = makeVocabularyCacheKey(fontPath, 12, 72, true);
+
+    // files of previous runs are removed, the stored one is the only file
+    DIR* dir = opendir(cacheDir.c_str());
+    for (dirent* entry = dir ? readdir(dir) : NULL; entry != NULL; entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            unlink((cacheDir + "/" + entry->d_name).c_str());
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+
+    GlyphVocabulary stored = makeTestVocabulary();
+    stored.glyphCells.clear();
+    storeVocabularyCache(cacheDir, key, stored);
+
+    dir = opendir(cacheDir.c_str());
+    std::string original;
+    for (dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            original = readFile(cacheDir + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    const size_t lookupSize = (MAX_GRAY_LEVELS + 1) * sizeof(uint32_t);
+    const uint32_t unknownSymbol = 0x2588;
+    const uint32_t firstRecord[] = {    FIRST_PRINTABLE_ASCII_SYMBOL,
+                                        FIRST_PRINTABLE_ASCII_SYMBOL * 2 };
+    const uint32_t brightRecord[] = { LAST_PRINTABLE_ASCII_SYMBOL, 1000 };
+
+    // the lookup entry of the last brightness, then the last symbol record
+    // turned into a second one of the first symbol, then a brightness out of
+    // the range in the last record
+    const size_t offsets[] = {  sizeof(uint32_t),
+                                lookupSize + sizeof(firstRecord),
+                                lookupSize + sizeof(brightRecord) };
+    const std::string damages[] = {
+        std::string(reinterpret_cast<const char*>(&unknownSymbol), sizeof(uint32_t)),
+        std::string(reinterpret_cast<const char*>(firstRecord), sizeof(firstRecord)),
+        std::string(reinterpret_cast<const char*>(brightRecord), sizeof(brightRecord))
+    };
+
+    for (size_t damage = 0; damage < 3; ++damage) {
+        damageCacheFile(cacheDir, original, offsets[damage], damages[damage]);
+
+        GlyphVocabulary restored;
+        if (loadVocabularyCache(cacheDir, key, restored)) {
+            std::cerr << "Damaged cache file #" << damage << " was restored" << std::endl;
+            return false;
+        }
+    }
+
+    damageCacheFile(cacheDir, original, 0, "");
+    GlyphVocabulary restored;
+    if (!loadVocabularyCache(cacheDir, key, restored)) {
+        std::cerr << "Undamaged cache file was not restored" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string cacheDir = std::string(argc > 1 ? argv[1] : ".")
+                            + "/glyph_cache_test_dir";
+    std::string fontPath = cacheDir + "_font.bin";
+    // unique font contents, so that files left by previous runs never match
+    std::ofstream(fontPath) << "not really a font "
+                    << std::chrono::system_clock::now().time_since_epoch().count();
+
+    VocabularyCacheKey key = makeVocabularyCacheKey(fontPath, 12, 72, true);
+    GlyphVocabulary stored = makeTestVocabulary();
+    GlyphVocabulary restored;
+
+    if (loadVocabularyCache(cacheDir, key, restored)) {
+        std::cerr << "Vocabulary restored before it was stored" << std::endl;
+        return 1;
+    }
+
+    storeVocabularyCache(cacheDir, key, stored);
+    if (!loadVocabularyCache(cacheDir, key, restored)
+        || !sameVocabulary(stored, restored)) {
+        std::cerr << "Stored vocabulary was not restored" << std::endl;
+        return 1;
+    }
+
+    if (!checkConcurrentStores(cacheDir, key, stored)) {
+        return 1;
+    }
+
+    if (!checkDamagedFiles(argc > 1 ? argv[1] : ".")) {
+        return 1;
+    }
+
+    VocabularyCacheKey otherSize = makeVocabularyCacheKey(fontPath, 13, 72, true);
+    VocabularyCacheKey otherCharset = makeVocabularyCacheKey(fontPath, 12, 72, true,
+                                                            parseCharset("blocks"));
+    std::ofstream(fontPath) << "other font contents";
+    VocabularyCacheKey otherFont = makeVocabularyCacheKey(fontPath, 12, 72, true);
+    if (    loadVocabularyCache(cacheDir, otherSize, restored)
+        ||  loadVocabularyCache(cacheDir, otherCharset, restored)
+        ||  loadVocabularyCache(cacheDir, otherFont, restored)) {
+        std::cerr << "Vocabulary restored for a different key" << std::endl;
+        return 1;
+    }
+
+    std::cout << "glyph cache test passed" << std::endl;
+    return 0;
+}
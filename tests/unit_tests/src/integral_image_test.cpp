@@ -0,0 +1,76 @@
+#include <iostream>
+#include <random>
+
+#include "grayscale_bitmap.h"
+
+static SDL_Surface* makeNoiseSurface(int width, int height) {
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 32,
+                                                0x00FF0000, 0x0000FF00,
+                                                0x000000FF, 0);
+    if (surface == NULL) {
+        return NULL;
+    }
+
+    std::mt19937 generator(width * height);
+    for (int row = 0; row < height; ++row) {
+        uint32_t* pixelRow = reinterpret_cast<uint32_t*>(
+                    static_cast<uint8_t*>(surface->pixels) + row * surface->pitch);
+        for (int col = 0; col < width; ++col) {
+            pixelRow[col] = generator() & 0x00FFFFFF;
+        }
+    }
+
+    return surface;
+}
+
+// every frame sum taken from the summed-area table must match the one
+// calculated by going through the frame pixels
+static bool checkFrameSize(FramedBitmap& scanMap, FramedBitmap& integralMap,
+                            size_t width, size_t height) {
+    scanMap.setFrameSize(width, height);
+    integralMap.setFrameSize(width, height);
+
+    FrameSlider scanFrame       = scanMap.firstFrame();
+    FrameSlider integralFrame   = integralMap.firstFrame();
+    const FrameSlider scanEnd   = scanMap.lastFrame();
+
+    while (true) {
+        if (scanFrame.brightnessSum() != integralFrame.brightnessSum()) {
+            std::cerr << "Brightness mismatch for " << width << "x" << height
+                      << " frames" << std::endl;
+            return false;
+        }
+
+        if (scanFrame == scanEnd) {
+            return true;
+        }
+
+        scanFrame.slide();
+        integralFrame.slide();
+    }
+}
+
+int main() {
+    SDL_Surface* surface = makeNoiseSurface(257, 131);
+    if (surface == NULL) {
+        std::cerr << "Unable to create test surface" << std::endl;
+        return 1;
+    }
+
+    FramedBitmap scanMap(surface);
+    FramedBitmap integralMap(surface);
+    SDL_FreeSurface(surface);
+
+    integralMap.buildIntegralImage();
+
+    const size_t frameSizes[][2] = { {1, 1}, {3, 7}, {6, 13}, {20, 33},
+                                     {257, 131} };
+    for (const size_t* frameSize : frameSizes) {
+        if (!checkFrameSize(scanMap, integralMap, frameSize[0], frameSize[1])) {
+            return 1;
+        }
+    }
+
+    std::cout << "integral image test passed" << std::endl;
+    return 0;
+}
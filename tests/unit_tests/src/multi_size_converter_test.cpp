@@ -0,0 +1,133 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "multi_size_converter.h"
+#include "image_processor.h"
+#include "error_diffusion.h"
+#include "test_vocabulary.h"
+
+static const size_t IMAGE_ROWS    = 97;
+static const size_t IMAGE_COLUMNS = 131;
+static const size_t WORKERS       = 3;
+
+// symbols of one size matched on their own, the way a single size run does
+static std::vector<code_point> singleSizeMatches(   const FramedBitmap& map,
+                                                    const GlyphVocabulary& vocab,
+                                                    const Settings& settings) {
+    FramedBitmap sized = map.view();
+    sized.setFrameSize(vocab.fontWidth, vocab.fontHeight);
+
+    if (settings.dithering != NO_DITHERING) {
+        ErrorDiffusion diffusion(vocab, settings.dithering);
+        DiffusionWavefront wavefront(sized);
+        diffusion.matchStrips(sized, wavefront, 0);
+        return wavefront.frameMatches;
+    }
+
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(vocab,
+                                                settings.matching, settings.shapeGrid);
+    ImageToTextResult result(sized.countFrames());
+    processImagePart(sized, 0, sized.countFrames(), *matcher, result);
+    return result.frameMatches;
+}
+
+static bool checkSizes( const FramedBitmap& map,
+                        const std::vector<GlyphVocabulary>& vocabs,
+                        const Settings& settings, ThreadPool& pool,
+                        const std::string& name) {
+    std::vector<SizeMatches> matches = matchImageSizes(map, vocabs, settings, pool);
+    if (matches.size() != vocabs.size()) {
+        std::cerr << name << ": " << matches.size() << " sizes matched instead of "
+                  << vocabs.size() << std::endl;
+        return false;
+    }
+
+    for (size_t size = 0; size < vocabs.size(); ++size) {
+        const GlyphVocabulary& vocab = vocabs[size];
+        if (    matches[size].framesInStrip != map.columns / vocab.fontWidth
+            ||  matches[size].frameMatches != singleSizeMatches(map, vocab, settings)) {
+            std::cerr << name << ": symbols of the " << vocab.fontWidth << "x"
+                      << vocab.fontHeight << " size differ from the single size "
+                      << "ones" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool checkOutfilePaths() {
+    const char* cases[][2] = {
+        { "art/cat.txt",    "art/cat.8.txt"     },
+        { "art.d/cat",      "art.d/cat.8"       },
+        { "cat.tar.txt",    "cat.tar.8.txt"     }
+    };
+
+    for (const auto& pathCase : cases) {
+        if (sizedOutfilePath(pathCase[0], 8) != pathCase[1]) {
+            std::cerr << "Output of size 8 for '" << pathCase[0] << "' is '"
+                      << sizedOutfilePath(pathCase[0], 8) << "'" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    const size_t stride = IMAGE_COLUMNS + 5;
+    std::mt19937 generator(stride);
+    pixels_vector pixels(stride * IMAGE_ROWS);
+    for (obj_brightness& pixel : pixels) {
+        pixel = generator() % (MAX_GRAY_LEVELS + 1);
+    }
+
+    FramedBitmap map(pixels.data(), IMAGE_ROWS, IMAGE_COLUMNS, stride,
+                    shared_owner_ptr());
+
+    // the biggest size fits fewer frames than there are workers
+    const std::vector<GlyphVocabulary> vocabs = {
+        flatVocabulary(2, 3, "#+ "), flatVocabulary(5, 9, "#+ "),
+        flatVocabulary(40, 70, "#+ ")
+    };
+    ThreadPool pool(WORKERS);
+
+    Settings settings;
+    settings.frameCacheEntries = 0;
+    if (!checkSizes(map, vocabs, settings, pool, "mean")) {
+        return 1;
+    }
+
+    settings.matching = SHAPE_MATCHING;
+    settings.frameCacheEntries = 64;
+    if (!checkSizes(map, vocabs, settings, pool, "shape, frame cache")) {
+        return 1;
+    }
+
+    settings.matching = MEAN_BRIGHTNESS_MATCHING;
+    settings.frameCacheEntries = 0;
+    settings.dithering = ATKINSON_DITHERING;
+    if (!checkSizes(map, vocabs, settings, pool, "dithered")) {
+        return 1;
+    }
+
+    // views made after the table is built share it
+    settings.dithering = NO_DITHERING;
+    map.buildIntegralImage();
+    if (!map.view().hasIntegralImage()) {
+        std::cerr << "Summed-area table is not shared with the view" << std::endl;
+        return 1;
+    }
+    if (!checkSizes(map, vocabs, settings, pool, "integral image")) {
+        return 1;
+    }
+
+    if (!checkOutfilePaths()) {
+        return 1;
+    }
+
+    std::cout << "multi-size converter test passed" << std::endl;
+    return 0;
+}
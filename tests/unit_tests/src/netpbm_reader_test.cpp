@@ -0,0 +1,157 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "netpbm_reader.h"
+#include "frame_kernels.h"
+
+static const size_t COLUMNS = 301;
+static const size_t ROWS    = 419;
+
+static uint32_t sampleAt(size_t row, size_t col, size_t channel, uint32_t maxValue) {
+    return (row * 7 + col * 13 + channel * 101) % (maxValue + 1);
+}
+
+static obj_brightness scaled(uint32_t sample, uint32_t maxValue) {
+    return (sample * MAX_GRAY_LEVELS + maxValue / 2) / maxValue;
+}
+
+// the header has a comment and the widest separators the format allows
+static void writeImage(const std::string& path, size_t channels, uint32_t maxValue) {
+    std::ofstream file(path, std::ios::binary);
+    file << 'P' << (channels == 1 ? '5' : '6') << "\n# test image\n"
+         << COLUMNS << "  " << ROWS << "\n\t" << maxValue << '\n';
+
+    for (size_t row = 0; row < ROWS; ++row) {
+        for (size_t col = 0; col < COLUMNS; ++col) {
+            for (size_t channel = 0; channel < channels; ++channel) {
+                uint32_t sample = sampleAt(row, col, channel, maxValue);
+                if (maxValue > MAX_GRAY_LEVELS) {
+                    file.put(static_cast<char>(sample >> 8));
+                }
+                file.put(static_cast<char>(sample & 0xFF));
+            }
+        }
+    }
+}
+
+static obj_brightness expectedGray(size_t row, size_t col, size_t channels,
+                                    uint32_t maxValue) {
+    obj_brightness levels[3];
+    for (size_t channel = 0; channel < channels; ++channel) {
+        levels[channel] = scaled(sampleAt(row, col, channel, maxValue), maxValue);
+    }
+
+    return channels == 1 ? levels[0]
+                         : rgbToGrayscale(levels[0], levels[1], levels[2]);
+}
+
+// rows are read in uneven portions, some larger than the read-ahead buffer
+static bool checkReader(const std::string& path, size_t channels, uint32_t maxValue) {
+    writeImage(path, channels, maxValue);
+
+    NetpbmReader reader(path);
+    if (reader.rows() != ROWS || reader.columns() != COLUMNS) {
+        std::cerr << "Wrong size read from the header" << std::endl;
+        return false;
+    }
+
+    const size_t stride = COLUMNS + 3;
+    const size_t portions[] = { 1, 2, 250, 17, 149 };
+    size_t firstRow = 0;
+
+    for (size_t count : portions) {
+        std::vector<obj_brightness> grays(count * stride);
+        reader.readRows(count, grays.data(), stride);
+
+        for (size_t row = 0; row < count; ++row) {
+            for (size_t col = 0; col < COLUMNS; ++col) {
+                obj_brightness expected = expectedGray(firstRow + row, col,
+                                                        channels, maxValue);
+                if (grays[row * stride + col] != expected) {
+                    std::cerr   << "Wrong gray level at " << firstRow + row << ':'
+                                << col << " of " << channels << " channel image "
+                                << "with maximum value " << maxValue << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        firstRow += count;
+    }
+
+    return true;
+}
+
+// 8-bit PGM images are viewed in the mapping, the rest are converted
+static bool checkMapping(const std::string& path, size_t channels, uint32_t maxValue) {
+    FramedBitmap map = mapNetpbmImage(path);
+    if (map.rows != ROWS || map.columns != COLUMNS) {
+        std::cerr << "Wrong size of the mapped image" << std::endl;
+        return false;
+    }
+
+    bool viewed = channels == 1 && maxValue == MAX_GRAY_LEVELS;
+    if (viewed != !map.pixels) {
+        std::cerr << "Mapped image is " << (viewed ? "copied" : "not converted")
+                  << std::endl;
+        return false;
+    }
+
+    for (size_t row = 0; row < ROWS; ++row) {
+        for (size_t col = 0; col < COLUMNS; ++col) {
+            if (map.rowPixels(row)[col] != expectedGray(row, col, channels, maxValue)) {
+                std::cerr   << "Wrong mapped gray level at " << row << ':' << col
+                            << " of " << channels << " channel image with "
+                            << "maximum value " << maxValue << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = std::string(argc > 1 ? argv[1] : ".")
+                        + "/netpbm_reader_test.pnm";
+
+    const uint32_t maxValues[] = { 255, 100, 1000, 65535 };
+    for (size_t channels : { 1, 3 }) {
+        for (uint32_t maxValue : maxValues) {
+            if (    !checkReader(path, channels, maxValue)
+                ||  !checkMapping(path, channels, maxValue)) {
+                return 1;
+            }
+        }
+    }
+
+    bool truncatedDetected = false;
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "P5 4 4 255\n" << "0123456789";
+    }
+    try {
+        NetpbmReader reader(path);
+        std::vector<obj_brightness> grays(16);
+        reader.readRows(4, grays.data(), 4);
+    }
+    catch (const std::runtime_error&) {
+        truncatedDetected = true;
+    }
+
+    try {
+        mapNetpbmImage(path);
+        truncatedDetected = false;
+    }
+    catch (const std::runtime_error&) {}
+
+    if (!truncatedDetected) {
+        std::cerr << "Truncated image was read without an error" << std::endl;
+        return 1;
+    }
+
+    std::cout << "netpbm reader test passed" << std::endl;
+    return 0;
+}
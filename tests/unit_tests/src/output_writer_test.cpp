@@ -0,0 +1,200 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "output_writer.h"
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static std::string expectedText(const std::vector<code_point>& symbols,
+                                size_t symbolsInLine) {
+    std::string text;
+    for (size_t lineStart = 0; lineStart < symbols.size(); lineStart += symbolsInLine) {
+        appendUtf8(symbols.data() + lineStart, symbolsInLine, text);
+        text += '\n';
+    }
+
+    return text;
+}
+
+// buffer sizes make lines fit exactly, leave gaps and overflow the buffer
+static bool checkWriter(const std::string& path, size_t bufferSize,
+                        size_t symbolsInLine) {
+    // every symbol length of UTF-8 takes part
+    const code_point wide[] = { 0xE9, 0x2588, 0x1F600 };
+    std::vector<code_point> symbols;
+    for (size_t symbol = 0; symbol < symbolsInLine * 37; ++symbol) {
+        symbols.push_back(symbol % 5 == 4 ? wide[symbol % 3] : '!' + symbol % 90);
+    }
+
+    {
+        TextWriter writer(path, bufferSize);
+        size_t half = symbols.size() / symbolsInLine / 2 * symbolsInLine;
+        writer.writeLines(symbols.data(), half, symbolsInLine);
+        writer.writeLines(symbols.data() + half, symbols.size() - half, symbolsInLine);
+        writer.flush();
+
+        if (writer.bytesWritten() != expectedText(symbols, symbolsInLine).size()) {
+            std::cerr << "Wrong number of bytes reported" << std::endl;
+            return false;
+        }
+    }
+
+    if (readFile(path) != expectedText(symbols, symbolsInLine)) {
+        std::cerr << "Wrong output with " << bufferSize << " bytes buffer and "
+                  << symbolsInLine << " symbols in line" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// raw bytes go between the lines in order, even when they overflow the buffer
+static bool checkRawBytes(const std::string& path) {
+    const std::string header = "picture 1 full\n";
+    const std::string longBlock(100, '*');
+    {
+        TextWriter writer(path, 32);
+        writer.write(header.data(), header.size());
+        const code_point first[] = { 'a', 'b', 'c', 'd', 0x2588, 'f' };
+        const code_point second[] = { 0x2800, 'h' };
+        writer.writeLines(first, 6, 3);
+        writer.write(longBlock.data(), longBlock.size());
+        writer.writeLines(second, 2, 2);
+        writer.flush();
+    }
+
+    const std::string expected = header + "abc\nd\xE2\x96\x88" "f\n"
+                                + longBlock + "\xE2\xA0\x80" "h\n";
+    if (readFile(path) != expected) {
+        std::cerr << "Wrong output of raw bytes" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static std::string coloredOutput(  const std::string& path, ColorMode mode,
+                                    const code_point* symbols,
+                                    const RgbColor* colors, size_t count,
+                                    size_t symbolsInLine) {
+    {
+        TextWriter writer(path, 16);
+        ColorTextWriter colored(writer, mode, false);
+        colored.writeLines(symbols, colors, count, symbolsInLine);
+        colored.finish();
+        writer.flush();
+    }
+
+    return readFile(path);
+}
+
+// color is set where it changes, spaces go on with the run they are in
+static bool checkColoredRuns(const std::string& path) {
+    const RgbColor red = { 255, 0, 0 }, blue = { 0, 0, 255 };
+    const code_point symbols[] = { 'a', 'b', ' ', 'c', 'd', '<',
+                                   ' ', ' ', 'e', 0x2588, ' ', '&' };
+    const RgbColor colors[] = { red, red, blue, red, blue, blue,
+                                red, blue, blue, blue, red, blue };
+
+    // leading spaces are written before any color is set
+    const std::string expectedAnsi = "\x1b[38;2;255;0;0mab c\x1b[38;2;0;0;255md<"
+                                     "\x1b[0m\n  \x1b[38;2;0;0;255me\xE2\x96\x88 &"
+                                     "\x1b[0m\n";
+    if (coloredOutput(path, ANSI_TRUECOLOR, symbols, colors, 12, 6) != expectedAnsi) {
+        std::cerr << "Wrong 24-bit color output" << std::endl;
+        return false;
+    }
+
+    const std::string expected256 = "\x1b[38;5;196mab c\x1b[38;5;21md<\x1b[0m\n"
+                                    "  \x1b[38;5;21me\xE2\x96\x88 &\x1b[0m\n";
+    if (coloredOutput(path, ANSI_256_COLOR, symbols, colors, 12, 6) != expected256) {
+        std::cerr << "Wrong 256-color output" << std::endl;
+        return false;
+    }
+
+    const std::string html = coloredOutput(path, HTML_COLOR, symbols, colors, 12, 6);
+    const std::string expectedLines =
+        "<span style=\"color:#ff0000\">ab c</span>"
+        "<span style=\"color:#0000ff\">d&lt;</span>\n"
+        "  <span style=\"color:#0000ff\">e\xE2\x96\x88 &amp;</span>\n";
+    const size_t linesStart = html.find("<pre");
+    const size_t linesEnd   = html.find("</pre>");
+    if (    html.compare(0, 15, "<!DOCTYPE html>") != 0
+        ||  linesStart == std::string::npos || linesEnd == std::string::npos
+        ||  html.substr(html.find('\n', linesStart) + 1,
+                        linesEnd - html.find('\n', linesStart) - 1) != expectedLines
+        ||  html.find("background:#ffffff") == std::string::npos) {
+        std::cerr << "Wrong HTML output:\n" << html << std::endl;
+        return false;
+    }
+
+    // blank lines have no color to reset
+    const code_point blank[] = { ' ', ' ' };
+    if (coloredOutput(path, ANSI_TRUECOLOR, blank, colors, 2, 2) != "  \n") {
+        std::cerr << "Wrong output of a blank line" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool checkPaletteIndex() {
+    struct PaletteCase {
+        RgbColor    color;
+        uint8_t     index;
+    };
+    const PaletteCase cases[] = {
+        { {   0,   0,   0 },  16 },
+        { { 255, 255, 255 }, 231 },
+        { {  95, 135, 175 },  67 },
+        { { 100, 100, 100 }, 241 },
+        { {   8,   8,   8 }, 232 },
+        { { 238, 238, 238 }, 255 },
+        { { 250,  10,  12 }, 196 }
+    };
+
+    for (const PaletteCase& paletteCase : cases) {
+        uint8_t index = ColorTextWriter::paletteIndex(paletteCase.color);
+        if (index != paletteCase.index) {
+            std::cerr << "Palette index of (" << int(paletteCase.color.red) << ", "
+                      << int(paletteCase.color.green) << ", "
+                      << int(paletteCase.color.blue) << ") is " << int(index)
+                      << " instead of " << int(paletteCase.index) << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = std::string(argc > 1 ? argv[1] : ".")
+                        + "/output_writer_test.txt";
+
+    const size_t cases[][2] = { {1 << 20, 80}, {81, 80}, {100, 80}, {16, 80},
+                                {1, 1} };
+    for (const size_t* writerCase : cases) {
+        if (!checkWriter(path, writerCase[0], writerCase[1])) {
+            return 1;
+        }
+    }
+
+    if (!checkRawBytes(path)) {
+        return 1;
+    }
+
+    if (!checkColoredRuns(path) || !checkPaletteIndex()) {
+        return 1;
+    }
+
+    std::cout << "output writer test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sequence_converter.h"
+#include "freetype_interface.h"
+#include "test_vocabulary.h"
+
+static const size_t FONT_WIDTH  = 2;
+static const size_t FONT_HEIGHT = 3;
+static const size_t FRAME_COLS  = 9;
+static const size_t FRAME_ROWS  = 6;
+
+// one extra pixel column is outside the frames
+static FramedBitmap makePicture(size_t shift, size_t frameCols = FRAME_COLS) {
+    FramedBitmap picture(FRAME_ROWS * FONT_HEIGHT, frameCols * FONT_WIDTH + 1);
+    obj_brightness* pixels = picture.pixels->data();
+    for (size_t row = 0; row < picture.rows; ++row) {
+        for (size_t col = 0; col < picture.columns; ++col) {
+            size_t level = (row / FONT_HEIGHT + col / FONT_WIDTH + shift) % 3;
+            pixels[row * picture.columns + col] = FLAT_LEVELS[level];
+        }
+    }
+
+    return picture;
+}
+
+static void setPixel(FramedBitmap& picture, size_t row, size_t col, obj_brightness level) {
+    picture.pixels->at(row * picture.columns + col) = level;
+}
+
+static bool checkSymbols(   const TemporalMatcher& temporal, FramedBitmap& picture,
+                            const FrameMatcher& matcher) {
+    TemporalMatcher fresh(matcher, FONT_WIDTH, FONT_HEIGHT, 1);
+    fresh.update(picture);
+
+    if (temporal.symbols() != fresh.symbols()) {
+        std::cerr << "Reused symbols differ from a whole match" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static size_t countChanged(const TemporalMatcher& temporal) {
+    size_t changed = 0;
+    for (char flag : temporal.changedFrames()) {
+        changed += flag ? 1 : 0;
+    }
+
+    return changed;
+}
+
+static bool checkTemporalMatcher(size_t workersNum) {
+    GlyphVocabulary vocab = flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ ");
+    MeanBrightnessMatcher matcher(vocab);
+    TemporalMatcher temporal(matcher, FONT_WIDTH, FONT_HEIGHT, workersNum);
+
+    FramedBitmap first = makePicture(0);
+    if (    temporal.update(first) != FRAME_COLS * FRAME_ROWS || !temporal.keyframe()
+        ||  countChanged(temporal) != FRAME_COLS * FRAME_ROWS
+        ||  !checkSymbols(temporal, first, matcher)) {
+        std::cerr << "First picture was not matched whole" << std::endl;
+        return false;
+    }
+
+    // black frame turns white, frame next to it gets one pixel a bit lighter,
+    // pixel outside the frames changes too
+    FramedBitmap second = makePicture(0);
+    for (size_t row = 3; row < 6; ++row) {
+        for (size_t col = 4; col < 6; ++col) {
+            setPixel(second, row, col, MAX_GRAY_LEVELS);
+        }
+    }
+    setPixel(second, 4, 6, 1);
+    setPixel(second, 10, FRAME_COLS * FONT_WIDTH, 77);
+
+    if (    temporal.update(second) != 2 || temporal.keyframe()
+        ||  countChanged(temporal) != 1
+        ||  !temporal.changedFrames()[1 * FRAME_COLS + 2]
+        ||  !checkSymbols(temporal, second, matcher)) {
+        std::cerr << "Changed frames of the second picture were not found"
+                  << std::endl;
+        return false;
+    }
+
+    FramedBitmap same = makePicture(0);
+    for (size_t row = 3; row < 6; ++row) {
+        for (size_t col = 4; col < 6; ++col) {
+            setPixel(same, row, col, MAX_GRAY_LEVELS);
+        }
+    }
+    setPixel(same, 4, 6, 1);
+    if (temporal.update(same) != 0 || countChanged(temporal) != 0) {
+        std::cerr << "Unchanged picture was matched again" << std::endl;
+        return false;
+    }
+
+    FramedBitmap shifted = makePicture(1);
+    if (    temporal.update(shifted) != FRAME_COLS * FRAME_ROWS
+        ||  countChanged(temporal) != FRAME_COLS * FRAME_ROWS
+        ||  !checkSymbols(temporal, shifted, matcher)) {
+        std::cerr << "Wholly changed picture was matched wrong" << std::endl;
+        return false;
+    }
+
+    FramedBitmap narrow = makePicture(1, FRAME_COLS - 2);
+    if (    temporal.update(narrow) != (FRAME_COLS - 2) * FRAME_ROWS
+        ||  !temporal.keyframe() || !checkSymbols(temporal, narrow, matcher)) {
+        std::cerr << "Picture of a new size was not matched whole" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool checkNaturalOrder() {
+    const char* ordered[] = { "a/frame1.png", "a/frame2.png", "a/frame02b.png",
+                              "a/frame10.png", "a/frame10b.png", "b/frame0.png" };
+    const size_t count = sizeof(ordered) / sizeof(ordered[0]);
+
+    for (size_t left = 0; left < count; ++left) {
+        for (size_t right = 0; right < count; ++right) {
+            if (naturalPathLess(ordered[left], ordered[right]) != (left < right)) {
+                std::cerr << "Wrong order of '" << ordered[left] << "' and '"
+                          << ordered[right] << "'" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    if (!checkNaturalOrder()) {
+        return 1;
+    }
+
+    const size_t workers[] = { 1, 3 };
+    for (size_t workersNum : workers) {
+        if (!checkTemporalMatcher(workersNum)) {
+            std::cerr << workersNum << " workers" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "sequence converter test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "stream_converter.h"
+#include "netpbm_reader.h"
+#include "converter.h"
+#include "test_vocabulary.h"
+
+static const size_t FONT_WIDTH  = 2;
+static const size_t FONT_HEIGHT = 3;
+static const size_t FRAME_COLS  = 7;
+static const size_t FRAME_ROWS  = 11;
+
+// image is one pixel wider and two pixels taller than the frames, the rest
+// must not be read
+static const size_t WIDTH  = FRAME_COLS * FONT_WIDTH + 1;
+static const size_t HEIGHT = FRAME_ROWS * FONT_HEIGHT + 2;
+
+static std::vector<uint8_t> makeSamples(size_t channels) {
+    std::vector<uint8_t> samples(HEIGHT * WIDTH * channels);
+    for (size_t sample = 0; sample < samples.size(); ++sample) {
+        samples[sample] = static_cast<uint8_t>((sample * 37 + sample / 5 * 11) % 256);
+    }
+
+    return samples;
+}
+
+static void writeImage( const std::string& path, size_t channels,
+                        const std::vector<uint8_t>& samples, size_t bytes) {
+    std::ofstream file(path, std::ios::binary);
+    file << 'P' << (channels == 1 ? '5' : '6') << '\n'
+         << WIDTH << ' ' << HEIGHT << "\n255\n";
+    file.write(reinterpret_cast<const char*>(samples.data()), bytes);
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Reader that checks the portions the stream asks for
+ */
+class CountingSource : public ImageRowSource {
+public:
+    explicit CountingSource(const std::string& path)
+        : reader(path)
+        , rowsRead(0)
+        , emptyReads(0) {
+        imageRows    = reader.rows();
+        imageColumns = reader.columns();
+    }
+
+    void readRows(size_t count, obj_brightness* grays, size_t stride) override {
+        if (count == 0) {
+            ++emptyReads;
+        }
+
+        reader.readRows(count, grays, stride);
+        rowsRead += count;
+    }
+
+    NetpbmReader    reader;
+    size_t          rowsRead;
+    size_t          emptyReads;
+};
+
+static std::string streamImage( const std::string& textPath,
+                                const FrameMatcher& matcher, size_t chunkStrips,
+                                BrightnessEngine engine, ThreadPool& pool,
+                                CountingSource& source,
+                                StatsCollector* stats = NULL) {
+    {
+        TextWriter outfile(textPath, 16);
+        streamRowsToText(   source, matcher, FONT_WIDTH, FONT_HEIGHT, chunkStrips,
+                            engine, pool, outfile, stats);
+    }
+
+    return readFile(textPath);
+}
+
+// chunks of one strip, uneven chunks, a divisor of the strips number and
+// a chunk larger than the image give the same text as the whole image
+static bool checkChunks(const std::string& dir, size_t channels) {
+    const std::string imagePath = dir + "/stream_test.pnm";
+    const std::string textPath  = dir + "/stream_test.txt";
+    std::vector<uint8_t> samples = makeSamples(channels);
+    writeImage(imagePath, channels, samples, samples.size());
+
+    GlyphVocabulary vocab = flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ ");
+    ConverterOptions options;
+    options.threads = 1;
+    Converter converter(vocab, options);
+    const std::string expected = converter.convert(
+                                    samples.data(), WIDTH, HEIGHT, WIDTH * channels,
+                                    channels == 1 ? GRAY8_PIXELS : RGB24_PIXELS);
+
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(
+                                    vocab, MEAN_BRIGHTNESS_MATCHING, options.shapeGrid);
+    const size_t chunkSizes[] = { 1, 2, 3, 4, 11, 12, 100 };
+    const BrightnessEngine engines[] = { PIXEL_SCAN_ENGINE, INTEGRAL_IMAGE_ENGINE };
+    const size_t threads[] = { 1, 3 };
+
+    for (size_t threadsNum : threads) {
+        ThreadPool pool(threadsNum);
+        for (BrightnessEngine engine : engines) {
+            for (size_t chunkStrips : chunkSizes) {
+                CountingSource source(imagePath);
+                std::string text = streamImage( textPath, *matcher, chunkStrips,
+                                                engine, pool, source);
+                if (text != expected) {
+                    std::cerr   << "Wrong text of " << chunkStrips << " strip chunks, "
+                                << channels << " channels, engine #" << engine
+                                << ", " << threadsNum << " threads:\n"
+                                << text << std::endl;
+                    return false;
+                }
+
+                if (    source.rowsRead != FRAME_ROWS * FONT_HEIGHT
+                    ||  source.emptyReads != 0) {
+                    std::cerr   << "Wrong rows read in " << chunkStrips
+                                << " strip chunks: " << source.rowsRead << ", "
+                                << source.emptyReads << " empty reads" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// every chunk is decoded and partitioned separately, while the matching and
+// the output of the whole image are counted once
+static bool checkStageCounts(const std::string& dir) {
+    const std::string imagePath = dir + "/stream_test.pnm";
+    const std::string textPath  = dir + "/stream_test.txt";
+    std::vector<uint8_t> samples = makeSamples(1);
+    writeImage(imagePath, 1, samples, samples.size());
+
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(
+                                    flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ "),
+                                    MEAN_BRIGHTNESS_MATCHING, 3);
+    ThreadPool pool(2);
+    StatsCollector stats(2);
+    CountingSource source(imagePath);
+    streamImage(textPath, *matcher, 4, PIXEL_SCAN_ENGINE, pool, source, &stats);
+
+    const uint64_t chunks = (FRAME_ROWS + 3) / 4;
+    ConversionStats counted = stats.stats();
+    if (    counted.stages[DECODE_STAGE].calls          != chunks
+        ||  counted.stages[PARTITIONING_STAGE].calls    != chunks
+        ||  counted.stages[MATCHING_STAGE].calls        != 1
+        ||  counted.stages[OUTPUT_STAGE].calls          != 1) {
+        std::cerr << "Wrong number of stage passes" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// the image is cut in the fifth strip: the first chunk is written, the one
+// matched while the third fails to decode is not, and the error reaches the
+// caller once the workers are done
+static bool checkDecodeError(const std::string& dir) {
+    const std::string imagePath = dir + "/stream_truncated_test.pgm";
+    const std::string textPath  = dir + "/stream_truncated_test.txt";
+    std::vector<uint8_t> samples = makeSamples(1);
+    writeImage(imagePath, 1, samples, (4 * FONT_HEIGHT + 1) * WIDTH);
+
+    GlyphVocabulary vocab = flatVocabulary(FONT_WIDTH, FONT_HEIGHT, "#+ ");
+    ConverterOptions options;
+    options.threads = 1;
+    const std::string whole = Converter(vocab, options).convert(
+                                    samples.data(), WIDTH, HEIGHT, WIDTH, GRAY8_PIXELS);
+    const std::string firstLines = whole.substr(0, 2 * (FRAME_COLS + 1));
+
+    std::unique_ptr<FrameMatcher> matcher = createFrameMatcher(
+                                    vocab, MEAN_BRIGHTNESS_MATCHING, options.shapeGrid);
+    ThreadPool pool(2);
+    CountingSource source(imagePath);
+
+    try {
+        streamImage(textPath, *matcher, 2, PIXEL_SCAN_ENGINE, pool, source);
+    }
+    catch (const std::runtime_error&) {
+        std::string text = readFile(textPath);
+        if (text != firstLines) {
+            std::cerr << "Wrong text before the decode error:\n" << text << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    std::cerr << "Truncated image streamed without an error" << std::endl;
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: stream_converter_test <scratch directory>" << std::endl;
+        return 1;
+    }
+
+    const std::string dir = argv[1];
+    if (    !checkChunks(dir, 1) || !checkChunks(dir, 3) || !checkStageCounts(dir)
+        ||  !checkDecodeError(dir)) {
+        return 1;
+    }
+
+    std::cout << "stream converter test passed" << std::endl;
+    return 0;
+}
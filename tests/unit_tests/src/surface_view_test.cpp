@@ -0,0 +1,164 @@
+#include <iostream>
+#include <random>
+#include <utility>
+
+#include "grayscale_bitmap.h"
+
+// fills every byte of the rows, including the padding up to the pitch
+static void fillNoise(SDL_Surface* surface, std::mt19937& generator) {
+    uint8_t* bytes = static_cast<uint8_t*>(surface->pixels);
+    for (int pos = 0; pos < surface->pitch * surface->h; ++pos) {
+        bytes[pos] = generator() & 0xFF;
+    }
+}
+
+static SDL_Surface* makePalettedSurface(int width, int height, bool grayPalette,
+                                        std::mt19937& generator) {
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, width, height, 8, 0, 0, 0, 0);
+    if (surface == NULL) {
+        return NULL;
+    }
+
+    SDL_Color colors[256];
+    for (int color = 0; color < 256; ++color) {
+        uint8_t gray = color;
+        colors[color].r = grayPalette ? gray : generator() & 0xFF;
+        colors[color].g = grayPalette ? gray : generator() & 0xFF;
+        colors[color].b = grayPalette ? gray : generator() & 0xFF;
+        colors[color].a = 0xFF;
+    }
+    SDL_SetPaletteColors(surface->format->palette, colors, 0, 256);
+
+    fillNoise(surface, generator);
+    return surface;
+}
+
+static bool sameBitmaps(const GrayscaleBitmap& first, const GrayscaleBitmap& second) {
+    if (first.rows != second.rows || first.columns != second.columns) {
+        return false;
+    }
+
+    for (size_t row = 0; row < first.rows; ++row) {
+        for (size_t col = 0; col < first.columns; ++col) {
+            if (first.rowPixels(row)[col] != second.rowPixels(row)[col]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// the view converts the surface in place, so the copy is made first
+static bool checkSurfaceView(SDL_Surface* surface, const char* name) {
+    if (surface == NULL) {
+        std::cerr << "Unable to create " << name << " test surface" << std::endl;
+        return false;
+    }
+
+    FramedBitmap copied(surface);
+    FramedBitmap viewed(shared_surface_ptr(surface, SDL_FreeSurface));
+
+    if (viewed.pixels || viewed.stride != static_cast<size_t>(surface->pitch)) {
+        std::cerr << "Bitmap over " << name << " surface is not a view" << std::endl;
+        return false;
+    }
+
+    if (!sameBitmaps(copied, viewed)) {
+        std::cerr << "View of " << name << " surface differs from its copy"
+                  << std::endl;
+        return false;
+    }
+
+    FramedBitmap compact(viewed);
+    FramedBitmap moved(std::move(viewed));
+    if (    compact.stride != compact.columns
+        ||  moved.rowPixels(0) != static_cast<obj_brightness*>(surface->pixels)
+        ||  !sameBitmaps(compact, moved)) {
+        std::cerr << "Copy or move of " << name << " surface view is broken"
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// the same glyph stored top-down and bottom-up gives the same cell
+static bool checkGlyphPitch() {
+    const int glyphRows = 3;
+    const int glyphCols = 2;
+    const int pitch     = 4;
+    uint8_t topDown[glyphRows * pitch];
+    uint8_t bottomUp[glyphRows * pitch];
+    for (int row = 0; row < glyphRows; ++row) {
+        for (int col = 0; col < pitch; ++col) {
+            topDown[row * pitch + col] = static_cast<uint8_t>(row * 40 + col * 7 + 1);
+            bottomUp[(glyphRows - 1 - row) * pitch + col] = topDown[row * pitch + col];
+        }
+    }
+
+    FT_SizeRec size = FT_SizeRec();
+    size.metrics.height         = 5 << 6;
+    size.metrics.max_advance    = 4 << 6;
+    size.metrics.ascender       = 4 << 6;
+
+    FT_GlyphSlotRec glyph = FT_GlyphSlotRec();
+    glyph.bitmap.rows       = glyphRows;
+    glyph.bitmap.width      = glyphCols;
+    glyph.bitmap.num_grays  = 256;
+    glyph.bitmap_left       = 1;
+    glyph.bitmap_top        = 3;
+
+    FT_FaceRec face = FT_FaceRec();
+    face.size  = &size;
+    face.glyph = &glyph;
+
+    glyph.bitmap.pitch  = pitch;
+    glyph.bitmap.buffer = topDown;
+    GrayscaleBitmap downwards(&face);
+
+    glyph.bitmap.pitch  = -pitch;
+    glyph.bitmap.buffer = bottomUp;
+    GrayscaleBitmap upwards(&face);
+
+    if (    !sameBitmaps(downwards, upwards)
+        ||  downwards.rowPixels(1)[1] != MAX_GRAY_LEVELS - topDown[0]
+        ||  downwards.rowPixels(3)[2] != MAX_GRAY_LEVELS - topDown[2 * pitch + 1]) {
+        std::cerr << "Glyph with a negative pitch is drawn wrong" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    std::mt19937 generator(31);
+    const int widths[] = { 1, 33, 257 };
+
+    for (int width : widths) {
+        SDL_Surface* rgb888 = SDL_CreateRGBSurface(0, width, 19, 32, 0x00FF0000,
+                                                   0x0000FF00, 0x000000FF, 0);
+        SDL_Surface* rgb24  = SDL_CreateRGBSurface(0, width, 19, 24, 0x00FF0000,
+                                                   0x0000FF00, 0x000000FF, 0);
+        if (rgb888 != NULL && rgb24 != NULL) {
+            fillNoise(rgb888, generator);
+            fillNoise(rgb24, generator);
+        }
+
+        if (    !checkSurfaceView(rgb888, "RGB888")
+            ||  !checkSurfaceView(rgb24, "RGB24")
+            ||  !checkSurfaceView(makePalettedSurface(width, 19, true, generator),
+                                  "gray paletted")
+            ||  !checkSurfaceView(makePalettedSurface(width, 19, false, generator),
+                                  "color paletted")) {
+            return 1;
+        }
+    }
+
+    if (!checkGlyphPitch()) {
+        return 1;
+    }
+
+    std::cout << "surface view test passed" << std::endl;
+    return 0;
+}
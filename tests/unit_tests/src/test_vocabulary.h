@@ -0,0 +1,47 @@
+#ifndef __TEST_VOCABULARY_H__
+#define __TEST_VOCABULARY_H__
+
+/**
+ * @file test_vocabulary.h
+ * @brief Vocabulary of flat glyphs shared by the converter tests
+ */
+
+#include <string>
+
+#include "freetype_interface.h"
+
+/**
+ * @brief Levels of the dark, middle and bright glyphs of the flat vocabulary
+ */
+static const obj_brightness FLAT_LEVELS[] = { 0, 128, MAX_GRAY_LEVELS };
+
+/**
+ * @brief Create a vocabulary of three glyphs of one flat level each
+ * @details Every matching strategy picks the same symbols for such glyphs, so
+ * the symbol of a frame depends on its mean brightness only
+ * @param width, height glyph size
+ * @param symbols dark, middle and bright symbols
+ */
+static inline GlyphVocabulary flatVocabulary(   size_t width, size_t height,
+                                                const std::string& symbols) {
+    GlyphVocabulary vocab;
+    vocab.fontWidth  = width;
+    vocab.fontHeight = height;
+    vocab.invert     = false;
+
+    for (size_t glyph = 0; glyph < symbols.size(); ++glyph) {
+        vocab.glyphSymbols.push_back(symbols[glyph]);
+        vocab.glyphCells.insert(vocab.glyphCells.end(), width * height,
+                                FLAT_LEVELS[glyph]);
+        vocab.brightness[symbols[glyph]] = FLAT_LEVELS[glyph];
+    }
+
+    for (size_t brightness = 0; brightness <= MAX_GRAY_LEVELS; ++brightness) {
+        size_t closest = brightness < 64 ? 0 : brightness < 192 ? 1 : 2;
+        vocab.brightnessLookup[brightness] = symbols[closest];
+    }
+
+    return vocab;
+}
+
+#endif // __TEST_VOCABULARY_H__